@@ -0,0 +1,198 @@
+#include <benchmark/benchmark.h>
+
+#include <math.h>
+#include <random>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/ext.hpp>
+
+#include "bvh.hpp"
+
+// boxes of one to two units spread at the same density for every
+// count, so that the queries find about as much at every size, the
+// reference versions test every box
+
+namespace {
+
+std::vector<BoundingBox> make_boxes(int count)
+{
+  std::mt19937 rng(count);
+  const float side = 4.0f * cbrtf(static_cast<float>(count));
+  std::uniform_real_distribution<float> position(0.0f, side);
+  std::uniform_real_distribution<float> extent(0.5f, 1.0f);
+
+  std::vector<BoundingBox> boxes;
+  for(int i = 0; i < count; ++i)
+  {
+    glm::vec3 center(position(rng), position(rng), position(rng));
+    glm::vec3 half(extent(rng), extent(rng), extent(rng));
+    boxes.emplace_back(center - half, center + half);
+  }
+  return boxes;
+}
+
+void fill(Bvh& bvh, std::vector<BoundingBox> const& boxes)
+{
+  for(auto const& box : boxes)
+  {
+    bvh.insert(box);
+  }
+  bvh.commit();
+}
+
+glm::vec3 get_center(int count)
+{
+  return glm::vec3(2.0f * cbrtf(static_cast<float>(count)));
+}
+
+Frustum make_frustum(int count)
+{
+  glm::vec3 eye = get_center(count);
+  return Frustum(glm::perspective(glm::radians(60.0f), 1.6f, 0.1f, 40.0f) *
+                 glm::lookAt(eye, eye + glm::vec3(1.0f, 0.2f, 0.5f), glm::vec3(0.0f, 1.0f, 0.0f)));
+}
+
+const glm::vec3 ray_direction = glm::normalize(glm::vec3(1.0f, 0.3f, 0.6f));
+
+} // namespace
+
+static void BM_bvh_build(benchmark::State& state)
+{
+  std::vector<BoundingBox> boxes = make_boxes(state.range_x());
+  Bvh bvh;
+  fill(bvh, boxes);
+  while (state.KeepRunning())
+  {
+    bvh.build();
+    benchmark::DoNotOptimize(bvh.get_nodes().data());
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range_x());
+}
+BENCHMARK(BM_bvh_build)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void BM_bvh_refit(benchmark::State& state)
+{
+  // a tenth of the boxes moves back and forth each iteration
+  std::vector<BoundingBox> boxes = make_boxes(state.range_x());
+  Bvh bvh;
+  fill(bvh, boxes);
+  const int moving = state.range_x() / 10;
+  float offset = 0.1f;
+  while (state.KeepRunning())
+  {
+    for(int i = 0; i < moving; ++i)
+    {
+      BoundingBox const& box = bvh.get_box(i * 10);
+      bvh.update(i * 10, BoundingBox(box.min + offset, box.max + offset));
+    }
+    offset = -offset;
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * moving);
+}
+BENCHMARK(BM_bvh_refit)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void BM_bvh_query_frustum(benchmark::State& state)
+{
+  Bvh bvh;
+  fill(bvh, make_boxes(state.range_x()));
+  Frustum frustum = make_frustum(state.range_x());
+  std::vector<int> result;
+  while (state.KeepRunning())
+  {
+    result.clear();
+    bvh.query_frustum(frustum, result);
+    benchmark::DoNotOptimize(result.data());
+  }
+}
+BENCHMARK(BM_bvh_query_frustum)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void BM_bvh_query_frustum_reference(benchmark::State& state)
+{
+  std::vector<BoundingBox> boxes = make_boxes(state.range_x());
+  Frustum frustum = make_frustum(state.range_x());
+  std::vector<int> result;
+  while (state.KeepRunning())
+  {
+    result.clear();
+    for(size_t i = 0; i < boxes.size(); ++i)
+    {
+      if (frustum.intersects_box(boxes[i].min, boxes[i].max))
+      {
+        result.push_back(static_cast<int>(i));
+      }
+    }
+    benchmark::DoNotOptimize(result.data());
+  }
+}
+BENCHMARK(BM_bvh_query_frustum_reference)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void BM_bvh_query_ray(benchmark::State& state)
+{
+  Bvh bvh;
+  fill(bvh, make_boxes(state.range_x()));
+  glm::vec3 origin = get_center(state.range_x());
+  std::vector<int> result;
+  while (state.KeepRunning())
+  {
+    result.clear();
+    bvh.query_ray(origin, ray_direction, 1000.0f, result);
+    benchmark::DoNotOptimize(result.data());
+  }
+}
+BENCHMARK(BM_bvh_query_ray)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void BM_bvh_query_ray_reference(benchmark::State& state)
+{
+  std::vector<BoundingBox> boxes = make_boxes(state.range_x());
+  glm::vec3 origin = get_center(state.range_x());
+  std::vector<int> result;
+  while (state.KeepRunning())
+  {
+    result.clear();
+    for(size_t i = 0; i < boxes.size(); ++i)
+    {
+      float distance;
+      if (boxes[i].intersects_ray(origin, ray_direction, distance))
+      {
+        result.push_back(static_cast<int>(i));
+      }
+    }
+    benchmark::DoNotOptimize(result.data());
+  }
+}
+BENCHMARK(BM_bvh_query_ray_reference)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void BM_bvh_query_sphere(benchmark::State& state)
+{
+  Bvh bvh;
+  fill(bvh, make_boxes(state.range_x()));
+  glm::vec3 center = get_center(state.range_x());
+  std::vector<int> result;
+  while (state.KeepRunning())
+  {
+    result.clear();
+    bvh.query_sphere(center, 8.0f, result);
+    benchmark::DoNotOptimize(result.data());
+  }
+}
+BENCHMARK(BM_bvh_query_sphere)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void BM_bvh_query_box(benchmark::State& state)
+{
+  Bvh bvh;
+  fill(bvh, make_boxes(state.range_x()));
+  glm::vec3 center = get_center(state.range_x());
+  BoundingBox box(center - 8.0f, center + 8.0f);
+  std::vector<int> result;
+  while (state.KeepRunning())
+  {
+    result.clear();
+    bvh.query_box(box, result);
+    benchmark::DoNotOptimize(result.data());
+  }
+}
+BENCHMARK(BM_bvh_query_box)->Arg(1000)->Arg(10000)->Arg(100000);
+
+BENCHMARK_MAIN()
+
+/* EOF */
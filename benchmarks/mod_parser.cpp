@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "mapped_file.hpp"
+#include "mod_parser.hpp"
+
+// run from the top level source directory so that data/ can be found
+
+namespace {
+
+std::string read_file(const std::string& filename)
+{
+  std::ifstream in(filename);
+  std::ostringstream os;
+  os << in.rdbuf();
+  return os.str();
+}
+
+void bench_istream(benchmark::State& state, const std::string& filename)
+{
+  std::string content = read_file(filename);
+  while (state.KeepRunning())
+  {
+    std::istringstream in(content);
+    auto objects = ModParser::from_istream(in);
+    benchmark::DoNotOptimize(objects.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * content.size());
+}
+
+void bench_memory(benchmark::State& state, const std::string& filename)
+{
+  std::string content = read_file(filename);
+  while (state.KeepRunning())
+  {
+    auto objects = ModParser::from_memory(content.data(), content.size());
+    benchmark::DoNotOptimize(objects.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * content.size());
+}
+
+void bench_parallel(benchmark::State& state, const std::string& filename)
+{
+  std::string content = read_file(filename);
+  while (state.KeepRunning())
+  {
+    auto objects = ModParser::from_memory_parallel(content.data(), content.size());
+    benchmark::DoNotOptimize(objects.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * content.size());
+}
+
+void bench_mmap(benchmark::State& state, const std::string& filename)
+{
+  size_t size = MappedFile(filename).get_size();
+  while (state.KeepRunning())
+  {
+    auto objects = ModParser::from_file(filename);
+    benchmark::DoNotOptimize(objects.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+}
+
+} // namespace
+
+static void BM_istream_mech(benchmark::State& state)
+{
+  bench_istream(state, "data/mech-with-landscape.mod");
+}
+BENCHMARK(BM_istream_mech);
+
+static void BM_memory_mech(benchmark::State& state)
+{
+  bench_memory(state, "data/mech-with-landscape.mod");
+}
+BENCHMARK(BM_memory_mech);
+
+static void BM_mmap_mech(benchmark::State& state)
+{
+  bench_mmap(state, "data/mech-with-landscape.mod");
+}
+BENCHMARK(BM_mmap_mech);
+
+static void BM_istream_room(benchmark::State& state)
+{
+  bench_istream(state, "data/room/blender.mod");
+}
+BENCHMARK(BM_istream_room);
+
+static void BM_memory_room(benchmark::State& state)
+{
+  bench_memory(state, "data/room/blender.mod");
+}
+BENCHMARK(BM_memory_room);
+
+static void BM_parallel_room(benchmark::State& state)
+{
+  bench_parallel(state, "data/room/blender.mod");
+}
+BENCHMARK(BM_parallel_room);
+
+static void BM_mmap_room(benchmark::State& state)
+{
+  bench_mmap(state, "data/room/blender.mod");
+}
+BENCHMARK(BM_mmap_room);
+
+BENCHMARK_MAIN()
+
+/* EOF */
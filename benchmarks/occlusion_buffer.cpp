@@ -0,0 +1,106 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/ext.hpp>
+
+#include "occlusion_buffer.hpp"
+
+// quads of one to three units facing a camera at the origin, spread
+// over the view at five to twenty five units away, and boxes behind
+// and among them to test
+
+namespace {
+
+const int buffer_width = 320;
+const int buffer_height = 192;
+
+glm::mat4 get_matrix()
+{
+  return glm::perspective(glm::radians(60.0f), 1.6f, 0.1f, 100.0f) *
+    glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+OccluderMesh make_quads(int triangles)
+{
+  std::mt19937 rng(triangles);
+  std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+  std::uniform_real_distribution<float> depth(-25.0f, -5.0f);
+  std::uniform_real_distribution<float> extent(0.5f, 1.5f);
+
+  OccluderMesh mesh;
+  for(int i = 0; i < triangles / 2; ++i)
+  {
+    glm::vec3 center(position(rng), position(rng) * 0.6f, depth(rng));
+    glm::vec2 half(extent(rng), extent(rng));
+    int first = static_cast<int>(mesh.positions.size());
+    mesh.positions.emplace_back(center.x - half.x, center.y - half.y, center.z);
+    mesh.positions.emplace_back(center.x + half.x, center.y - half.y, center.z);
+    mesh.positions.emplace_back(center.x + half.x, center.y + half.y, center.z);
+    mesh.positions.emplace_back(center.x - half.x, center.y + half.y, center.z);
+    for(int index : { 0, 1, 2, 0, 2, 3 })
+    {
+      mesh.indices.push_back(first + index);
+    }
+  }
+  return mesh;
+}
+
+std::vector<BoundingBox> make_boxes(int count)
+{
+  std::mt19937 rng(count);
+  std::uniform_real_distribution<float> position(-15.0f, 15.0f);
+  std::uniform_real_distribution<float> depth(-40.0f, -5.0f);
+  std::uniform_real_distribution<float> extent(0.1f, 1.0f);
+
+  std::vector<BoundingBox> boxes;
+  for(int i = 0; i < count; ++i)
+  {
+    glm::vec3 center(position(rng), position(rng) * 0.6f, depth(rng));
+    glm::vec3 half(extent(rng));
+    boxes.emplace_back(center - half, center + half);
+  }
+  return boxes;
+}
+
+} // namespace
+
+static void BM_occlusion_draw(benchmark::State& state)
+{
+  OccluderMesh mesh = make_quads(state.range_x());
+  OcclusionBuffer buffer(buffer_width, buffer_height);
+  glm::mat4 matrix = get_matrix();
+  while (state.KeepRunning())
+  {
+    buffer.clear(0, buffer.get_tile_rows());
+    buffer.draw(matrix, mesh, ClusterCuller::FaceCulling::Back, 0, buffer.get_tile_rows());
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range_x());
+}
+BENCHMARK(BM_occlusion_draw)->Arg(100)->Arg(1000)->Arg(10000);
+
+static void BM_occlusion_test(benchmark::State& state)
+{
+  OccluderMesh mesh = make_quads(1000);
+  std::vector<BoundingBox> boxes = make_boxes(state.range_x());
+  OcclusionBuffer buffer(buffer_width, buffer_height);
+  glm::mat4 matrix = get_matrix();
+  buffer.draw(matrix, mesh, ClusterCuller::FaceCulling::Back, 0, buffer.get_tile_rows());
+  int hidden = 0;
+  while (state.KeepRunning())
+  {
+    for(auto const& box : boxes)
+    {
+      OcclusionBuffer::Query query = buffer.project(matrix, box);
+      hidden += buffer.test(query, 0, buffer.get_tile_rows()) == OcclusionBuffer::Visibility::Hidden;
+    }
+  }
+  benchmark::DoNotOptimize(hidden);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range_x());
+}
+BENCHMARK(BM_occlusion_test)->Arg(100)->Arg(1000)->Arg(10000);
+
+BENCHMARK_MAIN()
+
+/* EOF */
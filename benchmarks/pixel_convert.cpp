@@ -0,0 +1,186 @@
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <utility>
+#include <vector>
+
+#include "pixel_convert.hpp"
+
+// the reference versions are the byte at a time loops the kernels
+// replaced
+
+namespace {
+
+const int width = 1024;
+const int height = 1024;
+
+std::vector<uint8_t> make_pixels(int bytes_per_pixel)
+{
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * bytes_per_pixel);
+  for(auto& p : pixels)
+  {
+    p = static_cast<uint8_t>(rand());
+  }
+  return pixels;
+}
+
+/** Premultiplied BGRA, the color never exceeds the alpha */
+std::vector<uint8_t> make_premultiplied()
+{
+  std::vector<uint8_t> pixels = make_pixels(4);
+  for(size_t i = 0; i < pixels.size(); i += 4)
+  {
+    for(int c = 0; c < 3; ++c)
+    {
+      pixels[i + c] = static_cast<uint8_t>(pixels[i + c] * pixels[i + 3] / 255);
+    }
+  }
+  return pixels;
+}
+
+void bench_swap_red_blue(benchmark::State& state, PixelConvert::Isa isa, int bytes_per_pixel)
+{
+  PixelConvert::set_isa(isa);
+  std::vector<uint8_t> pixels = make_pixels(bytes_per_pixel);
+  while (state.KeepRunning())
+  {
+    PixelConvert::swap_red_blue(pixels.data(), static_cast<size_t>(width) * height, bytes_per_pixel);
+    benchmark::DoNotOptimize(pixels.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * pixels.size());
+}
+
+void bench_unpremultiply(benchmark::State& state, PixelConvert::Isa isa)
+{
+  PixelConvert::set_isa(isa);
+  std::vector<uint8_t> original = make_premultiplied();
+  std::vector<uint8_t> pixels = original;
+  while (state.KeepRunning())
+  {
+    // the conversion is in place, so start over from the same data
+    state.PauseTiming();
+    pixels = original;
+    state.ResumeTiming();
+
+    PixelConvert::unpremultiply_bgra(pixels.data(), static_cast<size_t>(width) * height);
+    benchmark::DoNotOptimize(pixels.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * pixels.size());
+}
+
+void bench_rgb_to_rgba(benchmark::State& state, PixelConvert::Isa isa)
+{
+  PixelConvert::set_isa(isa);
+  std::vector<uint8_t> rgb = make_pixels(3);
+  std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+  while (state.KeepRunning())
+  {
+    PixelConvert::rgb_to_rgba(rgba.data(), rgb.data(), static_cast<size_t>(width) * height);
+    benchmark::DoNotOptimize(rgba.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * rgba.size());
+}
+
+} // namespace
+
+static void BM_swap_red_blue_rgba_reference(benchmark::State& state)
+{
+  std::vector<uint8_t> pixels = make_pixels(4);
+  while (state.KeepRunning())
+  {
+    for(size_t i = 0; i < pixels.size(); i += 4)
+    {
+      std::swap(pixels[i], pixels[i + 2]);
+    }
+    benchmark::DoNotOptimize(pixels.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * pixels.size());
+}
+BENCHMARK(BM_swap_red_blue_rgba_reference);
+
+static void BM_swap_red_blue_rgba_scalar(benchmark::State& state)
+{
+  bench_swap_red_blue(state, PixelConvert::Isa::Scalar, 4);
+}
+BENCHMARK(BM_swap_red_blue_rgba_scalar);
+
+static void BM_swap_red_blue_rgba_ssse3(benchmark::State& state)
+{
+  bench_swap_red_blue(state, PixelConvert::Isa::SSSE3, 4);
+}
+BENCHMARK(BM_swap_red_blue_rgba_ssse3);
+
+static void BM_swap_red_blue_rgba_avx2(benchmark::State& state)
+{
+  bench_swap_red_blue(state, PixelConvert::Isa::AVX2, 4);
+}
+BENCHMARK(BM_swap_red_blue_rgba_avx2);
+
+static void BM_swap_red_blue_rgb_scalar(benchmark::State& state)
+{
+  bench_swap_red_blue(state, PixelConvert::Isa::Scalar, 3);
+}
+BENCHMARK(BM_swap_red_blue_rgb_scalar);
+
+static void BM_swap_red_blue_rgb_ssse3(benchmark::State& state)
+{
+  bench_swap_red_blue(state, PixelConvert::Isa::SSSE3, 3);
+}
+BENCHMARK(BM_swap_red_blue_rgb_ssse3);
+
+static void BM_unpremultiply_reference(benchmark::State& state)
+{
+  std::vector<uint8_t> original = make_premultiplied();
+  std::vector<uint8_t> pixels = original;
+  while (state.KeepRunning())
+  {
+    state.PauseTiming();
+    pixels = original;
+    state.ResumeTiming();
+
+    for(size_t x = 0; x < pixels.size(); x += 4)
+    {
+      uint8_t r = pixels[x+0];
+      uint8_t g = pixels[x+1];
+      uint8_t b = pixels[x+2];
+      uint8_t a = pixels[x+3];
+      if (a != 0)
+      {
+        pixels[x+0] = static_cast<uint8_t>(b * 255 / a);
+        pixels[x+1] = static_cast<uint8_t>(g * 255 / a);
+        pixels[x+2] = static_cast<uint8_t>(r * 255 / a);
+      }
+    }
+    benchmark::DoNotOptimize(pixels.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * pixels.size());
+}
+BENCHMARK(BM_unpremultiply_reference);
+
+static void BM_unpremultiply_scalar(benchmark::State& state)
+{
+  bench_unpremultiply(state, PixelConvert::Isa::Scalar);
+}
+BENCHMARK(BM_unpremultiply_scalar);
+
+static void BM_unpremultiply_avx2(benchmark::State& state)
+{
+  bench_unpremultiply(state, PixelConvert::Isa::AVX2);
+}
+BENCHMARK(BM_unpremultiply_avx2);
+
+static void BM_rgb_to_rgba_scalar(benchmark::State& state)
+{
+  bench_rgb_to_rgba(state, PixelConvert::Isa::Scalar);
+}
+BENCHMARK(BM_rgb_to_rgba_scalar);
+
+static void BM_rgb_to_rgba_ssse3(benchmark::State& state)
+{
+  bench_rgb_to_rgba(state, PixelConvert::Isa::SSSE3);
+}
+BENCHMARK(BM_rgb_to_rgba_ssse3);
+
+BENCHMARK_MAIN()
+
+/* EOF */
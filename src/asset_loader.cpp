@@ -0,0 +1,102 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "asset_loader.hpp"
+
+#include "log.hpp"
+#include "material_factory.hpp"
+
+AssetLoader::AssetLoader(ThreadPool& pool) :
+  m_pool(pool),
+  m_pending(),
+  m_uploads(),
+  m_placeholder_material()
+{
+}
+
+void
+AssetLoader::upload(std::function<void ()> job)
+{
+  m_uploads.push_back(std::move(job));
+}
+
+void
+AssetLoader::poll(std::function<bool ()> job)
+{
+  m_pending.push_back(std::move(job));
+}
+
+void
+AssetLoader::update(float time_budget)
+{
+  auto start_time = std::chrono::steady_clock::now();
+
+  // the callbacks may queue up new loads, so don't iterate over
+  // m_pending directly
+  std::vector<std::function<bool ()> > pending;
+  pending.swap(m_pending);
+  for(auto& poll : pending)
+  {
+    bool done;
+    try
+    {
+      done = poll();
+    }
+    catch(const std::exception& err)
+    {
+      log_error("AssetLoader: %s", err.what());
+      done = true;
+    }
+
+    if (!done)
+    {
+      m_pending.push_back(std::move(poll));
+    }
+  }
+
+  while(!m_uploads.empty())
+  {
+    std::function<void ()> job = std::move(m_uploads.front());
+    m_uploads.pop_front();
+
+    try
+    {
+      job();
+    }
+    catch(const std::exception& err)
+    {
+      log_error("AssetLoader: %s", err.what());
+    }
+
+    std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start_time;
+    if (elapsed.count() >= time_budget)
+    {
+      break;
+    }
+  }
+}
+
+MaterialPtr
+AssetLoader::get_placeholder_material()
+{
+  if (!m_placeholder_material)
+  {
+    m_placeholder_material = MaterialFactory::get().create("basic_white");
+  }
+  return m_placeholder_material;
+}
+
+/* EOF */
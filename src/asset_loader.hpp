@@ -0,0 +1,100 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_ASSET_LOADER_HPP
+#define HEADER_ASSET_LOADER_HPP
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <type_traits>
+#include <vector>
+
+#include "material.hpp"
+#include "thread_pool.hpp"
+
+/** Background loading: the CPU heavy part of a load runs on the
+    ThreadPool, everything touching OpenGL is queued up and run on the
+    render thread in small steps via update(). As update() runs
+    between frames, swapping in a finished Model or Material is
+    atomic from the renderers point of view. */
+class AssetLoader
+{
+private:
+  ThreadPool& m_pool;
+
+  /** Polls for finished background jobs, return true once done */
+  std::vector<std::function<bool ()> > m_pending;
+
+  /** OpenGL work waiting for the render thread */
+  std::deque<std::function<void ()> > m_uploads;
+
+  MaterialPtr m_placeholder_material;
+
+public:
+  AssetLoader(ThreadPool& pool = ThreadPool::get());
+
+  /** Run \a work on the ThreadPool and hand its result to \a done,
+      which is called from update() on the render thread */
+  template<typename Work, typename Done>
+  void load(Work&& work, Done&& done)
+  {
+    typedef typename std::result_of<Work()>::type Result;
+
+    std::shared_future<Result> future = m_pool.schedule(std::forward<Work>(work)).share();
+    m_pending.emplace_back(
+      [future, done]() -> bool {
+        if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+          return false;
+        }
+        else
+        {
+          done(future.get());
+          return true;
+        }
+      });
+  }
+
+  /** Queue \a job to be run on the render thread, jobs run in the
+      order they were queued */
+  void upload(std::function<void ()> job);
+
+  /** Call \a job from each update() until it returns true, for
+      waiting on work the driver does in the background */
+  void poll(std::function<bool ()> job);
+
+  /** Collect finished background jobs and run queued uploads until
+      \a time_budget seconds are used up, at least one upload is run
+      per call so that loading always progresses */
+  void update(float time_budget);
+
+  /** True while background jobs or uploads are outstanding */
+  bool is_busy() const { return !m_pending.empty() || !m_uploads.empty(); }
+
+  /** Cheap material used for Models whose real Material isn't
+      loaded yet */
+  MaterialPtr get_placeholder_material();
+
+private:
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+};
+
+#endif
+
+/* EOF */
@@ -0,0 +1,290 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "block_compressor.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+
+namespace {
+
+typedef uint8_t Block[16][4];
+
+void fetch_block(const Image& image, int bx, int by, Block& block)
+{
+  for(int y = 0; y < 4; ++y)
+    for(int x = 0; x < 4; ++x)
+    {
+      int sx = std::min(bx * 4 + x, image.width - 1);
+      int sy = std::min(by * 4 + y, image.height - 1);
+      const uint8_t* src = image.pixels.data() + (static_cast<size_t>(sy) * image.width + sx) * image.bytes_per_pixel;
+      uint8_t* dst = block[y * 4 + x];
+      dst[0] = src[0];
+      dst[1] = src[1];
+      dst[2] = src[2];
+      dst[3] = (image.bytes_per_pixel == 4) ? src[3] : 255;
+    }
+}
+
+uint16_t to_rgb565(const float* color)
+{
+  int r = std::max(0, std::min(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 31));
+  int g = std::max(0, std::min(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 63));
+  int b = std::max(0, std::min(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 31));
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void from_rgb565(uint16_t c, int* color)
+{
+  int r = (c >> 11) & 31;
+  int g = (c >> 5) & 63;
+  int b = c & 31;
+  color[0] = (r << 3) | (r >> 2);
+  color[1] = (g << 2) | (g >> 4);
+  color[2] = (b << 3) | (b >> 2);
+}
+
+void write_le16(uint8_t* out, uint16_t v)
+{
+  out[0] = static_cast<uint8_t>(v & 0xff);
+  out[1] = static_cast<uint8_t>(v >> 8);
+}
+
+/** BC1 color block, also the second half of a BC3 block */
+void encode_color_block(const Block& block, uint8_t* out)
+{
+  float mean[3] = { 0.0f, 0.0f, 0.0f };
+  for(int i = 0; i < 16; ++i)
+    for(int c = 0; c < 3; ++c)
+    {
+      mean[c] += block[i][c] / 16.0f;
+    }
+
+  float cov[3][3] = {};
+  for(int i = 0; i < 16; ++i)
+    for(int a = 0; a < 3; ++a)
+      for(int b = 0; b < 3; ++b)
+      {
+        cov[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+      }
+
+  // principal axis by power iteration
+  float axis[3] = { 1.0f, 1.0f, 1.0f };
+  for(int iter = 0; iter < 4; ++iter)
+  {
+    float next[3];
+    for(int a = 0; a < 3; ++a)
+    {
+      next[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+    }
+    float norm = std::max(fabsf(next[0]), std::max(fabsf(next[1]), fabsf(next[2])));
+    if (norm < 1.0e-6f)
+    {
+      break;
+    }
+    for(int a = 0; a < 3; ++a)
+    {
+      axis[a] = next[a] / norm;
+    }
+  }
+
+  // the extreme colors along the axis become the endpoints
+  float lo = 0.0f;
+  float hi = 0.0f;
+  for(int i = 0; i < 16; ++i)
+  {
+    float t = ((block[i][0] - mean[0]) * axis[0] +
+               (block[i][1] - mean[1]) * axis[1] +
+               (block[i][2] - mean[2]) * axis[2]);
+    if (i == 0 || t < lo) { lo = t; }
+    if (i == 0 || t > hi) { hi = t; }
+  }
+
+  float axis_len2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+  float max_color[3];
+  float min_color[3];
+  for(int c = 0; c < 3; ++c)
+  {
+    max_color[c] = mean[c] + axis[c] * hi / axis_len2;
+    min_color[c] = mean[c] + axis[c] * lo / axis_len2;
+  }
+
+  uint16_t c0 = to_rgb565(max_color);
+  uint16_t c1 = to_rgb565(min_color);
+  if (c0 < c1)
+  {
+    std::swap(c0, c1);
+  }
+
+  write_le16(out + 0, c0);
+  write_le16(out + 2, c1);
+
+  uint32_t indices = 0;
+  if (c0 != c1)
+  {
+    // four color mode, needs c0 > c1
+    int palette[4][3];
+    from_rgb565(c0, palette[0]);
+    from_rgb565(c1, palette[1]);
+    for(int c = 0; c < 3; ++c)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for(int i = 0; i < 16; ++i)
+    {
+      int best = 0;
+      int best_dist = 0;
+      for(int p = 0; p < 4; ++p)
+      {
+        int dr = block[i][0] - palette[p][0];
+        int dg = block[i][1] - palette[p][1];
+        int db = block[i][2] - palette[p][2];
+        int dist = dr * dr + dg * dg + db * db;
+        if (p == 0 || dist < best_dist)
+        {
+          best = p;
+          best_dist = dist;
+        }
+      }
+      indices |= static_cast<uint32_t>(best) << (2 * i);
+    }
+  }
+
+  for(int i = 0; i < 4; ++i)
+  {
+    out[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+  }
+}
+
+/** BC4/RGTC1 block of channel \a channel, also the alpha half of BC3 */
+void encode_channel_block(const Block& block, int channel, uint8_t* out)
+{
+  int a0 = 0;
+  int a1 = 255;
+  for(int i = 0; i < 16; ++i)
+  {
+    a0 = std::max(a0, static_cast<int>(block[i][channel]));
+    a1 = std::min(a1, static_cast<int>(block[i][channel]));
+  }
+
+  out[0] = static_cast<uint8_t>(a0);
+  out[1] = static_cast<uint8_t>(a1);
+
+  uint64_t indices = 0;
+  if (a0 != a1)
+  {
+    // eight value mode, needs a0 > a1
+    int palette[8];
+    palette[0] = a0;
+    palette[1] = a1;
+    for(int p = 2; p < 8; ++p)
+    {
+      palette[p] = ((8 - p) * a0 + (p - 1) * a1) / 7;
+    }
+
+    for(int i = 0; i < 16; ++i)
+    {
+      int best = 0;
+      for(int p = 1; p < 8; ++p)
+      {
+        if (abs(block[i][channel] - palette[p]) < abs(block[i][channel] - palette[best]))
+        {
+          best = p;
+        }
+      }
+      indices |= static_cast<uint64_t>(best) << (3 * i);
+    }
+  }
+
+  for(int i = 0; i < 6; ++i)
+  {
+    out[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+  }
+}
+
+} // namespace
+
+TextureFormat
+BlockCompressor::choose_format(const Image& image, bool rgtc)
+{
+  bool gray = rgtc;
+  bool alpha = false;
+  for(size_t i = 0; i < image.pixels.size(); i += image.bytes_per_pixel)
+  {
+    const uint8_t* p = image.pixels.data() + i;
+    gray = gray && p[0] == p[1] && p[1] == p[2];
+    alpha = alpha || (image.bytes_per_pixel == 4 && p[3] != 255);
+  }
+
+  if (alpha)
+  {
+    return TextureFormat::BC3;
+  }
+  else if (gray)
+  {
+    return TextureFormat::RGTC1;
+  }
+  else
+  {
+    return TextureFormat::BC1;
+  }
+}
+
+std::vector<uint8_t>
+BlockCompressor::compress(const Image& image, TextureFormat format)
+{
+  if (!is_compressed(format))
+  {
+    throw std::runtime_error("BlockCompressor: not a block format");
+  }
+
+  std::vector<uint8_t> result(get_level_size(format, image.width, image.height));
+  size_t block_size = (format == TextureFormat::BC3) ? 16 : 8;
+
+  int blocks_x = (image.width + 3) / 4;
+  int blocks_y = (image.height + 3) / 4;
+  uint8_t* out = result.data();
+  Block block;
+  for(int by = 0; by < blocks_y; ++by)
+    for(int bx = 0; bx < blocks_x; ++bx)
+    {
+      fetch_block(image, bx, by, block);
+      switch(format)
+      {
+        case TextureFormat::BC1:
+          encode_color_block(block, out);
+          break;
+
+        case TextureFormat::BC3:
+          encode_channel_block(block, 3, out);
+          encode_color_block(block, out + 8);
+          break;
+
+        case TextureFormat::RGTC1:
+        default:
+          encode_channel_block(block, 0, out);
+          break;
+      }
+      out += block_size;
+    }
+
+  return result;
+}
+
+/* EOF */
@@ -0,0 +1,46 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_BLOCK_COMPRESSOR_HPP
+#define HEADER_BLOCK_COMPRESSOR_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include "image.hpp"
+#include "texture_format.hpp"
+
+/** Encoder for the S3TC and RGTC block formats, no OpenGL needed, so
+    it runs on the ThreadPool and in the offline transcoding. Each 4x4
+    block is fitted along the principal axis of its colors, which is
+    fast and good enough for diffuse maps, but not up to the quality
+    of a dedicated compressor. */
+class BlockCompressor
+{
+public:
+  /** Smallest format that keeps the content of \a image: RGTC1 for
+      gray images when \a rgtc is allowed, BC3 when the alpha channel
+      is used, BC1 otherwise */
+  static TextureFormat choose_format(const Image& image, bool rgtc);
+
+  /** Encode \a image into the block format \a format, sizes that
+      aren't a multiple of four repeat the edge pixels */
+  static std::vector<uint8_t> compress(const Image& image, TextureFormat format);
+};
+
+#endif
+
+/* EOF */
@@ -0,0 +1,95 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "bounding_box.hpp"
+
+#include <algorithm>
+#include <limits>
+
+BoundingBox
+BoundingBox::infinite()
+{
+  const float inf = std::numeric_limits<float>::infinity();
+  return BoundingBox(glm::vec3(-inf), glm::vec3(inf));
+}
+
+BoundingBox::BoundingBox() :
+  min(std::numeric_limits<float>::max()),
+  max(-std::numeric_limits<float>::max())
+{
+}
+
+BoundingBox::BoundingBox(const glm::vec3& min_, const glm::vec3& max_) :
+  min(min_),
+  max(max_)
+{
+}
+
+bool
+BoundingBox::is_infinite() const
+{
+  return min.x == -std::numeric_limits<float>::infinity();
+}
+
+bool
+BoundingBox::intersects_ray(const glm::vec3& origin, const glm::vec3& direction, float& distance) const
+{
+  if (is_empty())
+  {
+    return false;
+  }
+
+  // slabs, a zero direction component gives infinities that the
+  // comparisons handle as long as the origin isn't on the slab border
+  float t_near = 0.0f;
+  float t_far = std::numeric_limits<float>::infinity();
+  for(int i = 0; i < 3; ++i)
+  {
+    float inv = 1.0f / direction[i];
+    float t0 = (min[i] - origin[i]) * inv;
+    float t1 = (max[i] - origin[i]) * inv;
+    t_near = std::max(t_near, std::min(t0, t1));
+    t_far = std::min(t_far, std::max(t0, t1));
+  }
+
+  distance = t_near;
+  return t_near <= t_far;
+}
+
+BoundingBox
+BoundingBox::transform(const glm::mat4& matrix) const
+{
+  if (is_empty() || is_infinite())
+  {
+    return *this;
+  }
+  else
+  {
+    // Arvo, each column of the matrix stretches the box along one axis
+    glm::vec3 new_min(matrix[3]);
+    glm::vec3 new_max(matrix[3]);
+    for(int i = 0; i < 3; ++i)
+    {
+      glm::vec3 a = glm::vec3(matrix[i]) * min[i];
+      glm::vec3 b = glm::vec3(matrix[i]) * max[i];
+      new_min += glm::min(a, b);
+      new_max += glm::max(a, b);
+    }
+    return BoundingBox(new_min, new_max);
+  }
+}
+
+/* EOF */
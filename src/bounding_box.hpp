@@ -0,0 +1,67 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_BOUNDING_BOX_HPP
+#define HEADER_BOUNDING_BOX_HPP
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+/** Axis aligned box, empty until something is added. An infinite box
+    stands for things whose extent isn't known, like skinned meshes,
+    and must never be culled */
+class BoundingBox
+{
+public:
+  glm::vec3 min;
+  glm::vec3 max;
+
+public:
+  static BoundingBox infinite();
+
+  BoundingBox();
+  BoundingBox(const glm::vec3& min_, const glm::vec3& max_);
+
+  bool is_empty() const { return min.x > max.x; }
+  bool is_infinite() const;
+
+  void add(const glm::vec3& point)
+  {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  void add(const BoundingBox& box)
+  {
+    if (!box.is_empty())
+    {
+      min = glm::min(min, box.min);
+      max = glm::max(max, box.max);
+    }
+  }
+
+  /** True if the ray hits the box, \a distance is where it enters in
+      multiples of \a direction, 0 if \a origin is inside */
+  bool intersects_ray(const glm::vec3& origin, const glm::vec3& direction, float& distance) const;
+
+  /** The box around the transformed corners, empty and infinite boxes
+      stay as they are */
+  BoundingBox transform(const glm::mat4& matrix) const;
+};
+
+#endif
+
+/* EOF */
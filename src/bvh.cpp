@@ -0,0 +1,669 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <float.h>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+namespace {
+
+const int sah_bins = 16;
+
+/** Below this depth the splits fall back to the median, which keeps
+    the depth and with it the traversal stack bounded */
+const int max_sah_depth = 32;
+
+/** Each node pops one entry and pushes at most four, 3 * depth + 1
+    entries are enough, median splits add log4(n) levels */
+const int stack_size = 256;
+
+float get_area(const BoundingBox& box)
+{
+  glm::vec3 d = box.max - box.min;
+  return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+// The tests take a node and return a bit mask of the children whose
+// bounds pass. Empty slots have inverted bounds, but may still pass
+// the frustum and ray tests, traverse() skips them by their child.
+
+#ifdef __SSE2__
+
+struct BoxTest
+{
+  __m128 min_x, min_y, min_z;
+  __m128 max_x, max_y, max_z;
+
+  BoxTest(const BoundingBox& box) :
+    min_x(_mm_set1_ps(box.min.x)), min_y(_mm_set1_ps(box.min.y)), min_z(_mm_set1_ps(box.min.z)),
+    max_x(_mm_set1_ps(box.max.x)), max_y(_mm_set1_ps(box.max.y)), max_z(_mm_set1_ps(box.max.z))
+  {}
+
+  int operator()(const Bvh::Node& node) const
+  {
+    __m128 x = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.min_x), max_x), _mm_cmpge_ps(_mm_loadu_ps(node.max_x), min_x));
+    __m128 y = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.min_y), max_y), _mm_cmpge_ps(_mm_loadu_ps(node.max_y), min_y));
+    __m128 z = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.min_z), max_z), _mm_cmpge_ps(_mm_loadu_ps(node.max_z), min_z));
+    return _mm_movemask_ps(_mm_and_ps(x, _mm_and_ps(y, z)));
+  }
+};
+
+struct SphereTest
+{
+  __m128 x, y, z;
+  __m128 radius2;
+
+  SphereTest(const glm::vec3& center, float radius) :
+    x(_mm_set1_ps(center.x)), y(_mm_set1_ps(center.y)), z(_mm_set1_ps(center.z)),
+    radius2(_mm_set1_ps(radius * radius))
+  {}
+
+  int operator()(const Bvh::Node& node) const
+  {
+    // distance from the center to the closest point of each box
+    __m128 zero = _mm_setzero_ps();
+    __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.min_x), x), _mm_sub_ps(x, _mm_loadu_ps(node.max_x))), zero);
+    __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.min_y), y), _mm_sub_ps(y, _mm_loadu_ps(node.max_y))), zero);
+    __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.min_z), z), _mm_sub_ps(z, _mm_loadu_ps(node.max_z))), zero);
+    __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_add_ps(_mm_mul_ps(dy, dy), _mm_mul_ps(dz, dz)));
+    return _mm_movemask_ps(_mm_cmple_ps(d2, radius2));
+  }
+};
+
+struct RayTest
+{
+  __m128 x, y, z;
+  __m128 inv_x, inv_y, inv_z;
+  __m128 max_distance;
+
+  RayTest(const glm::vec3& origin, const glm::vec3& direction, float max_distance_) :
+    x(_mm_set1_ps(origin.x)), y(_mm_set1_ps(origin.y)), z(_mm_set1_ps(origin.z)),
+    inv_x(_mm_set1_ps(1.0f / direction.x)), inv_y(_mm_set1_ps(1.0f / direction.y)), inv_z(_mm_set1_ps(1.0f / direction.z)),
+    max_distance(_mm_set1_ps(max_distance_))
+  {}
+
+  int operator()(const Bvh::Node& node) const
+  {
+    __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.min_x), x), inv_x);
+    __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.max_x), x), inv_x);
+    __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.min_y), y), inv_y);
+    __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.max_y), y), inv_y);
+    __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.min_z), z), inv_z);
+    __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.max_z), z), inv_z);
+
+    __m128 t_near = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)),
+                               _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_setzero_ps()));
+    __m128 t_far = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)),
+                              _mm_min_ps(_mm_max_ps(t0z, t1z), max_distance));
+    return _mm_movemask_ps(_mm_cmple_ps(t_near, t_far));
+  }
+};
+
+struct FrustumTest
+{
+  __m128 normal_x[6], normal_y[6], normal_z[6], distance[6];
+
+  /** Which corner is furthest along the normal */
+  bool positive_x[6], positive_y[6], positive_z[6];
+
+  FrustumTest(const Frustum& frustum)
+  {
+    for(int i = 0; i < 6; ++i)
+    {
+      glm::vec4 const& plane = frustum.get_plane(i);
+      normal_x[i] = _mm_set1_ps(plane.x);
+      normal_y[i] = _mm_set1_ps(plane.y);
+      normal_z[i] = _mm_set1_ps(plane.z);
+      distance[i] = _mm_set1_ps(plane.w);
+      positive_x[i] = plane.x >= 0.0f;
+      positive_y[i] = plane.y >= 0.0f;
+      positive_z[i] = plane.z >= 0.0f;
+    }
+  }
+
+  int operator()(const Bvh::Node& node) const
+  {
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for(int i = 0; i < 6; ++i)
+    {
+      __m128 px = _mm_loadu_ps(positive_x[i] ? node.max_x : node.min_x);
+      __m128 py = _mm_loadu_ps(positive_y[i] ? node.max_y : node.min_y);
+      __m128 pz = _mm_loadu_ps(positive_z[i] ? node.max_z : node.min_z);
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal_x[i], px), _mm_mul_ps(normal_y[i], py)),
+                            _mm_add_ps(_mm_mul_ps(normal_z[i], pz), distance[i]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+    }
+    return _mm_movemask_ps(inside);
+  }
+};
+
+#else
+
+struct BoxTest
+{
+  BoundingBox box;
+
+  BoxTest(const BoundingBox& box_) :
+    box(box_)
+  {}
+
+  int operator()(const Bvh::Node& node) const
+  {
+    int mask = 0;
+    for(int i = 0; i < 4; ++i)
+    {
+      if (node.min_x[i] <= box.max.x && node.max_x[i] >= box.min.x &&
+          node.min_y[i] <= box.max.y && node.max_y[i] >= box.min.y &&
+          node.min_z[i] <= box.max.z && node.max_z[i] >= box.min.z)
+      {
+        mask |= 1 << i;
+      }
+    }
+    return mask;
+  }
+};
+
+struct SphereTest
+{
+  glm::vec3 center;
+  float radius2;
+
+  SphereTest(const glm::vec3& center_, float radius) :
+    center(center_),
+    radius2(radius * radius)
+  {}
+
+  int operator()(const Bvh::Node& node) const
+  {
+    int mask = 0;
+    for(int i = 0; i < 4; ++i)
+    {
+      float dx = std::max(std::max(node.min_x[i] - center.x, center.x - node.max_x[i]), 0.0f);
+      float dy = std::max(std::max(node.min_y[i] - center.y, center.y - node.max_y[i]), 0.0f);
+      float dz = std::max(std::max(node.min_z[i] - center.z, center.z - node.max_z[i]), 0.0f);
+      if (dx * dx + dy * dy + dz * dz <= radius2)
+      {
+        mask |= 1 << i;
+      }
+    }
+    return mask;
+  }
+};
+
+struct RayTest
+{
+  glm::vec3 origin;
+  glm::vec3 inv;
+  float max_distance;
+
+  RayTest(const glm::vec3& origin_, const glm::vec3& direction, float max_distance_) :
+    origin(origin_),
+    inv(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z),
+    max_distance(max_distance_)
+  {}
+
+  int operator()(const Bvh::Node& node) const
+  {
+    int mask = 0;
+    for(int i = 0; i < 4; ++i)
+    {
+      float t0x = (node.min_x[i] - origin.x) * inv.x;
+      float t1x = (node.max_x[i] - origin.x) * inv.x;
+      float t0y = (node.min_y[i] - origin.y) * inv.y;
+      float t1y = (node.max_y[i] - origin.y) * inv.y;
+      float t0z = (node.min_z[i] - origin.z) * inv.z;
+      float t1z = (node.max_z[i] - origin.z) * inv.z;
+
+      float t_near = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)),
+                              std::max(std::min(t0z, t1z), 0.0f));
+      float t_far = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)),
+                             std::min(std::max(t0z, t1z), max_distance));
+      if (t_near <= t_far)
+      {
+        mask |= 1 << i;
+      }
+    }
+    return mask;
+  }
+};
+
+struct FrustumTest
+{
+  const Frustum& frustum;
+
+  FrustumTest(const Frustum& frustum_) :
+    frustum(frustum_)
+  {}
+
+  int operator()(const Bvh::Node& node) const
+  {
+    int mask = 0;
+    for(int i = 0; i < 4; ++i)
+    {
+      if (frustum.intersects_box(glm::vec3(node.min_x[i], node.min_y[i], node.min_z[i]),
+                                 glm::vec3(node.max_x[i], node.max_y[i], node.max_z[i])))
+      {
+        mask |= 1 << i;
+      }
+    }
+    return mask;
+  }
+};
+
+#endif
+
+} // namespace
+
+const int Bvh::s_empty_slot = -0x7fffffff - 1;
+
+Bvh::Bvh() :
+  m_proxies(),
+  m_free_proxies(),
+  m_unbounded(),
+  m_nodes(),
+  m_root(-1),
+  m_needs_build(false)
+{
+}
+
+int
+Bvh::insert(const BoundingBox& box)
+{
+  int proxy;
+  if (m_free_proxies.empty())
+  {
+    proxy = static_cast<int>(m_proxies.size());
+    m_proxies.emplace_back();
+  }
+  else
+  {
+    proxy = m_free_proxies.back();
+    m_free_proxies.pop_back();
+  }
+
+  m_proxies[proxy] = Proxy{ box, -1, -1, true };
+  m_needs_build = true;
+  return proxy;
+}
+
+void
+Bvh::remove(int proxy)
+{
+  if (proxy < 0 || proxy >= static_cast<int>(m_proxies.size()) || !m_proxies[proxy].used)
+  {
+    throw std::runtime_error("Bvh::remove: invalid proxy");
+  }
+
+  m_proxies[proxy] = Proxy{ BoundingBox(), -1, -1, false };
+  m_free_proxies.push_back(proxy);
+  m_needs_build = true;
+}
+
+void
+Bvh::update(int proxy, const BoundingBox& box)
+{
+  Proxy& p = m_proxies[proxy];
+  if (p.box.min == box.min && p.box.max == box.max)
+  {
+    return;
+  }
+
+  // infinite and empty boxes are kept out of the tree, changing from
+  // or to them changes the tree
+  if (p.box.is_infinite() != box.is_infinite() || p.box.is_empty() != box.is_empty())
+  {
+    p.box = box;
+    m_needs_build = true;
+    return;
+  }
+
+  p.box = box;
+  if (p.node < 0 || m_needs_build)
+  {
+    return;
+  }
+
+  // refit the path up to the root, stopping where the bounds stay
+  // the same
+  int node = p.node;
+  int slot = p.slot;
+  BoundingBox bounds = box;
+  for(;;)
+  {
+    set_slot(node, slot, bounds);
+
+    Node const& n = m_nodes[node];
+    if (n.parent < 0)
+    {
+      break;
+    }
+
+    bounds = get_node_box(node);
+    Node const& parent = m_nodes[n.parent];
+    const int ps = n.parent_slot;
+    if (parent.min_x[ps] == bounds.min.x && parent.min_y[ps] == bounds.min.y && parent.min_z[ps] == bounds.min.z &&
+        parent.max_x[ps] == bounds.max.x && parent.max_y[ps] == bounds.max.y && parent.max_z[ps] == bounds.max.z)
+    {
+      break;
+    }
+
+    slot = n.parent_slot;
+    node = n.parent;
+  }
+}
+
+void
+Bvh::commit()
+{
+  if (m_needs_build)
+  {
+    build();
+  }
+}
+
+void
+Bvh::build()
+{
+  m_nodes.clear();
+  m_unbounded.clear();
+  m_root = -1;
+
+  std::vector<BuildItem> items;
+  for(int i = 0; i < static_cast<int>(m_proxies.size()); ++i)
+  {
+    Proxy& p = m_proxies[i];
+    p.node = -1;
+    p.slot = -1;
+    if (!p.used || p.box.is_empty())
+    {
+      // nothing to find
+    }
+    else if (p.box.is_infinite())
+    {
+      m_unbounded.push_back(i);
+    }
+    else
+    {
+      items.push_back({ p.box, (p.box.min + p.box.max) * 0.5f, i });
+    }
+  }
+
+  if (!items.empty())
+  {
+    // a four-wide tree has about a third as many nodes as leaves
+    m_nodes.reserve(items.size() / 3 + 1);
+    m_root = build_node(items, 0, static_cast<int>(items.size()), -1, -1, 0);
+  }
+
+  m_needs_build = false;
+}
+
+int
+Bvh::get_proxy_count() const
+{
+  return static_cast<int>(m_proxies.size() - m_free_proxies.size());
+}
+
+int
+Bvh::split(std::vector<BuildItem>& items, int begin, int end, bool median)
+{
+  BoundingBox centroids;
+  for(int i = begin; i < end; ++i)
+  {
+    centroids.add(items[i].centroid);
+  }
+
+  glm::vec3 extent = centroids.max - centroids.min;
+  int axis = 0;
+  if (extent.y > extent[axis]) axis = 1;
+  if (extent.z > extent[axis]) axis = 2;
+
+  if (median || extent[axis] <= 0.0f)
+  {
+    const int mid = begin + (end - begin) / 2;
+    std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+                     [axis](BuildItem const& lhs, BuildItem const& rhs) {
+                       return lhs.centroid[axis] < rhs.centroid[axis];
+                     });
+    return mid;
+  }
+
+  // bin the centroids along the longest axis and take the cheapest
+  // border between two bins, cost is area times count on each side,
+  // small ranges get fewer bins as most would stay empty
+  const int bins = std::min(sah_bins, end - begin);
+  const float offset = centroids.min[axis];
+  const float scale = static_cast<float>(bins) / extent[axis];
+  auto get_bin = [axis, offset, scale, bins](BuildItem const& item) {
+    return std::min(static_cast<int>((item.centroid[axis] - offset) * scale), bins - 1);
+  };
+
+  BoundingBox bin_boxes[sah_bins];
+  int bin_counts[sah_bins] = {};
+  for(int i = begin; i < end; ++i)
+  {
+    int bin = get_bin(items[i]);
+    bin_boxes[bin].add(items[i].box);
+    bin_counts[bin] += 1;
+  }
+
+  float right_cost[sah_bins];
+  BoundingBox right;
+  int right_count = 0;
+  for(int bin = bins - 1; bin > 0; --bin)
+  {
+    right.add(bin_boxes[bin]);
+    right_count += bin_counts[bin];
+    right_cost[bin] = right.is_empty() ? 0.0f : get_area(right) * static_cast<float>(right_count);
+  }
+
+  int best_bin = 1;
+  float best_cost = FLT_MAX;
+  BoundingBox left;
+  int left_count = 0;
+  for(int bin = 1; bin < bins; ++bin)
+  {
+    left.add(bin_boxes[bin - 1]);
+    left_count += bin_counts[bin - 1];
+    float cost = (left.is_empty() ? 0.0f : get_area(left) * static_cast<float>(left_count)) + right_cost[bin];
+    if (cost < best_cost)
+    {
+      best_cost = cost;
+      best_bin = bin;
+    }
+  }
+
+  // the first bin holds the smallest centroid and the last the
+  // largest, so both sides get some
+  auto mid = std::partition(items.begin() + begin, items.begin() + end,
+                            [&](BuildItem const& item) { return get_bin(item) < best_bin; });
+  return static_cast<int>(mid - items.begin());
+}
+
+int
+Bvh::build_node(std::vector<BuildItem>& items, int begin, int end, int parent, int parent_slot, int depth)
+{
+  const int index = static_cast<int>(m_nodes.size());
+  m_nodes.emplace_back();
+  {
+    Node& node = m_nodes.back();
+    for(int slot = 0; slot < 4; ++slot)
+    {
+      node.min_x[slot] = node.min_y[slot] = node.min_z[slot] = FLT_MAX;
+      node.max_x[slot] = node.max_y[slot] = node.max_z[slot] = -FLT_MAX;
+      node.child[slot] = s_empty_slot;
+    }
+    node.parent = parent;
+    node.parent_slot = parent_slot;
+  }
+
+  int ranges[4][2];
+  int range_count = 0;
+  if (end - begin <= 4)
+  {
+    for(int i = begin; i < end; ++i)
+    {
+      ranges[range_count][0] = i;
+      ranges[range_count][1] = i + 1;
+      range_count += 1;
+    }
+  }
+  else
+  {
+    const bool median = depth >= max_sah_depth;
+    const int mid = split(items, begin, end, median);
+    const int halves[2][2] = { { begin, mid }, { mid, end } };
+    for(auto const& half : halves)
+    {
+      if (half[1] - half[0] >= 2)
+      {
+        const int quarter = split(items, half[0], half[1], median);
+        ranges[range_count][0] = half[0];
+        ranges[range_count][1] = quarter;
+        range_count += 1;
+        ranges[range_count][0] = quarter;
+        ranges[range_count][1] = half[1];
+        range_count += 1;
+      }
+      else
+      {
+        ranges[range_count][0] = half[0];
+        ranges[range_count][1] = half[1];
+        range_count += 1;
+      }
+    }
+  }
+
+  for(int slot = 0; slot < range_count; ++slot)
+  {
+    const int first = ranges[slot][0];
+    const int last = ranges[slot][1];
+    if (last - first == 1)
+    {
+      Proxy& proxy = m_proxies[items[first].proxy];
+      proxy.node = index;
+      proxy.slot = slot;
+      m_nodes[index].child[slot] = ~items[first].proxy;
+      set_slot(index, slot, proxy.box);
+    }
+    else
+    {
+      // build_node() grows m_nodes, so no references across it
+      const int child = build_node(items, first, last, index, slot, depth + 1);
+      m_nodes[index].child[slot] = child;
+      set_slot(index, slot, get_node_box(child));
+    }
+  }
+
+  return index;
+}
+
+void
+Bvh::set_slot(int node, int slot, const BoundingBox& box)
+{
+  Node& n = m_nodes[node];
+  n.min_x[slot] = box.min.x;
+  n.min_y[slot] = box.min.y;
+  n.min_z[slot] = box.min.z;
+  n.max_x[slot] = box.max.x;
+  n.max_y[slot] = box.max.y;
+  n.max_z[slot] = box.max.z;
+}
+
+BoundingBox
+Bvh::get_node_box(int node) const
+{
+  Node const& n = m_nodes[node];
+  BoundingBox box;
+  for(int slot = 0; slot < 4; ++slot)
+  {
+    if (n.child[slot] != s_empty_slot)
+    {
+      box.add(BoundingBox(glm::vec3(n.min_x[slot], n.min_y[slot], n.min_z[slot]),
+                          glm::vec3(n.max_x[slot], n.max_y[slot], n.max_z[slot])));
+    }
+  }
+  return box;
+}
+
+template<typename Test>
+void
+Bvh::traverse(const Test& test, std::vector<int>& result) const
+{
+  result.insert(result.end(), m_unbounded.begin(), m_unbounded.end());
+
+  if (m_root < 0)
+  {
+    return;
+  }
+
+  int stack[stack_size];
+  int top = 0;
+  stack[top++] = m_root;
+  while(top > 0)
+  {
+    Node const& node = m_nodes[stack[--top]];
+    const int mask = test(node);
+    for(int slot = 0; slot < 4; ++slot)
+    {
+      const int child = node.child[slot];
+      if ((mask & (1 << slot)) && child != s_empty_slot)
+      {
+        if (child < 0)
+        {
+          result.push_back(~child);
+        }
+        else
+        {
+          stack[top++] = child;
+        }
+      }
+    }
+  }
+}
+
+void
+Bvh::query_frustum(const Frustum& frustum, std::vector<int>& result) const
+{
+  traverse(FrustumTest(frustum), result);
+}
+
+void
+Bvh::query_box(const BoundingBox& box, std::vector<int>& result) const
+{
+  traverse(BoxTest(box), result);
+}
+
+void
+Bvh::query_sphere(const glm::vec3& center, float radius, std::vector<int>& result) const
+{
+  traverse(SphereTest(center, radius), result);
+}
+
+void
+Bvh::query_ray(const glm::vec3& origin, const glm::vec3& direction, float max_distance,
+               std::vector<int>& result) const
+{
+  traverse(RayTest(origin, direction, max_distance), result);
+}
+
+/* EOF */
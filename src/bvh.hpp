@@ -0,0 +1,140 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_BVH_HPP
+#define HEADER_BVH_HPP
+
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "bounding_box.hpp"
+#include "frustum.hpp"
+
+/** Bounding volume hierarchy over boxes that get referred to by proxy
+    ids. The tree is built with the surface area heuristic and has four
+    children per node, so that a node's children get tested together
+    with SSE. Moving a box refits the tree in place, adding or removing
+    boxes rebuilds it on the next commit(). Infinite boxes stay outside
+    of the tree and are part of every query result. */
+class Bvh
+{
+public:
+  struct Node
+  {
+    /** Bounds of the four children, structure of arrays for SSE */
+    float min_x[4];
+    float min_y[4];
+    float min_z[4];
+    float max_x[4];
+    float max_y[4];
+    float max_z[4];
+
+    /** Node index, ~proxy for a leaf or s_empty_slot */
+    int child[4];
+
+    int parent;
+    int parent_slot;
+  };
+
+  static const int s_empty_slot;
+
+private:
+  struct Proxy
+  {
+    BoundingBox box;
+
+    /** Where the leaf sits in the tree, -1 while it isn't in it */
+    int node;
+    int slot;
+
+    bool used;
+  };
+
+  /** A proxy while build() sorts them, kept together with its box so
+      that the splits walk over contiguous memory */
+  struct BuildItem
+  {
+    BoundingBox box;
+    glm::vec3 centroid;
+    int proxy;
+  };
+
+  std::vector<Proxy> m_proxies;
+  std::vector<int> m_free_proxies;
+  std::vector<int> m_unbounded;
+
+  std::vector<Node> m_nodes;
+  int m_root;
+
+  /** Proxies were added or removed since the last build() */
+  bool m_needs_build;
+
+public:
+  Bvh();
+
+  /** Returns the proxy id for \a box, ids of removed proxies get reused */
+  int insert(const BoundingBox& box);
+  void remove(int proxy);
+
+  /** Move the box of \a proxy, refits the nodes above it right away */
+  void update(int proxy, const BoundingBox& box);
+
+  /** Rebuild the tree if proxies were added or removed, queries must
+      only be made after this */
+  void commit();
+
+  /** Rebuild the whole tree from the current boxes */
+  void build();
+
+  BoundingBox const& get_box(int proxy) const { return m_proxies[proxy].box; }
+
+  /** Proxies in use */
+  int get_proxy_count() const;
+
+  std::vector<Node> const& get_nodes() const { return m_nodes; }
+
+  /** The proxies whose boxes may intersect, appended to \a result in
+      no particular order */
+  void query_frustum(const Frustum& frustum, std::vector<int>& result) const;
+  void query_box(const BoundingBox& box, std::vector<int>& result) const;
+  void query_sphere(const glm::vec3& center, float radius, std::vector<int>& result) const;
+  void query_ray(const glm::vec3& origin, const glm::vec3& direction, float max_distance,
+                 std::vector<int>& result) const;
+
+private:
+  /** Reorder the items between \a begin and \a end into two groups
+      and return where the second starts, by SAH or by the median */
+  static int split(std::vector<BuildItem>& items, int begin, int end, bool median);
+
+  /** Create the node for the items between \a begin and \a end, split
+      twice so that it gets up to four children */
+  int build_node(std::vector<BuildItem>& items, int begin, int end, int parent, int parent_slot, int depth);
+
+  void set_slot(int node, int slot, const BoundingBox& box);
+  BoundingBox get_node_box(int node) const;
+
+  template<typename Test>
+  void traverse(const Test& test, std::vector<int>& result) const;
+
+private:
+  Bvh(const Bvh&) = delete;
+  Bvh& operator=(const Bvh&) = delete;
+};
+
+#endif
+
+/* EOF */
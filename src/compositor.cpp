@@ -4,6 +4,7 @@
 #include "framebuffer.hpp"
 #include "material.hpp"
 #include "opengl_state.hpp"
+#include "program_cache.hpp"
 #include "viewer.hpp"
 #include "render_context.hpp"
 #include "renderbuffer.hpp"
@@ -25,33 +26,21 @@ Compositor::Compositor(int screen_w, int screen_h) :
   m_renderbuffer2 = std::make_unique<Renderbuffer>(m_screen_w, m_screen_h);
   g_shadowmap = std::make_unique<Framebuffer>(m_shadowmap_resolution, m_shadowmap_resolution);
 
-  m_cybermaxx_prog = Program::create(
-    Shader::from_file(GL_VERTEX_SHADER, "src/glsl/composite.vert"),
-    Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/composite.frag",
-                      {"INTERLACED_COMPOSITION"}));
+  m_cybermaxx_prog = ProgramCache::get().create("src/glsl/composite.vert", {},
+                                                "src/glsl/composite.frag", {"INTERLACED_COMPOSITION"});
 
-  m_crosseye_prog = Program::create(
-    Shader::from_file(GL_VERTEX_SHADER, "src/glsl/composite.vert"),
-    Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/composite.frag",
-                      {"CROSSEYE_COMPOSITION"}));
+  m_crosseye_prog = ProgramCache::get().create("src/glsl/composite.vert", {},
+                                               "src/glsl/composite.frag", {"CROSSEYE_COMPOSITION"});
 
-  m_anaglyph_prog = Program::create(
-    Shader::from_file(GL_VERTEX_SHADER, "src/glsl/composite.vert"),
-    Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/composite.frag",
-                      {"ANAGLYPH_COMPOSITION"}));
+  m_anaglyph_prog = ProgramCache::get().create("src/glsl/composite.vert", {},
+                                               "src/glsl/composite.frag", {"ANAGLYPH_COMPOSITION"});
 
-  m_depth_prog = Program::create(
-    Shader::from_file(GL_VERTEX_SHADER, "src/glsl/composite.vert"),
-    Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/composite.frag",
-                      {"DEPTH_COMPOSITION"}));
+  m_depth_prog = ProgramCache::get().create("src/glsl/composite.vert", {},
+                                            "src/glsl/composite.frag", {"DEPTH_COMPOSITION"});
 
-  m_newsprint_prog = Program::create(
-    Shader::from_file(GL_VERTEX_SHADER, "src/glsl/composite.vert"),
-    Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/newsprint.frag"));
+  m_newsprint_prog = ProgramCache::get().create("src/glsl/composite.vert", "src/glsl/newsprint.frag");
 
-  m_mono_prog = Program::create(
-    Shader::from_file(GL_VERTEX_SHADER, "src/glsl/composite.vert"),
-    Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/composite.frag"));
+  m_mono_prog = ProgramCache::get().create("src/glsl/composite.vert", "src/glsl/composite.frag");
 
   m_composition_prog = m_mono_prog;
 
@@ -165,6 +154,7 @@ Compositor::render(Viewer& viewer)
 
     SceneManager mgr;
     mgr.get_world()->attach_model(model);
+    mgr.update();
 
     RenderContext ctx(camera, mgr.get_world());
 
@@ -1,5 +1,6 @@
 #if 0
 #include "examples.hpp"
+#include "program_cache.hpp"
 
 void make_pose()
 {
@@ -117,8 +118,8 @@ void make_lightcone()
   material->set_uniform("diffuse_texture", 0);
   material->set_uniform("ModelViewMatrix", UniformSymbol::ModelViewMatrix);
   material->set_uniform("MVP", UniformSymbol::ModelViewProjectionMatrix);
-  material->set_program(Program::create(Shader::from_file(GL_VERTEX_SHADER, "src/glsl/lightcone.vert"),
-                                        Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/lightcone.frag")));
+  material->set_program(ProgramCache::get().create("src/glsl/lightcone.vert",
+                                                   "src/glsl/lightcone.frag"));
 
   auto mesh = std::make_unique<Mesh>(GL_POINTS);
   // generate light cone mesh
@@ -139,9 +140,7 @@ void make_lightcone()
       position.emplace_back(length * progress, 0.0f, 0.0f);
       alpha.push_back(0.25 * (1.0f - progress));
     }
-    mesh->attach_float_array("position", position);
-    mesh->attach_float_array("point_size", point_size);
-    mesh->attach_float_array("alpha", alpha);
+    mesh->attach_interleaved({ { "position", position }, { "point_size", point_size }, { "alpha", alpha } });
   }
 
   ModelPtr model = std::make_shared<Model>();
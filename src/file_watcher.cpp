@@ -0,0 +1,156 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "file_watcher.hpp"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "log.hpp"
+
+std::string
+FileWatcher::canonical_path(const std::string& filename)
+{
+  boost::system::error_code ec;
+  boost::filesystem::path path = boost::filesystem::canonical(filename, ec);
+  if (ec)
+  {
+    return boost::filesystem::absolute(filename).lexically_normal().string();
+  }
+  else
+  {
+    return path.string();
+  }
+}
+
+FileWatcher::FileWatcher() :
+  m_fd(-1),
+  m_directories(),
+  m_callbacks(),
+  m_changed()
+{
+  m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_fd < 0)
+  {
+    log_warn("FileWatcher: inotify not available, hot reload disabled: %s", strerror(errno));
+  }
+}
+
+FileWatcher::~FileWatcher()
+{
+  if (m_fd >= 0)
+  {
+    close(m_fd);
+  }
+}
+
+void
+FileWatcher::watch(const std::string& filename, Callback callback)
+{
+  if (m_fd < 0)
+  {
+    return;
+  }
+
+  std::string path = canonical_path(filename);
+  std::string directory = boost::filesystem::path(path).parent_path().string();
+
+  // inotify hands out the same descriptor for a directory that is
+  // already watched
+  int wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (wd < 0)
+  {
+    log_warn("FileWatcher: couldn't watch %s: %s", directory, strerror(errno));
+  }
+  else
+  {
+    m_directories[wd] = directory;
+    m_callbacks[path].push_back(std::move(callback));
+  }
+}
+
+void
+FileWatcher::update()
+{
+  if (m_fd < 0)
+  {
+    return;
+  }
+
+  read_events();
+
+  if (!m_changed.empty())
+  {
+    std::string filename = std::move(m_changed.front());
+    m_changed.pop_front();
+
+    log_info("FileWatcher: %s changed, reloading", filename);
+
+    // callbacks may register new files, don't hold on to the vector
+    std::vector<Callback> callbacks = m_callbacks[filename];
+    for(auto const& callback : callbacks)
+    {
+      try
+      {
+        callback(filename);
+      }
+      catch(const std::exception& err)
+      {
+        log_error("FileWatcher: %s: reload failed: %s", filename, err.what());
+      }
+    }
+  }
+}
+
+void
+FileWatcher::read_events()
+{
+  alignas(struct inotify_event) char buffer[4096];
+  while(true)
+  {
+    ssize_t len = read(m_fd, buffer, sizeof(buffer));
+    if (len <= 0)
+    {
+      // EAGAIN, nothing more to read
+      break;
+    }
+
+    for(char* p = buffer; p < buffer + len;)
+    {
+      const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+      p += sizeof(struct inotify_event) + event->len;
+
+      auto dir = m_directories.find(event->wd);
+      if (dir == m_directories.end() || event->len == 0)
+      {
+        continue;
+      }
+
+      std::string filename = dir->second + "/" + event->name;
+      if (m_callbacks.find(filename) != m_callbacks.end() &&
+          std::find(m_changed.begin(), m_changed.end(), filename) == m_changed.end())
+      {
+        m_changed.push_back(filename);
+      }
+    }
+  }
+}
+
+/* EOF */
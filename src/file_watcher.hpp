@@ -0,0 +1,85 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_FILE_WATCHER_HPP
+#define HEADER_FILE_WATCHER_HPP
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** Watches files for changes via inotify and calls back into whoever
+    loaded them, which then rebuilds its GPU objects in place. The
+    directories are watched instead of the files themselves, as most
+    editors save by writing a new file and renaming it over the old
+    one. Render thread only. */
+class FileWatcher
+{
+public:
+  typedef std::function<void (const std::string& filename)> Callback;
+
+  static FileWatcher& get()
+  {
+    static FileWatcher instance;
+    return instance;
+  }
+
+private:
+  /** inotify file descriptor, -1 if inotify isn't available */
+  int m_fd;
+
+  /** Watch descriptor to directory */
+  std::unordered_map<int, std::string> m_directories;
+
+  /** Canonical filename to the callbacks interested in it */
+  std::unordered_map<std::string, std::vector<Callback> > m_callbacks;
+
+  /** Changed files waiting to be handed to their callbacks */
+  std::deque<std::string> m_changed;
+
+public:
+  /** The name under which watch() callbacks see \a filename */
+  static std::string canonical_path(const std::string& filename);
+
+public:
+  FileWatcher();
+  ~FileWatcher();
+
+  /** Call \a callback with the canonical filename whenever \a filename
+      changes, a file can have multiple callbacks */
+  void watch(const std::string& filename, Callback callback);
+
+  /** Collect pending change notifications without blocking and hand
+      at most one changed file to its callbacks, so that reloading a
+      batch of files is spread over multiple frames */
+  void update();
+
+  /** True if changes are still queued up */
+  bool is_busy() const { return !m_changed.empty(); }
+
+private:
+  void read_events();
+
+private:
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+};
+
+#endif
+
+/* EOF */
@@ -0,0 +1,77 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "frustum.hpp"
+
+#include <glm/ext.hpp>
+
+Frustum::Frustum(const glm::mat4& m) :
+  m_planes()
+{
+  // Gribb/Hartmann, glm::mat4 is indexed [column][row]
+  glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+  glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+  glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+  glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+  m_planes[0] = row3 + row0;
+  m_planes[1] = row3 - row0;
+  m_planes[2] = row3 + row1;
+  m_planes[3] = row3 - row1;
+  m_planes[4] = row3 + row2;
+  m_planes[5] = row3 - row2;
+
+  for(auto& plane : m_planes)
+  {
+    float len = glm::length(glm::vec3(plane));
+    if (len > 0.0f)
+    {
+      plane /= len;
+    }
+  }
+}
+
+bool
+Frustum::intersects(const glm::vec3& center, float radius) const
+{
+  for(auto const& plane : m_planes)
+  {
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+Frustum::intersects_box(const glm::vec3& min, const glm::vec3& max) const
+{
+  for(auto const& plane : m_planes)
+  {
+    // the corner furthest along the plane normal
+    glm::vec3 p(plane.x >= 0.0f ? max.x : min.x,
+                plane.y >= 0.0f ? max.y : min.y,
+                plane.z >= 0.0f ? max.z : min.z);
+    if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* EOF */
@@ -0,0 +1,48 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_FRUSTUM_HPP
+#define HEADER_FRUSTUM_HPP
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+/** The six clip planes of a view-projection matrix. Built from a
+    matrix that includes the model transform the planes end up in
+    model space, so bounds can be tested without transforming them */
+class Frustum
+{
+private:
+  /** left, right, bottom, top, near, far, normalized and pointing
+      inwards */
+  glm::vec4 m_planes[6];
+
+public:
+  Frustum(const glm::mat4& matrix);
+
+  /** False if the sphere is completely outside of a plane */
+  bool intersects(const glm::vec3& center, float radius) const;
+
+  /** False if the box is completely outside of a plane */
+  bool intersects_box(const glm::vec3& min, const glm::vec3& max) const;
+
+  /** Normal in xyz, distance in w, see m_planes for the order */
+  glm::vec4 const& get_plane(int i) const { return m_planes[i]; }
+};
+
+#endif
+
+/* EOF */
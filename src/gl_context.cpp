@@ -1,19 +1,43 @@
 #include "gl_context.hpp"
 
+#include "gpu_buffer_arena.hpp"
+#include "texture_uploader.hpp"
+
 GLContext::GLContext(SDL_GLContext context) :
-  m_context(context)
+  m_context(context),
+  m_vertex_arena(std::make_shared<GpuBufferArena>(GL_ARRAY_BUFFER, GpuBufferArena::s_block_size)),
+  m_index_arena(std::make_shared<GpuBufferArena>(GL_ELEMENT_ARRAY_BUFFER, GpuBufferArena::s_block_size)),
+  m_texture_uploader(std::make_unique<TextureUploader>())
 {
+  GpuBufferArena::set_arenas(m_vertex_arena.get(), m_index_arena.get());
+  TextureUploader::set_current(m_texture_uploader.get());
 }
 
 GLContext::GLContext(GLContext&& other) :
-  m_context(other.m_context)
+  m_context(other.m_context),
+  m_vertex_arena(std::move(other.m_vertex_arena)),
+  m_index_arena(std::move(other.m_index_arena)),
+  m_texture_uploader(std::move(other.m_texture_uploader))
 {
   other.m_context = 0;
 }
 
 GLContext::~GLContext()
 {
-  SDL_GL_DeleteContext(m_context);
+  if (m_context)
+  {
+    // textures still loading keep their placeholder
+    TextureUploader::set_current(nullptr);
+    m_texture_uploader.reset();
+
+    // Meshes that are still alive keep their allocations, but those
+    // no longer refer to the arenas
+    GpuBufferArena::set_arenas(nullptr, nullptr);
+    m_vertex_arena.reset();
+    m_index_arena.reset();
+
+    SDL_GL_DeleteContext(m_context);
+  }
 }
 
 /* EOF */
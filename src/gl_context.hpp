@@ -2,11 +2,21 @@
 #define HEADER_GL_CONTEXT_HPP
 
 #include <SDL.h>
+#include <memory>
 
+class GpuBufferArena;
+class TextureUploader;
+
+/** Owns the OpenGL context along with the GpuBufferArenas and the
+    TextureUploader, which have to delete their buffers while the
+    context is still there */
 class GLContext
 {
 private:
   SDL_GLContext m_context;
+  std::shared_ptr<GpuBufferArena> m_vertex_arena;
+  std::shared_ptr<GpuBufferArena> m_index_arena;
+  std::unique_ptr<TextureUploader> m_texture_uploader;
 
 public:
   GLContext(SDL_GLContext context);
@@ -0,0 +1,318 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gpu_buffer_arena.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "assert_gl.hpp"
+
+namespace {
+
+size_t align_up(size_t offset, size_t alignment)
+{
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+/** The binding point used to fill the buffers of an arena for
+    \a target. Binding GL_ELEMENT_ARRAY_BUFFER changes the bound
+    vertex array object, or is an error when none is bound, so go
+    through GL_COPY_WRITE_BUFFER where it is available. */
+GLenum get_upload_target(GLenum target)
+{
+#ifndef HAVE_OPENGLES2
+  if (GLEW_ARB_copy_buffer)
+  {
+    return GL_COPY_WRITE_BUFFER;
+  }
+#endif
+  return target;
+}
+
+} // namespace
+
+GpuBufferArena* GpuBufferArena::s_vertex_arena = nullptr;
+GpuBufferArena* GpuBufferArena::s_index_arena = nullptr;
+
+GpuBufferArena&
+GpuBufferArena::get_vertex_arena()
+{
+  if (!s_vertex_arena)
+  {
+    throw std::runtime_error("GpuBufferArena: no OpenGL context");
+  }
+  return *s_vertex_arena;
+}
+
+GpuBufferArena&
+GpuBufferArena::get_index_arena()
+{
+  if (!s_index_arena)
+  {
+    throw std::runtime_error("GpuBufferArena: no OpenGL context");
+  }
+  return *s_index_arena;
+}
+
+void
+GpuBufferArena::set_arenas(GpuBufferArena* vertex_arena, GpuBufferArena* index_arena)
+{
+  s_vertex_arena = vertex_arena;
+  s_index_arena = index_arena;
+}
+
+GpuBufferArena::GpuBufferArena(GLenum target, size_t block_size) :
+  m_target(target),
+  m_block_size(block_size),
+  m_blocks()
+{
+}
+
+GpuBufferArena::~GpuBufferArena()
+{
+  for(auto const& block : m_blocks)
+  {
+    glDeleteBuffers(1, &block->buffer);
+  }
+}
+
+GpuAllocationPtr
+GpuBufferArena::allocate(const void* data, size_t size, size_t alignment)
+{
+  size = std::max<size_t>(size, 1);
+  alignment = std::max<size_t>(alignment, 1);
+
+  Block* block = nullptr;
+  size_t offset = 0;
+  for(auto const& candidate : m_blocks)
+  {
+    if (allocate_from(*candidate, size, alignment, offset))
+    {
+      block = candidate.get();
+      break;
+    }
+  }
+
+  if (!block)
+  {
+    block = &create_block(std::max(m_block_size, size));
+    if (!allocate_from(*block, size, alignment, offset))
+    {
+      throw std::runtime_error("GpuBufferArena: allocation failed");
+    }
+  }
+
+  const GLenum target = get_upload_target(m_target);
+  glBindBuffer(target, block->buffer);
+  glBufferSubData(target, offset, size, data);
+  glBindBuffer(target, 0);
+  assert_gl("GpuBufferArena::allocate");
+
+  GpuAllocation* allocation = new GpuAllocation{ block->buffer, offset, size, alignment, 0 };
+  block->allocations.insert(allocation);
+
+  std::weak_ptr<GpuBufferArena> arena = shared_from_this();
+  return GpuAllocationPtr(allocation,
+                          [arena](GpuAllocation* p) {
+                            if (auto self = arena.lock())
+                            {
+                              self->free(p);
+                            }
+                            delete p;
+                          });
+}
+
+void
+GpuBufferArena::free(GpuAllocation* allocation)
+{
+  for(auto it = m_blocks.begin(); it != m_blocks.end(); ++it)
+  {
+    Block& block = **it;
+    if (block.buffer == allocation->buffer)
+    {
+      block.allocations.erase(allocation);
+      free_range(block, allocation->offset, allocation->size);
+
+      // keep the last block around for the next allocation
+      if (block.allocations.empty() && m_blocks.size() > 1)
+      {
+        glDeleteBuffers(1, &block.buffer);
+        m_blocks.erase(it);
+      }
+      return;
+    }
+  }
+}
+
+void
+GpuBufferArena::compact()
+{
+#ifndef HAVE_OPENGLES2
+  if (!GLEW_ARB_copy_buffer)
+  {
+    return;
+  }
+
+  std::vector<std::unique_ptr<Block> > old_blocks = std::move(m_blocks);
+  m_blocks.clear();
+
+  // largest alignments first leaves the least padding
+  std::vector<std::pair<GLuint, GpuAllocation*> > allocations;
+  for(auto const& block : old_blocks)
+  {
+    for(GpuAllocation* allocation : block->allocations)
+    {
+      allocations.emplace_back(block->buffer, allocation);
+    }
+  }
+  std::sort(allocations.begin(), allocations.end(),
+            [](std::pair<GLuint, GpuAllocation*> const& lhs, std::pair<GLuint, GpuAllocation*> const& rhs) {
+              return lhs.second->alignment > rhs.second->alignment;
+            });
+
+  for(auto const& it : allocations)
+  {
+    GpuAllocation* allocation = it.second;
+
+    Block* block = nullptr;
+    size_t offset = 0;
+    for(auto const& candidate : m_blocks)
+    {
+      if (allocate_from(*candidate, allocation->size, allocation->alignment, offset))
+      {
+        block = candidate.get();
+        break;
+      }
+    }
+
+    if (!block)
+    {
+      block = &create_block(std::max(m_block_size, allocation->size));
+      allocate_from(*block, allocation->size, allocation->alignment, offset);
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, it.first);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, block->buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        allocation->offset, offset, allocation->size);
+
+    allocation->buffer = block->buffer;
+    allocation->offset = offset;
+    allocation->generation += 1;
+    block->allocations.insert(allocation);
+  }
+
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  for(auto const& block : old_blocks)
+  {
+    glDeleteBuffers(1, &block->buffer);
+  }
+  assert_gl("GpuBufferArena::compact");
+#endif
+}
+
+GpuBufferArena::Stats
+GpuBufferArena::get_stats() const
+{
+  Stats stats{ static_cast<int>(m_blocks.size()), 0, 0, 0, 0 };
+  for(auto const& block : m_blocks)
+  {
+    stats.allocations += static_cast<int>(block->allocations.size());
+    stats.capacity += block->size;
+
+    size_t free = 0;
+    for(auto const& range : block->free_ranges)
+    {
+      free += range.second;
+      stats.largest_free = std::max(stats.largest_free, range.second);
+    }
+    stats.used += block->size - free;
+  }
+  return stats;
+}
+
+GpuBufferArena::Block&
+GpuBufferArena::create_block(size_t size)
+{
+  std::unique_ptr<Block> block = std::make_unique<Block>();
+  block->size = size;
+  block->free_ranges[0] = size;
+
+  glGenBuffers(1, &block->buffer);
+  const GLenum target = get_upload_target(m_target);
+  glBindBuffer(target, block->buffer);
+  glBufferData(target, size, nullptr, GL_STATIC_DRAW);
+  glBindBuffer(target, 0);
+  assert_gl("GpuBufferArena::create_block");
+
+  m_blocks.push_back(std::move(block));
+  return *m_blocks.back();
+}
+
+bool
+GpuBufferArena::allocate_from(Block& block, size_t size, size_t alignment, size_t& offset)
+{
+  for(auto it = block.free_ranges.begin(); it != block.free_ranges.end(); ++it)
+  {
+    const size_t range_offset = it->first;
+    const size_t range_end = it->first + it->second;
+    const size_t aligned = align_up(range_offset, alignment);
+
+    if (aligned + size <= range_end)
+    {
+      block.free_ranges.erase(it);
+      if (aligned != range_offset)
+      {
+        block.free_ranges[range_offset] = aligned - range_offset;
+      }
+      if (aligned + size != range_end)
+      {
+        block.free_ranges[aligned + size] = range_end - (aligned + size);
+      }
+      offset = aligned;
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+GpuBufferArena::free_range(Block& block, size_t offset, size_t size)
+{
+  auto next = block.free_ranges.lower_bound(offset);
+  if (next != block.free_ranges.end() && offset + size == next->first)
+  {
+    size += next->second;
+    next = block.free_ranges.erase(next);
+  }
+
+  if (next != block.free_ranges.begin())
+  {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset)
+    {
+      prev->second += size;
+      return;
+    }
+  }
+
+  block.free_ranges[offset] = size;
+}
+
+/* EOF */
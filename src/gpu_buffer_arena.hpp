@@ -0,0 +1,131 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_GPU_BUFFER_ARENA_HPP
+#define HEADER_GPU_BUFFER_ARENA_HPP
+
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "opengl.hpp"
+
+/** A range within one of the buffer objects of a GpuBufferArena, it
+    goes back to the arena when the last reference is dropped */
+struct GpuAllocation
+{
+  GLuint buffer;
+  size_t offset;
+  size_t size;
+  size_t alignment;
+
+  /** Changes whenever GpuBufferArena::compact() moves the range */
+  unsigned int generation;
+};
+
+typedef std::shared_ptr<GpuAllocation> GpuAllocationPtr;
+
+/** Suballocates vertex or index data from a few large buffer objects
+    instead of creating one buffer object per Mesh. Allocations only
+    hold a weak reference, so that those outliving the arena just let
+    go of their range. */
+class GpuBufferArena : public std::enable_shared_from_this<GpuBufferArena>
+{
+public:
+  /** Size of the buffer objects, larger allocations get their own */
+  static const size_t s_block_size = 4 * 1024 * 1024;
+
+  struct Stats
+  {
+    int blocks;
+    int allocations;
+    size_t capacity;
+    size_t used;
+    size_t largest_free;
+
+    /** Share of the free space that lies outside the largest free
+        range, 0 when it is all in one piece */
+    float get_fragmentation() const
+    {
+      size_t free = capacity - used;
+      return (free == 0) ? 0.0f : 1.0f - static_cast<float>(largest_free) / static_cast<float>(free);
+    }
+  };
+
+public:
+  /** The arenas of the current GLContext, which owns them and
+      destroys them before the context itself */
+  static GpuBufferArena& get_vertex_arena();
+  static GpuBufferArena& get_index_arena();
+  static void set_arenas(GpuBufferArena* vertex_arena, GpuBufferArena* index_arena);
+
+private:
+  static GpuBufferArena* s_vertex_arena;
+  static GpuBufferArena* s_index_arena;
+
+private:
+  struct Block
+  {
+    GLuint buffer;
+    size_t size;
+
+    /** Free ranges by offset, neighbouring ranges are always merged */
+    std::map<size_t, size_t> free_ranges;
+
+    std::set<GpuAllocation*> allocations;
+  };
+
+private:
+  GLenum m_target;
+  size_t m_block_size;
+  std::vector<std::unique_ptr<Block> > m_blocks;
+
+public:
+  GpuBufferArena(GLenum target, size_t block_size);
+  ~GpuBufferArena();
+
+  /** The arena has to be owned by a std::shared_ptr. Upload \a size
+      bytes of \a data into a range that starts at a
+      multiple of \a alignment, which doesn't have to be a power of
+      two, a vertex stride makes the offset a base vertex */
+  GpuAllocationPtr allocate(const void* data, size_t size, size_t alignment);
+
+  /** Move all allocations together into as few buffer objects as
+      possible, the moved ones get a new generation. Does nothing
+      without GL_ARB_copy_buffer. */
+  void compact();
+
+  Stats get_stats() const;
+
+private:
+  void free(GpuAllocation* allocation);
+
+  Block& create_block(size_t size);
+
+  /** First fit, returns false if the block has no room */
+  static bool allocate_from(Block& block, size_t size, size_t alignment, size_t& offset);
+
+  static void free_range(Block& block, size_t offset, size_t size);
+
+private:
+  GpuBufferArena(const GpuBufferArena&) = delete;
+  GpuBufferArena& operator=(const GpuBufferArena&) = delete;
+};
+
+#endif
+
+/* EOF */
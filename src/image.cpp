@@ -0,0 +1,62 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "image.hpp"
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <stdexcept>
+
+#include "format.hpp"
+#include "pixel_convert.hpp"
+
+Image
+Image::from_file(const std::string& filename, bool vflip, bool swap_red_blue)
+{
+  SDL_Surface* surface = IMG_Load(filename.c_str());
+  if (!surface)
+  {
+    throw std::runtime_error(format("%s: couldn't load image: %s", filename, SDL_GetError()));
+  }
+
+  if (surface->format->BytesPerPixel != 3 && surface->format->BytesPerPixel != 4)
+  {
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(surface);
+    if (!converted)
+    {
+      throw std::runtime_error(format("%s: couldn't convert image: %s", filename, SDL_GetError()));
+    }
+    surface = converted;
+  }
+
+  Image image(surface->w, surface->h, surface->format->BytesPerPixel);
+
+  PixelConvert::copy_rows(image.pixels.data(), image.get_pitch(),
+                          static_cast<const uint8_t*>(surface->pixels), surface->pitch,
+                          image.get_pitch(), image.height, vflip);
+  SDL_FreeSurface(surface);
+
+  if (swap_red_blue)
+  {
+    PixelConvert::swap_red_blue(image.pixels.data(), static_cast<size_t>(image.width) * image.height,
+                                image.bytes_per_pixel);
+  }
+
+  return image;
+}
+
+/* EOF */
@@ -0,0 +1,57 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_IMAGE_HPP
+#define HEADER_IMAGE_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Tightly packed 8-bit RGB or RGBA pixels in main memory, rows
+    without padding */
+struct Image
+{
+  /** Decode an image file via SDL_image, thread-safe, throws on
+      failure. \a vflip puts the bottom row first as glTexImage2D()
+      expects it. Paletted and grayscale images are converted to RGBA. */
+  static Image from_file(const std::string& filename, bool vflip, bool swap_red_blue);
+
+  int width;
+  int height;
+  int bytes_per_pixel;
+  std::vector<uint8_t> pixels;
+
+  Image() :
+    width(0),
+    height(0),
+    bytes_per_pixel(0),
+    pixels()
+  {}
+
+  Image(int width_, int height_, int bytes_per_pixel_) :
+    width(width_),
+    height(height_),
+    bytes_per_pixel(bytes_per_pixel_),
+    pixels(static_cast<size_t>(width_) * height_ * bytes_per_pixel_)
+  {}
+
+  size_t get_pitch() const { return static_cast<size_t>(width) * bytes_per_pixel; }
+};
+
+#endif
+
+/* EOF */
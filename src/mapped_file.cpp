@@ -0,0 +1,80 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mapped_file.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "format.hpp"
+
+MappedFile::MappedFile(const std::string& filename) :
+  m_filename(filename),
+  m_data(nullptr),
+  m_size(0)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw std::runtime_error(format("%s: couldn't open file: %s", filename, strerror(errno)));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+  {
+    int err = errno;
+    close(fd);
+    throw std::runtime_error(format("%s: couldn't stat file: %s", filename, strerror(err)));
+  }
+
+  m_size = static_cast<size_t>(st.st_size);
+
+  // mmap() refuses zero length mappings, an empty file is just an
+  // empty buffer
+  if (m_size != 0)
+  {
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      int err = errno;
+      close(fd);
+      throw std::runtime_error(format("%s: couldn't mmap file: %s", filename, strerror(err)));
+    }
+
+    // the whole file is read front to back by the parsers
+    madvise(data, m_size, MADV_SEQUENTIAL);
+
+    m_data = static_cast<const char*>(data);
+  }
+
+  // the mapping keeps its own reference to the file
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (m_data)
+  {
+    munmap(const_cast<char*>(m_data), m_size);
+  }
+}
+
+/* EOF */
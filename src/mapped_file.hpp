@@ -0,0 +1,47 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_MAPPED_FILE_HPP
+#define HEADER_MAPPED_FILE_HPP
+
+#include <stddef.h>
+#include <string>
+
+/** Read-only memory mapping of a whole file, the mapping stays valid
+    for the lifetime of the object */
+class MappedFile
+{
+private:
+  std::string m_filename;
+  const char* m_data;
+  size_t m_size;
+
+public:
+  MappedFile(const std::string& filename);
+  ~MappedFile();
+
+  const char* get_data() const { return m_data; }
+  size_t get_size() const { return m_size; }
+  std::string const& get_filename() const { return m_filename; }
+
+private:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+};
+
+#endif
+
+/* EOF */
@@ -24,7 +24,16 @@
 #include "log.hpp"
 #include "render_context.hpp"
 
+MaterialPtr
+Material::create_instance(MaterialPtr prototype)
+{
+  MaterialPtr material = std::make_shared<Material>();
+  material->reload(prototype);
+  return material;
+}
+
 Material::Material() :
+  m_prototype(),
   m_cast_shadow(true),
   m_program(),
   m_textures(),
@@ -38,6 +47,22 @@ Material::Material() :
 {
 }
 
+void
+Material::reload(MaterialPtr prototype)
+{
+  m_prototype = prototype;
+  m_cast_shadow = prototype->m_cast_shadow;
+  m_program = prototype->m_program;
+  m_textures = prototype->m_textures;
+  m_uniforms->set_parent(prototype->m_uniforms);
+  m_capabilities = prototype->m_capabilities;
+  m_color_mask = prototype->m_color_mask;
+  m_depth_mask = prototype->m_depth_mask;
+  m_blend_sfactor = prototype->m_blend_sfactor;
+  m_blend_dfactor = prototype->m_blend_dfactor;
+  m_cull_face = prototype->m_cull_face;
+}
+
 void
 Material::color_mask(bool r, bool g, bool b, bool a)
 {
@@ -75,7 +100,14 @@ Material::disable(GLenum cap)
   m_capabilities[cap] = false;
 }
 
-void
+bool
+Material::is_enabled(GLenum cap) const
+{
+  auto it = m_capabilities.find(cap);
+  return it != m_capabilities.end() && it->second;
+}
+
+bool
 Material::apply(RenderContext const& context)
 {
   assert_gl("Material::apply:enter");
@@ -143,20 +175,41 @@ Material::apply(RenderContext const& context)
   }
   assert_gl("textures bound");
 
-  if (m_program)
+  if (!m_program)
+  {
+    glUseProgram(0);
+    return false;
+  }
+
+  // only blocks if the link submitted by ProgramCache isn't done yet,
+  // a broken shader is reported once and then left out
+  try
+  {
+    m_program->finish();
+  }
+  catch(const std::exception& err)
   {
-    glUseProgram(m_program->get_id());
-    assert_gl("program bound");
+    log_error("Material::apply: %s", err.what());
+  }
 
-    if (m_uniforms)
-    {
-      assert_gl("apply uniforms:enter");
-      m_uniforms->apply(m_program, context);
-      assert_gl("apply uniforms:exit");
-    }
+  if (m_program->is_failed())
+  {
+    glUseProgram(0);
+    return false;
+  }
+
+  glUseProgram(m_program->get_id());
+  assert_gl("program bound");
+
+  if (m_uniforms)
+  {
+    assert_gl("apply uniforms:enter");
+    m_uniforms->apply(m_program, context);
+    assert_gl("apply uniforms:exit");
   }
 
   assert_gl("Material::apply:exit");
+  return true;
 }
 
 /* EOF */
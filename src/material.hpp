@@ -37,9 +37,23 @@ public:
   TexturePtr secondary; // used for right eye in stereo
 };
 
+class Material;
+
+typedef std::shared_ptr<Material> MaterialPtr;
+
 class Material
 {
+public:
+  /** Create a cheap Material sharing Program, Textures and uniforms
+      with \a prototype. Uniforms set on the instance override those
+      of the prototype, everything else is copied and can be changed
+      without affecting the prototype. */
+  static MaterialPtr create_instance(MaterialPtr prototype);
+
 private:
+  /** Kept alive for the shared uniforms, nullptr if not an instance */
+  MaterialPtr m_prototype;
+
   bool m_cast_shadow;
 
   ProgramPtr m_program;
@@ -59,10 +73,16 @@ private:
 public:
   Material();
 
+  /** Make this instance follow a new \a prototype, e.g. after its
+      .material file was edited. Uniforms set on the instance are
+      kept, everything else is taken from \a prototype. */
+  void reload(MaterialPtr prototype);
+
   void cast_shadow(bool v) { m_cast_shadow = v; }
   bool cast_shadow() const { return m_cast_shadow; }
 
   void set_program(ProgramPtr program) { m_program = program; }
+  ProgramPtr get_program() const { return m_program; }
   void set_texture(int unit, TexturePtr texture) { m_textures[unit] = {TextureValue::REGULAR_TEXTURE, texture, texture}; }
   void set_texture(int unit, TexturePtr left, TexturePtr right) { m_textures[unit] = {TextureValue::REGULAR_TEXTURE, left, right}; }
   void set_video_texture(int unit) { m_textures[unit] = {TextureValue::VIDEO_TEXTURE, {}, {}}; }
@@ -71,25 +91,29 @@ public:
   void depth_mask(bool flag);
   void blend_func(GLenum sfactor, GLenum dfactor);
   void cull_face(GLenum mode);
+  GLenum get_cull_face() const { return m_cull_face; }
 
   void enable(GLenum cap);
   void disable(GLenum cap);
 
+  /** False for capabilities the Material leaves alone */
+  bool is_enabled(GLenum cap) const;
+
   template<typename T>
   void set_uniform(const std::string& name, T const& value)
   {
     m_uniforms->set_uniform(name, value);
   }
 
-  void apply(RenderContext const& context);
+  /** Returns false when the program failed to link or there is none,
+      nothing may be drawn with the material then */
+  bool apply(RenderContext const& context);
 
 private:
   Material(const Material&);
   Material& operator=(const Material&);
 };
 
-typedef std::shared_ptr<Material> MaterialPtr;
-
 #endif
 
 /* EOF */
@@ -16,18 +16,48 @@
 
 #include "material_factory.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/operations.hpp>
 
+#include "file_watcher.hpp"
 #include "framebuffer.hpp"
+#include "log.hpp"
 #include "material_parser.hpp"
+#include "program_cache.hpp"
 #include "render_context.hpp"
+#include "texture_cache.hpp"
+
+namespace {
+
+/** Returns false and logs the error if the link failed */
+bool finish_program(Program& program, std::string const& name)
+{
+  try
+  {
+    program.finish();
+  }
+  catch(const std::exception& err)
+  {
+    log_error("%s: %s", name, err.what());
+  }
+  return !program.is_failed();
+}
+
+} // namespace
 
 extern glm::mat4 g_shadowmap_matrix;
 extern std::unique_ptr<Framebuffer> g_shadowmap;
 
 MaterialFactory::MaterialFactory() :
-  m_materials()
+  m_materials(),
+  m_file_materials(),
+  m_pending_reloads(),
+  m_parses(0),
+  m_parses_avoided(0),
+  m_compiles_avoided(0),
+  m_reloads(0)
 {
   m_materials["basic_white"] = create_basic_white();
   m_materials["phong"] = create_phong(glm::vec3(0.5f, 0.5f, 0.5f),
@@ -57,6 +87,99 @@ MaterialFactory::MaterialFactory() :
 MaterialPtr
 MaterialFactory::from_file(const boost::filesystem::path& filename)
 {
+  boost::system::error_code ec;
+  boost::filesystem::path canonical = boost::filesystem::canonical(filename, ec);
+  std::string key = ec ? filename.string() : canonical.string();
+
+  FileMaterial& entry = m_file_materials[key];
+  MaterialPtr prototype = entry.prototype.lock();
+  if (prototype)
+  {
+    m_parses_avoided += 1;
+    if (prototype->get_program())
+    {
+      m_compiles_avoided += 1;
+    }
+  }
+  else
+  {
+    prototype = parse_file(filename);
+
+    if (entry.filename.empty())
+    {
+      FileWatcher::get().watch(key, [this](const std::string& changed){ reload(changed); });
+    }
+    entry.prototype = prototype;
+    entry.instances.clear();
+    entry.filename = filename;
+  }
+
+  MaterialPtr instance = Material::create_instance(prototype);
+  entry.instances.push_back(instance);
+  return instance;
+}
+
+void
+MaterialFactory::update()
+{
+  for(auto it = m_pending_reloads.begin(); it != m_pending_reloads.end();)
+  {
+    ProgramPtr program = it->prototype->get_program();
+    if (program && !program->is_ready())
+    {
+      ++it;
+    }
+    else if (program && !finish_program(*program, it->key))
+    {
+      log_error("%s: reload failed, keeping the old material", it->key);
+      it = m_pending_reloads.erase(it);
+    }
+    else
+    {
+      FileMaterial& entry = m_file_materials[it->key];
+      for(auto const& weak_instance : entry.instances)
+      {
+        if (MaterialPtr instance = weak_instance.lock())
+        {
+          instance->reload(it->prototype);
+        }
+      }
+      entry.instances.erase(std::remove_if(entry.instances.begin(), entry.instances.end(),
+                                           [](std::weak_ptr<Material> const& instance) {
+                                             return instance.expired();
+                                           }),
+                            entry.instances.end());
+      entry.prototype = it->prototype;
+      m_reloads += 1;
+
+      it = m_pending_reloads.erase(it);
+    }
+  }
+}
+
+void
+MaterialFactory::reload(const std::string& key)
+{
+  auto it = m_file_materials.find(key);
+  if (it != m_file_materials.end() && !it->second.prototype.expired())
+  {
+    // a parse error throws and leaves the old material in place
+    m_pending_reloads.push_back({ key, parse_file(it->second.filename) });
+  }
+}
+
+void
+MaterialFactory::log_stats() const
+{
+  log_info("MaterialFactory: %d parses, %d parses and %d compiles avoided, %d reloads",
+           m_parses, m_parses_avoided, m_compiles_avoided, m_reloads);
+}
+
+MaterialPtr
+MaterialFactory::parse_file(const boost::filesystem::path& filename)
+{
+  m_parses += 1;
+
   MaterialPtr material = MaterialParser::from_file(filename);
 
   material->set_uniform("ModelMatrix", UniformSymbol::ModelMatrix);
@@ -116,8 +239,7 @@ MaterialFactory::create_basic_white()
 
   material->set_uniform("MVP", UniformSymbol::ModelViewProjectionMatrix);
 
-  material->set_program(Program::create(Shader::from_file(GL_VERTEX_SHADER,   "src/glsl/basic_white.vert"),
-                                        Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/basic_white.frag")));
+  material->set_program(ProgramCache::get().create("src/glsl/basic_white.vert", "src/glsl/basic_white.frag"));
   return material;
 }
 
@@ -163,10 +285,9 @@ MaterialFactory::create_phong(const glm::vec3& diffuse,
                                 }));
   phong->set_texture(0, g_shadowmap->get_depth_texture());
   phong->set_uniform("ShadowMap", 0);
-  phong->set_texture(1, Texture::cubemap_from_file("data/textures/miramar/"));
+  phong->set_texture(1, TextureCache::get().cubemap_from_file("data/textures/miramar/"));
   //phong->set_uniform("LightMap", 1);
-  phong->set_program(Program::create(Shader::from_file(GL_VERTEX_SHADER, "src/glsl/phong.vert"),
-                                              Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/phong.frag")));
+  phong->set_program(ProgramCache::get().create("src/glsl/phong.vert", "src/glsl/phong.frag"));
   return phong;
 }
 
@@ -179,12 +300,11 @@ MaterialFactory::create_skybox()
   material->enable(GL_BLEND);
   material->enable(GL_CULL_FACE);
   material->enable(GL_DEPTH_TEST);
-  material->set_texture(0, Texture::cubemap_from_file("data/textures/miramar/"));
+  material->set_texture(0, TextureCache::get().cubemap_from_file("data/textures/miramar/"));
   material->set_uniform("diffuse", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
   material->set_uniform("diffuse_texture", 0);
   material->set_uniform("MVP", UniformSymbol::ModelViewProjectionMatrix);
-  material->set_program(Program::create(Shader::from_file(GL_VERTEX_SHADER, "src/glsl/cubemap.vert"),
-                                        Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/cubemap.frag")));
+  material->set_program(ProgramCache::get().create("src/glsl/cubemap.vert", "src/glsl/cubemap.frag"));
 
   return material;
 }
@@ -197,11 +317,10 @@ MaterialFactory::create_textured()
   material->enable(GL_CULL_FACE);
   material->enable(GL_DEPTH_TEST);
 
-  material->set_program(Program::create(Shader::from_file(GL_VERTEX_SHADER, "src/glsl/textured.vert"),
-                                        Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/textured.frag")));
+  material->set_program(ProgramCache::get().create("src/glsl/textured.vert", "src/glsl/textured.frag"));
 
-  material->set_texture(0, Texture::from_file("data/textures/uvtest.png"));
-  material->set_texture(1, Texture::from_file("data/textures/uvtest.png"));
+  material->set_texture(0, TextureCache::get().from_file("data/textures/uvtest.png"));
+  material->set_texture(1, TextureCache::get().from_file("data/textures/uvtest.png"));
   material->set_uniform("texture_diff", 0);
   material->set_uniform("texture_spec", 1);
 
@@ -20,6 +20,7 @@
 #include <boost/filesystem/path.hpp>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "material.hpp"
 
@@ -32,16 +33,62 @@ public:
     return instance;
   }
 
+private:
+  struct FileMaterial
+  {
+    std::weak_ptr<Material> prototype;
+
+    /** Handed out by from_file(), updated when the file is reloaded */
+    std::vector<std::weak_ptr<Material> > instances;
+
+    boost::filesystem::path filename;
+  };
+
+  struct PendingReload
+  {
+    std::string key;
+    MaterialPtr prototype;
+  };
+
 private:
   std::unordered_map<std::string, MaterialPtr> m_materials;
 
+  /** Parsed .material files keyed by canonical path, from_file()
+      hands out instances of these */
+  std::unordered_map<std::string, FileMaterial> m_file_materials;
+
+  /** Reparsed materials waiting for their program to be linked */
+  std::vector<PendingReload> m_pending_reloads;
+
+  int m_parses;
+  int m_parses_avoided;
+  int m_compiles_avoided;
+  int m_reloads;
+
 public:
   MaterialFactory();
 
+  /** Returns an instance of the material in \a name, the file is only
+      parsed and its program compiled on first use */
   MaterialPtr from_file(const boost::filesystem::path& name);
   MaterialPtr create(const std::string& name);
 
+  int get_parses() const { return m_parses; }
+  int get_parses_avoided() const { return m_parses_avoided; }
+  int get_compiles_avoided() const { return m_compiles_avoided; }
+
+  /** Swap in reloaded .material files once their programs are ready,
+      call once per frame outside of rendering */
+  void update();
+
+  void log_stats() const;
+
 private:
+  MaterialPtr parse_file(const boost::filesystem::path& filename);
+
+  /** Reparse the .material file \a key, called by the FileWatcher */
+  void reload(const std::string& key);
+
   static MaterialPtr create_phong(const glm::vec3& diffuse,
                                   const glm::vec3& ambient,
                                   const glm::vec3& specular,
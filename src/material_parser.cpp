@@ -9,6 +9,8 @@
 #include "opengl.hpp"
 #include "tokenize.hpp"
 #include "assert_gl.hpp"
+#include "program_cache.hpp"
+#include "texture_cache.hpp"
 
 namespace {
 
@@ -49,6 +51,37 @@ std::string to_string(T beg, T end)
   }
 }
 
+void add_default_fragment_defines(std::vector<std::string>& defines,
+                                  bool has_diffuse_texture,
+                                  bool has_specular_texture,
+                                  bool has_reflection_texture)
+{
+  if (has_diffuse_texture)
+  {
+    defines.emplace_back("DIFFUSE_COLOR_FROM_TEXTURE");
+  }
+  else
+  {
+    defines.emplace_back("DIFFUSE_COLOR_FROM_MATERIAL");
+  }
+
+  if (has_specular_texture)
+  {
+    defines.emplace_back("SPECULAR_COLOR_FROM_TEXTURE");
+  }
+  else
+  {
+    defines.emplace_back("SPECULAR_COLOR_FROM_MATERIAL");
+  }
+
+  if (has_reflection_texture)
+  {
+    defines.emplace_back("REFLECTION_TEXTURE");
+  }
+
+  defines.emplace_back("SHADOW_VALUE_4");
+}
+
 } // namespace
 
 //-----------------------------------------------------------------------------
@@ -77,6 +110,21 @@ MaterialParser::from_stream(std::istream& in)
   return parser.get_material();
 }
 
+std::vector<ProgramCache::Variant>
+MaterialParser::get_default_program_variants()
+{
+  std::vector<ProgramCache::Variant> variants;
+  for(int i = 0; i < 8; ++i)
+  {
+    ProgramCache::Variant variant;
+    variant.vertex_filename = "src/glsl/default.vert";
+    variant.fragment_filename = "src/glsl/default.frag";
+    add_default_fragment_defines(variant.fragment_defines, i & 1, i & 2, i & 4);
+    variants.push_back(variant);
+  }
+  return variants;
+}
+
 //-----------------------------------------------------------------------------
 
 MaterialParser::MaterialParser(const std::string& filename) :
@@ -132,14 +180,14 @@ MaterialParser::parse(std::istream& in)
             }
             else
             {
-              m_material->set_texture(current_texture_unit, Texture::from_file(diffuse_texture_name));
+              m_material->set_texture(current_texture_unit, TextureCache::get().from_file(diffuse_texture_name));
             }
           }
           else if (args.size() == 3)
           {
             m_material->set_texture(current_texture_unit,
-                                    Texture::from_file(args[1]),
-                                    Texture::from_file(args[2]));
+                                    TextureCache::get().from_file(args[1]),
+                                    TextureCache::get().from_file(args[2]));
           }
           else
           {
@@ -157,7 +205,7 @@ MaterialParser::parse(std::istream& in)
         else if (args[0] == "material.specular_texture")
         {
           has_specular_texture = true;
-          m_material->set_texture(current_texture_unit, Texture::from_file(to_string(args.begin()+1, args.end())));
+          m_material->set_texture(current_texture_unit, TextureCache::get().from_file(to_string(args.begin()+1, args.end())));
           m_material->set_uniform("material.specular_texture", current_texture_unit);
           current_texture_unit += 1;
         }
@@ -169,7 +217,7 @@ MaterialParser::parse(std::istream& in)
         else if (args[0] == "material.reflection_texture")
         {
           has_reflection_texture = true;
-          m_material->set_texture(current_texture_unit, Texture::cubemap_from_file(to_string(args.begin()+1, args.end())));
+          m_material->set_texture(current_texture_unit, TextureCache::get().cubemap_from_file(to_string(args.begin()+1, args.end())));
           m_material->set_uniform("material.reflection_texture", current_texture_unit);
           current_texture_unit += 1;
         }
@@ -247,34 +295,12 @@ MaterialParser::parse(std::istream& in)
 
   if (default_program)
   {
-    if (has_diffuse_texture)
-    {
-      program_fragment_defines.emplace_back("DIFFUSE_COLOR_FROM_TEXTURE");
-    }
-    else
-    {
-      program_fragment_defines.emplace_back("DIFFUSE_COLOR_FROM_MATERIAL");
-    }
-
-    if (has_specular_texture)
-    {
-      program_fragment_defines.emplace_back("SPECULAR_COLOR_FROM_TEXTURE");
-    }
-    else
-    {
-      program_fragment_defines.emplace_back("SPECULAR_COLOR_FROM_MATERIAL");
-    }
-
-    if (has_reflection_texture)
-    {
-      program_fragment_defines.emplace_back("REFLECTION_TEXTURE");
-    }
-
-    program_fragment_defines.emplace_back("SHADOW_VALUE_4");
+    add_default_fragment_defines(program_fragment_defines,
+                                 has_diffuse_texture, has_specular_texture, has_reflection_texture);
   }
 
-  ProgramPtr program = Program::create(Shader::from_file(GL_VERTEX_SHADER, program_vertex, program_vertex_defines),
-                                       Shader::from_file(GL_FRAGMENT_SHADER, program_fragment, program_fragment_defines));
+  ProgramPtr program = ProgramCache::get().create(program_vertex, program_vertex_defines,
+                                                  program_fragment, program_fragment_defines);
   m_material->set_program(program);
 }
 
@@ -3,9 +3,11 @@
 
 #include <iosfwd>
 #include <string>
+#include <vector>
 #include <boost/filesystem/path.hpp>
 
 #include "material.hpp"
+#include "program_cache.hpp"
 
 class MaterialParser
 {
@@ -17,6 +19,10 @@ public:
   static MaterialPtr from_file(const boost::filesystem::path& filename);
   static MaterialPtr from_stream(std::istream& in);
 
+  /** All combinations of the default program a .material file
+      without its own program.* lines can end up with */
+  static std::vector<ProgramCache::Variant> get_default_program_variants();
+
   MaterialParser(const std::string& filename);
   void parse(std::istream& in);
   MaterialPtr get_material() { return m_material; }
@@ -18,14 +18,172 @@
 
 #define GLM_FORCE_RADIANS
 #include <glm/ext.hpp>
+#include <algorithm>
 #include <iostream>
+#include <string.h>
 
 #include "opengl.hpp"
 #include "log.hpp"
 #include "opengl_state.hpp"
+#include "render_stats.hpp"
+#include "vertex_quantizer.hpp"
 
 namespace {
 
+/** Vertices addressable with 16-bit indices, 0xffff stays free as it
+    is the primitive restart index */
+const int max_short_vertices = 65535;
+
+/** Bounds of the positions as stored, before the vertex transform.
+    Skinned vertices leave them when posed, those get an infinite box */
+BoundingBox get_stored_bounds(const VertexFormat& format, const void* data, int count)
+{
+  const VertexFormat::Attribute* position = nullptr;
+  for(auto const& attr : format.get_attributes())
+  {
+    if (attr.name == "bone_index")
+    {
+      return BoundingBox::infinite();
+    }
+    else if (attr.name == "position")
+    {
+      position = &attr;
+    }
+  }
+
+  if (!position || position->size < 2)
+  {
+    return BoundingBox::infinite();
+  }
+
+  const uint8_t* vertex = static_cast<const uint8_t*>(data) + position->offset;
+  const int components = std::min(position->size, 3);
+  BoundingBox box;
+  for(int i = 0; i < count; ++i, vertex += format.get_stride())
+  {
+    glm::vec3 p(0.0f);
+    for(int c = 0; c < components; ++c)
+    {
+      if (position->component == GL_FLOAT)
+      {
+        memcpy(&p[c], vertex + 4 * c, sizeof(float));
+      }
+      else if (position->component == GL_UNSIGNED_SHORT && position->normalized)
+      {
+        uint16_t value;
+        memcpy(&value, vertex + 2 * c, sizeof(value));
+        p[c] = static_cast<float>(value) / 65535.0f;
+      }
+      else
+      {
+        return BoundingBox::infinite();
+      }
+    }
+    box.add(p);
+  }
+  return box;
+}
+
+struct MeshPart
+{
+  std::vector<int> vertices;
+  std::vector<uint16_t> indices;
+  std::vector<MeshCluster> clusters;
+};
+
+/** Distribute the triangles over parts that each stay below
+    max_short_vertices, vertices used by several parts get duplicated.
+    With \a clusters the parts are only cut between clusters. */
+std::vector<MeshPart> split_triangles(const int* indices, int count, int vertex_count,
+                                      const MeshCluster* clusters, int cluster_count)
+{
+  std::vector<MeshPart> parts(1);
+  std::vector<int> remap(vertex_count, -1);
+  std::vector<int> counted(vertex_count, -1);
+
+  const int groups = (cluster_count != 0) ? cluster_count : count / 3;
+  for(int group = 0; group < groups; ++group)
+  {
+    const int first = (cluster_count != 0) ? clusters[group].first : group * 3;
+    const int last = (cluster_count != 0) ? first + clusters[group].count : first + 3;
+
+    size_t new_vertices = 0;
+    for(int i = first; i < last; ++i)
+    {
+      if (indices[i] < 0 || indices[i] >= vertex_count)
+      {
+        throw std::runtime_error("index out of range");
+      }
+      else if (remap[indices[i]] == -1 && counted[indices[i]] != group)
+      {
+        counted[indices[i]] = group;
+        new_vertices += 1;
+      }
+    }
+
+    if (parts.back().vertices.size() + new_vertices > max_short_vertices)
+    {
+      for(int v : parts.back().vertices)
+      {
+        remap[v] = -1;
+      }
+      parts.emplace_back();
+    }
+
+    MeshPart& part = parts.back();
+    if (cluster_count != 0)
+    {
+      part.clusters.push_back(clusters[group]);
+      part.clusters.back().first = static_cast<int>(part.indices.size());
+    }
+
+    for(int i = first; i < last; ++i)
+    {
+      if (remap[indices[i]] == -1)
+      {
+        remap[indices[i]] = static_cast<int>(part.vertices.size());
+        part.vertices.push_back(indices[i]);
+      }
+      part.indices.push_back(static_cast<uint16_t>(remap[indices[i]]));
+    }
+  }
+
+  return parts;
+}
+
+/** Triangles drawn from \a count vertices or indices */
+long get_triangle_count(GLenum primitive_type, int count)
+{
+  switch(primitive_type)
+  {
+    case GL_TRIANGLES:
+      return count / 3;
+
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+      return std::max(0, count - 2);
+
+    default:
+      return 0;
+  }
+}
+
+/** Throws unless the clusters are consecutive whole triangle ranges */
+void check_clusters(const MeshCluster* clusters, int cluster_count, int count)
+{
+  int end = 0;
+  for(int i = 0; i < cluster_count; ++i)
+  {
+    if (clusters[i].first != end ||
+        clusters[i].count <= 0 || clusters[i].count % 3 != 0 ||
+        clusters[i].count > count - clusters[i].first)
+    {
+      throw std::runtime_error("cluster out of range");
+    }
+    end = clusters[i].first + clusters[i].count;
+  }
+}
+
 } // namespace
 
 std::unique_ptr<Mesh>
@@ -88,9 +246,7 @@ Mesh::create_skybox(float size)
 
   std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(GL_TRIANGLES);
 
-  mesh->attach_float_array("normal", vn);
-  mesh->attach_float_array("texcoord", vt);
-  mesh->attach_float_array("position", vp);
+  mesh->attach_interleaved({ { "position", vp }, { "normal", vn }, { "texcoord", vt } });
   mesh->attach_element_array(FaceLst(faces, faces + sizeof(faces)/sizeof(faces[0])));
 
   return mesh;
@@ -120,9 +276,7 @@ Mesh::create_plane(float size, glm::vec3 center)
   vp.emplace_back(+size, 0, -size);
   vp.emplace_back(-size, 0, -size);
 
-  mesh->attach_float_array("normal", vn);
-  mesh->attach_float_array("texcoord", vt);
-  mesh->attach_float_array("position", vp);
+  mesh->attach_interleaved({ { "position", vp }, { "normal", vn }, { "texcoord", vt } });
 
   return mesh;
 }
@@ -145,8 +299,7 @@ Mesh::create_rect(float x1, float y1, float x2, float y2, float z)
   vp.emplace_back(x2, y1, z);
   vp.emplace_back(x1, y1, z);
 
-  mesh->attach_float_array("texcoord", vt);
-  mesh->attach_float_array("position", vp);
+  mesh->attach_interleaved({ { "position", vp }, { "texcoord", vt } });
 
   return mesh;
 }
@@ -171,38 +324,43 @@ Mesh::create_curved_screen(float size, float hfov, float vfov, int rings, int se
   // hfov = 2.0f * glm::pi<float>()
   // vfov = glm::pi<float>()
 
-  // FIXME: should use indexed array instead to save some vertices
-  auto add_point = [&](int ring, int seg) {
-    float r = static_cast<float>(ring + offset_y) / rings;
-    float s = static_cast<float>(seg + offset_x)  / segments;
+  for(int ring = 0; ring <= rings; ++ring)
+  {
+    for(int seg = 0; seg <= segments; ++seg)
+    {
+      float r = static_cast<float>(ring + offset_y) / rings;
+      float s = static_cast<float>(seg + offset_x)  / segments;
 
-    float f = sinf((r-0.5f) * vfov + glm::half_pi<float>());
-    glm::vec3 p(cosf((s-0.5f) * hfov - glm::half_pi<float>()) * f,
-                cosf((r-0.5f) * vfov + glm::half_pi<float>()),
-                sinf((s-0.5f) * hfov - glm::half_pi<float>()) * f);
+      float f = sinf((r-0.5f) * vfov + glm::half_pi<float>());
+      glm::vec3 p(cosf((s-0.5f) * hfov - glm::half_pi<float>()) * f,
+                  cosf((r-0.5f) * vfov + glm::half_pi<float>()),
+                  sinf((s-0.5f) * hfov - glm::half_pi<float>()) * f);
 
-    vn.push_back(-p);
-    vt.emplace_back(!flip_uv_x ? s : 1.0f - s, !flip_uv_y ? r : 1.0f - r, 0.0f);
-    vp.push_back(p * size);
-  };
+      vn.push_back(-p);
+      vt.emplace_back(!flip_uv_x ? s : 1.0f - s, !flip_uv_y ? r : 1.0f - r, 0.0f);
+      vp.push_back(p * size);
+    }
+  }
+
+  auto idx = [&](int ring, int seg) { return ring * (segments + 1) + seg; };
 
+  FaceLst faces;
   for(int ring = 0; ring < rings; ++ring)
   {
     for(int seg = 0; seg < segments; ++seg)
     {
-      add_point(ring+1, seg  );
-      add_point(ring+1, seg+1);
-      add_point(ring,   seg  );
+      faces.push_back(idx(ring+1, seg  ));
+      faces.push_back(idx(ring+1, seg+1));
+      faces.push_back(idx(ring,   seg  ));
 
-      add_point(ring+1, seg+1);
-      add_point(ring,   seg+1);
-      add_point(ring,   seg  );
+      faces.push_back(idx(ring+1, seg+1));
+      faces.push_back(idx(ring,   seg+1));
+      faces.push_back(idx(ring,   seg  ));
     }
   }
 
-  mesh->attach_float_array("normal", vn);
-  mesh->attach_float_array("texcoord", vt);
-  mesh->attach_float_array("position", vp);
+  mesh->attach_interleaved({ { "position", vp }, { "normal", vn }, { "texcoord", vt } });
+  mesh->attach_element_array(faces);
 
   return mesh;
 }
@@ -216,120 +374,495 @@ Mesh::create_sphere(float size, int rings, int segments)
   TexCoordLst vt;
   VertexLst   vp;
 
-  // FIXME: should use indexed array instead to save some vertices
-  auto add_point = [&](int ring, int seg) {
-    float r = static_cast<float>(ring) / rings;
-    float s = static_cast<float>(seg)  / segments;
+  for(int ring = 0; ring <= rings; ++ring)
+  {
+    for(int seg = 0; seg <= segments; ++seg)
+    {
+      float r = static_cast<float>(ring) / rings;
+      float s = static_cast<float>(seg)  / segments;
 
-    float f = sinf(r * glm::pi<float>());
-    glm::vec3 p(cosf(s * 2.0f * glm::pi<float>()) * f,
-                cosf(r * glm::pi<float>()),
-                sinf(s * 2.0f * glm::pi<float>()) * f);
+      float f = sinf(r * glm::pi<float>());
+      glm::vec3 p(cosf(s * 2.0f * glm::pi<float>()) * f,
+                  cosf(r * glm::pi<float>()),
+                  sinf(s * 2.0f * glm::pi<float>()) * f);
 
-    vn.push_back(p);
-    vt.emplace_back(r, s, 0.0f);
-    vp.push_back(p * size);
-  };
+      vn.push_back(p);
+      vt.emplace_back(r, s, 0.0f);
+      vp.push_back(p * size);
+    }
+  }
+
+  auto idx = [&](int ring, int seg) { return ring * (segments + 1) + seg; };
 
+  FaceLst faces;
   for(int ring = 0; ring < rings; ++ring)
   {
     for(int seg = 0; seg < segments; ++seg)
     {
-      add_point(ring,   seg  );
-      add_point(ring,   seg+1);
-      add_point(ring+1, seg  );
+      faces.push_back(idx(ring,   seg  ));
+      faces.push_back(idx(ring,   seg+1));
+      faces.push_back(idx(ring+1, seg  ));
 
-      add_point(ring,   seg+1);
-      add_point(ring+1, seg+1);
-      add_point(ring+1, seg  );
+      faces.push_back(idx(ring,   seg+1));
+      faces.push_back(idx(ring+1, seg+1));
+      faces.push_back(idx(ring+1, seg  ));
     }
   }
 
-  mesh->attach_float_array("normal", vn);
-  mesh->attach_float_array("texcoord", vt);
-  mesh->attach_float_array("position", vp);
+  mesh->attach_interleaved({ { "position", vp }, { "normal", vn }, { "texcoord", vt } });
+  mesh->attach_element_array(faces);
 
   return mesh;
 }
 
+std::vector<MeshData>
+Mesh::prepare_indexed(const VertexData& vertices, const int* indices, int count,
+                      const MeshCluster* clusters, int cluster_count,
+                      const int* lod_indices, int lod_index_count,
+                      const MeshLod* lods, int lod_count)
+{
+  std::vector<MeshData> parts;
+
+  check_clusters(clusters, cluster_count, count);
+
+  if (vertices.count <= max_short_vertices)
+  {
+    // the LOD levels go behind the full mesh into the same element array
+    MeshData part{ vertices, std::vector<uint16_t>(indices, indices + count),
+                   std::vector<MeshCluster>(clusters, clusters + cluster_count), {} };
+    for(int i = 0; i < lod_count && cluster_count != 0; ++i)
+    {
+      if (lods[i].first < 0 || lods[i].count < 0 || lods[i].count > lod_index_count - lods[i].first)
+      {
+        throw std::runtime_error("LOD out of range");
+      }
+      part.lods.push_back(lods[i]);
+      part.lods.back().first = static_cast<int>(part.indices.size());
+      part.indices.insert(part.indices.end(), lod_indices + lods[i].first, lod_indices + lods[i].first + lods[i].count);
+    }
+    parts.push_back(std::move(part));
+  }
+  else
+  {
+    for(auto& part : split_triangles(indices, count, vertices.count, clusters, cluster_count))
+    {
+      parts.push_back(MeshData{ vertices.gather(part.vertices), std::move(part.indices),
+                                std::move(part.clusters), {} });
+    }
+  }
+
+  return parts;
+}
+
+std::unique_ptr<Mesh>
+Mesh::create(const MeshDataRef& data)
+{
+  std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(GL_TRIANGLES);
+  mesh->attach_vertex_buffer(data.format, data.vertices, data.vertex_count);
+  mesh->m_vertex_transform = data.transform;
+  mesh->m_bounding_box = mesh->m_bounding_box.transform(data.transform);
+  mesh->attach_element_array(data.indices, data.index_count);
+  mesh->attach_clusters(std::vector<MeshCluster>(data.clusters, data.clusters + data.cluster_count));
+  mesh->attach_lods(std::vector<MeshLod>(data.lods, data.lods + data.lod_count));
+  return mesh;
+}
+
+std::vector<std::unique_ptr<Mesh> >
+Mesh::create_indexed(const VertexData& vertices, const int* indices, int count,
+                     const MeshCluster* clusters, int cluster_count,
+                     const int* lod_indices, int lod_index_count,
+                     const MeshLod* lods, int lod_count)
+{
+  std::vector<std::unique_ptr<Mesh> > meshes;
+  for(auto const& part : prepare_indexed(vertices, indices, count, clusters, cluster_count,
+                                         lod_indices, lod_index_count, lods, lod_count))
+  {
+    meshes.push_back(create(part.get_ref()));
+  }
+  return meshes;
+}
+
 Mesh::Mesh(GLenum primitive_type) :
   m_primitive_type(primitive_type),
-  m_attribute_arrays(),
-  m_element_array_vbo(0),
-  m_element_count(-1)
+  m_vertex_format(),
+  m_vertex_allocation(),
+  m_vertex_count(0),
+  m_element_allocation(),
+  m_element_type(GL_UNSIGNED_SHORT),
+  m_element_count(0),
+  m_vertex_array(0),
+  m_vertex_array_generation(0),
+  m_base_vertex(0),
+  m_vertex_transform(1.0f),
+  m_bounding_box(),
+  m_clusters(),
+  m_bounds(),
+  m_lods(),
+  m_lod(0),
+  m_draw_counts(),
+  m_draw_offsets(),
+  m_draw_base_vertices()
 {
 }
 
 Mesh::~Mesh()
 {
-  for(auto const& array : m_attribute_arrays)
+#ifndef HAVE_OPENGLES2
+  glDeleteVertexArrays(1, &m_vertex_array);
+#endif
+}
+
+bool
+Mesh::has_base_vertex()
+{
+#ifdef HAVE_OPENGLES2
+  return false;
+#else
+  return GLEW_ARB_draw_elements_base_vertex;
+#endif
+}
+
+void
+Mesh::attach_vertex_buffer(const VertexFormat& format, const void* data, int count)
+{
+  if (m_vertex_allocation)
+  {
+    throw std::runtime_error("vertex buffer already present");
+  }
+
+  for(auto const& attr : format.get_attributes())
   {
-    glDeleteBuffers(1, &array.second.vbo);
+    if (VertexAttribute::get_location(attr.name) == -1)
+    {
+      throw std::runtime_error("array '" + attr.name + "' has no attribute location");
+    }
   }
-  glDeleteBuffers(1, &m_element_array_vbo);
+
+  const size_t stride = format.get_stride();
+  m_vertex_allocation = GpuBufferArena::get_vertex_arena().allocate(data, stride * count, stride);
+  m_vertex_format = format;
+  m_vertex_count = count;
+  m_bounding_box = get_stored_bounds(format, data, count);
 }
 
 void
-Mesh::draw()
+Mesh::attach_element_array(const int* data, int count)
 {
-  OpenGLState state;
+  int max_index = 0;
+  for(int i = 0; i < count; ++i)
+  {
+    max_index = std::max(max_index, data[i]);
+  }
 
-  GLint program;
-  glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+  if (max_index < max_short_vertices)
+  {
+    std::vector<uint16_t> indices(data, data + count);
+    attach_element_array(indices.data(), count);
+  }
+  else if (m_element_allocation)
+  {
+    throw std::runtime_error("element array already present");
+  }
+  else
+  {
+#ifdef HAVE_OPENGLES2
+    throw std::runtime_error("indices don't fit into 16 bits, use Mesh::create_indexed()");
+#else
+    m_element_allocation = GpuBufferArena::get_index_arena().allocate(data, sizeof(int) * count, sizeof(int));
+    m_element_type = GL_UNSIGNED_INT;
+    m_element_count = count;
+#endif
+  }
+}
 
-  assert_gl("Mesh::draw1");
-  //log_debug("Mesh::draw: %d", program);
+void
+Mesh::attach_element_array(const uint16_t* data, int count)
+{
+  if (m_element_allocation)
+  {
+    throw std::runtime_error("element array already present");
+  }
+  else
+  {
+    m_element_allocation = GpuBufferArena::get_index_arena().allocate(data, sizeof(uint16_t) * count, sizeof(uint16_t));
+    m_element_type = GL_UNSIGNED_SHORT;
+    m_element_count = count;
+  }
+}
+
+void
+Mesh::attach_clusters(std::vector<MeshCluster> clusters)
+{
+  m_clusters = std::move(clusters);
 
-  // activate attribute arrays
-  for(auto const& array : m_attribute_arrays)
+  if (!m_clusters.empty())
   {
-    int loc = glGetAttribLocation(program, array.first.c_str());
-    if (loc == -1)
+    m_bounds = m_clusters.front();
+    for(auto const& cluster : m_clusters)
     {
-      //log_error("%s: attribute not found", array.first);
+      m_bounds.min = glm::min(m_bounds.min, cluster.min);
+      m_bounds.max = glm::max(m_bounds.max, cluster.max);
+    }
+    m_bounds.first = 0;
+    m_bounds.count = m_clusters.back().first + m_clusters.back().count;
+    m_bounds.center = (m_bounds.min + m_bounds.max) * 0.5f;
+    m_bounds.radius = 0.0f;
+    for(auto const& cluster : m_clusters)
+    {
+      m_bounds.radius = std::max(m_bounds.radius, glm::length(cluster.center - m_bounds.center) + cluster.radius);
+    }
+    m_bounds.cone_cutoff = -1.0f;
+  }
+}
+
+void
+Mesh::attach_lods(std::vector<MeshLod> lods)
+{
+  if (!lods.empty() && m_clusters.empty())
+  {
+    throw std::runtime_error("LOD levels need clusters");
+  }
+
+  for(auto const& lod : lods)
+  {
+    if (lod.first < 0 || lod.count < 0 || lod.count > m_element_count - lod.first)
+    {
+      throw std::runtime_error("LOD out of range");
+    }
+  }
+
+  m_lods = std::move(lods);
+  m_lod = 0;
+}
+
+void
+Mesh::attach_vertex_data(const VertexData& vertices)
+{
+  attach_vertex_buffer(vertices.format, vertices.data.data(), vertices.count);
+  m_vertex_transform = vertices.transform;
+  m_bounding_box = m_bounding_box.transform(m_vertex_transform);
+}
+
+void
+Mesh::attach_interleaved(std::vector<VertexSource> const& sources)
+{
+  attach_vertex_data(VertexData::interleave(sources));
+}
+
+void
+Mesh::attach_quantized(std::vector<VertexSource> const& sources)
+{
+#ifdef HAVE_OPENGLES2
+  attach_interleaved(sources);
+#else
+  attach_vertex_data(VertexQuantizer::quantize(sources));
+#endif
+}
+
+unsigned int
+Mesh::get_generation() const
+{
+  return
+    (m_vertex_allocation ? m_vertex_allocation->generation : 0) +
+    (m_element_allocation ? m_element_allocation->generation : 0);
+}
+
+void
+Mesh::setup_arrays()
+{
+  m_base_vertex = 0;
+
+  if (m_vertex_allocation)
+  {
+    // the vertices start at a multiple of the stride, without base
+    // vertex support their offset goes into the attribute pointers
+    const int stride = m_vertex_format.get_stride();
+    size_t buffer_offset = 0;
+    if (has_base_vertex())
+    {
+      m_base_vertex = static_cast<int>(m_vertex_allocation->offset / stride);
     }
     else
     {
-      glBindBuffer(GL_ARRAY_BUFFER, array.second.vbo);
+      buffer_offset = m_vertex_allocation->offset;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertex_allocation->buffer);
+    for(auto const& attr : m_vertex_format.get_attributes())
+    {
+      int loc = VertexAttribute::get_location(attr.name);
 
-      if (array.second.type == Array::Integer)
+      const GLvoid* offset = reinterpret_cast<const GLvoid*>(static_cast<uintptr_t>(buffer_offset + attr.offset));
+      if (attr.type == VertexFormat::Type::Integer)
       {
 #ifndef HAVE_OPENGLES2
-        glVertexAttribIPointer(loc, array.second.size, GL_INT, 0, nullptr);
+        glVertexAttribIPointer(loc, attr.size, attr.component, stride, offset);
 #endif
       }
-      else // if (array.second.type == Array::Float)
+      else // if (attr.type == VertexFormat::Type::Float)
       {
-        glVertexAttribPointer(loc, array.second.size, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glVertexAttribPointer(loc, attr.size, attr.component, attr.normalized ? GL_TRUE : GL_FALSE, stride, offset);
       }
 
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
-
       glEnableVertexAttribArray(loc);
     }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
   }
-  assert_gl("Mesh::draw2");
 
-  // activate element array and draw the mesh
-  if (m_element_array_vbo)
+  if (m_element_allocation)
   {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_element_array_vbo);
-    assert_gl("Mesh::draw: glBindBuffer");
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_element_allocation->buffer);
+  }
+  assert_gl("Mesh::setup_arrays");
+}
+
+void
+Mesh::draw(const ClusterCuller* culler)
+{
+  if (m_element_allocation)
+  {
+    // the ranges of the element array to draw, neighbouring visible
+    // clusters merge into one
+    m_draw_counts.clear();
+    m_draw_offsets.clear();
+    int end = -1;
+    auto add_range = [this, &end](int first, int count) {
+      const size_t index_size = (m_element_type == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(int);
+      if (first == end)
+      {
+        m_draw_counts.back() += count;
+      }
+      else
+      {
+        m_draw_counts.push_back(count);
+        m_draw_offsets.push_back(reinterpret_cast<const GLvoid*>(
+                                   static_cast<uintptr_t>(m_element_allocation->offset + index_size * first)));
+      }
+      end = first + count;
+    };
+
+    if (m_lod > 0 && m_lod <= static_cast<int>(m_lods.size()))
+    {
+      if (!culler || culler->is_visible(m_bounds))
+      {
+        add_range(m_lods[m_lod - 1].first, m_lods[m_lod - 1].count);
+      }
+    }
+    else if (culler && !m_clusters.empty())
+    {
+      for(auto const& cluster : m_clusters)
+      {
+        if (culler->is_visible(cluster))
+        {
+          add_range(cluster.first, cluster.count);
+        }
+      }
+    }
+    else
+    {
+      // the LOD levels follow behind the full mesh
+      add_range(0, m_lods.empty() ? m_element_count : m_lods.front().first);
+    }
+
+    if (m_draw_counts.empty())
+    {
+      return;
+    }
+  }
+
+  OpenGLState state;
+
+#ifndef HAVE_OPENGLES2
+  // put back whatever was bound before, the viewer keeps a default
+  // vertex array object bound for all the GL calls outside of draws
+  GLint previous_vertex_array = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous_vertex_array);
+
+  if (!m_vertex_array)
+  {
+    glGenVertexArrays(1, &m_vertex_array);
+    glBindVertexArray(m_vertex_array);
+    setup_arrays();
+    m_vertex_array_generation = get_generation();
+  }
+  else
+  {
+    glBindVertexArray(m_vertex_array);
+    if (m_vertex_array_generation != get_generation())
+    {
+      // moved by GpuBufferArena::compact()
+      setup_arrays();
+      m_vertex_array_generation = get_generation();
+    }
+  }
+#else
+  setup_arrays();
+#endif
+
+  if (m_element_allocation)
+  {
+    const GLsizei drawcount = static_cast<GLsizei>(m_draw_counts.size());
+    if (drawcount == 1)
+    {
+#ifndef HAVE_OPENGLES2
+      if (m_base_vertex != 0)
+      {
+        glDrawElementsBaseVertex(m_primitive_type, m_draw_counts[0], m_element_type,
+                                 const_cast<GLvoid*>(m_draw_offsets[0]), m_base_vertex);
+      }
+      else
+#endif
+      {
+        glDrawElements(m_primitive_type, m_draw_counts[0], m_element_type, m_draw_offsets[0]);
+      }
+    }
+    else
+    {
 #ifndef HAVE_OPENGLES2
-    glDrawElements(m_primitive_type, m_element_count, GL_UNSIGNED_INT, 0);
+      if (m_base_vertex != 0)
+      {
+        m_draw_base_vertices.assign(drawcount, m_base_vertex);
+        glMultiDrawElementsBaseVertex(m_primitive_type, m_draw_counts.data(), m_element_type,
+                                      const_cast<GLvoid**>(m_draw_offsets.data()), drawcount,
+                                      m_draw_base_vertices.data());
+      }
+      else
+      {
+        glMultiDrawElements(m_primitive_type, m_draw_counts.data(), m_element_type, m_draw_offsets.data(), drawcount);
+      }
 #else
-    glDrawElements(m_primitive_type, m_element_count, GL_UNSIGNED_SHORT, 0);
+      for(GLsizei i = 0; i < drawcount; ++i)
+      {
+        glDrawElements(m_primitive_type, m_draw_counts[i], m_element_type, m_draw_offsets[i]);
+      }
 #endif
+    }
     assert_gl("Mesh::draw: glDrawElements");
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    RenderStats::get().draw_calls += 1;
+    for(GLsizei count : m_draw_counts)
+    {
+      RenderStats::get().triangles += get_triangle_count(m_primitive_type, count);
+    }
   }
   else
   {
-    glDrawArrays(m_primitive_type, 0, m_element_count);
+    glDrawArrays(m_primitive_type, m_base_vertex, m_vertex_count);
     assert_gl("Mesh::draw: glDrawArrays");
+
+    RenderStats::get().draw_calls += 1;
+    RenderStats::get().triangles += get_triangle_count(m_primitive_type, m_vertex_count);
   }
 
-  // FIXME: missing glDisableVertexAttribArray()
+#ifndef HAVE_OPENGLES2
+  glBindVertexArray(static_cast<GLuint>(previous_vertex_array));
+#else
+  for(auto const& attr : m_vertex_format.get_attributes())
+  {
+    glDisableVertexAttribArray(VertexAttribute::get_location(attr.name));
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+#endif
 }
 
 /* EOF */
@@ -21,9 +21,13 @@
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <memory>
-#include <unordered_map>
 
+#include "bounding_box.hpp"
+#include "gpu_buffer_arena.hpp"
+#include "mesh_cluster.hpp"
+#include "mesh_simplifier.hpp"
 #include "opengl_state.hpp"
+#include "vertex_format.hpp"
 
 typedef std::vector<glm::vec3>  NormalLst;
 typedef std::vector<glm::vec3>  VertexLst;
@@ -33,6 +37,43 @@ typedef std::vector<glm::vec4>  BoneWeights;
 typedef std::vector<glm::ivec4> BoneIndices;
 typedef std::vector<int>        BoneCounts;
 
+/** The vertices and 16-bit indices of one Mesh in the formats they
+    get uploaded in, pointing into memory owned by someone else, such
+    as a MeshData or a mapped SceneCache */
+struct MeshDataRef
+{
+  VertexFormat format;
+  glm::mat4 transform;
+  const void* vertices;
+  int vertex_count;
+  const uint16_t* indices;
+  int index_count;
+  const MeshCluster* clusters;
+  int cluster_count;
+  const MeshLod* lods;
+  int lod_count;
+};
+
+/** Output of Mesh::prepare_indexed(), the LOD levels index the
+    element array behind the full mesh */
+struct MeshData
+{
+  VertexData vertices;
+  std::vector<uint16_t> indices;
+  std::vector<MeshCluster> clusters;
+  std::vector<MeshLod> lods;
+
+  MeshDataRef get_ref() const
+  {
+    return MeshDataRef{
+      vertices.format, vertices.transform,
+      vertices.data.data(), vertices.count,
+      indices.data(), static_cast<int>(indices.size()),
+      clusters.data(), static_cast<int>(clusters.size()),
+      lods.data(), static_cast<int>(lods.size()) };
+  }
+};
+
 template<typename C>
 inline size_t glm_vec_length()
 {
@@ -47,28 +88,50 @@ template<> inline size_t glm_vec_length<glm::vec4>() { return 4; }
 class Mesh
 {
 private:
-  struct Array
-  {
-    enum Type { Integer, Float } type;
-    int size;
-    GLuint vbo;
-
-    Array() : type(), size(), vbo()
-    {}
+  GLenum m_primitive_type;
 
-    Array(Type type_, int size_, GLuint vbo_) :
-      type(type_),
-      size(size_),
-      vbo(vbo_)
-    {}
-  };
+  /** The vertices live in a range of the vertex arena, at a multiple
+      of the stride so that the offset makes a base vertex */
+  VertexFormat m_vertex_format;
+  GpuAllocationPtr m_vertex_allocation;
+  int m_vertex_count;
 
-private:
-  GLenum m_primitive_type;
-  std::unordered_map<std::string, Array> m_attribute_arrays;
-  GLuint m_element_array_vbo;
+  GpuAllocationPtr m_element_allocation;
+  GLenum m_element_type;
   int m_element_count;
 
+  /** Captures the attribute setup, built on the first draw(). As the
+      attribute locations are fixed it works with every program */
+  GLuint m_vertex_array;
+
+  /** Generations of the allocations the vertex array was built for,
+      GpuBufferArena::compact() invalidates it */
+  unsigned int m_vertex_array_generation;
+  int m_base_vertex;
+
+  /** Maps quantized positions back into model space */
+  glm::mat4 m_vertex_transform;
+
+  /** Of the vertices in model space */
+  BoundingBox m_bounding_box;
+
+  /** Ranges of the element array that get culled individually, empty
+      to always draw everything */
+  std::vector<MeshCluster> m_clusters;
+
+  /** Bounds of all clusters together */
+  MeshCluster m_bounds;
+
+  /** Simplified levels behind the full triangles in the element
+      array, m_lod selects the one to draw, 0 for the full mesh */
+  std::vector<MeshLod> m_lods;
+  int m_lod;
+
+  /** Visible ranges of the current draw(), kept to save allocations */
+  std::vector<GLsizei> m_draw_counts;
+  std::vector<const GLvoid*> m_draw_offsets;
+  std::vector<GLint> m_draw_base_vertices;
+
 public:
   /** Create a cube with cubemap texture coordinates */
   static std::unique_ptr<Mesh> create_skybox(float size);
@@ -80,79 +143,97 @@ public:
                                                     int offset_x = 0, int offset_y = 0,
                                                     bool flip_uv_x = false, bool flip_uv_y = false);
 
+  /** Split indexed triangles into parts that 16-bit indices can
+      address. The \a clusters, if any, stay whole and go along with
+      their part. The \a lods index the same vertices, they are
+      dropped when the triangles have to be split. Doesn't touch
+      OpenGL, so it can run on the ThreadPool. */
+  static std::vector<MeshData> prepare_indexed(const VertexData& vertices, const int* indices, int count,
+                                               const MeshCluster* clusters = nullptr, int cluster_count = 0,
+                                               const int* lod_indices = nullptr, int lod_index_count = 0,
+                                               const MeshLod* lods = nullptr, int lod_count = 0);
+
+  /** Upload a part from prepare_indexed() as it is */
+  static std::unique_ptr<Mesh> create(const MeshDataRef& data);
+
+  /** prepare_indexed() followed by create() for each part */
+  static std::vector<std::unique_ptr<Mesh> > create_indexed(const VertexData& vertices, const int* indices, int count,
+                                                            const MeshCluster* clusters = nullptr, int cluster_count = 0,
+                                                            const int* lod_indices = nullptr, int lod_index_count = 0,
+                                                            const MeshLod* lods = nullptr, int lod_count = 0);
+
 public:
   Mesh(GLenum primitive_type);
   ~Mesh();
 
-  void draw();
+  /** Draw the clusters \a culler considers visible, or everything
+      when there is no \a culler or no clusters. A LOD level is drawn
+      as a whole once any of it is visible. */
+  void draw(const ClusterCuller* culler = nullptr);
 
-  void attach_array(const std::string& name, Array const& array, int element_count)
-  {
-    if (m_attribute_arrays.find(name) != m_attribute_arrays.end())
-    {
-      throw std::runtime_error("array '" + name + "' already present");
-    }
-    else if (m_element_count != -1 && m_element_count != element_count)
-    {
-      throw std::runtime_error("element count does not match");
-    }
-    else
-    {
-      m_element_count = element_count;
-      m_attribute_arrays[name] = array;
-    }
-  }
+  /** Attach an already interleaved vertex buffer holding \a count
+      vertices laid out as described by \a format, a Mesh has a single
+      vertex buffer */
+  void attach_vertex_buffer(const VertexFormat& format, const void* data, int count);
 
-  void attach_float_array(const std::string& name, const std::vector<float>& vec)
-  {
-    GLuint vbo = build_vbo(GL_ARRAY_BUFFER, vec);
-    attach_array(name, Array(Array::Float, 1, vbo), vec.size());
-  }
+  /** Attach vertices from VertexData::interleave() or
+      VertexQuantizer::quantize() */
+  void attach_vertex_data(const VertexData& vertices);
 
-  template<typename T>
-  void attach_float_array(const std::string& name, const std::vector<T>& vec)
-  {
-    GLuint vbo = build_vbo(GL_ARRAY_BUFFER, vec);
-    attach_array(name, Array(Array::Float, glm_vec_length<T>(), vbo), vec.size());
-  }
+  /** Interleave the given arrays into a single vertex buffer, so that
+      drawing binds one buffer instead of one per attribute and each
+      vertex is fetched from a single cache line */
+  void attach_interleaved(std::vector<VertexSource> const& sources);
 
-  void attach_int_array(const std::string& name, const std::vector<int>& vec)
-  {
-    GLuint vbo = build_vbo(GL_ARRAY_BUFFER, vec);
-    attach_array(name, Array(Array::Integer, 1, vbo), vec.size());
-  }
+  /** Like attach_interleaved(), but packs the attributes into smaller
+      formats, see VertexQuantizer. The positions are stored relative
+      to the bounding box, get_vertex_transform() maps them back */
+  void attach_quantized(std::vector<VertexSource> const& sources);
 
-  template<typename T>
-  void attach_int_array(const std::string& name, const std::vector<T>& vec)
-  {
-    GLuint vbo = build_vbo(GL_ARRAY_BUFFER, vec);
-    attach_array(name, Array(Array::Integer, glm_vec_length<T>(), vbo), vec.size());
-  }
+  /** Uploads 16-bit indices when they all fit, 32-bit ones otherwise,
+      which OpenGL ES 2 can't draw, use create_indexed() for those */
+  void attach_element_array(const int* data, int count);
+  void attach_element_array(const uint16_t* data, int count);
 
   void attach_element_array(const std::vector<int>& vec)
   {
-    if (m_element_array_vbo != 0)
-    {
-      throw std::runtime_error("element array already present");
-    }
-    else
-    {
-      m_element_array_vbo = build_vbo(GL_ELEMENT_ARRAY_BUFFER, vec);
-      m_element_count = vec.size();
-    }
+    attach_element_array(vec.data(), static_cast<int>(vec.size()));
   }
 
+  /** Clusters covering the element array, see MeshOptimizer::build_clusters() */
+  void attach_clusters(std::vector<MeshCluster> clusters);
+
+  /** LOD levels as ranges of the element array behind the full mesh,
+      needs clusters for the bounds */
+  void attach_lods(std::vector<MeshLod> lods);
+
+  std::vector<MeshLod> const& get_lods() const { return m_lods; }
+  MeshCluster const& get_bounds() const { return m_bounds; }
+
+  /** 0 draws the full mesh, 1 and up get_lods()[lod - 1] */
+  void set_lod(int lod) { m_lod = lod; }
+  int get_lod() const { return m_lod; }
+
+  /** Transform from the stored positions to model space, the identity
+      unless the Mesh is quantized */
+  glm::mat4 const& get_vertex_transform() const { return m_vertex_transform; }
+
+  /** In model space, infinite for skinned meshes */
+  BoundingBox const& get_bounding_box() const { return m_bounding_box; }
+
+  /** Bytes of vertex data in GPU memory */
+  size_t get_vertex_bytes() const { return m_vertex_allocation ? m_vertex_allocation->size : 0; }
+
 private:
-  template<typename T>
-  GLuint build_vbo(GLenum target, const std::vector<T>& vec)
-  {
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(target, vbo);
-    glBufferData(target, sizeof(T) * vec.size(), vec.data(), GL_STATIC_DRAW);
-    glBindBuffer(target, 0);
-    return vbo;
-  }
+  /** Point the attribute locations at the vertices, bind the element
+      array and set the base vertex to draw with */
+  void setup_arrays();
+
+  unsigned int get_generation() const;
+
+  /** True if vertices can be addressed with a base vertex instead of
+      moving the attribute pointers */
+  static bool has_base_vertex();
 
 private:
   Mesh(const Mesh&) = delete;
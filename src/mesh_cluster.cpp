@@ -0,0 +1,110 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mesh_cluster.hpp"
+
+#include <algorithm>
+#include <glm/ext.hpp>
+#include <math.h>
+
+ClusterCuller::ClusterCuller(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model,
+                             FaceCulling face_culling) :
+  m_frustum(projection * view * model),
+  m_camera(),
+  m_facing(0.0f)
+{
+  glm::mat4 inv_model_view = glm::inverse(view * model);
+  if (projection[2][3] == 0.0f)
+  {
+    // orthographic, all rays run along -z in view space
+    m_camera = inv_model_view * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+  }
+  else
+  {
+    m_camera = inv_model_view * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  }
+
+  switch(face_culling)
+  {
+    case FaceCulling::Back:
+      m_facing = 1.0f;
+      break;
+
+    case FaceCulling::Front:
+      m_facing = -1.0f;
+      break;
+
+    case FaceCulling::None:
+      m_facing = 0.0f;
+      break;
+  }
+
+  // a mirroring transform flips the winding on screen
+  if (glm::determinant(glm::mat3(model)) < 0.0f)
+  {
+    m_facing = -m_facing;
+  }
+}
+
+bool
+ClusterCuller::is_visible(const MeshCluster& cluster) const
+{
+  if (!m_frustum.intersects(cluster.center, cluster.radius) ||
+      !m_frustum.intersects_box(cluster.min, cluster.max))
+  {
+    return false;
+  }
+  else if (m_facing == 0.0f || cluster.cone_cutoff <= 0.0f)
+  {
+    return true;
+  }
+  else
+  {
+    // a triangle with normal n faces away from the camera e when
+    // dot(p - e, n) > 0 for its points p. With the normals within
+    // alpha of the axis and beta the angle between the axis and the
+    // view ray to the center, that holds for the whole bounding
+    // sphere when |c - e| * cos(beta + alpha) > radius.
+    glm::vec3 axis = cluster.cone_axis * m_facing;
+    glm::vec3 ray;
+    float radius;
+    if (m_camera.w == 0.0f)
+    {
+      ray = glm::vec3(m_camera);
+      radius = 0.0f;
+    }
+    else
+    {
+      ray = cluster.center - glm::vec3(m_camera) / m_camera.w;
+      radius = cluster.radius;
+    }
+
+    float distance = glm::length(ray);
+    if (distance <= radius)
+    {
+      return true;
+    }
+
+    float cos_beta = glm::dot(ray, axis) / distance;
+    float sin_beta = sqrtf(std::max(0.0f, 1.0f - cos_beta * cos_beta));
+    float sin_alpha = sqrtf(std::max(0.0f, 1.0f - cluster.cone_cutoff * cluster.cone_cutoff));
+    float cos_sum = cos_beta * cluster.cone_cutoff - sin_beta * sin_alpha;
+
+    return !(cos_sum > 0.0f && distance * cos_sum > radius);
+  }
+}
+
+/* EOF */
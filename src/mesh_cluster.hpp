@@ -0,0 +1,75 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_MESH_CLUSTER_HPP
+#define HEADER_MESH_CLUSTER_HPP
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+/** A spatially coherent run of triangles in the index array of an
+    object, built by MeshOptimizer::build_clusters(). This is plain
+    data, it gets written to the SceneCache as is. All bounds are in
+    model space, before any quantization. */
+struct MeshCluster
+{
+  /** Range in the index array, in indices, not triangles */
+  int first;
+  int count;
+
+  glm::vec3 min;
+  glm::vec3 max;
+
+  glm::vec3 center;
+  float radius;
+
+  /** All triangle normals are within acos(cone_cutoff) of cone_axis,
+      a cone_cutoff <= 0 means the normals spread too far to ever
+      face away from the camera all at once */
+  glm::vec3 cone_axis;
+  float cone_cutoff;
+};
+
+/** Decides which clusters of a Mesh need drawing for one camera */
+class ClusterCuller
+{
+public:
+  /** The faces the material has OpenGL cull */
+  enum class FaceCulling { None, Back, Front };
+
+private:
+  Frustum m_frustum;
+
+  /** The camera position in model space, or for orthographic
+      projections the view direction with w = 0 */
+  glm::vec4 m_camera;
+
+  /** +1 to reject clusters facing away, -1 to reject clusters facing
+      the camera, 0 to keep them all */
+  float m_facing;
+
+public:
+  ClusterCuller(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model,
+                FaceCulling face_culling);
+
+  bool is_visible(const MeshCluster& cluster) const;
+};
+
+#endif
+
+/* EOF */
@@ -0,0 +1,608 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdexcept>
+#include <string.h>
+
+namespace {
+
+// the parameters from Forsyth's article, tuned for a 32 entry LRU cache
+const int cache_size = 32;
+const float cache_decay_power = 1.5f;
+const float last_tri_score = 0.75f;
+const float valence_boost_scale = 2.0f;
+const float valence_boost_power = 0.5f;
+
+float get_vertex_score(int cache_position, int remaining)
+{
+  if (remaining == 0)
+  {
+    // no triangle left, the vertex doesn't matter anymore
+    return -1.0f;
+  }
+  else
+  {
+    float score = 0.0f;
+    if (cache_position < 0)
+    {
+      // not in the cache
+    }
+    else if (cache_position < 3)
+    {
+      // used by the last triangle, a fixed score keeps from
+      // favouring one of its edges
+      score = last_tri_score;
+    }
+    else
+    {
+      const float scaler = 1.0f / (cache_size - 3);
+      score = powf(1.0f - (cache_position - 3) * scaler, cache_decay_power);
+    }
+
+    // prefer finishing off vertices with few triangles left
+    score += valence_boost_scale * powf(static_cast<float>(remaining), -valence_boost_power);
+    return score;
+  }
+}
+
+uint64_t hash_vertex(std::vector<VertexSource> const& sources, int v)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for(auto const& source : sources)
+  {
+    const size_t size = source.size * 4;
+    const uint8_t* data = static_cast<const uint8_t*>(source.data) + size * v;
+    for(size_t i = 0; i < size; ++i)
+    {
+      hash ^= data[i];
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+bool equal_vertices(std::vector<VertexSource> const& sources, int a, int b)
+{
+  for(auto const& source : sources)
+  {
+    const size_t size = source.size * 4;
+    const uint8_t* data = static_cast<const uint8_t*>(source.data);
+    if (memcmp(data + size * a, data + size * b, size) != 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/** Interleave the lower 10 bits of \a v with two zero bits each */
+uint32_t expand_bits(uint32_t v)
+{
+  v = (v * 0x00010001u) & 0xFF0000FFu;
+  v = (v * 0x00000101u) & 0x0F00F00Fu;
+  v = (v * 0x00000011u) & 0xC30C30C3u;
+  v = (v * 0x00000005u) & 0x49249249u;
+  return v;
+}
+
+/** Bounds and normal cone of the triangles in indices[first, first + count) */
+MeshCluster compute_cluster(std::vector<int> const& indices, int first, int count,
+                            std::vector<glm::vec3> const& positions)
+{
+  MeshCluster cluster;
+  cluster.first = first;
+  cluster.count = count;
+
+  cluster.min = positions[indices[first]];
+  cluster.max = positions[indices[first]];
+  for(int i = first; i < first + count; ++i)
+  {
+    cluster.min = glm::min(cluster.min, positions[indices[i]]);
+    cluster.max = glm::max(cluster.max, positions[indices[i]]);
+  }
+
+  cluster.center = (cluster.min + cluster.max) * 0.5f;
+  cluster.radius = 0.0f;
+  for(int i = first; i < first + count; ++i)
+  {
+    cluster.radius = std::max(cluster.radius, glm::length(positions[indices[i]] - cluster.center));
+  }
+
+  // degenerate triangles face nowhere and are left out of the cone
+  std::vector<glm::vec3> normals;
+  glm::vec3 axis(0.0f, 0.0f, 0.0f);
+  for(int i = first; i + 2 < first + count; i += 3)
+  {
+    glm::vec3 n = glm::cross(positions[indices[i + 1]] - positions[indices[i]],
+                             positions[indices[i + 2]] - positions[indices[i]]);
+    float len = glm::length(n);
+    if (len > 0.0f)
+    {
+      normals.push_back(n / len);
+      axis += n / len;
+    }
+  }
+
+  float axis_len = glm::length(axis);
+  if (normals.empty() || axis_len < 1.0e-3f * normals.size())
+  {
+    cluster.cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+    cluster.cone_cutoff = -1.0f;
+  }
+  else
+  {
+    cluster.cone_axis = axis / axis_len;
+    cluster.cone_cutoff = 1.0f;
+    for(auto const& n : normals)
+    {
+      cluster.cone_cutoff = std::min(cluster.cone_cutoff, glm::dot(n, cluster.cone_axis));
+    }
+  }
+
+  return cluster;
+}
+
+} // namespace
+
+int
+MeshOptimizer::weld(std::vector<VertexSource> const& sources, std::vector<int>& remap)
+{
+  const int count = sources.empty() ? 0 : sources.front().count;
+  for(auto const& source : sources)
+  {
+    if (source.count != count)
+    {
+      throw std::runtime_error("element count does not match");
+    }
+  }
+
+  // open addressing, holding the first vertex of each kind
+  size_t table_size = 1;
+  while(table_size < static_cast<size_t>(count) * 2)
+  {
+    table_size *= 2;
+  }
+  const size_t mask = table_size - 1;
+  std::vector<int> table(table_size, -1);
+
+  remap.assign(count, -1);
+  int unique = 0;
+  for(int v = 0; v < count; ++v)
+  {
+    size_t slot = hash_vertex(sources, v) & mask;
+    while(table[slot] != -1 && !equal_vertices(sources, table[slot], v))
+    {
+      slot = (slot + 1) & mask;
+    }
+
+    if (table[slot] == -1)
+    {
+      table[slot] = v;
+      remap[v] = unique++;
+    }
+    else
+    {
+      remap[v] = remap[table[slot]];
+    }
+  }
+
+  return unique;
+}
+
+void
+MeshOptimizer::optimize_vertex_cache(std::vector<int>& indices, int vertex_count)
+{
+  const int tri_count = static_cast<int>(indices.size() / 3);
+
+  // the triangles of each vertex, the first remaining[v] entries of a
+  // vertex are those not emitted yet
+  std::vector<int> offsets(vertex_count + 1, 0);
+  for(int i = 0; i < tri_count * 3; ++i)
+  {
+    offsets[indices[i] + 1] += 1;
+  }
+  for(int v = 0; v < vertex_count; ++v)
+  {
+    offsets[v + 1] += offsets[v];
+  }
+
+  std::vector<int> remaining(vertex_count, 0);
+  std::vector<int> adjacency(tri_count * 3);
+  for(int i = 0; i < tri_count * 3; ++i)
+  {
+    int v = indices[i];
+    adjacency[offsets[v] + remaining[v]] = i / 3;
+    remaining[v] += 1;
+  }
+
+  std::vector<int> cache_position(vertex_count, -1);
+  std::vector<float> vertex_score(vertex_count);
+  for(int v = 0; v < vertex_count; ++v)
+  {
+    vertex_score[v] = get_vertex_score(-1, remaining[v]);
+  }
+
+  std::vector<float> tri_score(tri_count);
+  std::vector<char> emitted(tri_count, 0);
+  int best = -1;
+  float best_score = -1.0f;
+  for(int t = 0; t < tri_count; ++t)
+  {
+    tri_score[t] = vertex_score[indices[3*t]] + vertex_score[indices[3*t + 1]] + vertex_score[indices[3*t + 2]];
+    if (tri_score[t] > best_score)
+    {
+      best = t;
+      best_score = tri_score[t];
+    }
+  }
+
+  std::vector<int> result;
+  result.reserve(tri_count * 3);
+
+  std::vector<int> cache;
+  std::vector<int> new_cache;
+  cache.reserve(cache_size + 3);
+  new_cache.reserve(cache_size + 3);
+
+  int cursor = 0;
+  while(static_cast<int>(result.size()) < tri_count * 3)
+  {
+    if (best == -1)
+    {
+      // nothing in the cache connects to the rest, take the next
+      // triangle in the original order
+      while(emitted[cursor])
+      {
+        ++cursor;
+      }
+      best = cursor;
+    }
+
+    const int* tri = &indices[3 * best];
+    emitted[best] = 1;
+    new_cache.clear();
+    for(int k = 0; k < 3; ++k)
+    {
+      int v = tri[k];
+      result.push_back(v);
+
+      // move the triangle out of the remaining ones of the vertex
+      int* adj = &adjacency[offsets[v]];
+      for(int i = 0; i < remaining[v]; ++i)
+      {
+        if (adj[i] == best)
+        {
+          std::swap(adj[i], adj[remaining[v] - 1]);
+          remaining[v] -= 1;
+          break;
+        }
+      }
+
+      if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end())
+      {
+        new_cache.push_back(v);
+      }
+    }
+
+    for(int v : cache)
+    {
+      if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end())
+      {
+        new_cache.push_back(v);
+      }
+    }
+
+    // update the scores of everything that moved in the cache,
+    // including the vertices that just fell out of it
+    for(int i = 0; i < static_cast<int>(new_cache.size()); ++i)
+    {
+      int v = new_cache[i];
+      cache_position[v] = (i < cache_size) ? i : -1;
+      vertex_score[v] = get_vertex_score(cache_position[v], remaining[v]);
+    }
+
+    best = -1;
+    best_score = -1.0f;
+    for(int i = 0; i < static_cast<int>(new_cache.size()); ++i)
+    {
+      int v = new_cache[i];
+      for(int j = 0; j < remaining[v]; ++j)
+      {
+        int t = adjacency[offsets[v] + j];
+        tri_score[t] = vertex_score[indices[3*t]] + vertex_score[indices[3*t + 1]] + vertex_score[indices[3*t + 2]];
+        if (tri_score[t] > best_score)
+        {
+          best = t;
+          best_score = tri_score[t];
+        }
+      }
+    }
+
+    if (new_cache.size() > static_cast<size_t>(cache_size))
+    {
+      new_cache.resize(cache_size);
+    }
+    std::swap(cache, new_cache);
+  }
+
+  // a trailing partial triangle, if any, stays where it was
+  result.insert(result.end(), indices.begin() + tri_count * 3, indices.end());
+  indices = std::move(result);
+}
+
+std::vector<MeshCluster>
+MeshOptimizer::build_clusters(std::vector<int>& indices, std::vector<glm::vec3> const& positions)
+{
+  const int tri_count = static_cast<int>(indices.size() / 3);
+  const int vertex_count = static_cast<int>(positions.size());
+
+  if (tri_count == 0)
+  {
+    return {};
+  }
+
+  std::vector<glm::vec3> centroids(tri_count);
+  std::vector<glm::vec3> normals(tri_count);
+  glm::vec3 min = positions[indices[0]];
+  glm::vec3 max = positions[indices[0]];
+  for(int t = 0; t < tri_count; ++t)
+  {
+    const glm::vec3& a = positions[indices[3*t]];
+    const glm::vec3& b = positions[indices[3*t + 1]];
+    const glm::vec3& c = positions[indices[3*t + 2]];
+    centroids[t] = (a + b + c) / 3.0f;
+
+    glm::vec3 n = glm::cross(b - a, c - a);
+    float len = glm::length(n);
+    normals[t] = (len > 0.0f) ? n / len : glm::vec3(0.0f, 0.0f, 0.0f);
+
+    min = glm::min(min, centroids[t]);
+    max = glm::max(max, centroids[t]);
+  }
+
+  // seeds are taken in Morton order, so that whatever a cluster has
+  // to pick up when it runs out of neighbours is close by
+  std::vector<std::pair<uint32_t, int> > morton(tri_count);
+  glm::vec3 extent = glm::max(max - min, glm::vec3(1.0e-6f, 1.0e-6f, 1.0e-6f));
+  for(int t = 0; t < tri_count; ++t)
+  {
+    glm::vec3 p = (centroids[t] - min) / extent * 1023.0f;
+    morton[t].first =
+      (expand_bits(static_cast<uint32_t>(p.x)) << 2) |
+      (expand_bits(static_cast<uint32_t>(p.y)) << 1) |
+      expand_bits(static_cast<uint32_t>(p.z));
+    morton[t].second = t;
+  }
+  std::sort(morton.begin(), morton.end());
+
+  // the triangles of each vertex
+  std::vector<int> offsets(vertex_count + 1, 0);
+  for(int i = 0; i < tri_count * 3; ++i)
+  {
+    offsets[indices[i] + 1] += 1;
+  }
+  for(int v = 0; v < vertex_count; ++v)
+  {
+    offsets[v + 1] += offsets[v];
+  }
+
+  std::vector<int> adjacency(tri_count * 3);
+  {
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for(int i = 0; i < tri_count * 3; ++i)
+    {
+      adjacency[fill[indices[i]]++] = i / 3;
+    }
+  }
+
+  std::vector<char> assigned(tri_count, 0);
+  std::vector<int> candidate_of(tri_count, -1);
+  std::vector<int> candidates;
+  std::vector<int> order;
+  order.reserve(tri_count);
+  std::vector<int> cluster_sizes;
+
+  int cursor = 0;
+  while(static_cast<int>(order.size()) < tri_count)
+  {
+    const int cluster_idx = static_cast<int>(cluster_sizes.size());
+    const size_t cluster_begin = order.size();
+    glm::vec3 centroid_sum(0.0f, 0.0f, 0.0f);
+    glm::vec3 normal_sum(0.0f, 0.0f, 0.0f);
+    candidates.clear();
+
+    int next = -1;
+    while(static_cast<int>(order.size() - cluster_begin) < s_cluster_max_triangles)
+    {
+      if (next == -1)
+      {
+        if (candidates.empty())
+        {
+          if (static_cast<int>(order.size() - cluster_begin) >= s_cluster_min_triangles)
+          {
+            break;
+          }
+
+          while(cursor < tri_count && assigned[morton[cursor].second])
+          {
+            ++cursor;
+          }
+
+          if (cursor == tri_count)
+          {
+            break;
+          }
+          next = morton[cursor].second;
+        }
+        else
+        {
+          // prefer triangles close to the cluster and facing the same
+          // way, the latter keeps the normal cone narrow
+          glm::vec3 center = centroid_sum / static_cast<float>(order.size() - cluster_begin);
+          float normal_len = glm::length(normal_sum);
+          glm::vec3 axis = (normal_len > 0.0f) ? normal_sum / normal_len : glm::vec3(0.0f, 0.0f, 0.0f);
+
+          size_t best = 0;
+          float best_score = 0.0f;
+          for(size_t i = 0; i < candidates.size(); ++i)
+          {
+            int t = candidates[i];
+            float score = glm::length(centroids[t] - center) * (2.0f - glm::dot(normals[t], axis));
+            if (i == 0 || score < best_score)
+            {
+              best = i;
+              best_score = score;
+            }
+          }
+
+          next = candidates[best];
+          candidates[best] = candidates.back();
+          candidates.pop_back();
+        }
+      }
+
+      assigned[next] = 1;
+      order.push_back(next);
+      centroid_sum += centroids[next];
+      normal_sum += normals[next];
+
+      for(int k = 0; k < 3; ++k)
+      {
+        int v = indices[3*next + k];
+        for(int j = offsets[v]; j < offsets[v + 1]; ++j)
+        {
+          int t = adjacency[j];
+          if (!assigned[t] && candidate_of[t] != cluster_idx)
+          {
+            candidate_of[t] = cluster_idx;
+            candidates.push_back(t);
+          }
+        }
+      }
+
+      next = -1;
+    }
+
+    // candidates left over stay unassigned and get picked up by later
+    // clusters, candidate_of[] is reset by the new cluster index
+    cluster_sizes.push_back(static_cast<int>(order.size() - cluster_begin));
+  }
+
+  // emit the clusters, each with its own vertex cache optimization on
+  // a compact local numbering of its vertices
+  std::vector<int> result;
+  result.reserve(indices.size());
+  std::vector<MeshCluster> clusters;
+  std::vector<int> local_of(vertex_count, -1);
+  std::vector<int> global_of;
+  std::vector<int> local;
+
+  size_t pos = 0;
+  for(int size : cluster_sizes)
+  {
+    global_of.clear();
+    local.clear();
+    for(size_t i = pos; i < pos + size; ++i)
+    {
+      for(int k = 0; k < 3; ++k)
+      {
+        int v = indices[3*order[i] + k];
+        if (local_of[v] == -1)
+        {
+          local_of[v] = static_cast<int>(global_of.size());
+          global_of.push_back(v);
+        }
+        local.push_back(local_of[v]);
+      }
+    }
+
+    optimize_vertex_cache(local, static_cast<int>(global_of.size()));
+
+    const int first = static_cast<int>(result.size());
+    for(int l : local)
+    {
+      result.push_back(global_of[l]);
+    }
+    for(int v : global_of)
+    {
+      local_of[v] = -1;
+    }
+
+    clusters.push_back(compute_cluster(result, first, size * 3, positions));
+    pos += size;
+  }
+
+  // a trailing partial triangle, if any, stays at the end outside of
+  // all clusters
+  result.insert(result.end(), indices.begin() + tri_count * 3, indices.end());
+  indices = std::move(result);
+
+  return clusters;
+}
+
+int
+MeshOptimizer::optimize_vertex_fetch(std::vector<int>& indices, int vertex_count, std::vector<int>& remap)
+{
+  remap.assign(vertex_count, -1);
+  int next = 0;
+  for(int& index : indices)
+  {
+    if (remap[index] == -1)
+    {
+      remap[index] = next++;
+    }
+    index = remap[index];
+  }
+  return next;
+}
+
+float
+MeshOptimizer::get_acmr(std::vector<int> const& indices)
+{
+  if (indices.size() < 3)
+  {
+    return 0.0f;
+  }
+
+  int vertex_count = 0;
+  for(int index : indices)
+  {
+    vertex_count = std::max(vertex_count, index + 1);
+  }
+
+  // a vertex is cached while fewer than s_acmr_cache_size misses
+  // happened since it got inserted
+  std::vector<int> inserted(vertex_count, -s_acmr_cache_size - 1);
+  int misses = 0;
+  for(int index : indices)
+  {
+    if (misses - inserted[index] >= s_acmr_cache_size)
+    {
+      misses += 1;
+      inserted[index] = misses;
+    }
+  }
+
+  return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+/* EOF */
@@ -0,0 +1,80 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_MESH_OPTIMIZER_HPP
+#define HEADER_MESH_OPTIMIZER_HPP
+
+#include <vector>
+
+#include "mesh_cluster.hpp"
+#include "vertex_format.hpp"
+
+/** Load time optimizations for indexed triangle lists, the vertices
+    are described by VertexSources and get reordered through remap
+    tables, old index to new index, with remap_vertices() */
+class MeshOptimizer
+{
+public:
+  /** Size of the FIFO cache get_acmr() simulates */
+  static const int s_acmr_cache_size = 16;
+
+  /** Triangles per cluster, clusters only end early when they run
+      out of connected triangles nearby */
+  static const int s_cluster_min_triangles = 128;
+  static const int s_cluster_max_triangles = 256;
+
+public:
+  /** Map vertices with identical attributes onto one, returns the
+      number of unique vertices */
+  static int weld(std::vector<VertexSource> const& sources, std::vector<int>& remap);
+
+  /** Reorder the triangles for the post-transform vertex cache,
+      following Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" */
+  static void optimize_vertex_cache(std::vector<int>& indices, int vertex_count);
+
+  /** Group the triangles into spatially coherent clusters of
+      s_cluster_min_triangles to s_cluster_max_triangles, reorders
+      \a indices so that each cluster is a contiguous range and
+      optimizes the vertex cache order inside of each cluster */
+  static std::vector<MeshCluster> build_clusters(std::vector<int>& indices,
+                                                 std::vector<glm::vec3> const& positions);
+
+  /** Number the vertices in the order the triangles first use them,
+      rewrites \a indices and returns the number of used vertices */
+  static int optimize_vertex_fetch(std::vector<int>& indices, int vertex_count, std::vector<int>& remap);
+
+  /** Average cache miss ratio, vertex shader invocations per triangle
+      with a FIFO cache of s_acmr_cache_size entries, 0.5 is ideal */
+  static float get_acmr(std::vector<int> const& indices);
+
+  template<typename T>
+  static std::vector<T> remap_vertices(std::vector<T> const& vertices, std::vector<int> const& remap, int count)
+  {
+    std::vector<T> result(count);
+    for(size_t i = 0; i < remap.size() && i < vertices.size(); ++i)
+    {
+      if (remap[i] != -1)
+      {
+        result[remap[i]] = vertices[i];
+      }
+    }
+    return result;
+  }
+};
+
+#endif
+
+/* EOF */
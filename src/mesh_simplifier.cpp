@@ -0,0 +1,636 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+#include "mesh_optimizer.hpp"
+
+namespace {
+
+/** Border edges weigh more than faces, so that open surfaces keep
+    their outline */
+const float border_weight = 10.0f;
+
+struct Quadric
+{
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+  double w;
+};
+
+/** Squared distance to the plane dot(n, p) + d = 0, \a n normalized */
+Quadric make_quadric(glm::vec3 const& n, float d, float w)
+{
+  Quadric q;
+  q.a00 = w * n.x * n.x;
+  q.a01 = w * n.x * n.y;
+  q.a02 = w * n.x * n.z;
+  q.a11 = w * n.y * n.y;
+  q.a12 = w * n.y * n.z;
+  q.a22 = w * n.z * n.z;
+  q.b0 = w * n.x * d;
+  q.b1 = w * n.y * d;
+  q.b2 = w * n.z * d;
+  q.c = w * d * d;
+  q.w = w;
+  return q;
+}
+
+void add_quadric(Quadric& q, Quadric const& o)
+{
+  q.a00 += o.a00;
+  q.a01 += o.a01;
+  q.a02 += o.a02;
+  q.a11 += o.a11;
+  q.a12 += o.a12;
+  q.a22 += o.a22;
+  q.b0 += o.b0;
+  q.b1 += o.b1;
+  q.b2 += o.b2;
+  q.c += o.c;
+  q.w += o.w;
+}
+
+/** Weighted mean of the squared distances of \a p to the planes */
+float get_error(Quadric const& q, glm::vec3 const& p)
+{
+  double x = p.x;
+  double y = p.y;
+  double z = p.z;
+  double r =
+    q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+    2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+    2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) +
+    q.c;
+  return (q.w > 0.0) ? static_cast<float>(fabs(r) / q.w) : 0.0f;
+}
+
+enum class Kind
+{
+  /** All triangles around it share the vertex */
+  Manifold,
+  /** On a single open border */
+  Border,
+  /** Two vertices at this position, splitting the triangles around
+      it along a normal or texcoord seam */
+  Seam,
+  /** Corners, non-manifold or otherwise complicated */
+  Locked
+};
+
+struct Collapse
+{
+  int u;
+  int v;
+  float error;
+};
+
+/** Connectivity of the current triangles, vertices with the same
+    position are linked in a ring through the wedge array */
+class Topology
+{
+public:
+  std::vector<int> const& indices;
+  std::vector<int> const& pos_id;
+  std::vector<int> const& wedge;
+  std::vector<int> offsets;
+  std::vector<int> triangles;
+
+  Topology(std::vector<int> const& indices_, std::vector<int> const& pos_id_, std::vector<int> const& wedge_) :
+    indices(indices_),
+    pos_id(pos_id_),
+    wedge(wedge_),
+    offsets(pos_id_.size() + 1, 0),
+    triangles(indices_.size())
+  {
+    for(int v : indices)
+    {
+      offsets[v + 1] += 1;
+    }
+    for(size_t v = 0; v < pos_id.size(); ++v)
+    {
+      offsets[v + 1] += offsets[v];
+    }
+
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < indices.size(); ++i)
+    {
+      triangles[fill[indices[i]]++] = static_cast<int>(i / 3);
+    }
+  }
+
+  /** The corner following \a v in triangle \a t */
+  int next(int t, int v) const
+  {
+    const int* tri = &indices[3 * t];
+    return (tri[0] == v) ? tri[1] : (tri[1] == v) ? tri[2] : tri[0];
+  }
+
+  bool has_edge(int a, int b) const
+  {
+    for(int i = offsets[a]; i < offsets[a + 1]; ++i)
+    {
+      if (next(triangles[i], a) == b)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /** Like has_edge(), but between positions instead of vertices */
+  bool has_position_edge(int a, int b) const
+  {
+    int x = a;
+    do
+    {
+      for(int i = offsets[x]; i < offsets[x + 1]; ++i)
+      {
+        if (pos_id[next(triangles[i], x)] == pos_id[b])
+        {
+          return true;
+        }
+      }
+      x = wedge[x];
+    }
+    while(x != a);
+
+    return false;
+  }
+
+  int get_valence(int v) const
+  {
+    return offsets[v + 1] - offsets[v];
+  }
+};
+
+/** Would moving \a u onto \a v turn any remaining triangle around */
+bool flips(Topology const& topo, std::vector<glm::vec3> const& positions, int u, int v)
+{
+  for(int i = topo.offsets[u]; i < topo.offsets[u + 1]; ++i)
+  {
+    const int* tri = &topo.indices[3 * topo.triangles[i]];
+    if (topo.pos_id[tri[0]] == topo.pos_id[v] ||
+        topo.pos_id[tri[1]] == topo.pos_id[v] ||
+        topo.pos_id[tri[2]] == topo.pos_id[v])
+    {
+      // collapses into nothing
+      continue;
+    }
+
+    glm::vec3 p[3];
+    glm::vec3 q[3];
+    for(int k = 0; k < 3; ++k)
+    {
+      p[k] = positions[tri[k]];
+      q[k] = (tri[k] == u) ? positions[v] : p[k];
+    }
+
+    glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+    glm::vec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+    if (glm::dot(n0, n1) <= 0.0f)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** Vertex of the other side of the seam that belongs with \a v, -1
+    if the triangles around \a u2 don't reach that position */
+int find_seam_twin(Topology const& topo, int u2, int v)
+{
+  for(int i = topo.offsets[u2]; i < topo.offsets[u2 + 1]; ++i)
+  {
+    const int* tri = &topo.indices[3 * topo.triangles[i]];
+    for(int k = 0; k < 3; ++k)
+    {
+      if (tri[k] != v && topo.pos_id[tri[k]] == topo.pos_id[v])
+      {
+        return tri[k];
+      }
+    }
+  }
+  return -1;
+}
+
+/** Other vertex at the same position as \a v that is still in use */
+int get_other_wedge(Topology const& topo, int v)
+{
+  for(int x = topo.wedge[v]; x != v; x = topo.wedge[x])
+  {
+    if (topo.get_valence(x) != 0)
+    {
+      return x;
+    }
+  }
+  return -1;
+}
+
+/** The state of a simplification, the quadrics keep accumulating
+    over several calls to run(), so that the error of later results is
+    still measured against the original surface */
+class Simplification
+{
+private:
+  std::vector<glm::vec3> const& m_positions;
+
+  /** Vertices with the same position, m_pos_id[] is the first of them */
+  std::vector<int> m_pos_id;
+  std::vector<int> m_wedge;
+
+  std::vector<Quadric> m_quadrics;
+  float m_error;
+
+public:
+  /** Drops triangles without area from \a indices */
+  Simplification(std::vector<int>& indices, std::vector<glm::vec3> const& positions);
+
+  /** Returns the error of the result so far */
+  float run(std::vector<int>& indices, size_t target_count, float max_error);
+};
+
+Simplification::Simplification(std::vector<int>& indices, std::vector<glm::vec3> const& positions) :
+  m_positions(positions),
+  m_pos_id(positions.size()),
+  m_wedge(positions.size()),
+  m_quadrics(positions.size(), make_quadric(glm::vec3(0.0f, 0.0f, 0.0f), 0.0f, 0.0f)),
+  m_error(0.0f)
+{
+  const int vertex_count = static_cast<int>(positions.size());
+
+  std::vector<int> order(vertex_count);
+  for(int v = 0; v < vertex_count; ++v)
+  {
+    order[v] = v;
+  }
+  std::sort(order.begin(), order.end(),
+            [&positions](int a, int b) {
+              glm::vec3 const& p = positions[a];
+              glm::vec3 const& q = positions[b];
+              return (p.x != q.x) ? (p.x < q.x) : (p.y != q.y) ? (p.y < q.y) : (p.z < q.z);
+            });
+
+  for(int i = 0; i < vertex_count;)
+  {
+    int j = i + 1;
+    while(j < vertex_count && positions[order[j]] == positions[order[i]])
+    {
+      ++j;
+    }
+
+    for(int k = i; k < j; ++k)
+    {
+      m_pos_id[order[k]] = order[i];
+      m_wedge[order[k]] = order[(k + 1 < j) ? k + 1 : i];
+    }
+    i = j;
+  }
+
+  std::vector<int> result;
+  result.reserve(indices.size());
+  for(size_t i = 0; i + 2 < indices.size(); i += 3)
+  {
+    const int a = m_pos_id[indices[i]];
+    const int b = m_pos_id[indices[i + 1]];
+    const int c = m_pos_id[indices[i + 2]];
+    if (a != b && b != c && a != c)
+    {
+      result.insert(result.end(), indices.begin() + i, indices.begin() + i + 3);
+    }
+  }
+  indices = std::move(result);
+
+  Topology topo(indices, m_pos_id, m_wedge);
+  for(size_t i = 0; i < indices.size(); i += 3)
+  {
+    glm::vec3 const& p0 = positions[indices[i]];
+    glm::vec3 n = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+    float len = glm::length(n);
+    if (len == 0.0f)
+    {
+      continue;
+    }
+    n /= len;
+
+    Quadric face = make_quadric(n, -glm::dot(n, p0), len * 0.5f);
+    for(int k = 0; k < 3; ++k)
+    {
+      add_quadric(m_quadrics[m_pos_id[indices[i + k]]], face);
+
+      // keep open borders in place with a plane standing upright on them
+      int a = indices[i + k];
+      int b = indices[i + (k + 1) % 3];
+      if (!topo.has_position_edge(b, a))
+      {
+        glm::vec3 edge = positions[b] - positions[a];
+        glm::vec3 side = glm::cross(edge, n);
+        float side_len = glm::length(side);
+        if (side_len > 0.0f)
+        {
+          side /= side_len;
+          Quadric border = make_quadric(side, -glm::dot(side, positions[a]),
+                                        glm::dot(edge, edge) * border_weight);
+          add_quadric(m_quadrics[m_pos_id[a]], border);
+          add_quadric(m_quadrics[m_pos_id[b]], border);
+        }
+      }
+    }
+  }
+}
+
+float
+Simplification::run(std::vector<int>& indices, size_t target_count, float max_error)
+{
+  const int vertex_count = static_cast<int>(m_positions.size());
+  const float max_error_sq = max_error * max_error;
+
+  std::vector<Kind> kinds(vertex_count);
+  std::vector<int> border_edges(vertex_count);
+  std::vector<int> open_edges(vertex_count);
+  std::vector<int> remap(vertex_count);
+  std::vector<char> locked(vertex_count);
+  std::vector<char> border(indices.size());
+  std::vector<char> seam(indices.size());
+  std::vector<Collapse> collapses;
+
+  while(indices.size() > target_count)
+  {
+    Topology topo(indices, m_pos_id, m_wedge);
+
+    std::fill(border_edges.begin(), border_edges.end(), 0);
+    std::fill(open_edges.begin(), open_edges.end(), 0);
+    for(size_t i = 0; i < indices.size(); ++i)
+    {
+      // the edge from corner i to the next corner of its triangle
+      int a = indices[i];
+      int b = indices[i - i % 3 + (i + 1) % 3];
+      bool open = !topo.has_edge(b, a);
+      border[i] = open && !topo.has_position_edge(b, a);
+      seam[i] = open && !border[i];
+      if (open)
+      {
+        open_edges[a] += 1;
+        open_edges[b] += 1;
+      }
+      if (border[i])
+      {
+        border_edges[m_pos_id[a]] += 1;
+        border_edges[m_pos_id[b]] += 1;
+      }
+    }
+
+    for(int v = 0; v < vertex_count; ++v)
+    {
+      if (topo.get_valence(v) == 0)
+      {
+        kinds[v] = Kind::Locked;
+        continue;
+      }
+
+      int other = get_other_wedge(topo, v);
+      int edges = border_edges[m_pos_id[v]];
+      if (other == -1)
+      {
+        kinds[v] = (edges == 0) ? Kind::Manifold : (edges == 2) ? Kind::Border : Kind::Locked;
+      }
+      else if (edges == 0 && open_edges[v] == 2 && open_edges[other] == 2 &&
+               get_other_wedge(topo, other) == v)
+      {
+        kinds[v] = Kind::Seam;
+      }
+      else
+      {
+        kinds[v] = Kind::Locked;
+      }
+    }
+
+    // every edge in both directions, for the vertex that moves the
+    // kind of edge decides whether it is allowed to
+    collapses.clear();
+    for(size_t i = 0; i < indices.size(); ++i)
+    {
+      int a = indices[i];
+      int b = indices[i - i % 3 + (i + 1) % 3];
+
+      for(int dir = 0; dir < 2; ++dir)
+      {
+        int u = (dir == 0) ? a : b;
+        int v = (dir == 0) ? b : a;
+
+        bool allowed = false;
+        switch(kinds[u])
+        {
+          case Kind::Manifold:
+            allowed = true;
+            break;
+
+          case Kind::Border:
+            allowed = border[i] && (kinds[v] == Kind::Border || kinds[v] == Kind::Locked);
+            break;
+
+          case Kind::Seam:
+            allowed = seam[i] && (kinds[v] == Kind::Seam || kinds[v] == Kind::Locked);
+            break;
+
+          case Kind::Locked:
+            allowed = false;
+            break;
+        }
+
+        if (allowed)
+        {
+          collapses.push_back({ u, v, get_error(m_quadrics[m_pos_id[u]], m_positions[v]) });
+        }
+      }
+    }
+
+    if (collapses.empty())
+    {
+      break;
+    }
+
+    std::sort(collapses.begin(), collapses.end(),
+              [](Collapse const& lhs, Collapse const& rhs) { return lhs.error < rhs.error; });
+
+    // a collapse removes about two triangles, collapses much worse than
+    // the last one needed are left for later passes, by then cheaper
+    // ones that were blocked in this pass might have become possible
+    size_t goal = std::min((indices.size() - target_count) / 6, collapses.size() - 1);
+    float pass_error = std::min(max_error_sq, collapses[goal].error * 1.5f);
+
+    for(int v = 0; v < vertex_count; ++v)
+    {
+      remap[v] = v;
+    }
+    std::fill(locked.begin(), locked.end(), 0);
+
+    size_t remaining = indices.size();
+    int applied = 0;
+    for(auto const& collapse : collapses)
+    {
+      if (collapse.error > pass_error || remaining <= target_count)
+      {
+        break;
+      }
+
+      const int u = collapse.u;
+      const int v = collapse.v;
+      if (locked[m_pos_id[u]] || locked[m_pos_id[v]])
+      {
+        continue;
+      }
+
+      // a seam moves on both sides at once
+      int u2 = -1;
+      int v2 = -1;
+      if (kinds[u] == Kind::Seam)
+      {
+        u2 = get_other_wedge(topo, u);
+        v2 = find_seam_twin(topo, u2, v);
+        if (v2 == -1)
+        {
+          continue;
+        }
+      }
+
+      if (flips(topo, m_positions, u, v) ||
+          (u2 != -1 && flips(topo, m_positions, u2, v2)))
+      {
+        continue;
+      }
+
+      remap[u] = v;
+      if (u2 != -1)
+      {
+        remap[u2] = v2;
+      }
+      add_quadric(m_quadrics[m_pos_id[v]], m_quadrics[m_pos_id[u]]);
+      m_error = std::max(m_error, collapse.error);
+      applied += 1;
+
+      // the triangles around the collapse changed, they don't take
+      // part in any more collapses of this pass
+      for(int w : { u, u2 })
+      {
+        if (w == -1)
+        {
+          continue;
+        }
+
+        for(int i = topo.offsets[w]; i < topo.offsets[w + 1]; ++i)
+        {
+          const int* tri = &indices[3 * topo.triangles[i]];
+          for(int k = 0; k < 3; ++k)
+          {
+            locked[m_pos_id[tri[k]]] = 1;
+          }
+
+          if (m_pos_id[tri[0]] == m_pos_id[v] || m_pos_id[tri[1]] == m_pos_id[v] || m_pos_id[tri[2]] == m_pos_id[v])
+          {
+            remaining -= 3;
+          }
+        }
+      }
+    }
+
+    if (applied == 0)
+    {
+      break;
+    }
+
+    std::vector<int> result;
+    result.reserve(indices.size());
+    for(size_t i = 0; i < indices.size(); i += 3)
+    {
+      const int a = remap[indices[i]];
+      const int b = remap[indices[i + 1]];
+      const int c = remap[indices[i + 2]];
+      if (m_pos_id[a] != m_pos_id[b] && m_pos_id[b] != m_pos_id[c] && m_pos_id[a] != m_pos_id[c])
+      {
+        result.push_back(a);
+        result.push_back(b);
+        result.push_back(c);
+      }
+    }
+    indices = std::move(result);
+  }
+
+  return sqrtf(m_error);
+}
+
+} // namespace
+
+float
+MeshSimplifier::simplify(std::vector<int>& indices, std::vector<glm::vec3> const& positions,
+                         size_t target_count, float max_error)
+{
+  Simplification simplification(indices, positions);
+  return simplification.run(indices, target_count, max_error);
+}
+
+std::vector<MeshLod>
+MeshSimplifier::build_lods(std::vector<int> const& indices, std::vector<glm::vec3> const& positions,
+                           std::vector<int>& lod_indices)
+{
+  std::vector<MeshLod> lods;
+
+  if (indices.size() / 3 < static_cast<size_t>(s_min_triangles))
+  {
+    return lods;
+  }
+
+  glm::vec3 min = positions[indices[0]];
+  glm::vec3 max = positions[indices[0]];
+  for(int index : indices)
+  {
+    min = glm::min(min, positions[index]);
+    max = glm::max(max, positions[index]);
+  }
+
+  // anything coarser is too far off to be worth keeping around
+  const float max_error = glm::length(max - min) * 0.1f;
+
+  // the levels are snapshots of one continued simplification
+  std::vector<int> lod(indices.begin(), indices.end() - indices.size() % 3);
+  Simplification simplification(lod, positions);
+
+  size_t previous = lod.size();
+  for(int level = 1; level <= s_max_levels; ++level)
+  {
+    float error = simplification.run(lod, (indices.size() / 3 >> level) * 3, max_error);
+    if (lod.empty() || lod.size() > previous * 3 / 4)
+    {
+      break;
+    }
+
+    std::vector<int> optimized = lod;
+    MeshOptimizer::optimize_vertex_cache(optimized, static_cast<int>(positions.size()));
+
+    lods.push_back({ static_cast<int>(lod_indices.size()), static_cast<int>(optimized.size()), error });
+    lod_indices.insert(lod_indices.end(), optimized.begin(), optimized.end());
+
+    previous = lod.size();
+  }
+
+  return lods;
+}
+
+/* EOF */
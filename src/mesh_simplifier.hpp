@@ -0,0 +1,66 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_MESH_SIMPLIFIER_HPP
+#define HEADER_MESH_SIMPLIFIER_HPP
+
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+/** A simplified version of an object as a range of its LOD index
+    array, plain data that gets written to the SceneCache as is */
+struct MeshLod
+{
+  /** Range in the LOD index array, in indices */
+  int first;
+  int count;
+
+  /** How far, in model units, the surface moved at most */
+  float error;
+};
+
+/** Quadric error metric simplification by vertex collapses. Vertices
+    only ever collapse onto neighbouring vertices, so the simplified
+    triangles index the vertices of the original mesh and no new
+    vertex data is needed. */
+class MeshSimplifier
+{
+public:
+  /** Objects with fewer triangles don't get any LOD */
+  static const int s_min_triangles = 512;
+
+  /** Number of LOD levels below the full mesh, each aims for half the
+      triangles of the one before */
+  static const int s_max_levels = 3;
+
+public:
+  /** Collapse vertices until at most \a target_count indices are left
+      or the error would exceed \a max_error, returns the error of the
+      result. Border and attribute seam vertices only move along their
+      border or seam, vertices where those meet stay in place. */
+  static float simplify(std::vector<int>& indices, std::vector<glm::vec3> const& positions,
+                        size_t target_count, float max_error);
+
+  /** Simplify into up to s_max_levels levels, their indices get
+      appended to \a lod_indices */
+  static std::vector<MeshLod> build_lods(std::vector<int> const& indices, std::vector<glm::vec3> const& positions,
+                                         std::vector<int>& lod_indices);
+};
+
+#endif
+
+/* EOF */
@@ -0,0 +1,315 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mipmap.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#  include <immintrin.h>
+#endif
+
+namespace {
+
+const float kaiser_alpha = 4.0f;
+
+/** Support of the Kaiser filter in destination pixels to each side */
+const float kaiser_radius = 3.0f;
+
+/** Source pixels and weights contributing to each destination pixel
+    along one axis, the same for every row or column */
+struct Taps
+{
+  std::vector<int> start;
+  std::vector<int> count;
+  std::vector<int> index;
+  std::vector<float> weight;
+};
+
+float sinc(float x)
+{
+  if (fabsf(x) < 1.0e-6f)
+  {
+    return 1.0f;
+  }
+  else
+  {
+    x *= static_cast<float>(M_PI);
+    return sinf(x) / x;
+  }
+}
+
+/** Modified Bessel function of the first kind of order zero */
+float bessel_i0(float x)
+{
+  float sum = 1.0f;
+  float term = 1.0f;
+  float q = x * x / 4.0f;
+  for(int k = 1; k < 32 && term > sum * 1.0e-8f; ++k)
+  {
+    term *= q / static_cast<float>(k * k);
+    sum += term;
+  }
+  return sum;
+}
+
+float kaiser(float x)
+{
+  if (fabsf(x) >= kaiser_radius)
+  {
+    return 0.0f;
+  }
+  else
+  {
+    float t = x / kaiser_radius;
+    return sinc(x) * bessel_i0(kaiser_alpha * sqrtf(1.0f - t * t)) / bessel_i0(kaiser_alpha);
+  }
+}
+
+Taps make_taps(int src_size, int dst_size, MipmapFilter filter)
+{
+  Taps taps;
+  float scale = static_cast<float>(src_size) / static_cast<float>(dst_size);
+
+  for(int i = 0; i < dst_size; ++i)
+  {
+    int start = static_cast<int>(taps.index.size());
+    taps.start.push_back(start);
+
+    auto add = [&](int j, float w) {
+      if (w != 0.0f)
+      {
+        // clamp to edge
+        taps.index.push_back(std::max(0, std::min(j, src_size - 1)));
+        taps.weight.push_back(w);
+      }
+    };
+
+    if (src_size == dst_size)
+    {
+      add(i, 1.0f);
+    }
+    else if (filter == MipmapFilter::Box)
+    {
+      // exact coverage, odd sizes give fractional weights at the borders
+      float lo = static_cast<float>(i) * scale;
+      float hi = static_cast<float>(i + 1) * scale;
+      for(int j = static_cast<int>(floorf(lo)); j < static_cast<int>(ceilf(hi)); ++j)
+      {
+        add(j, std::min(hi, static_cast<float>(j + 1)) - std::max(lo, static_cast<float>(j)));
+      }
+    }
+    else
+    {
+      float center = (static_cast<float>(i) + 0.5f) * scale;
+      float radius = kaiser_radius * scale;
+      for(int j = static_cast<int>(floorf(center - radius)); j <= static_cast<int>(ceilf(center + radius)); ++j)
+      {
+        add(j, kaiser((static_cast<float>(j) + 0.5f - center) / scale));
+      }
+    }
+
+    float total = 0.0f;
+    for(size_t k = start; k < taps.weight.size(); ++k)
+    {
+      total += taps.weight[k];
+    }
+    for(size_t k = start; k < taps.weight.size(); ++k)
+    {
+      taps.weight[k] /= total;
+    }
+
+    taps.count.push_back(static_cast<int>(taps.index.size()) - start);
+  }
+
+  return taps;
+}
+
+/** dst[i] += src[i] * w */
+void axpy(float* dst, const float* src, float w, size_t n)
+{
+  size_t i = 0;
+#ifdef __AVX__
+  __m256 w8 = _mm256_set1_ps(w);
+  for(; i + 8 <= n; i += 8)
+  {
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i),
+                                            _mm256_mul_ps(_mm256_loadu_ps(src + i), w8)));
+  }
+#endif
+#ifdef __SSE2__
+  __m128 w4 = _mm_set1_ps(w);
+  for(; i + 4 <= n; i += 4)
+  {
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i),
+                                      _mm_mul_ps(_mm_loadu_ps(src + i), w4)));
+  }
+#endif
+  for(; i < n; ++i)
+  {
+    dst[i] += src[i] * w;
+  }
+}
+
+/** Horizontal pass, \a src and \a dst hold four floats per pixel */
+void resample_rows(const float* src, int src_width, int height,
+                   const Taps& taps, float* dst, int dst_width)
+{
+  for(int y = 0; y < height; ++y)
+  {
+    const float* row = src + static_cast<size_t>(y) * src_width * 4;
+    float* out = dst + static_cast<size_t>(y) * dst_width * 4;
+
+    for(int x = 0; x < dst_width; ++x)
+    {
+      const int* index = taps.index.data() + taps.start[x];
+      const float* weight = taps.weight.data() + taps.start[x];
+#ifdef __SSE2__
+      __m128 acc = _mm_setzero_ps();
+      for(int k = 0; k < taps.count[x]; ++k)
+      {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(row + 4 * index[k]), _mm_set1_ps(weight[k])));
+      }
+      _mm_storeu_ps(out + 4 * x, acc);
+#else
+      std::fill(out + 4 * x, out + 4 * x + 4, 0.0f);
+      for(int k = 0; k < taps.count[x]; ++k)
+      {
+        axpy(out + 4 * x, row + 4 * index[k], weight[k], 4);
+      }
+#endif
+    }
+  }
+}
+
+/** Vertical pass, whole rows at a time */
+void resample_columns(const float* src, int width,
+                      const Taps& taps, float* dst, int dst_height)
+{
+  size_t row_size = static_cast<size_t>(width) * 4;
+  for(int y = 0; y < dst_height; ++y)
+  {
+    float* out = dst + y * row_size;
+    std::fill(out, out + row_size, 0.0f);
+    for(int k = taps.start[y]; k < taps.start[y] + taps.count[y]; ++k)
+    {
+      axpy(out, src + taps.index[k] * row_size, taps.weight[k], row_size);
+    }
+  }
+}
+
+std::vector<float> to_float(const Image& image)
+{
+  size_t num_pixels = static_cast<size_t>(image.width) * image.height;
+  std::vector<float> result(num_pixels * 4, 255.0f);
+  for(size_t i = 0; i < num_pixels; ++i)
+  {
+    for(int c = 0; c < image.bytes_per_pixel; ++c)
+    {
+      result[4 * i + c] = image.pixels[i * image.bytes_per_pixel + c];
+    }
+  }
+  return result;
+}
+
+Image from_float(const std::vector<float>& data, int width, int height, int bytes_per_pixel)
+{
+  Image image(width, height, bytes_per_pixel);
+  size_t num_pixels = static_cast<size_t>(width) * height;
+  for(size_t i = 0; i < num_pixels; ++i)
+  {
+    uint8_t* dst = image.pixels.data() + i * bytes_per_pixel;
+#ifdef __SSE2__
+    // the Kaiser filter over- and undershoots at hard edges
+    __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(data.data() + 4 * i), _mm_setzero_ps()),
+                          _mm_set1_ps(255.0f));
+    __m128i bytes = _mm_cvtps_epi32(v);
+    bytes = _mm_packus_epi16(_mm_packs_epi32(bytes, bytes), bytes);
+    uint32_t rgba = static_cast<uint32_t>(_mm_cvtsi128_si32(bytes));
+    memcpy(dst, &rgba, bytes_per_pixel);
+#else
+    for(int c = 0; c < bytes_per_pixel; ++c)
+    {
+      float v = std::max(0.0f, std::min(data[4 * i + c], 255.0f));
+      dst[c] = static_cast<uint8_t>(v + 0.5f);
+    }
+#endif
+  }
+  return image;
+}
+
+} // namespace
+
+int
+Mipmap::get_num_levels(int width, int height)
+{
+  int size = std::max(width, height);
+  int levels = 1;
+  while(size > 1)
+  {
+    size /= 2;
+    levels += 1;
+  }
+  return levels;
+}
+
+std::vector<Image>
+Mipmap::generate(Image image, MipmapFilter filter)
+{
+  int num_levels = get_num_levels(image.width, image.height);
+
+  std::vector<Image> levels;
+  levels.reserve(num_levels);
+
+  int width = image.width;
+  int height = image.height;
+  int bytes_per_pixel = image.bytes_per_pixel;
+
+  std::vector<float> current = (num_levels > 1) ? to_float(image) : std::vector<float>();
+  std::vector<float> tmp;
+  std::vector<float> next;
+
+  levels.push_back(std::move(image));
+
+  for(int level = 1; level < num_levels; ++level)
+  {
+    int next_width = std::max(1, width / 2);
+    int next_height = std::max(1, height / 2);
+
+    tmp.resize(static_cast<size_t>(next_width) * height * 4);
+    resample_rows(current.data(), width, height,
+                  make_taps(width, next_width, filter), tmp.data(), next_width);
+
+    next.resize(static_cast<size_t>(next_width) * next_height * 4);
+    resample_columns(tmp.data(), next_width,
+                     make_taps(height, next_height, filter), next.data(), next_height);
+
+    levels.push_back(from_float(next, next_width, next_height, bytes_per_pixel));
+
+    current.swap(next);
+    width = next_width;
+    height = next_height;
+  }
+
+  return levels;
+}
+
+/* EOF */
@@ -0,0 +1,50 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_MIPMAP_HPP
+#define HEADER_MIPMAP_HPP
+
+#include <vector>
+
+#include "image.hpp"
+
+enum class MipmapFilter
+{
+  /** Average of the covered source pixels, cheap and a little blurry */
+  Box,
+
+  /** Kaiser windowed sinc, keeps the detail of the lower levels */
+  Kaiser
+};
+
+/** CPU mipmap generation for RGB and RGBA images of any size. Each
+    level halves the size of the previous one, rounding down, as
+    OpenGL expects it. Filtering happens in float with SSE/AVX, the
+    levels are resampled from each other without going through 8-bit.
+    Thread-safe, meant to run on the ThreadPool next to the decoding. */
+class Mipmap
+{
+public:
+  /** Number of levels down to and including 1x1 */
+  static int get_num_levels(int width, int height);
+
+  /** Returns the full chain, level 0 is \a image itself */
+  static std::vector<Image> generate(Image image, MipmapFilter filter = MipmapFilter::Kaiser);
+};
+
+#endif
+
+/* EOF */
@@ -0,0 +1,819 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mod_parser.hpp"
+
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/tokenizer.hpp>
+#include <boost/utility/string_view.hpp>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <string.h>
+
+#include "format.hpp"
+#include "log.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+const float g_float_pow10[] = {
+  1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+const double g_double_pow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+  1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21,
+  1e22
+};
+
+inline bool is_digit(char c)
+{
+  return '0' <= c && c <= '9';
+}
+
+/** Handles the plain decimal numbers written by the exporter. Only
+    cases where the result is exactly the correctly rounded float are
+    accepted, everything else returns false and is left to strtof(). */
+bool parse_float_fast(const char* p, const char* end, float& out)
+{
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+'))
+  {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool has_digits = false;
+
+  for(; p != end && is_digit(*p); ++p)
+  {
+    has_digits = true;
+    mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+    if (mantissa != 0 && ++digits > 15)
+    {
+      return false;
+    }
+  }
+
+  if (p != end && *p == '.')
+  {
+    ++p;
+    for(; p != end && is_digit(*p); ++p)
+    {
+      has_digits = true;
+      mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+      exponent -= 1;
+      if (mantissa != 0 && ++digits > 15)
+      {
+        return false;
+      }
+    }
+  }
+
+  if (!has_digits)
+  {
+    return false;
+  }
+
+  if (p != end && (*p == 'e' || *p == 'E'))
+  {
+    ++p;
+
+    bool exp_negative = false;
+    if (p != end && (*p == '-' || *p == '+'))
+    {
+      exp_negative = (*p == '-');
+      ++p;
+    }
+
+    if (p == end || !is_digit(*p))
+    {
+      return false;
+    }
+
+    int exp = 0;
+    for(; p != end && is_digit(*p); ++p)
+    {
+      exp = exp * 10 + (*p - '0');
+      if (exp > 1000)
+      {
+        return false;
+      }
+    }
+    exponent += exp_negative ? -exp : exp;
+  }
+
+  if (p != end)
+  {
+    return false;
+  }
+
+  if (mantissa == 0)
+  {
+    out = negative ? -0.0f : 0.0f;
+    return true;
+  }
+  else if (mantissa <= (1u << 24) && -10 <= exponent && exponent <= 10)
+  {
+    // mantissa and power of ten are exact floats, so a single
+    // operation gives the correctly rounded result
+    float value = static_cast<float>(mantissa);
+    value = (exponent < 0) ? value / g_float_pow10[-exponent] : value * g_float_pow10[exponent];
+    out = negative ? -value : value;
+    return true;
+  }
+  else if (-22 <= exponent && exponent <= 22)
+  {
+    // same as above in double precision, the correctly rounded double
+    // only rounds to the correct float when it doesn't sit exactly
+    // halfway between two floats
+    double value = static_cast<double>(mantissa);
+    value = (exponent < 0) ? value / g_double_pow10[-exponent] : value * g_double_pow10[exponent];
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x1fffffff) == 0x10000000)
+    {
+      return false;
+    }
+
+    float result = static_cast<float>(value);
+    out = negative ? -result : result;
+    return true;
+  }
+  else
+  {
+    return false;
+  }
+}
+
+float parse_float(boost::string_view str)
+{
+  float result;
+  if (parse_float_fast(str.begin(), str.end(), result))
+  {
+    return result;
+  }
+  else
+  {
+    // rare path for long mantissas, large exponents, inf and nan
+    char buf[64];
+    if (str.empty() || str.size() >= sizeof(buf) || isspace(static_cast<unsigned char>(str[0])))
+    {
+      throw std::runtime_error(format("invalid float: '%s'", str.to_string()));
+    }
+
+    memcpy(buf, str.data(), str.size());
+    buf[str.size()] = '\0';
+
+    char* endp;
+    result = strtof(buf, &endp);
+    if (endp != buf + str.size())
+    {
+      throw std::runtime_error(format("invalid float: '%s'", str.to_string()));
+    }
+    return result;
+  }
+}
+
+int parse_int(boost::string_view str)
+{
+  const char* p = str.begin();
+  const char* end = str.end();
+
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+'))
+  {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  if (p == end)
+  {
+    throw std::runtime_error(format("invalid integer: '%s'", str.to_string()));
+  }
+
+  long long value = 0;
+  for(; p != end; ++p)
+  {
+    if (!is_digit(*p))
+    {
+      throw std::runtime_error(format("invalid integer: '%s'", str.to_string()));
+    }
+
+    value = value * 10 + (*p - '0');
+    if (value > static_cast<long long>(INT_MAX) + 1)
+    {
+      throw std::runtime_error(format("integer out of range: '%s'", str.to_string()));
+    }
+  }
+
+  if (negative)
+  {
+    value = -value;
+  }
+
+  if (value > INT_MAX)
+  {
+    throw std::runtime_error(format("integer out of range: '%s'", str.to_string()));
+  }
+
+  return static_cast<int>(value);
+}
+
+/** Splits a single line on ' ', same as boost::char_separator<char>(" ", "") */
+class LineTokenizer
+{
+private:
+  const char* m_it;
+  const char* m_end;
+  int m_line_number;
+
+public:
+  LineTokenizer(const char* beg, const char* end, int line_number) :
+    m_it(beg),
+    m_end(end),
+    m_line_number(line_number)
+  {}
+
+  bool next(boost::string_view& token)
+  {
+    while(m_it != m_end && *m_it == ' ')
+    {
+      ++m_it;
+    }
+
+    if (m_it == m_end)
+    {
+      return false;
+    }
+    else
+    {
+      const char* start = m_it;
+      while(m_it != m_end && *m_it != ' ')
+      {
+        ++m_it;
+      }
+      token = boost::string_view(start, static_cast<size_t>(m_it - start));
+      return true;
+    }
+  }
+
+  boost::string_view expect()
+  {
+    boost::string_view token;
+    if (!next(token))
+    {
+      throw std::runtime_error((boost::format("not enough tokens at line %d") % m_line_number).str());
+    }
+    return token;
+  }
+
+  float expect_float() { return parse_float(expect()); }
+  int expect_int() { return parse_int(expect()); }
+};
+
+void commit_object(ModObject& obj, std::vector<ModObject>& objects)
+{
+  if (!obj.name.empty())
+  {
+    // the material stays active for the following objects
+    std::string material = obj.material;
+    objects.push_back(std::move(obj));
+    obj = ModObject();
+    obj.material = material;
+  }
+}
+
+void parse_line(const char* beg, const char* end, int line_number,
+                ModObject& obj, std::vector<ModObject>& objects)
+{
+  LineTokenizer tokens(beg, end, line_number);
+
+  boost::string_view tag;
+  if (tokens.next(tag))
+  {
+    // ordered by frequency
+    if (tag == "v")
+    {
+      glm::vec3 v;
+      v.x = tokens.expect_float();
+      v.y = tokens.expect_float();
+      v.z = tokens.expect_float();
+      obj.position.push_back(v);
+    }
+    else if (tag == "vn")
+    {
+      glm::vec3 vn;
+      vn.x = tokens.expect_float();
+      vn.y = tokens.expect_float();
+      vn.z = tokens.expect_float();
+      obj.normal.push_back(vn);
+    }
+    else if (tag == "vt")
+    {
+      glm::vec3 vt;
+      vt.s = tokens.expect_float();
+      vt.t = tokens.expect_float();
+      obj.texcoord.push_back(vt);
+    }
+    else if (tag == "f")
+    {
+      int a = tokens.expect_int();
+      int b = tokens.expect_int();
+      int c = tokens.expect_int();
+      obj.index.push_back(a);
+      obj.index.push_back(b);
+      obj.index.push_back(c);
+    }
+    else if (tag == "bw")
+    {
+      glm::vec4 bw;
+      bw.x = tokens.expect_float();
+      bw.y = tokens.expect_float();
+      bw.z = tokens.expect_float();
+      bw.w = tokens.expect_float();
+      obj.bone_weight.push_back(bw);
+    }
+    else if (tag == "bi")
+    {
+      glm::ivec4 bi;
+      bi.x = tokens.expect_int();
+      bi.y = tokens.expect_int();
+      bi.z = tokens.expect_int();
+      bi.w = tokens.expect_int();
+      obj.bone_index.push_back(bi);
+    }
+    else if (tag == "o")
+    {
+      commit_object(obj, objects);
+      obj.name = tokens.expect().to_string();
+    }
+    else if (tag == "g")
+    {
+      // group
+    }
+    else if (tag == "parent")
+    {
+      obj.parent = tokens.expect().to_string();
+    }
+    else if (tag == "mat")
+    {
+      obj.material = tokens.expect().to_string();
+    }
+    else if (tag == "loc")
+    {
+      obj.location.x = tokens.expect_float();
+      obj.location.y = tokens.expect_float();
+      obj.location.z = tokens.expect_float();
+    }
+    else if (tag == "rot")
+    {
+      obj.rotation.w = tokens.expect_float();
+      obj.rotation.x = tokens.expect_float();
+      obj.rotation.y = tokens.expect_float();
+      obj.rotation.z = tokens.expect_float();
+    }
+    else if (tag == "scale")
+    {
+      obj.scale.x = tokens.expect_float();
+      obj.scale.y = tokens.expect_float();
+      obj.scale.z = tokens.expect_float();
+    }
+    else if (tag[0] == '#')
+    {
+      // ignore comments
+    }
+    else
+    {
+      throw std::runtime_error((boost::format("unhandled token %s") % tag.to_string()).str());
+    }
+  }
+}
+
+/** Parses the lines in [beg, end), \a line_number is the number of
+    lines preceding \a beg and \a material the material active at
+    that point */
+std::vector<ModObject> parse_chunk(const char* beg, const char* end,
+                                   int line_number, const std::string& material,
+                                   const std::string& filename)
+{
+  std::vector<ModObject> objects;
+  ModObject obj;
+  obj.material = material;
+
+  const char* it = beg;
+  while(it != end)
+  {
+    const char* eol = static_cast<const char*>(memchr(it, '\n', static_cast<size_t>(end - it)));
+    if (!eol)
+    {
+      eol = end;
+    }
+
+    line_number += 1;
+
+    try
+    {
+      parse_line(it, eol, line_number, obj, objects);
+    }
+    catch(const std::exception& err)
+    {
+      throw std::runtime_error((boost::format("%s:%d: %s") % filename % line_number % err.what()).str());
+    }
+
+    it = (eol == end) ? end : eol + 1;
+  }
+
+  commit_object(obj, objects);
+
+  return objects;
+}
+
+/** A run of whole objects that can be parsed independently of the
+    rest of the file */
+struct Chunk
+{
+  const char* beg;
+  const char* end;
+  int line_number;
+  std::string material;
+};
+
+/** Pre-scan the file for 'o' lines and cut it into chunks of at
+    least \a min_size bytes, remembering the line number and the
+    material that the sequential parser would have at that point */
+std::vector<Chunk> split_objects(const char* data, size_t len, size_t min_size)
+{
+  std::vector<Chunk> chunks;
+  chunks.push_back(Chunk{data, nullptr, 0, "phong"});
+
+  std::string material = "phong";
+  bool seen_object = false;
+
+  const char* it = data;
+  const char* end = data + len;
+  int line_number = 0;
+  while(it != end)
+  {
+    const char* eol = static_cast<const char*>(memchr(it, '\n', static_cast<size_t>(end - it)));
+    if (!eol)
+    {
+      eol = end;
+    }
+
+    // only 'o' and 'mat' lines are of interest, skip the rest cheaply
+    const char* p = it;
+    while(p != eol && *p == ' ')
+    {
+      ++p;
+    }
+
+    if (p != eol && (*p == 'o' || *p == 'm'))
+    {
+      LineTokenizer tokens(p, eol, line_number + 1);
+      boost::string_view tag;
+      tokens.next(tag);
+      if (tag == "o")
+      {
+        // the first object shares its chunk with whatever comes before it
+        if (seen_object && static_cast<size_t>(it - chunks.back().beg) >= min_size)
+        {
+          chunks.back().end = it;
+          chunks.push_back(Chunk{it, nullptr, line_number, material});
+        }
+        seen_object = true;
+      }
+      else if (tag == "mat")
+      {
+        boost::string_view name;
+        if (tokens.next(name))
+        {
+          material = name.to_string();
+        }
+      }
+    }
+
+    line_number += 1;
+    it = (eol == end) ? end : eol + 1;
+  }
+
+  chunks.back().end = end;
+
+  return chunks;
+}
+
+/** The chunk jobs get threads of their own, from_memory_parallel()
+    waits for them and is itself called from jobs on ThreadPool::get(),
+    queued behind those the chunks could never run */
+ThreadPool& get_pool()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+void log_objects(const std::vector<ModObject>& objects)
+{
+  for(const auto& obj : objects)
+  {
+    log_debug("object: '%s'", obj.name);
+  }
+}
+
+} // namespace
+
+std::vector<ModObject>
+ModParser::from_file(const std::string& filename)
+{
+  MappedFile file(filename);
+  if (file.get_size() >= s_parallel_threshold)
+  {
+    return from_memory_parallel(file.get_data(), file.get_size(), filename);
+  }
+  else
+  {
+    return from_memory(file.get_data(), file.get_size(), filename);
+  }
+}
+
+std::vector<ModObject>
+ModParser::from_memory(const char* data, size_t len, const std::string& filename)
+{
+  // This is not a fully featured .obj file reader, it just takes some
+  // inspiration from it:
+  // http://www.martinreddy.net/gfx/3d/OBJ.spec
+  std::vector<ModObject> objects = parse_chunk(data, data + len, 0, "phong", filename);
+  log_objects(objects);
+  return objects;
+}
+
+std::vector<ModObject>
+ModParser::from_memory_parallel(const char* data, size_t len, const std::string& filename)
+{
+  ThreadPool& pool = get_pool();
+
+  std::vector<Chunk> chunks = split_objects(data, len, s_min_chunk_size);
+  if (chunks.size() == 1 || pool.get_num_threads() == 1)
+  {
+    return from_memory(data, len, filename);
+  }
+
+  // hand out the biggest chunks first so that a single large object
+  // doesn't end up as the last job
+  std::vector<size_t> order(chunks.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&chunks](size_t lhs, size_t rhs) {
+              return (chunks[lhs].end - chunks[lhs].beg) > (chunks[rhs].end - chunks[rhs].beg);
+            });
+
+  std::vector<std::future<std::vector<ModObject> > > futures(chunks.size());
+  for(size_t idx : order)
+  {
+    const Chunk& chunk = chunks[idx];
+    futures[idx] = pool.schedule([&chunk, &filename]{
+        return parse_chunk(chunk.beg, chunk.end, chunk.line_number, chunk.material, filename);
+      });
+  }
+
+  // wait for all jobs before rethrowing, they reference 'chunks'
+  for(auto& future : futures)
+  {
+    future.wait();
+  }
+
+  // get() rethrows parse errors, the one closest to the start of the
+  // file wins, same as with the sequential parser
+  std::vector<ModObject> objects;
+  for(auto& future : futures)
+  {
+    std::vector<ModObject> part = future.get();
+    std::move(part.begin(), part.end(), std::back_inserter(objects));
+  }
+
+  log_objects(objects);
+  return objects;
+}
+
+std::vector<ModObject>
+ModParser::from_istream(std::istream& in, const std::string& filename)
+{
+  std::vector<ModObject> objects;
+  ModObject obj;
+
+  // same as Scene::parse_istream() did, which never cleared the bone
+  // data, so that each object carries that of all objects before it
+  auto commit = [&obj, &objects]{
+    if (!obj.name.empty())
+    {
+      objects.push_back(obj);
+
+      obj.name.clear();
+      obj.parent.clear();
+      obj.normal.clear();
+      obj.texcoord.clear();
+      obj.position.clear();
+      obj.index.clear();
+      obj.location = glm::vec3(0.0f, 0.0f, 0.0f);
+      obj.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+      obj.scale = glm::vec3(1.0f, 1.0f, 1.0f);
+    }
+  };
+
+  std::string line;
+  int line_number = 0;
+  while(std::getline(in, line))
+  {
+    line_number += 1;
+
+    boost::tokenizer<boost::char_separator<char> > tokens(line, boost::char_separator<char>(" ", ""));
+    auto it = tokens.begin();
+    if (it != tokens.end())
+    {
+#define INCR_AND_CHECK {                                                \
+        ++it;                                                           \
+        if (it == tokens.end())                                         \
+        {                                                               \
+          throw std::runtime_error((boost::format("not enough tokens at line %d") % line_number).str()); \
+        }                                                               \
+      }
+
+      try
+      {
+        if (*it == "o")
+        {
+          // object
+          commit();
+
+          INCR_AND_CHECK;
+          log_debug("object: '%s'", *it);
+          obj.name = *it;
+        }
+        else if (*it == "g")
+        {
+          // group
+        }
+        else if (*it == "parent")
+        {
+          INCR_AND_CHECK;
+          obj.parent = *it;
+        }
+        else if (*it == "mat")
+        {
+          INCR_AND_CHECK;
+          obj.material = *it;
+        }
+        else if (*it == "loc")
+        {
+          INCR_AND_CHECK;
+          obj.location.x = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          obj.location.y = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          obj.location.z = boost::lexical_cast<float>(*it);
+        }
+        else if (*it == "rot")
+        {
+          INCR_AND_CHECK;
+          obj.rotation.w = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          obj.rotation.x = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          obj.rotation.y = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          obj.rotation.z = boost::lexical_cast<float>(*it);
+        }
+        else if (*it == "scale")
+        {
+          INCR_AND_CHECK;
+          obj.scale.x = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          obj.scale.y = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          obj.scale.z = boost::lexical_cast<float>(*it);
+        }
+        else if (*it == "v")
+        {
+          glm::vec3 v;
+
+          INCR_AND_CHECK;
+          v.x = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          v.y = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          v.z = boost::lexical_cast<float>(*it);
+
+          obj.position.push_back(v);
+        }
+        else if (*it == "vt")
+        {
+          glm::vec3 vt;
+
+          INCR_AND_CHECK;
+          vt.s = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          vt.t = boost::lexical_cast<float>(*it);
+
+          obj.texcoord.push_back(vt);
+        }
+        else if (*it == "vn")
+        {
+          glm::vec3 vn;
+
+          INCR_AND_CHECK;
+          vn.x = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          vn.y = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          vn.z = boost::lexical_cast<float>(*it);
+
+          obj.normal.push_back(vn);
+        }
+        else if (*it == "bw")
+        {
+          glm::vec4 bw;
+
+          INCR_AND_CHECK;
+          bw.x = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          bw.y = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          bw.z = boost::lexical_cast<float>(*it);
+          INCR_AND_CHECK;
+          bw.w = boost::lexical_cast<float>(*it);
+
+          obj.bone_weight.push_back(bw);
+        }
+        else if (*it == "bi")
+        {
+          glm::ivec4 bi;
+
+          INCR_AND_CHECK;
+          bi.x = boost::lexical_cast<int>(*it);
+          INCR_AND_CHECK;
+          bi.y = boost::lexical_cast<int>(*it);
+          INCR_AND_CHECK;
+          bi.z = boost::lexical_cast<int>(*it);
+          INCR_AND_CHECK;
+          bi.w = boost::lexical_cast<int>(*it);
+
+          obj.bone_index.push_back(bi);
+        }
+        else if (*it == "f")
+        {
+          INCR_AND_CHECK;
+          obj.index.push_back(boost::lexical_cast<int>(*it));
+          INCR_AND_CHECK;
+          obj.index.push_back(boost::lexical_cast<int>(*it));
+          INCR_AND_CHECK;
+          obj.index.push_back(boost::lexical_cast<int>(*it));
+        }
+        else if ((*it)[0] == '#')
+        {
+          // ignore comments
+        }
+        else
+        {
+          throw std::runtime_error((boost::format("unhandled token %s") % *it).str());
+        }
+      }
+      catch(const std::exception& err)
+      {
+        throw std::runtime_error((boost::format("%s:%d: %s") % filename % line_number % err.what()).str());
+      }
+
+#undef INCR_AND_CHECK
+    }
+  }
+
+  commit();
+
+  return objects;
+}
+
+/* EOF */
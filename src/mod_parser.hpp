@@ -0,0 +1,98 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_MOD_PARSER_HPP
+#define HEADER_MOD_PARSER_HPP
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+/** The content of a single 'o' block of a .mod file. This is plain
+    data without any OpenGL objects attached, turning it into
+    SceneNodes and Meshes is left to Scene. */
+struct ModObject
+{
+  ModObject() :
+    name(),
+    parent(),
+    material("phong"),
+    location(0.0f, 0.0f, 0.0f),
+    rotation(1.0f, 0.0f, 0.0f, 0.0f),
+    scale(1.0f, 1.0f, 1.0f),
+    normal(),
+    position(),
+    texcoord(),
+    index(),
+    bone_weight(),
+    bone_index()
+  {}
+
+  std::string name;
+  std::string parent;
+  std::string material;
+  glm::vec3 location;
+  glm::quat rotation;
+  glm::vec3 scale;
+  std::vector<glm::vec3>  normal;
+  std::vector<glm::vec3>  position;
+  std::vector<glm::vec3>  texcoord;
+  std::vector<int>        index;
+  std::vector<glm::vec4>  bone_weight;
+  std::vector<glm::ivec4> bone_index;
+};
+
+class ModParser
+{
+public:
+  /** Files of at least this size are parsed with from_memory_parallel() */
+  static const size_t s_parallel_threshold = 1024 * 1024;
+
+  /** Objects get merged into a single job until it reaches this size */
+  static const size_t s_min_chunk_size = 64 * 1024;
+
+public:
+  /** Parse the file through a read-only mmap(), large files with
+      from_memory_parallel() */
+  static std::vector<ModObject> from_file(const std::string& filename);
+
+  /** Zero-copy parser, tokenizes the buffer in place and parses
+      numbers without allocating */
+  static std::vector<ModObject> from_memory(const char* data, size_t len,
+                                            const std::string& filename = "unknown");
+
+  /** Same result as from_memory(), but splits the buffer at 'o' lines
+      and parses the objects on a ThreadPool reserved for this, so it
+      is safe to call from jobs on ThreadPool::get(). Parent/child
+      stitching and OpenGL uploads are left to the caller's thread. */
+  static std::vector<ModObject> from_memory_parallel(const char* data, size_t len,
+                                                     const std::string& filename = "unknown");
+
+  /** The original line based parser going through std::getline(),
+      boost::tokenizer and boost::lexical_cast, kept around as
+      reference implementation. Unlike the other parsers it keeps the
+      baseline behaviour of never clearing bone_weight and bone_index,
+      each object gets those of the objects before it prepended. */
+  static std::vector<ModObject> from_istream(std::istream& in,
+                                             const std::string& filename = "unknown");
+};
+
+#endif
+
+/* EOF */
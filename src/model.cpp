@@ -23,10 +23,84 @@
 #include <boost/format.hpp>
 
 #include "log.hpp"
+#include "mesh_cluster.hpp"
 #include "render_context.hpp"
 
+namespace {
+
+/** Widens the band in which a LOD level stays selected, so that it
+    doesn't flicker while its error sits right at the threshold */
+const float lod_hysteresis = 0.25f;
+
+/** The coarsest LOD level of \a mesh whose projected error stays
+    below \a threshold pixels, starting from the current level */
+int select_lod(Mesh const& mesh, RenderContext const& context, float threshold)
+{
+  auto const& lods = mesh.get_lods();
+  if (lods.empty() || threshold <= 0.0f || context.get_viewport_height() <= 0)
+  {
+    return 0;
+  }
+
+  glm::mat4 node = context.get_node_matrix();
+  float scale = std::max(glm::length(glm::vec3(node[0])),
+                         std::max(glm::length(glm::vec3(node[1])), glm::length(glm::vec3(node[2]))));
+
+  // pixels per model unit, [1][1] is 1/tan(fov/2) for perspective
+  // projections, at a distance of one
+  glm::mat4 projection = context.get_projection_matrix();
+  float pixels = projection[1][1] * 0.5f * static_cast<float>(context.get_viewport_height()) * scale;
+  if (projection[2][3] != 0.0f)
+  {
+    MeshCluster const& bounds = mesh.get_bounds();
+    glm::vec3 center(context.get_view_matrix() * node * glm::vec4(bounds.center, 1.0f));
+    float distance = glm::length(center) - bounds.radius * scale;
+    if (distance <= 0.0f)
+    {
+      return 0;
+    }
+    pixels /= distance;
+  }
+
+  const int count = static_cast<int>(lods.size());
+  int level = std::min(mesh.get_lod(), count);
+  while(level > 0 && lods[level - 1].error * pixels > threshold * (1.0f + lod_hysteresis))
+  {
+    level -= 1;
+  }
+  while(level < count && lods[level].error * pixels < threshold * (1.0f - lod_hysteresis))
+  {
+    level += 1;
+  }
+  return level;
+}
+
+ClusterCuller::FaceCulling get_face_culling(Material const& material)
+{
+  if (!material.is_enabled(GL_CULL_FACE))
+  {
+    return ClusterCuller::FaceCulling::None;
+  }
+  else if (material.get_cull_face() == GL_BACK)
+  {
+    return ClusterCuller::FaceCulling::Back;
+  }
+  else if (material.get_cull_face() == GL_FRONT)
+  {
+    return ClusterCuller::FaceCulling::Front;
+  }
+  else
+  {
+    return ClusterCuller::FaceCulling::None;
+  }
+}
+
+} // namespace
+
+float Model::s_lod_threshold = 1.0f;
+
 void
-Model::draw(RenderContext const& context)
+Model::draw(RenderContext& context)
 {
   if (!m_material)
   {
@@ -52,16 +126,66 @@ Model::draw(RenderContext const& context)
 
     if (material)
     {
-      material->apply(context);
+      // the cluster bounds are in model space, the same for all passes
+      // and eyes, only the camera and the faces OpenGL culls change
+      ClusterCuller culler(context.get_projection_matrix(), context.get_view_matrix(),
+                           context.get_node_matrix(), ::get_face_culling(*material));
 
+      // quantized meshes fold their dequantization into the model
+      // matrix, the uniforms only need updating when it changes
+      bool applied = false;
       for (MeshLst::iterator i = m_meshes.begin(); i != m_meshes.end(); ++i)
       {
-        (*i)->draw();
+        // the shadow pass keeps the level of the eye passes, so that
+        // the shadows match the surface they fall on
+        if (!context.get_override_material())
+        {
+          (*i)->set_lod(select_lod(**i, context, s_lod_threshold));
+        }
+
+        if (!applied || (*i)->get_vertex_transform() != context.get_vertex_transform())
+        {
+          context.set_vertex_transform((*i)->get_vertex_transform());
+          if (!material->apply(context))
+          {
+            // without a program there is nothing to draw with
+            break;
+          }
+          applied = true;
+        }
+        (*i)->draw(&culler);
       }
+      context.set_vertex_transform(glm::mat4(1.0f));
     }
 
     glUseProgram(0);
   }
 }
 
+const OccluderMesh*
+Model::get_occluder() const
+{
+  if (!m_occluder || !m_material || m_material->is_enabled(GL_BLEND))
+  {
+    return nullptr;
+  }
+  else
+  {
+    return m_occluder.get();
+  }
+}
+
+ClusterCuller::FaceCulling
+Model::get_face_culling() const
+{
+  if (!m_material)
+  {
+    return ClusterCuller::FaceCulling::None;
+  }
+  else
+  {
+    return ::get_face_culling(*m_material);
+  }
+}
+
 /* EOF */
@@ -21,6 +21,7 @@
 
 #include "mesh.hpp"
 #include "material.hpp"
+#include "occlusion_buffer.hpp"
 #include "opengl_state.hpp"
 
 class Model;
@@ -35,19 +36,51 @@ private:
 
   MaterialPtr m_material;
 
+  /** Of all meshes, in model space */
+  BoundingBox m_bounding_box;
+
+  /** Triangles to hide other models behind, in model space */
+  std::shared_ptr<const OccluderMesh> m_occluder;
+
+  /** Largest error in pixels a LOD level may show */
+  static float s_lod_threshold;
+
+public:
+  /** 0 always draws the full meshes */
+  static void set_lod_threshold(float pixels) { s_lod_threshold = pixels; }
+
 public:
   Model() :
     m_meshes(),
-    m_material()
+    m_material(),
+    m_bounding_box(),
+    m_occluder()
   {}
 
-  void draw(RenderContext const& context);
+  void draw(RenderContext& context);
 
   void set_material(MaterialPtr material) { m_material = material; }
   void add_mesh(std::unique_ptr<Mesh> mesh)
   {
+    m_bounding_box.add(mesh->get_bounding_box());
     m_meshes.push_back(std::move(mesh));
   }
+  void clear_meshes()
+  {
+    m_meshes.clear();
+    m_bounding_box = BoundingBox();
+  }
+
+  BoundingBox const& get_bounding_box() const { return m_bounding_box; }
+
+  void set_occluder(std::shared_ptr<const OccluderMesh> occluder) { m_occluder = std::move(occluder); }
+
+  /** The occluder, unless there is none or the material lets what is
+      behind shine through */
+  const OccluderMesh* get_occluder() const;
+
+  /** The faces the material has OpenGL cull */
+  ClusterCuller::FaceCulling get_face_culling() const;
 };
 
 #endif
@@ -0,0 +1,419 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "occlusion_buffer.hpp"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+namespace {
+
+const uint32_t full_mask = 0xffffffffu;
+
+/** Triangles smaller than this in pixels are skipped, they can't
+    cover a tile and their depth plane is unreliable */
+const float min_area = 1.0e-4f;
+
+/** Coverage of the pixel centers of one tile by the three edge
+    functions, \a origin is the edge value at the first pixel center,
+    \a dx and \a dy the steps per pixel. Bit row * 8 + column is set for
+    covered pixels. */
+uint32_t get_coverage(const float origin[3], const float dx[3], const float dy[3])
+{
+#ifdef __SSE2__
+  uint32_t mask = full_mask;
+  for(int i = 0; i < 3; ++i)
+  {
+    __m128 left = _mm_add_ps(_mm_set1_ps(origin[i]),
+                             _mm_mul_ps(_mm_set1_ps(dx[i]), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)));
+    __m128 right = _mm_add_ps(left, _mm_set1_ps(4.0f * dx[i]));
+    __m128 step = _mm_set1_ps(dy[i]);
+    uint32_t edge = 0;
+    for(int row = 0; row < OcclusionBuffer::s_tile_height; ++row)
+    {
+      uint32_t bits = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(left, _mm_setzero_ps()))) |
+        (static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(right, _mm_setzero_ps()))) << 4);
+      edge |= bits << (row * OcclusionBuffer::s_tile_width);
+      left = _mm_add_ps(left, step);
+      right = _mm_add_ps(right, step);
+    }
+    mask &= edge;
+  }
+  return mask;
+#else
+  uint32_t mask = 0;
+  for(int row = 0; row < OcclusionBuffer::s_tile_height; ++row)
+  {
+    for(int column = 0; column < OcclusionBuffer::s_tile_width; ++column)
+    {
+      bool inside = true;
+      for(int i = 0; i < 3; ++i)
+      {
+        inside = inside && origin[i] + dx[i] * static_cast<float>(column) + dy[i] * static_cast<float>(row) >= 0.0f;
+      }
+      if (inside)
+      {
+        mask |= 1u << (row * OcclusionBuffer::s_tile_width + column);
+      }
+    }
+  }
+  return mask;
+#endif
+}
+
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) :
+  m_width((width + s_tile_width - 1) / s_tile_width * s_tile_width),
+  m_height((height + s_tile_height - 1) / s_tile_height * s_tile_height),
+  m_tiles_x(m_width / s_tile_width),
+  m_tiles_y(m_height / s_tile_height),
+  m_tiles(m_tiles_x * m_tiles_y)
+{
+  clear(0, m_tiles_y);
+}
+
+void
+OcclusionBuffer::clear(int first_row, int last_row)
+{
+  Tile empty = { 1.0f, 1.0f, 0 };
+  std::fill(m_tiles.begin() + first_row * m_tiles_x,
+            m_tiles.begin() + last_row * m_tiles_x,
+            empty);
+}
+
+glm::vec3
+OcclusionBuffer::to_screen(const glm::vec4& clip) const
+{
+  float inv_w = 1.0f / clip.w;
+  return glm::vec3((clip.x * inv_w * 0.5f + 0.5f) * static_cast<float>(m_width),
+                   (clip.y * inv_w * 0.5f + 0.5f) * static_cast<float>(m_height),
+                   clip.z * inv_w);
+}
+
+void
+OcclusionBuffer::draw(const glm::mat4& matrix, const OccluderMesh& mesh, ClusterCuller::FaceCulling face_culling,
+                      int first_row, int last_row)
+{
+  // most triangles need no clipping, those get projected once per vertex
+  std::vector<glm::vec4> clip;
+  std::vector<glm::vec3> screen;
+  clip.reserve(mesh.positions.size());
+  screen.reserve(mesh.positions.size());
+  for(const auto& position : mesh.positions)
+  {
+    glm::vec4 vertex = matrix * glm::vec4(position, 1.0f);
+    clip.push_back(vertex);
+    screen.push_back(vertex.z + vertex.w >= 0.0f ? to_screen(vertex) : glm::vec3(0.0f));
+  }
+
+  const float band_y0 = static_cast<float>(first_row * s_tile_height);
+  const float band_y1 = static_cast<float>(last_row * s_tile_height);
+  for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+  {
+    const int ia = mesh.indices[i + 0];
+    const int ib = mesh.indices[i + 1];
+    const int ic = mesh.indices[i + 2];
+    const glm::vec4& a = clip[ia];
+    const glm::vec4& b = clip[ib];
+    const glm::vec4& c = clip[ic];
+
+    // reject triangles completely outside of one of the planes, the far
+    // plane included, the rest is left to the clamping in rasterize()
+    if ((a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+        (a.x >  a.w && b.x >  b.w && c.x >  c.w) ||
+        (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+        (a.y >  a.w && b.y >  b.w && c.y >  c.w) ||
+        (a.z < -a.w && b.z < -b.w && c.z < -c.w) ||
+        (a.z >  a.w && b.z >  b.w && c.z >  c.w))
+    {
+      continue;
+    }
+
+    if (a.z + a.w >= 0.0f && b.z + b.w >= 0.0f && c.z + c.w >= 0.0f)
+    {
+      const glm::vec3& sa = screen[ia];
+      const glm::vec3& sb = screen[ib];
+      const glm::vec3& sc = screen[ic];
+      if (std::max(sa.y, std::max(sb.y, sc.y)) >= band_y0 &&
+          std::min(sa.y, std::min(sb.y, sc.y)) < band_y1)
+      {
+        rasterize(sa, sb, sc, face_culling, first_row, last_row);
+      }
+    }
+    else
+    {
+      draw_clipped(a, b, c, face_culling, first_row, last_row);
+    }
+  }
+}
+
+void
+OcclusionBuffer::draw_clipped(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c,
+                              ClusterCuller::FaceCulling face_culling, int first_row, int last_row)
+{
+  // clipping a triangle at one plane leaves at most a quad
+  const glm::vec4 vertices[3] = { a, b, c };
+  const float distances[3] = { a.z + a.w, b.z + b.w, c.z + c.w };
+  glm::vec3 polygon[4];
+  int count = 0;
+  for(int i = 0; i < 3; ++i)
+  {
+    int j = (i + 1) % 3;
+    if (distances[i] >= 0.0f)
+    {
+      polygon[count++] = to_screen(vertices[i]);
+    }
+    if ((distances[i] >= 0.0f) != (distances[j] >= 0.0f))
+    {
+      float t = distances[i] / (distances[i] - distances[j]);
+      polygon[count++] = to_screen(vertices[i] + (vertices[j] - vertices[i]) * t);
+    }
+  }
+
+  for(int i = 2; i < count; ++i)
+  {
+    rasterize(polygon[0], polygon[i - 1], polygon[i], face_culling, first_row, last_row);
+  }
+}
+
+void
+OcclusionBuffer::rasterize(glm::vec3 a, glm::vec3 b, glm::vec3 c,
+                           ClusterCuller::FaceCulling face_culling, int first_row, int last_row)
+{
+  // counter clockwise with y up is front facing, like glFrontFace(GL_CCW)
+  float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+  switch(face_culling)
+  {
+    case ClusterCuller::FaceCulling::Back:
+      if (area <= 0.0f) return;
+      break;
+
+    case ClusterCuller::FaceCulling::Front:
+      if (area >= 0.0f) return;
+      break;
+
+    case ClusterCuller::FaceCulling::None:
+      break;
+  }
+
+  if (area < 0.0f)
+  {
+    std::swap(b, c);
+    area = -area;
+  }
+
+  if (area < min_area)
+  {
+    return;
+  }
+
+  int min_x = std::max(static_cast<int>(floorf(std::min(a.x, std::min(b.x, c.x)))), 0);
+  int max_x = std::min(static_cast<int>(ceilf(std::max(a.x, std::max(b.x, c.x)))), m_width - 1);
+  int min_y = std::max(static_cast<int>(floorf(std::min(a.y, std::min(b.y, c.y)))), first_row * s_tile_height);
+  int max_y = std::min(static_cast<int>(ceilf(std::max(a.y, std::max(b.y, c.y)))), last_row * s_tile_height - 1);
+  if (min_x > max_x || min_y > max_y)
+  {
+    return;
+  }
+
+  // edge functions, positive to the left of each edge, which is the
+  // inside of a counter clockwise triangle
+  const glm::vec3 points[3] = { a, b, c };
+  float edge_dx[3];
+  float edge_dy[3];
+  for(int i = 0; i < 3; ++i)
+  {
+    const glm::vec3& p = points[i];
+    const glm::vec3& q = points[(i + 1) % 3];
+    edge_dx[i] = p.y - q.y;
+    edge_dy[i] = q.x - p.x;
+  }
+
+  // the depth is linear in screen space
+  float dzdx = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+  float dzdy = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+  float max_z = std::max(a.z, std::max(b.z, c.z));
+
+  // the range of each edge function over the pixel centers of a tile,
+  // relative to the first one
+  float edge_low[3];
+  float edge_high[3];
+  for(int i = 0; i < 3; ++i)
+  {
+    float x = edge_dx[i] * static_cast<float>(s_tile_width - 1);
+    float y = edge_dy[i] * static_cast<float>(s_tile_height - 1);
+    edge_low[i] = std::min(x, 0.0f) + std::min(y, 0.0f);
+    edge_high[i] = std::max(x, 0.0f) + std::max(y, 0.0f);
+  }
+
+  for(int ty = min_y / s_tile_height; ty <= max_y / s_tile_height; ++ty)
+  {
+    float y = static_cast<float>(ty * s_tile_height);
+    for(int tx = min_x / s_tile_width; tx <= max_x / s_tile_width; ++tx)
+    {
+      float x = static_cast<float>(tx * s_tile_width);
+      Tile& tile = m_tiles[ty * m_tiles_x + tx];
+
+      // the farthest depth of the plane is at one of the corners,
+      // merge() drops anything behind z0 anyway
+      float z = std::min(a.z + dzdx * (x - a.x) + dzdy * (y - a.y) +
+                         std::max(0.0f, dzdx * static_cast<float>(s_tile_width)) +
+                         std::max(0.0f, dzdy * static_cast<float>(s_tile_height)),
+                         max_z);
+      if (z >= tile.z0)
+      {
+        continue;
+      }
+
+      float origin[3];
+      bool outside = false;
+      bool inside = true;
+      for(int i = 0; i < 3; ++i)
+      {
+        origin[i] = edge_dx[i] * (x + 0.5f - points[i].x) + edge_dy[i] * (y + 0.5f - points[i].y);
+        outside = outside || origin[i] + edge_high[i] < 0.0f;
+        inside = inside && origin[i] + edge_low[i] >= 0.0f;
+      }
+
+      if (!outside)
+      {
+        uint32_t mask = inside ? full_mask : get_coverage(origin, edge_dx, edge_dy);
+        if (mask)
+        {
+          merge(tile, mask, z);
+        }
+      }
+    }
+  }
+}
+
+void
+OcclusionBuffer::merge(Tile& tile, uint32_t mask, float depth)
+{
+  if (depth >= tile.z0)
+  {
+    // behind what already covers the whole tile
+  }
+  else if (mask == full_mask)
+  {
+    tile.z0 = depth;
+    if (tile.z1 >= depth)
+    {
+      tile.mask = 0;
+    }
+  }
+  else
+  {
+    tile.z1 = tile.mask ? std::max(tile.z1, depth) : depth;
+    tile.mask |= mask;
+    if (tile.mask == full_mask)
+    {
+      tile.z0 = std::min(tile.z0, tile.z1);
+      tile.mask = 0;
+    }
+  }
+}
+
+OcclusionBuffer::Query
+OcclusionBuffer::project(const glm::mat4& matrix, const BoundingBox& box) const
+{
+  Query query;
+  query.tile_x0 = 0;
+  query.tile_y0 = 0;
+  query.tile_x1 = -1;
+  query.tile_y1 = -1;
+  query.depth = -1.0f;
+  query.visible = true;
+
+  if (box.is_empty() || box.is_infinite())
+  {
+    return query;
+  }
+
+  float min_x = FLT_MAX;
+  float min_y = FLT_MAX;
+  float max_x = -FLT_MAX;
+  float max_y = -FLT_MAX;
+  float min_z = FLT_MAX;
+  for(int i = 0; i < 8; ++i)
+  {
+    glm::vec4 clip = matrix * glm::vec4((i & 1) ? box.max.x : box.min.x,
+                                        (i & 2) ? box.max.y : box.min.y,
+                                        (i & 4) ? box.max.z : box.min.z,
+                                        1.0f);
+    if (clip.w <= 0.0f || clip.z < -clip.w)
+    {
+      // reaches through the near plane, the camera might be inside
+      return query;
+    }
+
+    glm::vec3 p = to_screen(clip);
+    min_x = std::min(min_x, p.x);
+    min_y = std::min(min_y, p.y);
+    max_x = std::max(max_x, p.x);
+    max_y = std::max(max_y, p.y);
+    min_z = std::min(min_z, p.z);
+  }
+
+  query.visible = false;
+  query.depth = min_z;
+  if (max_x >= 0.0f && max_y >= 0.0f &&
+      min_x < static_cast<float>(m_width) && min_y < static_cast<float>(m_height))
+  {
+    query.tile_x0 = std::max(static_cast<int>(min_x), 0) / s_tile_width;
+    query.tile_y0 = std::max(static_cast<int>(min_y), 0) / s_tile_height;
+    query.tile_x1 = std::min(static_cast<int>(max_x), m_width - 1) / s_tile_width;
+    query.tile_y1 = std::min(static_cast<int>(max_y), m_height - 1) / s_tile_height;
+  }
+  return query;
+}
+
+OcclusionBuffer::Visibility
+OcclusionBuffer::test(const Query& query, int first_row, int last_row) const
+{
+  if (query.visible)
+  {
+    return Visibility::Visible;
+  }
+
+  int y0 = std::max(query.tile_y0, first_row);
+  int y1 = std::min(query.tile_y1, last_row - 1);
+  if (y0 > y1 || query.tile_x0 > query.tile_x1)
+  {
+    return Visibility::Outside;
+  }
+
+  for(int ty = y0; ty <= y1; ++ty)
+  {
+    const Tile* row = &m_tiles[ty * m_tiles_x];
+    for(int tx = query.tile_x0; tx <= query.tile_x1; ++tx)
+    {
+      if (query.depth <= row[tx].z0)
+      {
+        return Visibility::Visible;
+      }
+    }
+  }
+  return Visibility::Hidden;
+}
+
+/* EOF */
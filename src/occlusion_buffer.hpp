@@ -0,0 +1,120 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_OCCLUSION_BUFFER_HPP
+#define HEADER_OCCLUSION_BUFFER_HPP
+
+#include <stdint.h>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "bounding_box.hpp"
+#include "mesh_cluster.hpp"
+
+/** Triangles kept on the CPU to be drawn into an OcclusionBuffer */
+struct OccluderMesh
+{
+  std::vector<glm::vec3> positions;
+  std::vector<int> indices;
+};
+
+/** Low resolution depth buffer of occluders, for testing whether
+    bounds are hidden behind them. Pixels are grouped into tiles of
+    8x4, each tile only keeps the farthest depth of a layer of
+    triangles that covers it completely, plus a working layer with
+    its coverage mask that replaces it once the mask is full. Tile rows
+    are independent, so threads can each take a range of them. Depths
+    are normalized device z, so smaller is nearer. */
+class OcclusionBuffer
+{
+public:
+  static const int s_tile_width = 8;
+  static const int s_tile_height = 4;
+
+  enum class Visibility { Outside, Hidden, Visible };
+
+  /** Screen space bounds of a box, see project() */
+  struct Query
+  {
+    int tile_x0, tile_y0;
+    int tile_x1, tile_y1;
+
+    /** Nearest depth of the box */
+    float depth;
+
+    /** The box reaches in front of the near plane and can't be tested */
+    bool visible;
+  };
+
+private:
+  struct Tile
+  {
+    float z0;
+    float z1;
+    uint32_t mask;
+  };
+
+  int m_width;
+  int m_height;
+  int m_tiles_x;
+  int m_tiles_y;
+  std::vector<Tile> m_tiles;
+
+public:
+  /** \a width and \a height in pixels, rounded up to whole tiles */
+  OcclusionBuffer(int width, int height);
+
+  int get_tile_rows() const { return m_tiles_y; }
+
+  void clear(int first_row, int last_row);
+
+  /** Draw the triangles of \a mesh transformed by \a matrix, the model
+      view projection, into the tile rows from \a first_row up to, but
+      not including, \a last_row. Only the faces OpenGL would draw with
+      \a face_culling are drawn. */
+  void draw(const glm::mat4& matrix, const OccluderMesh& mesh, ClusterCuller::FaceCulling face_culling,
+            int first_row, int last_row);
+
+  /** Screen space bounds of \a box under the view projection \a matrix */
+  Query project(const glm::mat4& matrix, const BoundingBox& box) const;
+
+  /** Test a query against the tile rows from \a first_row up to
+      \a last_row, Outside if it covers none of them */
+  Visibility test(const Query& query, int first_row, int last_row) const;
+
+private:
+  /** Clip a triangle reaching in front of the near plane and rasterize
+      what is left of it */
+  void draw_clipped(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c,
+                    ClusterCuller::FaceCulling face_culling, int first_row, int last_row);
+
+  /** Rasterize a triangle given in pixels and normalized device depth */
+  void rasterize(glm::vec3 a, glm::vec3 b, glm::vec3 c,
+                 ClusterCuller::FaceCulling face_culling, int first_row, int last_row);
+
+  void merge(Tile& tile, uint32_t mask, float depth);
+
+  glm::vec3 to_screen(const glm::vec4& clip) const;
+
+private:
+  OcclusionBuffer(const OcclusionBuffer&) = delete;
+  OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+};
+
+#endif
+
+/* EOF */
@@ -0,0 +1,157 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "occlusion_culler.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "render_stats.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+/** Of the OcclusionBuffer, the occluders only need to hide whole
+    SceneNodes, so this is plenty */
+const int buffer_width = 320;
+const int buffer_height = 192;
+
+/** The jobs get threads of their own, on ThreadPool::get() they would
+    queue behind the asset loading and hold up every frame meanwhile */
+ThreadPool& get_pool()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller() :
+  m_buffer(buffer_width, buffer_height),
+  m_occluders(),
+  m_candidates(),
+  m_queries(),
+  m_band_count(0),
+  m_results(),
+  m_jobs(),
+  m_visible()
+{
+}
+
+void
+OcclusionCuller::clear()
+{
+  m_occluders.clear();
+  m_candidates.clear();
+  m_visible.clear();
+}
+
+void
+OcclusionCuller::add_occluder(const OccluderMesh& mesh, const glm::mat4& matrix,
+                              ClusterCuller::FaceCulling face_culling)
+{
+  m_occluders.push_back({ &mesh, matrix, face_culling });
+}
+
+int
+OcclusionCuller::add_candidate(const BoundingBox& box)
+{
+  m_candidates.push_back(box);
+  return static_cast<int>(m_candidates.size()) - 1;
+}
+
+void
+OcclusionCuller::begin(const glm::mat4& view_projection)
+{
+  m_queries.clear();
+  for(auto const& box : m_candidates)
+  {
+    m_queries.push_back(m_buffer.project(view_projection, box));
+  }
+
+  m_band_count = std::max(1, std::min(static_cast<int>(get_pool().get_num_threads()),
+                                      m_buffer.get_tile_rows()));
+  m_results.resize(m_queries.size() * m_band_count);
+  for(int band = 0; band < m_band_count; ++band)
+  {
+    m_jobs.push_back(get_pool().schedule([this, band]{
+          return run_band(band);
+        }));
+  }
+}
+
+long
+OcclusionCuller::run_band(int band)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  int rows = m_buffer.get_tile_rows();
+  int first_row = rows * band / m_band_count;
+  int last_row = rows * (band + 1) / m_band_count;
+
+  m_buffer.clear(first_row, last_row);
+  for(auto const& occluder : m_occluders)
+  {
+    m_buffer.draw(occluder.matrix, *occluder.mesh, occluder.face_culling, first_row, last_row);
+  }
+
+  OcclusionBuffer::Visibility* results = m_results.data() + band * m_queries.size();
+  for(size_t i = 0; i < m_queries.size(); ++i)
+  {
+    results[i] = m_buffer.test(m_queries[i], first_row, last_row);
+  }
+
+  return static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - start).count());
+}
+
+void
+OcclusionCuller::finish()
+{
+  auto start = std::chrono::steady_clock::now();
+
+  long cpu_us = 0;
+  for(auto& job : m_jobs)
+  {
+    cpu_us += job.get();
+  }
+  m_jobs.clear();
+
+  RenderStats& stats = RenderStats::get();
+  stats.occlusion_wait_us += static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                 std::chrono::steady_clock::now() - start).count());
+  stats.occlusion_cpu_us += cpu_us;
+
+  // hidden in all bands it covers, the ones outside of all of them are
+  // off screen
+  m_visible.assign(m_queries.size(), false);
+  for(int band = 0; band < m_band_count; ++band)
+  {
+    const OcclusionBuffer::Visibility* results = m_results.data() + band * m_queries.size();
+    for(size_t i = 0; i < m_queries.size(); ++i)
+    {
+      if (results[i] == OcclusionBuffer::Visibility::Visible)
+      {
+        m_visible[i] = true;
+      }
+    }
+  }
+
+  stats.occlusion_tested += static_cast<int>(m_queries.size());
+  stats.occlusion_culled += static_cast<int>(std::count(m_visible.begin(), m_visible.end(), false));
+}
+
+/* EOF */
@@ -0,0 +1,88 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_OCCLUSION_CULLER_HPP
+#define HEADER_OCCLUSION_CULLER_HPP
+
+#include <future>
+#include <vector>
+
+#include "occlusion_buffer.hpp"
+
+/** Tests boxes against an OcclusionBuffer of the occluders, with the
+    rows of tiles split among the threads of a ThreadPool reserved for
+    this. Between begin() and finish() the caller is free to go on,
+    e.g. with handing the occluders to OpenGL. */
+class OcclusionCuller
+{
+private:
+  struct Occluder
+  {
+    const OccluderMesh* mesh;
+    glm::mat4 matrix;
+    ClusterCuller::FaceCulling face_culling;
+  };
+
+  OcclusionBuffer m_buffer;
+  std::vector<Occluder> m_occluders;
+  std::vector<BoundingBox> m_candidates;
+  std::vector<OcclusionBuffer::Query> m_queries;
+
+  /** Visibility of each candidate in each band of rows, band major */
+  int m_band_count;
+  std::vector<OcclusionBuffer::Visibility> m_results;
+
+  /** The running jobs, one per band */
+  std::vector<std::future<long> > m_jobs;
+
+  std::vector<bool> m_visible;
+
+public:
+  OcclusionCuller();
+
+  /** Forget the occluders and candidates of the previous frame */
+  void clear();
+
+  /** The \a mesh must stay alive until finish(), \a matrix is its
+      model view projection */
+  void add_occluder(const OccluderMesh& mesh, const glm::mat4& matrix, ClusterCuller::FaceCulling face_culling);
+
+  /** Returns the index to pass to is_visible() */
+  int add_candidate(const BoundingBox& box);
+
+  /** Start drawing the occluders and testing the candidates, whose
+      boxes are in the space \a view_projection transforms from */
+  void begin(const glm::mat4& view_projection);
+
+  /** Wait for the jobs of begin() */
+  void finish();
+
+  /** False if the candidate is hidden behind the occluders */
+  bool is_visible(int candidate) const { return m_visible[candidate]; }
+
+private:
+  /** Draw and test band \a band of m_band_count, returns the
+      microseconds it took */
+  long run_band(int band);
+
+private:
+  OcclusionCuller(const OcclusionCuller&) = delete;
+  OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+};
+
+#endif
+
+/* EOF */
@@ -0,0 +1,280 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "pixel_convert.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define PIXEL_CONVERT_X86
+#  include <immintrin.h>
+#endif
+
+namespace {
+
+/** (c * values[a]) >> 16 == c * 255 / a for all 8-bit c and a, the
+    error of the rounded up reciprocal never reaches the next integer */
+struct ReciprocalTable
+{
+  uint32_t values[256];
+
+  ReciprocalTable()
+  {
+    values[0] = 1 << 16;
+    for(uint32_t a = 1; a < 256; ++a)
+    {
+      values[a] = (255u * 65536u + a - 1) / a;
+    }
+  }
+};
+
+const ReciprocalTable g_reciprocal;
+
+PixelConvert::Isa g_isa = PixelConvert::get_supported_isa();
+
+void swap_red_blue_scalar(uint8_t* pixels, size_t num_pixels, int bytes_per_pixel)
+{
+  for(size_t i = 0; i < num_pixels; ++i)
+  {
+    std::swap(pixels[0], pixels[2]);
+    pixels += bytes_per_pixel;
+  }
+}
+
+void unpremultiply_bgra_scalar(uint8_t* pixels, size_t num_pixels)
+{
+  for(size_t i = 0; i < num_pixels; ++i)
+  {
+    uint32_t reciprocal = g_reciprocal.values[pixels[3]];
+    uint8_t b = pixels[0];
+    pixels[0] = static_cast<uint8_t>((pixels[2] * reciprocal) >> 16);
+    pixels[1] = static_cast<uint8_t>((pixels[1] * reciprocal) >> 16);
+    pixels[2] = static_cast<uint8_t>((b * reciprocal) >> 16);
+    pixels += 4;
+  }
+}
+
+void rgb_to_rgba_scalar(uint8_t* dst, const uint8_t* src, size_t num_pixels)
+{
+  for(size_t i = 0; i < num_pixels; ++i)
+  {
+    dst[0] = src[0];
+    dst[1] = src[1];
+    dst[2] = src[2];
+    dst[3] = 255;
+    dst += 4;
+    src += 3;
+  }
+}
+
+#ifdef PIXEL_CONVERT_X86
+
+// the SIMD kernels return the number of pixels they handled, the
+// rest is left to the scalar code
+
+__attribute__((target("ssse3")))
+size_t swap_red_blue_rgba_ssse3(uint8_t* pixels, size_t num_pixels)
+{
+  const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  size_t i = 0;
+  for(; i + 4 <= num_pixels; i += 4)
+  {
+    __m128i* p = reinterpret_cast<__m128i*>(pixels + 4 * i);
+    _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), mask));
+  }
+  return i;
+}
+
+__attribute__((target("ssse3")))
+size_t swap_red_blue_rgb_ssse3(uint8_t* pixels, size_t num_pixels)
+{
+  // five pixels per 16 bytes, the last byte stays where it is and is
+  // done as the first byte of the next step. The next step is loaded
+  // before the store, the load would otherwise stall on the
+  // overlapping store.
+  const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+  size_t i = 0;
+  if (3 * num_pixels >= 16)
+  {
+    __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+    for(; 3 * (i + 5) + 16 <= 3 * num_pixels; i += 5)
+    {
+      __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 3 * (i + 5)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 3 * i), _mm_shuffle_epi8(current, mask));
+      current = next;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 3 * i), _mm_shuffle_epi8(current, mask));
+    i += 5;
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+size_t swap_red_blue_rgba_avx2(uint8_t* pixels, size_t num_pixels)
+{
+  const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  size_t i = 0;
+  for(; i + 8 <= num_pixels; i += 8)
+  {
+    __m256i* p = reinterpret_cast<__m256i*>(pixels + 4 * i);
+    _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), mask));
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+size_t unpremultiply_bgra_avx2(uint8_t* pixels, size_t num_pixels)
+{
+  const __m256i byte_mask = _mm256_set1_epi32(0xff);
+  const int* table = reinterpret_cast<const int*>(g_reciprocal.values);
+  size_t i = 0;
+  for(; i + 8 <= num_pixels; i += 8)
+  {
+    __m256i* p = reinterpret_cast<__m256i*>(pixels + 4 * i);
+    __m256i bgra = _mm256_loadu_si256(p);
+
+    __m256i alpha = _mm256_srli_epi32(bgra, 24);
+    __m256i reciprocal = _mm256_i32gather_epi32(table, alpha, 4);
+
+    __m256i b = _mm256_and_si256(bgra, byte_mask);
+    __m256i g = _mm256_and_si256(_mm256_srli_epi32(bgra, 8), byte_mask);
+    __m256i r = _mm256_and_si256(_mm256_srli_epi32(bgra, 16), byte_mask);
+
+    b = _mm256_and_si256(_mm256_srli_epi32(_mm256_mullo_epi32(b, reciprocal), 16), byte_mask);
+    g = _mm256_and_si256(_mm256_srli_epi32(_mm256_mullo_epi32(g, reciprocal), 16), byte_mask);
+    r = _mm256_and_si256(_mm256_srli_epi32(_mm256_mullo_epi32(r, reciprocal), 16), byte_mask);
+
+    __m256i rgba = _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)),
+                                   _mm256_or_si256(_mm256_slli_epi32(b, 16), _mm256_slli_epi32(alpha, 24)));
+    _mm256_storeu_si256(p, rgba);
+  }
+  return i;
+}
+
+__attribute__((target("ssse3")))
+size_t rgb_to_rgba_ssse3(uint8_t* dst, const uint8_t* src, size_t num_pixels)
+{
+  const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+  size_t i = 0;
+  // four pixels per step, but the load reads 16 bytes
+  for(; 3 * i + 16 <= 3 * num_pixels; i += 4)
+  {
+    __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i),
+                     _mm_or_si128(_mm_shuffle_epi8(rgb, mask), alpha));
+  }
+  return i;
+}
+
+#endif
+
+} // namespace
+
+PixelConvert::Isa
+PixelConvert::get_supported_isa()
+{
+#ifdef PIXEL_CONVERT_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    return Isa::AVX2;
+  }
+  else if (__builtin_cpu_supports("ssse3"))
+  {
+    return Isa::SSSE3;
+  }
+#endif
+  return Isa::Scalar;
+}
+
+void
+PixelConvert::set_isa(Isa isa)
+{
+  g_isa = std::min(isa, get_supported_isa());
+}
+
+PixelConvert::Isa
+PixelConvert::get_isa()
+{
+  return g_isa;
+}
+
+void
+PixelConvert::swap_red_blue(uint8_t* pixels, size_t num_pixels, int bytes_per_pixel)
+{
+  size_t done = 0;
+#ifdef PIXEL_CONVERT_X86
+  if (bytes_per_pixel == 4 && g_isa >= Isa::AVX2)
+  {
+    done = swap_red_blue_rgba_avx2(pixels, num_pixels);
+  }
+  else if (bytes_per_pixel == 4 && g_isa >= Isa::SSSE3)
+  {
+    done = swap_red_blue_rgba_ssse3(pixels, num_pixels);
+  }
+  else if (bytes_per_pixel == 3 && g_isa >= Isa::SSSE3)
+  {
+    done = swap_red_blue_rgb_ssse3(pixels, num_pixels);
+  }
+#endif
+  swap_red_blue_scalar(pixels + done * bytes_per_pixel, num_pixels - done, bytes_per_pixel);
+}
+
+void
+PixelConvert::copy_rows(uint8_t* dst, size_t dst_pitch,
+                        const uint8_t* src, size_t src_pitch,
+                        size_t row_size, int height, bool vflip)
+{
+  // memcpy() already picks the best vector code for the CPU
+  for(int y = 0; y < height; ++y)
+  {
+    int dst_y = vflip ? height - y - 1 : y;
+    memcpy(dst + dst_y * dst_pitch, src + y * src_pitch, row_size);
+  }
+}
+
+void
+PixelConvert::unpremultiply_bgra(uint8_t* pixels, size_t num_pixels)
+{
+  size_t done = 0;
+#ifdef PIXEL_CONVERT_X86
+  // the gather needs AVX2, below that the table lookup dominates and
+  // the scalar code is as good
+  if (g_isa >= Isa::AVX2)
+  {
+    done = unpremultiply_bgra_avx2(pixels, num_pixels);
+  }
+#endif
+  unpremultiply_bgra_scalar(pixels + 4 * done, num_pixels - done);
+}
+
+void
+PixelConvert::rgb_to_rgba(uint8_t* dst, const uint8_t* src, size_t num_pixels)
+{
+  size_t done = 0;
+#ifdef PIXEL_CONVERT_X86
+  if (g_isa >= Isa::SSSE3)
+  {
+    done = rgb_to_rgba_ssse3(dst, src, num_pixels);
+  }
+#endif
+  rgb_to_rgba_scalar(dst + 4 * done, src + 3 * done, num_pixels - done);
+}
+
+/* EOF */
@@ -0,0 +1,64 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_PIXEL_CONVERT_HPP
+#define HEADER_PIXEL_CONVERT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Pixel format conversion kernels for 8-bit RGB and RGBA data. Each
+    kernel has a scalar version and SSSE3/AVX2 versions that are picked
+    at runtime depending on the CPU. */
+class PixelConvert
+{
+public:
+  enum class Isa
+  {
+    Scalar,
+    SSSE3,
+    AVX2
+  };
+
+  /** Best instruction set supported by the CPU */
+  static Isa get_supported_isa();
+
+  /** Limit the kernels to \a isa, for benchmarks and tests, the
+      default is get_supported_isa() */
+  static void set_isa(Isa isa);
+  static Isa get_isa();
+
+  /** RGB <-> BGR or RGBA <-> BGRA in place */
+  static void swap_red_blue(uint8_t* pixels, size_t num_pixels, int bytes_per_pixel);
+
+  /** Copy \a height rows of \a row_size bytes between buffers with
+      different pitch, with \a vflip the last row comes first */
+  static void copy_rows(uint8_t* dst, size_t dst_pitch,
+                        const uint8_t* src, size_t src_pitch,
+                        size_t row_size, int height, bool vflip);
+
+  /** Cairo's premultiplied ARGB32, BGRA in memory, to straight RGBA
+      in place, divides through a table of reciprocals. Transparent
+      pixels are black in premultiplied form and stay so. */
+  static void unpremultiply_bgra(uint8_t* pixels, size_t num_pixels);
+
+  /** Expand \a num_pixels RGB pixels to RGBA with opaque alpha */
+  static void rgb_to_rgba(uint8_t* dst, const uint8_t* src, size_t num_pixels);
+};
+
+#endif
+
+/* EOF */
@@ -1,9 +1,12 @@
 #include "program.hpp"
 
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 #include "assert_gl.hpp"
 #include "log.hpp"
+#include "vertex_format.hpp"
 
 ProgramPtr
 Program::create(ShaderPtr shader)
@@ -44,10 +47,99 @@ Program::create(ShaderPtr shader1, ShaderPtr shader2, ShaderPtr shader3)
   return program;
 }
 
+ProgramPtr
+Program::from_binary(GLenum format, std::vector<char> const& binary)
+{
+#ifdef HAVE_OPENGLES2
+  return {};
+#else
+  ProgramPtr program = std::make_shared<Program>();
+  glProgramBinary(program->get_id(), format, binary.data(), static_cast<GLsizei>(binary.size()));
+  if (!program->get_link_status())
+  {
+    return {};
+  }
+  else
+  {
+    program->inspect();
+    return program;
+  }
+#endif
+}
+
+bool
+Program::has_binary_support()
+{
+#ifdef HAVE_OPENGLES2
+  return false;
+#else
+  if (!GLEW_ARB_get_program_binary)
+  {
+    return false;
+  }
+  else
+  {
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    return num_formats > 0;
+  }
+#endif
+}
+
+ProgramPtr
+Program::submit(ShaderPtr vertex_shader, ShaderPtr fragment_shader)
+{
+  ProgramPtr program = std::make_shared<Program>();
+  program->attach(vertex_shader);
+  program->attach(fragment_shader);
+  program->link();
+
+  program->m_pending = true;
+  program->m_shaders = { vertex_shader, fragment_shader };
+
+  return program;
+}
+
+bool
+Program::has_parallel_compile()
+{
+#ifdef HAVE_OPENGLES2
+  return false;
+#else
+  return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+#endif
+}
+
+void
+Program::init_parallel_compile()
+{
+#ifndef HAVE_OPENGLES2
+  if (GLEW_KHR_parallel_shader_compile)
+  {
+    glMaxShaderCompilerThreadsKHR(0xffffffff);
+  }
+  else if (GLEW_ARB_parallel_shader_compile)
+  {
+    glMaxShaderCompilerThreadsARB(0xffffffff);
+  }
+#endif
+}
+
 Program::Program() :
-  m_program()
+  m_program(),
+  m_pending(false),
+  m_shaders(),
+  m_failed(false)
 {
   m_program = glCreateProgram();
+
+#ifndef HAVE_OPENGLES2
+  if (GLEW_ARB_get_program_binary)
+  {
+    // must be set before linking for get_binary() to work
+    glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+#endif
 }
 
 Program::~Program()
@@ -64,9 +156,54 @@ Program::attach(ShaderPtr shader)
 void
 Program::link()
 {
+  for(int i = 0; i < VertexAttribute::Count; ++i)
+  {
+    glBindAttribLocation(m_program, i, VertexAttribute::get_name(i));
+  }
   glLinkProgram(m_program);
 }
 
+bool
+Program::is_ready() const
+{
+  if (!m_pending || !has_parallel_compile())
+  {
+    return true;
+  }
+  else
+  {
+#ifdef HAVE_OPENGLES2
+    return true;
+#else
+    GLint completion_status;
+    glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &completion_status);
+    return completion_status == GL_TRUE;
+#endif
+  }
+}
+
+void
+Program::finish_link()
+{
+  m_pending = false;
+  std::vector<ShaderPtr> shaders = std::move(m_shaders);
+
+  if (!get_link_status())
+  {
+    m_failed = true;
+
+    // a failed compile is the more useful error message
+    for(auto const& shader : shaders)
+    {
+      shader->check();
+    }
+
+    throw std::runtime_error("program link failed:\n" + get_info_log());
+  }
+
+  inspect();
+}
+
 void
 Program::validate()
 {
@@ -92,6 +229,38 @@ Program::get_info_log() const
   }
 }
 
+void
+Program::swap(Program& other)
+{
+  std::swap(m_program, other.m_program);
+  std::swap(m_pending, other.m_pending);
+  std::swap(m_shaders, other.m_shaders);
+  std::swap(m_failed, other.m_failed);
+}
+
+bool
+Program::get_binary(GLenum& format, std::vector<char>& binary) const
+{
+#ifdef HAVE_OPENGLES2
+  return false;
+#else
+  GLint length = 0;
+  glGetProgramiv(m_program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+  {
+    return false;
+  }
+  else
+  {
+    binary.resize(length);
+    GLsizei out_length = 0;
+    glGetProgramBinary(m_program, length, &out_length, &format, binary.data());
+    binary.resize(out_length);
+    return out_length > 0;
+  }
+#endif
+}
+
 bool
 Program::get_link_status() const
 {
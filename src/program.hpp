@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -21,11 +22,39 @@ class Program
 private:
   GLuint m_program;
 
+  /** Set while a submit()ed link hasn't been finish()ed yet, the
+      shaders are kept around for their error messages */
+  bool m_pending;
+  std::vector<ShaderPtr> m_shaders;
+
+  /** Set by a finish() whose link failed, the program can't be used */
+  bool m_failed;
+
 public:
   static ProgramPtr create(ShaderPtr shader);
   static ProgramPtr create(ShaderPtr shader1, ShaderPtr shader2);
   static ProgramPtr create(ShaderPtr shader1, ShaderPtr shader2, ShaderPtr shader3);
 
+  /** Create a Program from a binary returned by get_binary(), returns
+      nullptr when the driver rejects it, e.g. after a driver update */
+  static ProgramPtr from_binary(GLenum format, std::vector<char> const& binary);
+
+  /** True if the driver can save and restore program binaries */
+  static bool has_binary_support();
+
+  /** Links the program without waiting for the compiles or the link
+      to finish, use is_ready() to poll and finish() before first use.
+      Shaders should be created with Shader::submit() */
+  static ProgramPtr submit(ShaderPtr vertex_shader, ShaderPtr fragment_shader);
+
+  /** True if the driver compiles and links in the background
+      (GL_KHR_parallel_shader_compile), has_parallel_compile() tells
+      whether is_ready() can poll or has to report ready right away */
+  static bool has_parallel_compile();
+
+  /** Let the driver use as many compiler threads as it likes */
+  static void init_parallel_compile();
+
 public:
   Program();
   ~Program();
@@ -40,8 +69,33 @@ public:
 
   GLuint get_id() const { return m_program; }
 
+  /** Returns false while the driver is still compiling or linking,
+      never blocks */
+  bool is_ready() const;
+
+  /** Wait for a submit()ed link and check its result, throws if it
+      failed, does nothing for a program that is already finished */
+  void finish()
+  {
+    if (m_pending)
+    {
+      finish_link();
+    }
+  }
+
+  /** True once finish() found the link failed */
+  bool is_failed() const { return m_failed; }
+
   void inspect() const;
 
+  /** Exchange the OpenGL objects of the two programs, this swaps a
+      reloaded program into place without touching its users */
+  void swap(Program& other);
+
+  /** Retrieve the linked program in the driver's own binary format,
+      returns false if the driver doesn't provide one */
+  bool get_binary(GLenum& format, std::vector<char>& binary) const;
+
   template<typename T>
   void set_uniform(const std::string& name, T const& v)
   {
@@ -89,6 +143,9 @@ public:
   void set_uniform(GLint loc, const glm::mat4& v) { glProgramUniformMatrix4fv(m_program, loc, 1, GL_FALSE, glm::value_ptr(v)); }
 #endif
 
+private:
+  void finish_link();
+
 private:
   Program(const Program&);
   Program& operator=(const Program&);
@@ -0,0 +1,455 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "program_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+
+#include "file_watcher.hpp"
+#include "format.hpp"
+#include "log.hpp"
+
+namespace {
+
+struct BinaryHeader
+{
+  char magic[8];
+  uint64_t hash;
+  uint32_t format;
+  uint32_t size;
+};
+
+const char binary_magic[8] = { 'V', 'W', 'R', 'P', 'R', 'O', 'G', '2' };
+
+/** FNV-1a, std::hash is not guaranteed to be stable across runs */
+uint64_t hash_string(uint64_t hash, const std::string& str)
+{
+  for(unsigned char c : str)
+  {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+boost::filesystem::path default_directory()
+{
+  if (const char* cache_home = getenv("XDG_CACHE_HOME"))
+  {
+    if (*cache_home)
+    {
+      return boost::filesystem::path(cache_home) / "viewer" / "programs";
+    }
+  }
+
+  if (const char* home = getenv("HOME"))
+  {
+    return boost::filesystem::path(home) / ".cache" / "viewer" / "programs";
+  }
+
+  return {};
+}
+
+std::string get_gl_string(GLenum name)
+{
+  const GLubyte* str = glGetString(name);
+  return str ? reinterpret_cast<const char*>(str) : "";
+}
+
+float seconds_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+}
+
+void append_key(std::ostream& os, GLenum type, const std::string& filename,
+                std::vector<std::string> defines, std::vector<std::string> const& sources)
+{
+  std::sort(defines.begin(), defines.end());
+
+  // sources.back() is the file itself with all #includes expanded
+  os << type << ':' << filename << ':' << std::hash<std::string>()(sources.back());
+  for(auto const& def : defines)
+  {
+    os << ':' << def;
+  }
+  os << '\n';
+}
+
+} // namespace
+
+ProgramCache::ProgramCache() :
+  m_programs(),
+  m_pending(),
+  m_prewarmed(),
+  m_directory(default_directory()),
+  m_driver(),
+  m_hits(0),
+  m_misses(0),
+  m_compiles(0),
+  m_binary_loads(0),
+  m_binary_rejects(0),
+  m_compile_time(0.0f),
+  m_binary_load_time(0.0f),
+  m_watched(),
+  m_reloads(0)
+{
+  // the cache is first used after the GL context is up
+  Program::init_parallel_compile();
+}
+
+ProgramPtr
+ProgramCache::create(const std::string& vertex_filename,
+                     const std::string& fragment_filename)
+{
+  return create(vertex_filename, {}, fragment_filename, {});
+}
+
+ProgramPtr
+ProgramCache::create(const std::string& vertex_filename,
+                     std::vector<std::string> const& vertex_defines,
+                     const std::string& fragment_filename,
+                     std::vector<std::string> const& fragment_defines)
+{
+  Variant variant{ vertex_filename, vertex_defines, fragment_filename, fragment_defines };
+
+  // reading and expanding the sources is cheap compared to compiling
+  // them and catches edits to the files or their includes
+  std::vector<std::string> dependencies;
+  std::vector<std::string> vertex_sources = Shader::load_source(vertex_filename, vertex_defines, &dependencies);
+  std::vector<std::string> fragment_sources = Shader::load_source(fragment_filename, fragment_defines, &dependencies);
+
+  std::string key = make_key(variant, vertex_sources, fragment_sources);
+  Entry& entry = m_programs[key];
+  ProgramPtr program = entry.program.lock();
+  if (program)
+  {
+    m_hits += 1;
+  }
+  else
+  {
+    m_misses += 1;
+
+    dependencies.push_back(vertex_filename);
+    dependencies.push_back(fragment_filename);
+
+    program = compile(variant, vertex_sources, fragment_sources);
+    entry = Entry{ program, variant, watch(dependencies) };
+  }
+  return program;
+}
+
+void
+ProgramCache::prewarm(std::vector<Variant> const& variants)
+{
+  for(auto const& variant : variants)
+  {
+    m_prewarmed.push_back(create(variant.vertex_filename, variant.vertex_defines,
+                                 variant.fragment_filename, variant.fragment_defines));
+  }
+  log_info("ProgramCache: %d program variants submitted", static_cast<int>(variants.size()));
+}
+
+void
+ProgramCache::update()
+{
+  for(auto it = m_pending.begin(); it != m_pending.end();)
+  {
+    ProgramPtr program = it->program.lock();
+    if (!program)
+    {
+      it = m_pending.erase(it);
+    }
+    else if (!(it->replacement ? it->replacement : program)->is_ready())
+    {
+      ++it;
+    }
+    else
+    {
+      PendingLink link = std::move(*it);
+      it = m_pending.erase(it);
+
+      if (link.replacement)
+      {
+        try
+        {
+          link.replacement->finish();
+        }
+        catch(const std::exception& err)
+        {
+          log_error("ProgramCache: reload failed, keeping the old program: %s", err.what());
+          continue;
+        }
+
+        // the old OpenGL program goes away with the replacement
+        program->swap(*link.replacement);
+      }
+      else
+      {
+        try
+        {
+          program->finish();
+        }
+        catch(const std::exception& err)
+        {
+          // Material::apply() skips the failed program
+          log_error("ProgramCache: %s", err.what());
+          continue;
+        }
+      }
+      m_compile_time += seconds_since(link.start);
+
+      if (!link.binary_filename.empty())
+      {
+        save_binary(link.binary_filename, link.hash, *program);
+      }
+    }
+  }
+}
+
+std::string
+ProgramCache::make_key(const Variant& variant,
+                       std::vector<std::string> const& vertex_sources,
+                       std::vector<std::string> const& fragment_sources) const
+{
+  std::ostringstream key;
+  append_key(key, GL_VERTEX_SHADER, variant.vertex_filename, variant.vertex_defines, vertex_sources);
+  append_key(key, GL_FRAGMENT_SHADER, variant.fragment_filename, variant.fragment_defines, fragment_sources);
+  return key.str();
+}
+
+ProgramPtr
+ProgramCache::compile(const Variant& variant,
+                      std::vector<std::string> const& vertex_sources,
+                      std::vector<std::string> const& fragment_sources,
+                      ProgramPtr target)
+{
+  bool use_binary = !m_directory.empty() && Program::has_binary_support();
+  uint64_t hash = 14695981039346656037ull;
+  boost::filesystem::path binary_filename;
+  if (use_binary)
+  {
+    if (m_driver.empty())
+    {
+      m_driver = get_gl_string(GL_VENDOR) + '\n' +
+        get_gl_string(GL_RENDERER) + '\n' +
+        get_gl_string(GL_VERSION) + '\n';
+    }
+
+    hash = hash_string(hash, m_driver);
+    for(auto const* sources : { &vertex_sources, &fragment_sources })
+    {
+      for(auto const& source : *sources)
+      {
+        hash = hash_string(hash, source);
+        hash = hash_string(hash, "\n");
+      }
+      hash = hash_string(hash, "\f");
+    }
+
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+    binary_filename = m_directory / name.str();
+
+    auto start = std::chrono::steady_clock::now();
+    ProgramPtr program = load_binary(binary_filename, hash);
+    if (program)
+    {
+      m_binary_loads += 1;
+      m_binary_load_time += seconds_since(start);
+
+      if (target)
+      {
+        target->swap(*program);
+        return target;
+      }
+      else
+      {
+        return program;
+      }
+    }
+  }
+
+  // the binary gets saved by update() once the link is done
+  auto start = std::chrono::steady_clock::now();
+  ProgramPtr program = Program::submit(Shader::submit(GL_VERTEX_SHADER, vertex_sources, variant.vertex_filename),
+                                       Shader::submit(GL_FRAGMENT_SHADER, fragment_sources, variant.fragment_filename));
+  m_compiles += 1;
+
+  if (target)
+  {
+    m_pending.push_back({ target, program, start, binary_filename, hash });
+    return target;
+  }
+  else
+  {
+    m_pending.push_back({ program, {}, start, binary_filename, hash });
+    return program;
+  }
+}
+
+std::vector<std::string>
+ProgramCache::watch(std::vector<std::string> const& filenames)
+{
+  std::vector<std::string> result;
+  for(auto const& filename : filenames)
+  {
+    std::string path = FileWatcher::canonical_path(filename);
+    if (m_watched.insert(path).second)
+    {
+      FileWatcher::get().watch(path, [this](const std::string& changed){ reload(changed); });
+    }
+    result.push_back(path);
+  }
+  return result;
+}
+
+void
+ProgramCache::reload(const std::string& filename)
+{
+  std::vector<std::string> keys;
+  for(auto const& it : m_programs)
+  {
+    auto const& deps = it.second.dependencies;
+    if (!it.second.program.expired() &&
+        std::find(deps.begin(), deps.end(), filename) != deps.end())
+    {
+      keys.push_back(it.first);
+    }
+  }
+
+  for(auto const& key : keys)
+  {
+    Entry entry = m_programs[key];
+    ProgramPtr target = entry.program.lock();
+    Variant const& variant = entry.variant;
+
+    try
+    {
+      std::vector<std::string> dependencies;
+      std::vector<std::string> vertex_sources = Shader::load_source(variant.vertex_filename, variant.vertex_defines, &dependencies);
+      std::vector<std::string> fragment_sources = Shader::load_source(variant.fragment_filename, variant.fragment_defines, &dependencies);
+      dependencies.push_back(variant.vertex_filename);
+      dependencies.push_back(variant.fragment_filename);
+
+      compile(variant, vertex_sources, fragment_sources, target);
+      m_reloads += 1;
+
+      // the contents changed and with them the key
+      m_programs.erase(key);
+      m_programs[make_key(variant, vertex_sources, fragment_sources)] = Entry{ target, variant, watch(dependencies) };
+    }
+    catch(const std::exception& err)
+    {
+      log_error("ProgramCache: reload failed, keeping the old program: %s", err.what());
+    }
+  }
+}
+
+ProgramPtr
+ProgramCache::load_binary(const boost::filesystem::path& filename, uint64_t hash)
+{
+  std::ifstream in(filename.string(), std::ios::binary);
+  if (!in)
+  {
+    return {};
+  }
+
+  BinaryHeader header;
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      !std::equal(binary_magic, binary_magic + sizeof(binary_magic), header.magic) ||
+      header.hash != hash)
+  {
+    log_warn("%s: not a program binary, ignoring", filename.string());
+    return {};
+  }
+
+  std::vector<char> binary(header.size);
+  if (!in.read(binary.data(), binary.size()))
+  {
+    log_warn("%s: truncated program binary, ignoring", filename.string());
+    return {};
+  }
+
+  ProgramPtr program = Program::from_binary(header.format, binary);
+  if (!program)
+  {
+    m_binary_rejects += 1;
+    log_warn("%s: program binary rejected by driver, recompiling", filename.string());
+  }
+  return program;
+}
+
+void
+ProgramCache::save_binary(const boost::filesystem::path& filename, uint64_t hash, const Program& program)
+{
+  BinaryHeader header;
+  std::vector<char> binary;
+  GLenum binary_format = 0;
+  if (!program.get_binary(binary_format, binary))
+  {
+    return;
+  }
+
+  std::copy(binary_magic, binary_magic + sizeof(binary_magic), header.magic);
+  header.hash = hash;
+  header.format = binary_format;
+  header.size = static_cast<uint32_t>(binary.size());
+
+  // a failed write only costs a recompile in the next run
+  try
+  {
+    boost::filesystem::create_directories(filename.parent_path());
+
+    // write to a temporary file first, so that a concurrent or aborted
+    // run never sees a half written binary, the name is unique to this
+    // process as other viewer instances may be saving the same program
+    boost::filesystem::path tmp_filename = filename;
+    tmp_filename += format(".%d.%s.tmp", getpid(), std::this_thread::get_id());
+    {
+      std::ofstream out(tmp_filename.string(), std::ios::binary);
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.write(binary.data(), binary.size());
+      if (!out)
+      {
+        throw std::runtime_error(format("%s: write error", tmp_filename.string()));
+      }
+    }
+    boost::filesystem::rename(tmp_filename, filename);
+  }
+  catch(const std::exception& err)
+  {
+    log_warn("couldn't save program binary: %s", err.what());
+  }
+}
+
+void
+ProgramCache::log_stats() const
+{
+  log_info("ProgramCache: %d hits, %d misses, %d reloads", m_hits, m_misses, m_reloads);
+  log_info("ProgramCache: cold: %d programs compiled, %.3fs summed from submit to ready, warm: %d loaded from binary in %.3fs, %d rejected",
+           m_compiles, m_compile_time, m_binary_loads, m_binary_load_time, m_binary_rejects);
+}
+
+/* EOF */
@@ -0,0 +1,179 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_PROGRAM_CACHE_HPP
+#define HEADER_PROGRAM_CACHE_HPP
+
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "program.hpp"
+
+/** Process wide cache of linked Programs. Two requests share a
+    Program when they use the same stage files with the same
+    include-expanded content and the same set of defines, the order
+    of the defines doesn't matter. Programs are held weakly and
+    deleted once the last user is gone. Render thread only.
+
+    Linked programs are additionally saved to disk with
+    glGetProgramBinary(), keyed by the preprocessed sources and the
+    GL vendor, renderer and version, so that later runs skip compiling
+    and linking. A binary the driver rejects is replaced by a fresh
+    compile.
+
+    The stage files and their #includes are watched, a program whose
+    sources change is recompiled in the background and swapped in
+    place once linked, a broken edit keeps the old program.
+
+    Compiles don't block: create() returns a Program whose link may
+    still be running in the driver, Material::apply() finish()es it on
+    first use. update() polls the outstanding links between frames. */
+class ProgramCache
+{
+public:
+  struct Variant
+  {
+    std::string vertex_filename;
+    std::vector<std::string> vertex_defines;
+    std::string fragment_filename;
+    std::vector<std::string> fragment_defines;
+  };
+
+public:
+  static ProgramCache& get()
+  {
+    static ProgramCache instance;
+    return instance;
+  }
+
+private:
+  struct Entry
+  {
+    std::weak_ptr<Program> program;
+    Variant variant;
+
+    /** Canonical paths of the stage files and their #includes */
+    std::vector<std::string> dependencies;
+  };
+
+  struct PendingLink
+  {
+    std::weak_ptr<Program> program;
+
+    /** Set when reloading, swapped into program once linked */
+    ProgramPtr replacement;
+
+    std::chrono::steady_clock::time_point start;
+    boost::filesystem::path binary_filename;
+    uint64_t hash;
+  };
+
+private:
+  std::unordered_map<std::string, Entry> m_programs;
+
+  /** Links submitted to the driver that update() hasn't seen
+      finishing yet */
+  std::vector<PendingLink> m_pending;
+
+  /** Programs from prewarm(), kept alive until shutdown */
+  std::vector<ProgramPtr> m_prewarmed;
+
+  /** Directory of the on-disk binary cache, empty to disable it */
+  boost::filesystem::path m_directory;
+
+  /** GL_VENDOR, GL_RENDERER and GL_VERSION, filled on first use */
+  std::string m_driver;
+
+  int m_hits;
+  int m_misses;
+
+  int m_compiles;
+  int m_binary_loads;
+  int m_binary_rejects;
+  float m_compile_time;
+  float m_binary_load_time;
+
+  /** Files registered with the FileWatcher */
+  std::unordered_set<std::string> m_watched;
+  int m_reloads;
+
+public:
+  ProgramCache();
+
+  ProgramPtr create(const std::string& vertex_filename,
+                    const std::string& fragment_filename);
+  ProgramPtr create(const std::string& vertex_filename,
+                    std::vector<std::string> const& vertex_defines,
+                    const std::string& fragment_filename,
+                    std::vector<std::string> const& fragment_defines);
+
+  /** Submit all \a variants for compiling in one go, so that the
+      driver can work on them in parallel before they are needed */
+  void prewarm(std::vector<Variant> const& variants);
+
+  /** Collect finished links and save their binaries, call once per
+      frame outside of rendering */
+  void update();
+
+  /** True while submitted programs are still compiling */
+  bool is_busy() const { return !m_pending.empty(); }
+
+  int get_hits() const { return m_hits; }
+  int get_misses() const { return m_misses; }
+  int get_binary_loads() const { return m_binary_loads; }
+
+  void set_directory(const boost::filesystem::path& directory) { m_directory = directory; }
+  const boost::filesystem::path& get_directory() const { return m_directory; }
+
+  void log_stats() const;
+
+private:
+  std::string make_key(const Variant& variant,
+                       std::vector<std::string> const& vertex_sources,
+                       std::vector<std::string> const& fragment_sources) const;
+
+  /** Load the program from its binary or submit it for compiling, when
+      \a target is given the result replaces it once linked */
+  ProgramPtr compile(const Variant& variant,
+                     std::vector<std::string> const& vertex_sources,
+                     std::vector<std::string> const& fragment_sources,
+                     ProgramPtr target = {});
+
+  /** Register \a filenames with the FileWatcher, returns their
+      canonical paths */
+  std::vector<std::string> watch(std::vector<std::string> const& filenames);
+
+  /** Recompile all programs depending on \a filename, the old
+      programs stay in use until the new ones are linked */
+  void reload(const std::string& filename);
+
+  ProgramPtr load_binary(const boost::filesystem::path& filename, uint64_t hash);
+  void save_binary(const boost::filesystem::path& filename, uint64_t hash, const Program& program);
+
+private:
+  ProgramCache(const ProgramCache&) = delete;
+  ProgramCache& operator=(const ProgramCache&) = delete;
+};
+
+#endif
+
+/* EOF */
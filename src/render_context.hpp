@@ -16,6 +16,8 @@ private:
   MaterialPtr m_override_material;
   Stereo m_stero;
   TexturePtr m_video_texture;
+  glm::mat4 m_vertex_transform;
+  int m_viewport_height;
 
 public:
   RenderContext(Camera const& camera,
@@ -24,7 +26,10 @@ public:
     m_node(node),
     m_geometry_pass(false),
     m_override_material(),
-    m_stero(Stereo::Center)
+    m_stero(Stereo::Center),
+    m_video_texture(),
+    m_vertex_transform(1.0f),
+    m_viewport_height(0)
   {
   }
 
@@ -33,16 +38,45 @@ public:
     return m_camera.get_view_matrix();
   }
 
+  /** Transform of the vertices as stored in the Mesh, includes the
+      dequantization of quantized positions */
   glm::mat4 get_model_matrix() const
+  {
+    return m_node->get_transform() * m_vertex_transform;
+  }
+
+  /** Transform of the SceneNode alone, for the normals */
+  glm::mat4 get_node_matrix() const
   {
     return m_node->get_transform();
   }
 
+  void set_vertex_transform(glm::mat4 const& transform)
+  {
+    m_vertex_transform = transform;
+  }
+
+  glm::mat4 const& get_vertex_transform() const
+  {
+    return m_vertex_transform;
+  }
+
   glm::mat4 get_projection_matrix() const
   {
     return m_camera.get_projection_matrix();
   }
 
+  /** In pixels, to turn errors into pixels, 0 if unknown */
+  void set_viewport_height(int height)
+  {
+    m_viewport_height = height;
+  }
+
+  int get_viewport_height() const
+  {
+    return m_viewport_height;
+  }
+
   void set_geometry_pass()
   {
     m_geometry_pass = true;
@@ -0,0 +1,91 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_RENDER_STATS_HPP
+#define HEADER_RENDER_STATS_HPP
+
+#include <algorithm>
+
+/** Counters of what got handed to OpenGL, they keep adding up until
+    whoever reports them calls reset() */
+class RenderStats
+{
+public:
+  static RenderStats& get()
+  {
+    static RenderStats instance;
+    return instance;
+  }
+
+  /** The passes SceneManager::render() counts nodes for */
+  enum Pass { ShadowPass, CenterPass, LeftPass, RightPass, PassCount };
+
+  static const char* get_pass_name(int pass)
+  {
+    static const char* names[PassCount] = { "shadow", "center", "left", "right" };
+    return names[pass];
+  }
+
+public:
+  int draw_calls;
+  long triangles;
+
+  /** SceneNodes that passed and failed the frustum test, for the world
+      the nodes with models in the Bvh, for the view the children of a
+      culled node are not counted */
+  int drawn_nodes[PassCount];
+  int culled_nodes[PassCount];
+
+  /** SceneNodes tested against the OcclusionBuffer and found hidden,
+      the microseconds the threads spent on it and the main thread
+      spent waiting for them */
+  int occlusion_tested;
+  int occlusion_culled;
+  long occlusion_cpu_us;
+  long occlusion_wait_us;
+
+public:
+  RenderStats() :
+    draw_calls(0),
+    triangles(0),
+    drawn_nodes(),
+    culled_nodes(),
+    occlusion_tested(0),
+    occlusion_culled(0),
+    occlusion_cpu_us(0),
+    occlusion_wait_us(0)
+  {}
+
+  void reset()
+  {
+    draw_calls = 0;
+    triangles = 0;
+    std::fill(drawn_nodes, drawn_nodes + PassCount, 0);
+    std::fill(culled_nodes, culled_nodes + PassCount, 0);
+    occlusion_tested = 0;
+    occlusion_culled = 0;
+    occlusion_cpu_us = 0;
+    occlusion_wait_us = 0;
+  }
+
+private:
+  RenderStats(const RenderStats&) = delete;
+  RenderStats& operator=(const RenderStats&) = delete;
+};
+
+#endif
+
+/* EOF */
@@ -1,30 +1,359 @@
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/format.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/tokenizer.hpp>
-#include <fstream>
+#include <chrono>
+#include <iterator>
 #include <stdexcept>
 
+#include "asset_loader.hpp"
+#include "file_watcher.hpp"
+#include "gpu_buffer_arena.hpp"
+#include "log.hpp"
+#include "mesh_cluster.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
 #include "scene_node.hpp"
 #include "material_factory.hpp"
+#include "mod_parser.hpp"
+#include "occlusion_buffer.hpp"
+#include "scene_cache.hpp"
+#include "vertex_quantizer.hpp"
 
 #include "scene.hpp"
 
-std::unique_ptr<SceneNode>
-Scene::from_file(const std::string& filename)
+/** What Scene derives from a ModObject at load time, on top of the
+    parsed data, before it is turned into Meshes */
+struct ModObjectDetail
+{
+  ModObjectDetail() :
+    cluster(),
+    lod_index(),
+    lod()
+  {}
+
+  /** Spatial clusters of the triangles as ranges of ModObject::index */
+  std::vector<MeshCluster> cluster;
+
+  /** Simplified versions of the triangles as ranges of lod_index */
+  std::vector<int> lod_index;
+  std::vector<MeshLod> lod;
+};
+
+namespace {
+
+/** Weld the vertices of \a obj, group its triangles into clusters,
+    reorder them and the vertices for the vertex caches and build the
+    LOD levels into \a detail, returns false when the arrays don't
+    line up */
+bool optimize_object(ModObject& obj, ModObjectDetail& detail)
 {
-  std::ifstream in(filename.c_str());
-  if(!in)
+  const size_t count = obj.position.size();
+
+  if (count == 0 || obj.index.empty() ||
+      obj.normal.size() != count ||
+      obj.bone_weight.size() != obj.bone_index.size() ||
+      (!obj.bone_weight.empty() && obj.bone_weight.size() != count))
+  {
+    return false;
+  }
+
+  for(int index : obj.index)
+  {
+    if (index < 0 || static_cast<size_t>(index) >= count)
+    {
+      return false;
+    }
+  }
+
+  if (obj.texcoord.size() < count)
+  {
+    obj.texcoord.resize(count, glm::vec3(0.0f, 0.0f, 0.0f));
+  }
+
+  std::vector<VertexSource> sources = {
+    { "position", obj.position }, { "normal", obj.normal }, { "texcoord", obj.texcoord }
+  };
+  if (!obj.bone_weight.empty())
   {
-    throw std::runtime_error(format("%s: File not found", filename));
+    sources.emplace_back("bone_weight", obj.bone_weight);
+    sources.emplace_back("bone_index", obj.bone_index);
+  }
+
+  // the exporter writes one vertex per face corner
+  std::vector<int> remap;
+  const int unique = MeshOptimizer::weld(sources, remap);
+  for(int& index : obj.index)
+  {
+    index = remap[index];
+  }
+
+  if (obj.bone_weight.empty())
+  {
+    std::vector<glm::vec3> welded = MeshOptimizer::remap_vertices(obj.position, remap, unique);
+    detail.cluster = MeshOptimizer::build_clusters(obj.index, welded);
   }
   else
   {
-    Scene scene;
-    scene.set_directory(boost::filesystem::path(filename).parent_path());
-    scene.parse_istream(in);
-    return scene.get_node();
+    // skinned vertices move away from any bounds computed here
+    detail.cluster.clear();
+    MeshOptimizer::optimize_vertex_cache(obj.index, unique);
+  }
+
+  std::vector<int> fetch_remap;
+  const int used = MeshOptimizer::optimize_vertex_fetch(obj.index, unique, fetch_remap);
+  for(int& r : remap)
+  {
+    r = fetch_remap[r];
   }
+
+  obj.position = MeshOptimizer::remap_vertices(obj.position, remap, used);
+  obj.normal = MeshOptimizer::remap_vertices(obj.normal, remap, used);
+  obj.texcoord = MeshOptimizer::remap_vertices(obj.texcoord, remap, used);
+  if (!obj.bone_weight.empty())
+  {
+    obj.bone_weight = MeshOptimizer::remap_vertices(obj.bone_weight, remap, used);
+    obj.bone_index = MeshOptimizer::remap_vertices(obj.bone_index, remap, used);
+  }
+
+  detail.lod_index.clear();
+  detail.lod.clear();
+  if (!detail.cluster.empty())
+  {
+    detail.lod = MeshSimplifier::build_lods(obj.index, obj.position, detail.lod_index);
+  }
+
+  return true;
+}
+
+/** Objects with more triangles cost more to draw into the
+    OcclusionBuffer than they are likely to save */
+const int occluder_max_triangles = 2048;
+
+/** Objects need to extend this far along two axes to hide much */
+const float occluder_min_size = 0.5f;
+
+/** Skinned vertices move away from the stored positions, objects
+    with many triangles aren't worth drawing into the OcclusionBuffer */
+bool is_occluder_candidate(const ModObject& obj)
+{
+  return obj.bone_index.empty() && obj.index.size() / 3 <= static_cast<size_t>(occluder_max_triangles);
+}
+
+/** The triangles of \a obj for the OcclusionBuffer, if it is large
+    enough and cheap enough to be worth it. The .mod format has no way
+    to mark occluders, so this is all guesswork. */
+std::shared_ptr<const OccluderMesh> create_occluder(const SceneCacheObject& obj)
+{
+  if (obj.occluder_position.count == 0)
+  {
+    return {};
+  }
+
+  const glm::vec3* positions = static_cast<const glm::vec3*>(obj.occluder_position.data);
+  BoundingBox box;
+  for(int i = 0; i < obj.occluder_position.count; ++i)
+  {
+    box.add(positions[i]);
+  }
+
+  glm::vec3 size = (box.max - box.min) * glm::abs(obj.scale);
+  int large = (size.x >= occluder_min_size) + (size.y >= occluder_min_size) + (size.z >= occluder_min_size);
+  if (large < 2)
+  {
+    return {};
+  }
+  else
+  {
+    auto occluder = std::make_shared<OccluderMesh>();
+    occluder->positions.assign(positions, positions + obj.occluder_position.count);
+    const int* indices = static_cast<const int*>(obj.occluder_index.data);
+    occluder->indices.assign(indices, indices + obj.occluder_index.count);
+    return occluder;
+  }
+}
+
+/** Optimize all \a objects in place, returns the clusters and LOD
+    levels of each */
+std::vector<ModObjectDetail> optimize_objects(std::vector<ModObject>& objects, const std::string& filename)
+{
+  std::vector<ModObjectDetail> details(objects.size());
+
+  size_t vertices_before = 0;
+  size_t vertices_after = 0;
+  float misses_before = 0.0f;
+  float misses_after = 0.0f;
+  size_t triangles = 0;
+  size_t clusters = 0;
+  size_t lods = 0;
+
+  for(size_t idx = 0; idx < objects.size(); ++idx)
+  {
+    ModObject& obj = objects[idx];
+    ModObjectDetail& detail = details[idx];
+    const size_t count = obj.position.size();
+    const float acmr = MeshOptimizer::get_acmr(obj.index);
+    if (optimize_object(obj, detail))
+    {
+      vertices_before += count;
+      vertices_after += obj.position.size();
+      misses_before += acmr * (obj.index.size() / 3);
+      misses_after += MeshOptimizer::get_acmr(obj.index) * (obj.index.size() / 3);
+      triangles += obj.index.size() / 3;
+      clusters += detail.cluster.size();
+      lods += detail.lod.size();
+    }
+  }
+
+  if (triangles != 0)
+  {
+    log_info("%s: welded %d to %d vertices, ACMR %.3f to %.3f, %d triangles in %d clusters, %d LOD levels",
+             filename, vertices_before, vertices_after,
+             misses_before / triangles, misses_after / triangles,
+             triangles, clusters, lods);
+    for(size_t idx = 0; idx < objects.size(); ++idx)
+    {
+      for(auto const& lod : details[idx].lod)
+      {
+        log_debug("%s: LOD with %d triangles, error %.3f", objects[idx].name, lod.count / 3, lod.error);
+      }
+    }
+  }
+
+  return details;
+}
+
+/** Compact \a arena when much of its free space is unusable for
+    larger allocations */
+void compact_arena(const char* name, GpuBufferArena& arena)
+{
+  GpuBufferArena::Stats stats = arena.get_stats();
+  if (stats.get_fragmentation() > 0.5f)
+  {
+    arena.compact();
+    GpuBufferArena::Stats compacted = arena.get_stats();
+    log_info("%s arena: compacted from %d to %d blocks, fragmentation %.2f to %.2f",
+             name, stats.blocks, compacted.blocks, stats.get_fragmentation(), compacted.get_fragmentation());
+  }
+  else
+  {
+    log_info("%s arena: %d allocations, %d of %d bytes in %d blocks, fragmentation %.2f",
+             name, stats.allocations, stats.used, stats.capacity, stats.blocks, stats.get_fragmentation());
+  }
+}
+
+} // namespace
+
+/** The objects of a .mod file, either mapped from its .modc cache or
+    freshly parsed, in both cases seen through SceneCacheObject */
+struct Scene::Source
+{
+  std::unique_ptr<SceneCache> cache;
+  std::vector<ModObject> parsed;
+
+  /** Clusters and LOD levels of each parsed object, empty for objects
+      that didn't go through optimize_objects() */
+  std::vector<ModObjectDetail> details;
+
+  /** The parts of each parsed object, ready for the GPU */
+  std::vector<std::vector<MeshData> > prepared;
+
+  std::vector<SceneCacheObject> objects;
+
+  /** Content hash of each object, filled by hash_objects() */
+  std::vector<uint64_t> hashes;
+
+  Source(std::unique_ptr<SceneCache> cache_) :
+    cache(std::move(cache_)),
+    parsed(),
+    details(),
+    prepared(),
+    objects(cache->get_objects()),
+    hashes()
+  {}
+
+  Source(std::vector<ModObject> parsed_, std::vector<ModObjectDetail> details_ = {}) :
+    cache(),
+    parsed(std::move(parsed_)),
+    details(std::move(details_)),
+    prepared(),
+    objects(),
+    hashes()
+  {
+    details.resize(parsed.size());
+    for(size_t idx = 0; idx < parsed.size(); ++idx)
+    {
+      ModObject& obj = parsed[idx];
+
+      // fill in some texcoords if there aren't enough
+      if (!obj.position.empty() && obj.texcoord.size() < obj.position.size())
+      {
+        obj.texcoord.resize(obj.position.size());
+        for(FaceLst::size_type i = obj.position.size()-1; i < obj.texcoord.size(); ++i)
+        {
+          obj.texcoord[i] = glm::vec3(0.0f, 0.0f, 0.0f);
+        }
+      }
+
+      prepared.push_back(prepare_meshes(obj, details[idx]));
+
+      SceneCacheObject view{
+        obj.name, obj.parent, obj.material,
+        obj.location, obj.rotation, obj.scale,
+        {}, {}, {} };
+      for(auto const& mesh : prepared.back())
+      {
+        view.meshes.push_back(mesh.get_ref());
+      }
+      if (is_occluder_candidate(obj))
+      {
+        view.occluder_position = array(obj.position);
+        view.occluder_index = array(obj.index);
+      }
+      objects.push_back(view);
+    }
+  }
+
+  template<typename T>
+  static SceneCacheArray array(const std::vector<T>& data)
+  {
+    return SceneCacheArray{ data.data(), static_cast<int>(data.size()) };
+  }
+
+  /** Slow, call from the ThreadPool */
+  void hash_objects()
+  {
+    hashes.clear();
+    for(auto const& obj : objects)
+    {
+      uint64_t hash = 14695981039346656037ull;
+      hash = hash_bytes(hash, obj.material.data(), obj.material.size());
+      for(auto const& mesh : obj.meshes)
+      {
+        hash = hash_bytes(hash, mesh.vertices, static_cast<size_t>(mesh.vertex_count) * mesh.format.get_stride());
+        hash = hash_bytes(hash, mesh.indices, mesh.index_count * sizeof(uint16_t));
+      }
+      hashes.push_back(hash);
+    }
+  }
+
+  /** FNV-1a */
+  static uint64_t hash_bytes(uint64_t hash, const void* data, size_t len)
+  {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for(const unsigned char* end = p + len; p != end; ++p)
+    {
+      hash ^= *p;
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+};
+
+std::unique_ptr<SceneNode>
+Scene::from_file(const std::string& filename)
+{
+  Scene scene;
+  scene.set_directory(boost::filesystem::path(filename).parent_path());
+  scene.parse_file(filename);
+  return scene.get_node();
 }
 
 std::unique_ptr<SceneNode>
@@ -34,13 +363,168 @@ Scene::from_istream(std::istream& in)
   scene.parse_istream(in);
   return scene.get_node();
 }
+
+std::unique_ptr<SceneNode>
+Scene::from_file_async(const std::string& filename, AssetLoader& loader)
+{
+  auto scene = std::make_shared<Scene>();
+  scene->set_directory(boost::filesystem::path(filename).parent_path());
+  std::unique_ptr<SceneNode> node = scene->get_node();
+
+  FileWatcher::get().watch(filename, [scene, filename, &loader](const std::string&) {
+      reload(scene, filename, loader);
+    });
+
+  loader.load(
+    [filename]{
+      std::shared_ptr<Source> source = load_source(filename);
+      source->hash_objects();
+      return source;
+    },
+    [scene, &loader](std::shared_ptr<Source> source) {
+      scene->build_nodes(*source);
+
+      // geometry goes first, drawn with the placeholder, the real
+      // materials get queued behind all the meshes
+      for(size_t idx = 0; idx < source->objects.size(); ++idx)
+      {
+        loader.upload([scene, source, idx, &loader]{
+            ModelPtr model = scene->build_model(*source, idx, loader.get_placeholder_material());
+            if (model)
+            {
+              loader.upload([scene, source, idx, model, &loader]{
+                  MaterialPtr material = scene->create_material(source->objects[idx].material.to_string());
+
+                  // keep drawing the placeholder until the driver is
+                  // done compiling, so that the first draw doesn't stall
+                  loader.poll([model, material]{
+                      ProgramPtr program = material->get_program();
+                      if (program && !program->is_ready())
+                      {
+                        return false;
+                      }
+                      else
+                      {
+                        model->set_material(material);
+                        return true;
+                      }
+                    });
+                });
+            }
+          });
+      }
+    });
+
+  return node;
+}
+
+void
+Scene::reload(std::shared_ptr<Scene> scene, const std::string& filename, AssetLoader& loader)
+{
+  loader.load(
+    [filename]{
+      std::shared_ptr<Source> source = load_source(filename);
+      source->hash_objects();
+      return source;
+    },
+    [scene, filename, &loader](std::shared_ptr<Source> source) {
+      int changed = 0;
+      int ignored = 0;
+      for(size_t idx = 0; idx < source->objects.size(); ++idx)
+      {
+        SceneCacheObject const& obj = source->objects[idx];
+        std::string name = obj.name.to_string();
+
+        auto node = scene->m_nodes.find(name);
+        if (node == scene->m_nodes.end())
+        {
+          ignored += 1;
+        }
+        else
+        {
+          node->second->set_position(obj.location);
+          node->second->set_orientation(obj.rotation);
+          node->second->set_scale(obj.scale);
+
+          auto hash = scene->m_object_hashes.find(name);
+          if (hash == scene->m_object_hashes.end() || hash->second != source->hashes[idx])
+          {
+            changed += 1;
+            loader.upload([scene, source, idx]{
+                scene->rebuild_model(*source, idx);
+              });
+          }
+        }
+      }
+
+      log_info("%s: reloaded, %d of %d objects changed", filename, changed, source->objects.size());
+      if (ignored != 0)
+      {
+        log_warn("%s: %d new objects ignored, restart to see them", filename, ignored);
+      }
+
+      if (changed != 0)
+      {
+        // queued behind the rebuilds, which leave holes in the arenas
+        loader.upload([]{
+            compact_arena("vertex", GpuBufferArena::get_vertex_arena());
+            compact_arena("index", GpuBufferArena::get_index_arena());
+          });
+      }
+    });
+}
+
+std::shared_ptr<Scene::Source>
+Scene::load_source(const std::string& filename)
+{
+  auto start_time = std::chrono::steady_clock::now();
+
+  std::unique_ptr<SceneCache> cache = SceneCache::open(filename, use_quantized());
+  if (cache)
+  {
+    auto source = std::make_shared<Source>(std::move(cache));
+
+    std::chrono::duration<float, std::milli> duration = std::chrono::steady_clock::now() - start_time;
+    log_info("%s: loaded from %s in %.1fms (warm)",
+             filename, SceneCache::get_cache_filename(filename), duration.count());
+    return source;
+  }
+  else
+  {
+    std::vector<ModObject> objects = ModParser::from_file(filename);
+    std::vector<ModObjectDetail> details = optimize_objects(objects, filename);
+
+    auto source = std::make_shared<Source>(std::move(objects), std::move(details));
+
+    try
+    {
+      SceneCache::write(filename, source->objects, use_quantized());
+    }
+    catch(const std::exception& err)
+    {
+      log_warn("%s: couldn't write scene cache: %s", filename, err.what());
+    }
+
+    std::chrono::duration<float, std::milli> duration = std::chrono::steady_clock::now() - start_time;
+    log_info("%s: loaded in %.1fms (cold)", filename, duration.count());
+    return source;
+  }
+}
 
 Scene::Scene() :
   m_directory(),
-  m_node(std::make_unique<SceneNode>())
+  m_node(std::make_unique<SceneNode>()),
+  m_root(m_node.get()),
+  m_nodes(),
+  m_unattached_children(),
+  m_object_nodes(),
+  m_models(),
+  m_object_hashes()
 {
 }
 
+bool Scene::s_quantize_meshes = false;
+
 void
 Scene::set_directory(const boost::filesystem::path& path)
 {
@@ -50,285 +534,235 @@ Scene::set_directory(const boost::filesystem::path& path)
 void
 Scene::parse_istream(std::istream& in)
 {
-  // This is not a fully featured .obj file reader, it just takes some
-  // inspiration from it:
-  // http://www.martinreddy.net/gfx/3d/OBJ.spec
-  std::unordered_map<std::string, SceneNode*> nodes;
-  std::unordered_map<std::string, std::unique_ptr<SceneNode> > unattached_children;
-
-  std::string name;
-  std::string parent;
-  std::string material = "phong";
-  glm::vec3 location(0.0f, 0.0f, 0.0f);
-  glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
-  glm::vec3 scale(1.0f, 1.0f, 1.0f);
-  std::vector<glm::vec3>  normal;
-  std::vector<glm::vec3>  position;
-  std::vector<glm::vec3>  texcoord;
-  std::vector<int>        index;
-  std::vector<glm::vec4>  bone_weight;
-  std::vector<glm::ivec4> bone_index;
-  std::vector<int>        bone_count;
-
-  auto commit_object = [&]{
-    if (!name.empty())
+  // the same parser as for files, ModParser::from_istream() keeps the
+  // old handling of the bone data
+  std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  build(ModParser::from_memory(content.data(), content.size()));
+}
+
+void
+Scene::parse_file(const std::string& filename)
+{
+  build(*load_source(filename));
+}
+
+void
+Scene::build(std::vector<ModObject> objects)
+{
+  build(Source(std::move(objects)));
+}
+
+void
+Scene::build(const Source& source)
+{
+  build_nodes(source);
+
+  for(size_t idx = 0; idx < source.objects.size(); ++idx)
+  {
+    if (!source.objects[idx].meshes.empty())
     {
-      ModelPtr model;
+      build_model(source, idx, create_material(source.objects[idx].material.to_string()));
+    }
+  }
+}
 
-      if (!position.empty())
-      {
-        // fill in some texcoords if there aren't enough
-        if (texcoord.size() < position.size())
-        {
-          texcoord.resize(position.size());
-          for(FaceLst::size_type i = position.size()-1; i < texcoord.size(); ++i)
-          {
-            texcoord[i] = glm::vec3(0.0f, 0.0f, 0.0f);
-          }
-        }
+void
+Scene::build_nodes(const Source& source)
+{
+  for(auto const& obj : source.objects)
+  {
+    m_object_nodes.push_back(add_node(obj.name.to_string(), obj.parent.to_string(),
+                                      obj.location, obj.rotation, obj.scale));
+  }
 
-        {
-          // create Mesh
-          std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(GL_TRIANGLES);
+  link_nodes();
+}
 
-          mesh->attach_float_array("position", position);
-          mesh->attach_float_array("texcoord", texcoord);
-          mesh->attach_float_array("normal",   normal);
-          mesh->attach_element_array(index);
+ModelPtr
+Scene::build_model(const Source& source, size_t idx, MaterialPtr material)
+{
+  SceneCacheObject const& obj = source.objects[idx];
 
-          if (!bone_weight.empty() && !bone_index.empty())
-          {
-            mesh->attach_float_array("bone_weight", bone_weight);
-            mesh->attach_int_array("bone_index", bone_index);
-          }
+  if (!source.hashes.empty())
+  {
+    m_object_hashes[obj.name.to_string()] = source.hashes[idx];
+  }
 
-          // create Model
-          model = std::make_shared<Model>();
-          model->add_mesh(std::move(mesh));
+  if (obj.meshes.empty())
+  {
+    return {};
+  }
+  else
+  {
+    ModelPtr model = std::make_shared<Model>();
+    for(auto& mesh : create_meshes(obj))
+    {
+      model->add_mesh(std::move(mesh));
+    }
+    model->set_material(material);
+    model->set_occluder(create_occluder(obj));
 
-          if (boost::algorithm::ends_with(material, ".material"))
-          {
-            model->set_material(MaterialFactory::get().from_file(m_directory / boost::filesystem::path(material)));
-          }
-          else
-          {
-            model->set_material(MaterialFactory::get().create(material));
-          }
-        }
-      }
+    m_object_nodes[idx]->attach_model(model);
+    m_models[obj.name.to_string()] = model;
 
-      // create SceneNode
-      {
-        std::unique_ptr<SceneNode> node = std::make_unique<SceneNode>(name);
-        node->set_position(location);
-        node->set_orientation(rotation);
-        node->set_scale(scale);
+    return model;
+  }
+}
 
-        if (model)
-        {
-          node->attach_model(model);
-        }
+void
+Scene::rebuild_model(const Source& source, size_t idx)
+{
+  SceneCacheObject const& obj = source.objects[idx];
+  std::string name = obj.name.to_string();
 
-        if (nodes.find(name) != nodes.end())
-        {
-          throw std::runtime_error("duplicate object name: " + name);
-        }
+  m_object_hashes[name] = source.hashes[idx];
 
-        nodes[name] = node.get();
-        if (parent.empty())
-        {
-          m_node->attach_child(std::move(node));
-        }
-        else
-        {
-          unattached_children[parent] = std::move(node);
-        }
+  auto it = m_models.find(name);
+  if (it == m_models.end())
+  {
+    if (!obj.meshes.empty())
+    {
+      ModelPtr model = std::make_shared<Model>();
+      for(auto& mesh : create_meshes(obj))
+      {
+        model->add_mesh(std::move(mesh));
       }
+      model->set_material(create_material(obj.material.to_string()));
+      model->set_occluder(create_occluder(obj));
 
-      // clear for the next mesh
-      name.clear();
-      parent.clear();
-      normal.clear();
-      texcoord.clear();
-      position.clear();
-      index.clear();
-      location = glm::vec3(0.0f, 0.0f, 0.0f);
-      rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
-      scale = glm::vec3(1.0f, 1.0f, 1.0f);
+      m_nodes[name]->attach_model(model);
+      m_models[name] = model;
     }
-  };
+  }
+  else
+  {
+    // the old buffers are freed right here, the Model stays in place
+    it->second->clear_meshes();
+    for(auto& mesh : create_meshes(obj))
+    {
+      it->second->add_mesh(std::move(mesh));
+    }
+    it->second->set_material(create_material(obj.material.to_string()));
+    it->second->set_occluder(create_occluder(obj));
+
+    // the bounds changed along with the meshes
+    m_nodes[name]->invalidate();
+  }
+}
+
+bool
+Scene::use_quantized()
+{
+#ifndef HAVE_OPENGLES2
+  return s_quantize_meshes;
+#else
+  // the packed formats aren't available
+  return false;
+#endif
+}
 
-  std::string line;
-  int line_number = 0;
-  while(std::getline(in, line))
+std::vector<MeshData>
+Scene::prepare_meshes(const ModObject& obj, const ModObjectDetail& detail)
+{
+  if (obj.position.empty())
   {
-    line_number += 1;
+    return {};
+  }
 
-    boost::tokenizer<boost::char_separator<char> > tokens(line, boost::char_separator<char>(" ", ""));
-    auto it = tokens.begin();
-    if (it != tokens.end())
-    {
-#define INCR_AND_CHECK {                                                \
-        ++it;                                                           \
-        if (it == tokens.end())                                         \
-        {                                                               \
-          throw std::runtime_error((boost::format("not enough tokens at line %d") % line_number).str()); \
-        }                                                               \
-      }
+  // the per-attribute arrays from the parser get interleaved, or
+  // quantized, into a single vertex buffer
+  std::vector<VertexSource> sources = {
+    { "position", obj.position }, { "normal", obj.normal }, { "texcoord", obj.texcoord }
+  };
 
-      try
-      {
-        if (*it == "o")
-        {
-          // object
-          commit_object();
+  if (!obj.bone_weight.empty() && !obj.bone_index.empty())
+  {
+    sources.emplace_back("bone_weight", obj.bone_weight);
+    sources.emplace_back("bone_index", obj.bone_index);
+  }
 
-          INCR_AND_CHECK;
-          log_debug("object: '%s'", *it);
-          name = *it;
-        }
-        else if (*it == "g")
-        {
-          // group
-        }
-        else if (*it == "parent")
-        {
-          INCR_AND_CHECK;
-          parent = *it;
-        }
-        else if (*it == "mat")
-        {
-          INCR_AND_CHECK;
-          material = *it;
-        }
-        else if (*it == "loc")
-        {
-          INCR_AND_CHECK;
-          location.x = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          location.y = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          location.z = boost::lexical_cast<float>(*it);
-        }
-        else if (*it == "rot")
-        {
-          INCR_AND_CHECK;
-          rotation.w = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          rotation.x = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          rotation.y = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          rotation.z = boost::lexical_cast<float>(*it);
-        }
-        else if (*it == "scale")
-        {
-          INCR_AND_CHECK;
-          scale.x = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          scale.y = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          scale.z = boost::lexical_cast<float>(*it);
-        }
-        else if (*it == "v")
-        {
-          glm::vec3 v;
+  const bool quantize = use_quantized();
+  VertexData vertices = quantize ?
+    VertexQuantizer::quantize(sources) :
+    VertexData::interleave(sources);
 
-          INCR_AND_CHECK;
-          v.x = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          v.y = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          v.z = boost::lexical_cast<float>(*it);
+  if (quantize)
+  {
+    size_t float_bytes = 0;
+    for(auto const& source : sources)
+    {
+      float_bytes += static_cast<size_t>(source.size) * 4 * source.count;
+    }
+    log_debug("%s: quantized %d vertex bytes to %d", obj.name, float_bytes, vertices.data.size());
+  }
 
-          position.push_back(v);
-        }
-        else if (*it == "vt")
-        {
-          glm::vec3 vt;
+  // the parts all share the quantization of the whole object, so no
+  // cracks open up along their seams
+  return Mesh::prepare_indexed(vertices, obj.index.data(), static_cast<int>(obj.index.size()),
+                               detail.cluster.data(), static_cast<int>(detail.cluster.size()),
+                               detail.lod_index.data(), static_cast<int>(detail.lod_index.size()),
+                               detail.lod.data(), static_cast<int>(detail.lod.size()));
+}
 
-          INCR_AND_CHECK;
-          vt.s = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          vt.t = boost::lexical_cast<float>(*it);
+std::vector<std::unique_ptr<Mesh> >
+Scene::create_meshes(const SceneCacheObject& obj)
+{
+  std::vector<std::unique_ptr<Mesh> > meshes;
+  for(auto const& mesh : obj.meshes)
+  {
+    meshes.push_back(Mesh::create(mesh));
+  }
+  return meshes;
+}
 
-          texcoord.push_back(vt);
-        }
-        else if (*it == "vn")
-        {
-          glm::vec3 vn;
+MaterialPtr
+Scene::create_material(const std::string& name)
+{
+  if (boost::algorithm::ends_with(name, ".material"))
+  {
+    return MaterialFactory::get().from_file(m_directory / boost::filesystem::path(name));
+  }
+  else
+  {
+    return MaterialFactory::get().create(name);
+  }
+}
 
-          INCR_AND_CHECK;
-          vn.x = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          vn.y = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          vn.z = boost::lexical_cast<float>(*it);
+SceneNode*
+Scene::add_node(const std::string& name, const std::string& parent,
+                const glm::vec3& location, const glm::quat& rotation, const glm::vec3& scale)
+{
+  std::unique_ptr<SceneNode> node = std::make_unique<SceneNode>(name);
+  node->set_position(location);
+  node->set_orientation(rotation);
+  node->set_scale(scale);
 
-          normal.push_back(vn);
-        }
-        else if (*it == "bw")
-        {
-          glm::vec4 bw;
-
-          INCR_AND_CHECK;
-          bw.x = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          bw.y = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          bw.z = boost::lexical_cast<float>(*it);
-          INCR_AND_CHECK;
-          bw.w = boost::lexical_cast<float>(*it);
-
-          bone_weight.push_back(bw);
-        }
-        else if (*it == "bi")
-        {
-          glm::ivec4 bi;
-
-          INCR_AND_CHECK;
-          bi.x = boost::lexical_cast<int>(*it);
-          INCR_AND_CHECK;
-          bi.y = boost::lexical_cast<int>(*it);
-          INCR_AND_CHECK;
-          bi.z = boost::lexical_cast<int>(*it);
-          INCR_AND_CHECK;
-          bi.w = boost::lexical_cast<int>(*it);
-
-          bone_index.push_back(bi);
-        }
-        else if (*it == "f")
-        {
-          INCR_AND_CHECK;
-          index.push_back(boost::lexical_cast<int>(*it));
-          INCR_AND_CHECK;
-          index.push_back(boost::lexical_cast<int>(*it));
-          INCR_AND_CHECK;
-          index.push_back(boost::lexical_cast<int>(*it));
-        }
-        else if ((*it)[0] == '#')
-        {
-          // ignore comments
-        }
-        else
-        {
-          throw std::runtime_error((boost::format("unhandled token %s") % *it).str());
-        }
-      }
-      catch(const std::exception& err)
-      {
-        throw std::runtime_error((boost::format("unknown:%d: %s") % line_number % err.what()).str());
-      }
-    }
+  if (m_nodes.find(name) != m_nodes.end())
+  {
+    throw std::runtime_error("duplicate object name: " + name);
   }
 
-  commit_object();
+  SceneNode* result = node.get();
+  m_nodes[name] = result;
+  if (parent.empty())
+  {
+    m_root->attach_child(std::move(node));
+  }
+  else
+  {
+    m_unattached_children.emplace_back(parent, std::move(node));
+  }
+  return result;
+}
 
+void
+Scene::link_nodes()
+{
   // reconstruct parent/child relationships
-  for(auto& it : unattached_children)
+  for(auto& it : m_unattached_children)
   {
-    auto p = nodes.find(it.first);
-    if (p == nodes.end())
+    auto p = m_nodes.find(it.first);
+    if (p == m_nodes.end())
     {
       throw std::runtime_error("parent not found: " + it.first);
     }
@@ -337,6 +771,7 @@ Scene::parse_istream(std::istream& in)
       p->second->attach_child(std::move(it.second));
     }
   }
+  m_unattached_children.clear();
 }
 
 std::unique_ptr<SceneNode>
@@ -2,10 +2,21 @@
 #define HEADER_SCENE_HPP
 
 #include <iostream>
+#include <memory>
+#include <stdint.h>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <boost/filesystem/path.hpp>
 
+#include "model.hpp"
+
+class AssetLoader;
 class SceneNode;
+struct ModObject;
+struct ModObjectDetail;
+struct SceneCacheObject;
 
 class Scene
 {
@@ -13,17 +24,93 @@ public:
   static std::unique_ptr<SceneNode> from_istream(std::istream& in);
   static std::unique_ptr<SceneNode> from_file(const std::string& filename);
 
+  /** Returns an empty SceneNode right away, parsing happens on the
+      ThreadPool and the children, Meshes and Materials get filled in
+      by \a loader later on. Until its Material is loaded a Model is
+      drawn with the loaders placeholder material. The file is watched
+      for changes and objects whose data changed get their Mesh
+      rebuilt, for that the returned node and \a loader must stay
+      alive as long as the FileWatcher. */
+  static std::unique_ptr<SceneNode> from_file_async(const std::string& filename, AssetLoader& loader);
+
+  /** Store the vertices of Meshes created from now on in packed
+      formats, see Mesh::attach_quantized() */
+  static void set_quantize_meshes(bool quantize) { s_quantize_meshes = quantize; }
+
+private:
+  static bool s_quantize_meshes;
+
+  /** s_quantize_meshes, unless the packed formats aren't available */
+  static bool use_quantized();
+
+private:
+  struct Source;
+
+  /** Parse the file or map its .modc cache, doesn't touch OpenGL and
+      is safe to call from any thread */
+  static std::shared_ptr<Source> load_source(const std::string& filename);
+
+  /** Reload \a filename in the background and rebuild the Meshes of
+      the objects that changed, new and removed objects are ignored */
+  static void reload(std::shared_ptr<Scene> scene, const std::string& filename, AssetLoader& loader);
+
 private:
   boost::filesystem::path m_directory;
   std::unique_ptr<SceneNode> m_node;
+  SceneNode* m_root;
+
+  std::unordered_map<std::string, SceneNode*> m_nodes;
+  std::vector<std::pair<std::string, std::unique_ptr<SceneNode> > > m_unattached_children;
+
+  /** The SceneNode for each object of the Source, in file order */
+  std::vector<SceneNode*> m_object_nodes;
+
+  /** Models and content hashes by object name, for reloading */
+  std::unordered_map<std::string, ModelPtr> m_models;
+  std::unordered_map<std::string, uint64_t> m_object_hashes;
 
 public:
   Scene();
 
   void set_directory(const boost::filesystem::path& path);
   void parse_istream(std::istream& in);
+
+  /** Load the file from its .modc cache when that is current,
+      otherwise parse the text and write a new cache */
+  void parse_file(const std::string& filename);
+
+  /** Create the SceneNodes, Meshes and Materials for the given objects */
+  void build(std::vector<ModObject> objects);
+
   std::unique_ptr<SceneNode> get_node();
 
+private:
+  void build(const Source& source);
+
+  /** Create the SceneNode hierarchy without any Models, no OpenGL */
+  void build_nodes(const Source& source);
+
+  /** Upload the Mesh of object \a idx and attach it to its SceneNode,
+      returns nullptr for objects without geometry */
+  ModelPtr build_model(const Source& source, size_t idx, MaterialPtr material);
+
+  /** Replace the Mesh and Material of the existing Model of object
+      \a idx, creating the Model if the object had no geometry before */
+  void rebuild_model(const Source& source, size_t idx);
+
+  /** Interleave or quantize the vertices of \a obj and split it into
+      16-bit addressable parts along the clusters and LOD levels of
+      \a detail, doesn't touch OpenGL */
+  static std::vector<MeshData> prepare_meshes(const ModObject& obj, const ModObjectDetail& detail);
+
+  /** Upload the already prepared parts of \a obj, one Mesh each */
+  static std::vector<std::unique_ptr<Mesh> > create_meshes(const SceneCacheObject& obj);
+
+  MaterialPtr create_material(const std::string& name);
+  SceneNode* add_node(const std::string& name, const std::string& parent,
+                      const glm::vec3& location, const glm::quat& rotation, const glm::vec3& scale);
+  void link_nodes();
+
 private:
   Scene(const Scene&);
   Scene& operator=(const Scene&);
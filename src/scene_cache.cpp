@@ -0,0 +1,480 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "scene_cache.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <fstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "format.hpp"
+#include "log.hpp"
+#include "mapped_file.hpp"
+#include "source_stamp.hpp"
+
+namespace {
+
+const char g_magic[4] = { 'M', 'O', 'D', 'C' };
+
+struct FileHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t source_size;
+  int64_t source_mtime;
+  uint64_t source_hash;
+  uint32_t object_count;
+  uint32_t flags;
+};
+
+/** FileHeader::flags, the vertex formats depend on them */
+const uint32_t g_flag_quantized = 1;
+
+struct StringRef
+{
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct ArrayRef
+{
+  uint64_t offset;
+  uint32_t count;
+  uint32_t reserved;
+};
+
+struct AttributeRecord
+{
+  StringRef name;
+  uint32_t component;
+  int32_t size;
+  int32_t offset;
+  uint32_t normalized;
+};
+
+struct MeshRecord
+{
+  ArrayRef attributes;
+  int32_t stride;
+  int32_t reserved;
+  float transform[16];
+  ArrayRef vertices; // stride bytes each
+  ArrayRef indices;  // uint16_t
+  ArrayRef clusters;
+  ArrayRef lods;
+};
+
+struct ObjectRecord
+{
+  StringRef name;
+  StringRef parent;
+  StringRef material;
+  float location[3];
+  float rotation[4]; // w, x, y, z
+  float scale[3];
+  ArrayRef meshes;
+  ArrayRef occluder_position;
+  ArrayRef occluder_index;
+};
+
+size_t align16(size_t v)
+{
+  return (v + 15) & ~static_cast<size_t>(15);
+}
+
+class BlobWriter
+{
+private:
+  size_t m_base;
+  std::vector<char> m_data;
+
+public:
+  BlobWriter(size_t base) :
+    m_base(base),
+    m_data()
+  {}
+
+  StringRef add_string(const std::string& str)
+  {
+    StringRef ref = { static_cast<uint32_t>(m_base + m_data.size()),
+                      static_cast<uint32_t>(str.size()) };
+    m_data.insert(m_data.end(), str.begin(), str.end());
+    return ref;
+  }
+
+  ArrayRef add_array(const void* data, size_t element_size, int count)
+  {
+    m_data.resize(align16(m_data.size()));
+    ArrayRef ref = { m_base + m_data.size(), static_cast<uint32_t>(count), 0 };
+    const char* bytes = static_cast<const char*>(data);
+    m_data.insert(m_data.end(), bytes, bytes + element_size * count);
+    return ref;
+  }
+
+  template<typename T>
+  ArrayRef add_array(std::vector<T> const& vec)
+  {
+    return add_array(vec.data(), sizeof(T), static_cast<int>(vec.size()));
+  }
+
+  ArrayRef add_array(SceneCacheArray const& array, size_t element_size)
+  {
+    return add_array(array.data, element_size, array.count);
+  }
+
+  std::vector<char> const& get_data() const { return m_data; }
+};
+
+SceneCacheArray get_array(ArrayRef const& ref, size_t element_size, MappedFile const& file)
+{
+  if (ref.offset > file.get_size() ||
+      ref.count * element_size > file.get_size() - ref.offset)
+  {
+    throw std::runtime_error("array out of range");
+  }
+
+  return { file.get_data() + ref.offset, static_cast<int>(ref.count) };
+}
+
+boost::string_view get_string(StringRef const& ref, MappedFile const& file)
+{
+  if (ref.offset > file.get_size() ||
+      ref.length > file.get_size() - ref.offset)
+  {
+    throw std::runtime_error("string out of range");
+  }
+
+  return boost::string_view(file.get_data() + ref.offset, ref.length);
+}
+
+MeshRecord add_mesh(BlobWriter& blob, MeshDataRef const& mesh)
+{
+  std::vector<AttributeRecord> attributes;
+  for(auto const& attr : mesh.format.get_attributes())
+  {
+    attributes.push_back({ blob.add_string(attr.name), attr.component,
+                           attr.size, attr.offset, attr.normalized ? 1u : 0u });
+  }
+
+  MeshRecord record;
+  record.attributes = blob.add_array(attributes);
+  record.stride = mesh.format.get_stride();
+  record.reserved = 0;
+  memcpy(record.transform, glm::value_ptr(mesh.transform), sizeof(record.transform));
+  record.vertices = blob.add_array(mesh.vertices, mesh.format.get_stride(), mesh.vertex_count);
+  record.indices = blob.add_array(mesh.indices, sizeof(uint16_t), mesh.index_count);
+  record.clusters = blob.add_array(mesh.clusters, sizeof(MeshCluster), mesh.cluster_count);
+  record.lods = blob.add_array(mesh.lods, sizeof(MeshLod), mesh.lod_count);
+  return record;
+}
+
+/** The format is rebuilt the way it was built, so the offsets and
+    stride have to come out the same again */
+VertexFormat get_format(MeshRecord const& record, MappedFile const& file)
+{
+  SceneCacheArray array = get_array(record.attributes, sizeof(AttributeRecord), file);
+
+  std::vector<AttributeRecord> attributes(array.count);
+  memcpy(attributes.data(), array.data, sizeof(AttributeRecord) * array.count);
+
+  VertexFormat format;
+  for(size_t i = 0; i < attributes.size(); ++i)
+  {
+    std::string name = get_string(attributes[i].name, file).to_string();
+    int next = (i + 1 < attributes.size()) ? attributes[i + 1].offset : record.stride;
+    if (VertexAttribute::get_location(name) == -1)
+    {
+      throw std::runtime_error("unknown attribute '" + name + "'");
+    }
+    format.add_packed(name, attributes[i].component, attributes[i].size,
+                      attributes[i].normalized != 0, next - attributes[i].offset);
+    if (format.get_attributes().back().offset != attributes[i].offset)
+    {
+      throw std::runtime_error("vertex format out of range");
+    }
+  }
+
+  if (format.get_stride() != record.stride || record.stride <= 0)
+  {
+    throw std::runtime_error("vertex format out of range");
+  }
+
+  return format;
+}
+
+MeshDataRef get_mesh(MeshRecord const& record, MappedFile const& file)
+{
+  MeshDataRef mesh;
+  mesh.format = get_format(record, file);
+  memcpy(glm::value_ptr(mesh.transform), record.transform, sizeof(record.transform));
+
+  SceneCacheArray vertices = get_array(record.vertices, record.stride, file);
+  SceneCacheArray indices = get_array(record.indices, sizeof(uint16_t), file);
+  SceneCacheArray clusters = get_array(record.clusters, sizeof(MeshCluster), file);
+  SceneCacheArray lods = get_array(record.lods, sizeof(MeshLod), file);
+
+  mesh.vertices = vertices.data;
+  mesh.vertex_count = vertices.count;
+  mesh.indices = static_cast<const uint16_t*>(indices.data);
+  mesh.index_count = indices.count;
+  mesh.clusters = static_cast<const MeshCluster*>(clusters.data);
+  mesh.cluster_count = clusters.count;
+  mesh.lods = static_cast<const MeshLod*>(lods.data);
+  mesh.lod_count = lods.count;
+
+  // the GPU would read past the vertices otherwise
+  for(int i = 0; i < mesh.index_count; ++i)
+  {
+    if (mesh.indices[i] >= mesh.vertex_count)
+    {
+      throw std::runtime_error("index out of range");
+    }
+  }
+
+  // the ranges become glMultiDrawElements() offsets, same as above
+  for(int i = 0; i < mesh.cluster_count; ++i)
+  {
+    if (mesh.clusters[i].first < 0 || mesh.clusters[i].count < 0 ||
+        mesh.clusters[i].count > mesh.index_count - mesh.clusters[i].first)
+    {
+      throw std::runtime_error("cluster out of range");
+    }
+  }
+
+  for(int i = 0; i < mesh.lod_count; ++i)
+  {
+    if (mesh.lods[i].first < 0 || mesh.lods[i].count < 0 ||
+        mesh.lods[i].count > mesh.index_count - mesh.lods[i].first)
+    {
+      throw std::runtime_error("LOD out of range");
+    }
+  }
+
+  return mesh;
+}
+
+} // namespace
+
+std::string
+SceneCache::get_cache_filename(const std::string& filename)
+{
+  return filename + "c";
+}
+
+std::unique_ptr<SceneCache>
+SceneCache::open(const std::string& filename, bool quantized)
+{
+  std::string cache_filename = get_cache_filename(filename);
+
+  struct stat st;
+  if (stat(cache_filename.c_str(), &st) < 0)
+  {
+    return {};
+  }
+
+  try
+  {
+    auto file = std::make_unique<MappedFile>(cache_filename);
+
+    FileHeader header;
+    if (file->get_size() < sizeof(header))
+    {
+      throw std::runtime_error("file too short");
+    }
+    memcpy(&header, file->get_data(), sizeof(header));
+
+    if (memcmp(header.magic, g_magic, sizeof(g_magic)) != 0)
+    {
+      throw std::runtime_error("not a scene cache");
+    }
+    else if (header.version != s_version)
+    {
+      log_info("%s: version %d is outdated", cache_filename, header.version);
+      return {};
+    }
+    else if (((header.flags & g_flag_quantized) != 0) != quantized)
+    {
+      log_info("%s: built for other vertex formats", cache_filename);
+      return {};
+    }
+
+    SourceStamp stamp = SourceStamp::from_file(filename);
+    if (stamp.size != header.source_size)
+    {
+      return {};
+    }
+    else if (stamp.mtime != header.source_mtime &&
+             SourceStamp::hash_file(filename) != header.source_hash)
+    {
+      return {};
+    }
+    else
+    {
+      return std::make_unique<SceneCache>(std::move(file));
+    }
+  }
+  catch(const std::exception& err)
+  {
+    log_warn("%s: ignoring broken scene cache: %s", cache_filename, err.what());
+    return {};
+  }
+}
+
+void
+SceneCache::write(const std::string& filename, std::vector<SceneCacheObject> const& objects, bool quantized)
+{
+  SourceStamp stamp = SourceStamp::from_file(filename);
+
+  FileHeader header;
+  memcpy(header.magic, g_magic, sizeof(g_magic));
+  header.version = s_version;
+  header.source_size = stamp.size;
+  header.source_mtime = stamp.mtime;
+  header.source_hash = SourceStamp::hash_file(filename);
+  header.object_count = static_cast<uint32_t>(objects.size());
+  header.flags = quantized ? g_flag_quantized : 0;
+
+  std::vector<ObjectRecord> records;
+  BlobWriter blob(align16(sizeof(FileHeader) + sizeof(ObjectRecord) * objects.size()));
+
+  for(auto const& obj : objects)
+  {
+    ObjectRecord record;
+
+    record.name = blob.add_string(obj.name.to_string());
+    record.parent = blob.add_string(obj.parent.to_string());
+    record.material = blob.add_string(obj.material.to_string());
+
+    for(int i = 0; i < 3; ++i)
+    {
+      record.location[i] = obj.location[i];
+      record.scale[i] = obj.scale[i];
+    }
+
+    record.rotation[0] = obj.rotation.w;
+    record.rotation[1] = obj.rotation.x;
+    record.rotation[2] = obj.rotation.y;
+    record.rotation[3] = obj.rotation.z;
+
+    std::vector<MeshRecord> meshes;
+    for(auto const& mesh : obj.meshes)
+    {
+      meshes.push_back(add_mesh(blob, mesh));
+    }
+    record.meshes = blob.add_array(meshes);
+    record.occluder_position = blob.add_array(obj.occluder_position, sizeof(glm::vec3));
+    record.occluder_index = blob.add_array(obj.occluder_index, sizeof(int));
+
+    records.push_back(record);
+  }
+
+  // write to a temporary file first, so that a concurrent or aborted
+  // run never sees a half written cache, the name is unique to this
+  // thread as a reload may be writing the same cache as a load
+  std::string cache_filename = get_cache_filename(filename);
+  std::string tmp_filename = format("%s.%d.%s.tmp", cache_filename, getpid(), std::this_thread::get_id());
+  {
+    std::ofstream out(tmp_filename, std::ios::binary);
+    if (!out)
+    {
+      throw std::runtime_error(format("%s: couldn't open for writing", tmp_filename));
+    }
+
+    static const char padding[16] = {};
+    size_t head_size = sizeof(FileHeader) + sizeof(ObjectRecord) * records.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(records.data()), sizeof(ObjectRecord) * records.size());
+    out.write(padding, align16(head_size) - head_size);
+    out.write(blob.get_data().data(), blob.get_data().size());
+
+    if (!out)
+    {
+      throw std::runtime_error(format("%s: write error", tmp_filename));
+    }
+  }
+
+  if (rename(tmp_filename.c_str(), cache_filename.c_str()) < 0)
+  {
+    int err = errno;
+    remove(tmp_filename.c_str());
+    throw std::runtime_error(format("%s: couldn't rename: %s", cache_filename, strerror(err)));
+  }
+}
+
+SceneCache::SceneCache(std::unique_ptr<MappedFile> file) :
+  m_file(std::move(file)),
+  m_objects()
+{
+  FileHeader header;
+  memcpy(&header, m_file->get_data(), sizeof(header));
+
+  if (header.object_count > (m_file->get_size() - sizeof(header)) / sizeof(ObjectRecord))
+  {
+    throw std::runtime_error("object table out of range");
+  }
+
+  for(uint32_t i = 0; i < header.object_count; ++i)
+  {
+    ObjectRecord record;
+    memcpy(&record, m_file->get_data() + sizeof(header) + sizeof(ObjectRecord) * i, sizeof(record));
+
+    SceneCacheObject obj;
+    obj.name = get_string(record.name, *m_file);
+    obj.parent = get_string(record.parent, *m_file);
+    obj.material = get_string(record.material, *m_file);
+    obj.location = glm::vec3(record.location[0], record.location[1], record.location[2]);
+    obj.rotation = glm::quat(record.rotation[0], record.rotation[1], record.rotation[2], record.rotation[3]);
+    obj.scale = glm::vec3(record.scale[0], record.scale[1], record.scale[2]);
+    SceneCacheArray meshes = get_array(record.meshes, sizeof(MeshRecord), *m_file);
+    for(int j = 0; j < meshes.count; ++j)
+    {
+      MeshRecord mesh;
+      memcpy(&mesh, static_cast<const char*>(meshes.data) + sizeof(MeshRecord) * j, sizeof(mesh));
+      obj.meshes.push_back(get_mesh(mesh, *m_file));
+    }
+    obj.occluder_position = get_array(record.occluder_position, sizeof(glm::vec3), *m_file);
+    obj.occluder_index = get_array(record.occluder_index, sizeof(int), *m_file);
+
+    // the OcclusionBuffer would read past the positions otherwise
+    if (obj.occluder_index.count % 3 != 0)
+    {
+      throw std::runtime_error("occluder triangles out of range");
+    }
+
+    const int* occluder_indices = static_cast<const int*>(obj.occluder_index.data);
+    for(int j = 0; j < obj.occluder_index.count; ++j)
+    {
+      if (occluder_indices[j] < 0 || occluder_indices[j] >= obj.occluder_position.count)
+      {
+        throw std::runtime_error("occluder index out of range");
+      }
+    }
+
+    m_objects.push_back(obj);
+  }
+}
+
+SceneCache::~SceneCache()
+{
+}
+
+/* EOF */
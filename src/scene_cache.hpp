@@ -0,0 +1,100 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_SCENE_CACHE_HPP
+#define HEADER_SCENE_CACHE_HPP
+
+#include <boost/utility/string_view.hpp>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "mesh.hpp"
+
+class MappedFile;
+
+/** Array data inside the mapped cache file, ready to be handed to
+    glBufferData(), count is in elements, not in bytes */
+struct SceneCacheArray
+{
+  const void* data;
+  int count;
+};
+
+/** A single object of the cache, all pointers point into the mapped
+    file and stay valid as long as the SceneCache is alive */
+struct SceneCacheObject
+{
+  boost::string_view name;
+  boost::string_view parent;
+  boost::string_view material;
+  glm::vec3 location;
+  glm::quat rotation;
+  glm::vec3 scale;
+
+  /** Ready for Mesh::create(), one per 16-bit addressable part */
+  std::vector<MeshDataRef> meshes;
+
+  /** Triangles for the OcclusionBuffer, empty when the object is
+      skinned or too large to be drawn into it */
+  SceneCacheArray occluder_position; // glm::vec3
+  SceneCacheArray occluder_index;    // int
+};
+
+/** Binary sidecar (.modc) of a .mod file, holding the objects with
+    their vertices already interleaved or quantized and their indices
+    split into 16-bit parts, so that later loads skip the text parsing
+    and hand the mapped data straight to the GPU */
+class SceneCache
+{
+public:
+  /** Bump whenever the file layout changes */
+  static const uint32_t s_version = 5;
+
+  static std::string get_cache_filename(const std::string& filename);
+
+  /** Returns the cache for the source file \a filename or nullptr
+      when it doesn't exist, is damaged or is out of date. The cache
+      is considered current when the source size and mtime match, or
+      when the source content still hashes to the stored value, and
+      its vertices are \a quantized the same way. */
+  static std::unique_ptr<SceneCache> open(const std::string& filename, bool quantized);
+
+  /** Writes the cache for the source file \a filename */
+  static void write(const std::string& filename, std::vector<SceneCacheObject> const& objects, bool quantized);
+
+private:
+  std::unique_ptr<MappedFile> m_file;
+  std::vector<SceneCacheObject> m_objects;
+
+public:
+  SceneCache(std::unique_ptr<MappedFile> file);
+  ~SceneCache();
+
+  std::vector<SceneCacheObject> const& get_objects() const { return m_objects; }
+
+private:
+  SceneCache(const SceneCache&) = delete;
+  SceneCache& operator=(const SceneCache&) = delete;
+};
+
+#endif
+
+/* EOF */
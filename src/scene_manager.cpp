@@ -1,13 +1,55 @@
 #include "scene_manager.hpp"
 
+#include <algorithm>
+#include <limits>
+
 #include "camera.hpp"
+#include "frustum.hpp"
 #include "render_context.hpp"
+#include "render_stats.hpp"
+
+namespace {
+
+RenderStats::Pass get_pass(bool geometry_pass, Stereo stereo)
+{
+  if (geometry_pass)
+  {
+    return RenderStats::ShadowPass;
+  }
+  else
+  {
+    switch(stereo)
+    {
+      case Stereo::Left:
+        return RenderStats::LeftPass;
+
+      case Stereo::Right:
+        return RenderStats::RightPass;
+
+      default:
+        return RenderStats::CenterPass;
+    }
+  }
+}
+
+} // namespace
+
+bool SceneManager::s_occlusion_culling = true;
 
 SceneManager::SceneManager() :
   m_world(std::make_unique<SceneNode>()),
   m_view(std::make_unique<SceneNode>()),
   m_lights(),
-  m_override_material()
+  m_override_material(),
+  m_viewport_height(0),
+  m_bvh(),
+  m_bvh_nodes(),
+  m_changed(),
+  m_bvh_order(),
+  m_visible(),
+  m_occlusion_culler(),
+  m_occluders(),
+  m_candidates()
 {}
 
 SceneManager::~SceneManager()
@@ -35,22 +77,228 @@ SceneManager::create_light()
 }
 
 void
-SceneManager::render(Camera const& camera, bool geometry_pass, Stereo stereo)
+SceneManager::update()
 {
-  m_world->update_transform();
+  m_changed.clear();
+  m_world->update_changed(m_changed);
+
+  // nodes can't be detached, so proxies only go away with their models
+  bool proxies_changed = false;
+  for(SceneNode* node : m_changed)
+  {
+    if (update_proxy(node))
+    {
+      proxies_changed = true;
+    }
+  }
+
+  if (proxies_changed)
+  {
+    int order = 0;
+    update_order(m_world.get(), order);
+  }
+
+  m_bvh.commit();
+
   m_view->update_transform();
+}
 
-  render_node(camera, m_world.get(), geometry_pass, stereo);
+bool
+SceneManager::update_proxy(SceneNode* node)
+{
+  BoundingBox const& box = node->get_model_bounding_box();
+
+  int proxy = node->get_bvh_proxy();
+  if (proxy >= static_cast<int>(m_bvh_nodes.size()) || (proxy >= 0 && m_bvh_nodes[proxy] != node))
+  {
+    // the proxy of another SceneManager
+    proxy = -1;
+  }
+
+  if (box.is_empty())
+  {
+    node->set_bvh_proxy(-1);
+    if (proxy >= 0)
+    {
+      m_bvh.remove(proxy);
+      m_bvh_nodes[proxy] = nullptr;
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  else if (proxy < 0)
+  {
+    proxy = m_bvh.insert(box);
+    if (proxy >= static_cast<int>(m_bvh_nodes.size()))
+    {
+      m_bvh_nodes.resize(proxy + 1, nullptr);
+      m_bvh_order.resize(proxy + 1, 0);
+    }
+    m_bvh_nodes[proxy] = node;
+    node->set_bvh_proxy(proxy);
+    return true;
+  }
+  else
+  {
+    m_bvh.update(proxy, box);
+    return false;
+  }
+}
+
+void
+SceneManager::update_order(SceneNode* node, int& order)
+{
+  int proxy = node->get_bvh_proxy();
+  if (proxy >= 0 && proxy < static_cast<int>(m_bvh_nodes.size()) && m_bvh_nodes[proxy] == node)
+  {
+    m_bvh_order[proxy] = order++;
+  }
+
+  for(auto const& child : node->get_children())
+  {
+    update_order(child.get(), order);
+  }
+}
+
+void
+SceneManager::render(Camera const& camera, bool geometry_pass, Stereo stereo)
+{
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  m_viewport_height = viewport[3];
+
+  // the shadow pass gets the light's camera, so it culls against the
+  // light frustum
+  m_visible.clear();
+  m_bvh.query_frustum(Frustum(camera.get_matrix()), m_visible);
+
+  // drawing in tree order keeps parents before children as
+  // render_node() does, m_occluders and m_candidates inherit it
+  std::sort(m_visible.begin(), m_visible.end(),
+            [this](int lhs, int rhs) { return m_bvh_order[lhs] < m_bvh_order[rhs]; });
+
+  RenderStats::Pass pass = get_pass(geometry_pass, stereo);
+  RenderStats::get().drawn_nodes[pass] += static_cast<int>(m_visible.size());
+  RenderStats::get().culled_nodes[pass] += m_bvh.get_proxy_count() - static_cast<int>(m_visible.size());
+
+  if (s_occlusion_culling && !geometry_pass)
+  {
+    render_occlusion_culled(camera, stereo);
+  }
+  else
+  {
+    for(int proxy : m_visible)
+    {
+      draw_node(camera, m_bvh_nodes[proxy], geometry_pass, stereo);
+    }
+  }
 
   Camera id = camera;
   id.set_position(glm::vec3(0.0f, 0.0f, 0.0f));
-  render_node(id, m_view.get(), geometry_pass, stereo);
+  render_node(id, Frustum(id.get_matrix()), m_view.get(), geometry_pass, stereo);
+}
+
+void
+SceneManager::render_occlusion_culled(Camera const& camera, Stereo stereo)
+{
+  if (!m_occlusion_culler)
+  {
+    m_occlusion_culler = std::make_unique<OcclusionCuller>();
+  }
+  OcclusionCuller& culler = *m_occlusion_culler;
+
+  culler.clear();
+  m_occluders.clear();
+  m_candidates.clear();
+
+  glm::mat4 view_projection = camera.get_matrix();
+  for(int proxy : m_visible)
+  {
+    SceneNode* node = m_bvh_nodes[proxy];
+
+    bool occluder = false;
+    for(auto const& model : node->get_models())
+    {
+      if (const OccluderMesh* mesh = model->get_occluder())
+      {
+        culler.add_occluder(*mesh, view_projection * node->get_transform(), model->get_face_culling());
+        occluder = true;
+      }
+    }
+
+    if (occluder)
+    {
+      m_occluders.push_back(proxy);
+    }
+    else
+    {
+      culler.add_candidate(m_bvh.get_box(proxy));
+      m_candidates.push_back(proxy);
+    }
+  }
+
+  if (m_occluders.empty() || m_candidates.empty())
+  {
+    for(int proxy : m_visible)
+    {
+      draw_node(camera, m_bvh_nodes[proxy], false, stereo);
+    }
+  }
+  else
+  {
+    // the threads rasterize the occluders while OpenGL gets them, and
+    // the GPU is still busy with what came before
+    culler.begin(view_projection);
+    for(int proxy : m_occluders)
+    {
+      draw_node(camera, m_bvh_nodes[proxy], false, stereo);
+    }
+    culler.finish();
+
+    for(size_t i = 0; i < m_candidates.size(); ++i)
+    {
+      if (culler.is_visible(static_cast<int>(i)))
+      {
+        draw_node(camera, m_bvh_nodes[m_candidates[i]], false, stereo);
+      }
+    }
+  }
 }
 
 extern TexturePtr g_video_texture;
 
 void
-SceneManager::render_node(Camera const& camera, SceneNode* node, bool geometry_pass, Stereo stereo)
+SceneManager::render_node(Camera const& camera, Frustum const& frustum, SceneNode* node,
+                          bool geometry_pass, Stereo stereo)
+{
+  BoundingBox const& bounds = node->get_bounding_box();
+  if (bounds.is_empty())
+  {
+    // no models below this node
+    return;
+  }
+
+  RenderStats::Pass pass = get_pass(geometry_pass, stereo);
+  if (!bounds.is_infinite() && !frustum.intersects_box(bounds.min, bounds.max))
+  {
+    RenderStats::get().culled_nodes[pass] += 1;
+    return;
+  }
+  RenderStats::get().drawn_nodes[pass] += 1;
+
+  draw_node(camera, node, geometry_pass, stereo);
+
+  for(auto const& child : node->get_children())
+  {
+    render_node(camera, frustum, child.get(), geometry_pass, stereo);
+  }
+}
+
+void
+SceneManager::draw_node(Camera const& camera, SceneNode* node, bool geometry_pass, Stereo stereo)
 {
   OpenGLState state;
 
@@ -59,6 +307,7 @@ SceneManager::render_node(Camera const& camera, SceneNode* node, bool geometry_p
   context.set_video_texture(g_video_texture);
 
   context.set_stereo(stereo);
+  context.set_viewport_height(m_viewport_height);
 
   if (geometry_pass)
   {
@@ -69,17 +318,66 @@ SceneManager::render_node(Camera const& camera, SceneNode* node, bool geometry_p
   {
     model->draw(context);
   }
+}
 
-  for(auto const& child : node->get_children())
+void
+SceneManager::set_override_material(MaterialPtr material)
+{
+  m_override_material = material;
+}
+
+void
+SceneManager::get_nodes(std::vector<int> const& proxies, std::vector<SceneNode*>& result) const
+{
+  for(int proxy : proxies)
   {
-    render_node(camera, child.get(), geometry_pass, stereo);
+    result.push_back(m_bvh_nodes[proxy]);
   }
 }
 
 void
-SceneManager::set_override_material(MaterialPtr material)
+SceneManager::query_frustum(Frustum const& frustum, std::vector<SceneNode*>& result) const
 {
-  m_override_material = material;
+  std::vector<int> proxies;
+  m_bvh.query_frustum(frustum, proxies);
+  get_nodes(proxies, result);
+}
+
+void
+SceneManager::query_box(BoundingBox const& box, std::vector<SceneNode*>& result) const
+{
+  std::vector<int> proxies;
+  m_bvh.query_box(box, proxies);
+  get_nodes(proxies, result);
+}
+
+void
+SceneManager::query_sphere(glm::vec3 const& center, float radius, std::vector<SceneNode*>& result) const
+{
+  std::vector<int> proxies;
+  m_bvh.query_sphere(center, radius, proxies);
+  get_nodes(proxies, result);
+}
+
+SceneNode*
+SceneManager::pick(glm::vec3 const& origin, glm::vec3 const& direction) const
+{
+  std::vector<int> proxies;
+  m_bvh.query_ray(origin, direction, std::numeric_limits<float>::infinity(), proxies);
+
+  SceneNode* result = nullptr;
+  float nearest = std::numeric_limits<float>::infinity();
+  for(int proxy : proxies)
+  {
+    BoundingBox const& box = m_bvh.get_box(proxy);
+    float distance;
+    if (!box.is_infinite() && box.intersects_ray(origin, direction, distance) && distance < nearest)
+    {
+      nearest = distance;
+      result = m_bvh_nodes[proxy];
+    }
+  }
+  return result;
 }
 
 /* EOF */
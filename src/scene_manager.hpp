@@ -1,9 +1,12 @@
 #ifndef HEADER_SCENE_MANAGER_HPP
 #define HEADER_SCENE_MANAGER_HPP
 
+#include <memory>
 #include <vector>
 
+#include "bvh.hpp"
 #include "light.hpp"
+#include "occlusion_culler.hpp"
 #include "scene_node.hpp"
 #include "opengl_state.hpp"
 #include "material.hpp"
@@ -19,6 +22,40 @@ private:
   std::vector<LightPtr> m_lights;
   MaterialPtr m_override_material;
 
+  /** Of the current render() */
+  int m_viewport_height;
+
+  /** Over the nodes of m_world that have models, m_bvh_nodes maps the
+      proxies back to them */
+  Bvh m_bvh;
+  std::vector<SceneNode*> m_bvh_nodes;
+
+  /** Nodes whose transform or models changed in the current update(),
+      kept to save allocations */
+  std::vector<SceneNode*> m_changed;
+
+  /** Position of each proxy's node in a depth-first walk of m_world,
+      refreshed whenever proxies come or go. The proxy ids themselves
+      say nothing about it, as the Bvh hands out freed ids again. */
+  std::vector<int> m_bvh_order;
+
+  /** Visible proxies of the current render(), kept to save allocations */
+  std::vector<int> m_visible;
+
+  /** Created by the first render() that has occluders, m_occluders
+      and m_candidates split m_visible between the proxies whose nodes
+      have occluders and those tested against them */
+  std::unique_ptr<OcclusionCuller> m_occlusion_culler;
+  std::vector<int> m_occluders;
+  std::vector<int> m_candidates;
+
+  static bool s_occlusion_culling;
+
+public:
+  /** Skip the nodes hidden behind the occluders of other nodes, the
+      eye passes only */
+  static void set_occlusion_culling(bool enable) { s_occlusion_culling = enable; }
+
 public:
   SceneManager();
   ~SceneManager();
@@ -28,11 +65,47 @@ public:
 
   LightPtr create_light();
 
+  /** Update the transforms of the world and the Bvh over it, only
+      the nodes that changed since the last call get refit. Call once
+      per frame before the first render(), the passes and the queries
+      see the world as of the last call. */
+  void update();
+
   void render(Camera const& camera, bool geometry_pass = false, Stereo stereo = Stereo::Center);
-  void render_node(Camera const& camera, SceneNode* node, bool geometry_pass, Stereo stereo);
+
+  /** Draw \a node and its children, skipping the subtrees whose bounds
+      are outside of \a frustum */
+  void render_node(Camera const& camera, Frustum const& frustum, SceneNode* node,
+                   bool geometry_pass, Stereo stereo);
 
   void set_override_material(MaterialPtr material);
 
+  /** The nodes of the world whose models may intersect, appended to
+      \a result in no particular order */
+  void query_frustum(Frustum const& frustum, std::vector<SceneNode*>& result) const;
+  void query_box(BoundingBox const& box, std::vector<SceneNode*>& result) const;
+  void query_sphere(glm::vec3 const& center, float radius, std::vector<SceneNode*>& result) const;
+
+  /** The node of the world whose bounds the ray enters first, nullptr
+      if it hits none, nodes without bounds can't be picked */
+  SceneNode* pick(glm::vec3 const& origin, glm::vec3 const& direction) const;
+
+private:
+  /** Insert, refit or remove the proxy of \a node, returns true when
+      it gained or lost one */
+  bool update_proxy(SceneNode* node);
+
+  /** \a order counts the nodes with proxies in tree order */
+  void update_order(SceneNode* node, int& order);
+  void get_nodes(std::vector<int> const& proxies, std::vector<SceneNode*>& result) const;
+
+  /** Draw the nodes of m_visible that aren't hidden behind the
+      occluders among them */
+  void render_occlusion_culled(Camera const& camera, Stereo stereo);
+
+  /** Draw the models of \a node, but not its children */
+  void draw_node(Camera const& camera, SceneNode* node, bool geometry_pass, Stereo stereo);
+
 private:
   SceneManager(const SceneManager&);
   SceneManager& operator=(const SceneManager&);
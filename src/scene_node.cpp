@@ -22,6 +22,12 @@ SceneNode::SceneNode(const std::string& name) :
   m_orientation(1.0f, 0.0f, 0.0f, 0.0f),
   m_scale(1.0f , 1.0f, 1.0f),
   m_global_transform(1),
+  m_model_bounding_box(),
+  m_bounding_box(),
+  m_bvh_proxy(-1),
+  m_parent(nullptr),
+  m_dirty(true),
+  m_dirty_children(false),
   m_children(),
   m_models()
 {
@@ -35,6 +41,7 @@ void
 SceneNode::set_position(const glm::vec3& p)
 {
   m_position = p;
+  invalidate();
 }
 
 glm::vec3
@@ -47,6 +54,7 @@ void
 SceneNode::set_orientation(const glm::quat& q)
 {
  m_orientation = q;
+ invalidate();
 }
 
 glm::quat
@@ -59,6 +67,7 @@ void
 SceneNode::set_scale(const glm::vec3& s)
 {
  m_scale = s;
+ invalidate();
 }
 
 glm::vec3
@@ -82,9 +91,83 @@ SceneNode::update_transform(const glm::mat4& parent_transform)
     glm::mat4_cast(m_orientation) *
     glm::scale(m_scale);
 
+  update_models();
+
+  m_bounding_box = m_model_bounding_box;
+
   for(auto& child : m_children)
   {
     child->update_transform(m_global_transform);
+    m_bounding_box.add(child->get_bounding_box());
+  }
+
+  m_dirty = false;
+  m_dirty_children = false;
+}
+
+void
+SceneNode::update_changed(std::vector<SceneNode*>& changed)
+{
+  glm::mat4 parent_transform(1);
+  if (m_parent)
+  {
+    parent_transform = m_parent->m_global_transform;
+  }
+  update_changed(parent_transform, false, changed);
+}
+
+void
+SceneNode::update_changed(const glm::mat4& parent_transform, bool parent_changed,
+                          std::vector<SceneNode*>& changed)
+{
+  if (!parent_changed && !m_dirty && !m_dirty_children)
+  {
+    return;
+  }
+
+  bool self_changed = parent_changed || m_dirty;
+  if (self_changed)
+  {
+    m_global_transform =
+      parent_transform *
+      glm::translate(m_position) *
+      glm::mat4_cast(m_orientation) *
+      glm::scale(m_scale);
+
+    update_models();
+    changed.push_back(this);
+  }
+
+  // the bounds of the clean children are still current
+  m_bounding_box = m_model_bounding_box;
+
+  for(auto& child : m_children)
+  {
+    child->update_changed(m_global_transform, self_changed, changed);
+    m_bounding_box.add(child->get_bounding_box());
+  }
+
+  m_dirty = false;
+  m_dirty_children = false;
+}
+
+void
+SceneNode::update_models()
+{
+  m_model_bounding_box = BoundingBox();
+  for(auto const& model : m_models)
+  {
+    m_model_bounding_box.add(model->get_bounding_box().transform(m_global_transform));
+  }
+}
+
+void
+SceneNode::invalidate()
+{
+  m_dirty = true;
+  for(SceneNode* node = m_parent; node && !node->m_dirty_children; node = node->m_parent)
+  {
+    node->m_dirty_children = true;
   }
 }
 
@@ -92,11 +175,14 @@ void
 SceneNode::attach_model(ModelPtr model)
 {
   m_models.push_back(model);
+  invalidate();
 }
 
 void
 SceneNode::attach_child(std::unique_ptr<SceneNode> child)
 {
+  child->m_parent = this;
+  child->invalidate();
   m_children.push_back(std::move(child));
 }
 
@@ -34,6 +34,23 @@ private:
 
   glm::mat4 m_global_transform;
 
+  /** World space bounds of the models of this node alone and with
+      all of its children, updated along with the transform */
+  BoundingBox m_model_bounding_box;
+  BoundingBox m_bounding_box;
+
+  /** Of this node in SceneManager's Bvh, -1 while it has none */
+  int m_bvh_proxy;
+
+  SceneNode* m_parent;
+
+  /** The transform or models of this node changed since the last
+      update_changed(), which has to revisit the whole subtree */
+  bool m_dirty;
+
+  /** Some node below this one is dirty */
+  bool m_dirty_children;
+
   std::vector<std::unique_ptr<SceneNode> > m_children;
   std::vector<ModelPtr> m_models;
 
@@ -52,8 +69,24 @@ public:
 
   glm::mat4 get_transform() const;
 
+  /** Update the transforms and bounding boxes of the whole subtree */
   void update_transform(const glm::mat4& parent_transform = glm::mat4(1));
 
+  /** Same as update_transform() on the root of a tree, but only visits
+      the paths to the nodes that changed, those whose transform or
+      models changed get appended to \a changed */
+  void update_changed(std::vector<SceneNode*>& changed);
+
+  /** Has to be called when the meshes of an attached Model change,
+      transforms and attachments take care of it themselves */
+  void invalidate();
+
+  BoundingBox const& get_model_bounding_box() const { return m_model_bounding_box; }
+  BoundingBox const& get_bounding_box() const { return m_bounding_box; }
+
+  void set_bvh_proxy(int proxy) { m_bvh_proxy = proxy; }
+  int get_bvh_proxy() const { return m_bvh_proxy; }
+
   void attach_model(ModelPtr model);
   void attach_child(std::unique_ptr<SceneNode> child);
   SceneNode* create_child();
@@ -61,6 +94,11 @@ public:
   const std::vector<std::unique_ptr<SceneNode> >& get_children() const { return m_children; }
   const std::vector<ModelPtr>&   get_models() const { return m_models; }
 
+private:
+  void update_changed(const glm::mat4& parent_transform, bool parent_changed,
+                      std::vector<SceneNode*>& changed);
+  void update_models();
+
 private:
   SceneNode(const SceneNode&);
   SceneNode& operator=(const SceneNode&);
@@ -33,6 +33,13 @@ void include_file(std::string const& filename, std::ostream& os)
 ShaderPtr
 Shader::from_file(GLenum type, std::string const& filename,
                   std::vector<std::string> const& defines)
+{
+  return from_source(type, load_source(filename, defines), filename);
+}
+
+std::vector<std::string>
+Shader::load_source(std::string const& filename, std::vector<std::string> const& defines,
+                    std::vector<std::string>* includes)
 {
   std::ifstream in(filename);
   if (!in)
@@ -78,14 +85,14 @@ Shader::from_file(GLenum type, std::string const& filename,
         if (std::regex_match(line, rx_results, include_rx))
         {
           boost::filesystem::path include_filename(rx_results[1]);
-          if (include_filename.is_absolute())
+          if (!include_filename.is_absolute())
           {
-            include_file(include_filename.string(), os);
+            include_filename = boost::filesystem::path(filename).parent_path() / include_filename;
           }
-          else
+          include_file(include_filename.string(), os);
+          if (includes)
           {
-            include_file((boost::filesystem::path(filename).parent_path() / include_filename).string(),
-                         os);
+            includes->push_back(include_filename.string());
           }
           os << "#line " << line_count << '\n';
         }
@@ -99,24 +106,38 @@ Shader::from_file(GLenum type, std::string const& filename,
       sources.emplace_back(os.str());
     }
 
-    ShaderPtr shader = std::make_shared<Shader>(type);
+    return sources;
+  }
+}
 
-    shader->source(sources);
-    shader->compile();
+ShaderPtr
+Shader::from_source(GLenum type, std::vector<std::string> const& sources,
+                    std::string const& name)
+{
+  ShaderPtr shader = submit(type, sources, name);
 
-    if (!shader->get_compile_status())
-    {
-      throw std::runtime_error((boost::format("%s: error:\n %s") % filename % shader->get_info_log()).str());
-    }
+  shader->check();
 
-    //log_debug("%s: shader compile successful", filename);
+  //log_debug("%s: shader compile successful", name);
 
-    return shader;
-  }
+  return shader;
+}
+
+ShaderPtr
+Shader::submit(GLenum type, std::vector<std::string> const& sources,
+               std::string const& name)
+{
+  ShaderPtr shader = std::make_shared<Shader>(type, name);
+
+  shader->source(sources);
+  shader->compile();
+
+  return shader;
 }
 
-Shader::Shader(GLenum type) :
-  m_shader()
+Shader::Shader(GLenum type, std::string const& name) :
+  m_shader(),
+  m_name(name)
 {
   m_shader = glCreateShader(type);
 }
@@ -181,4 +202,13 @@ Shader::get_compile_status() const
   return compile_status == GL_TRUE;
 }
 
+void
+Shader::check() const
+{
+  if (!get_compile_status())
+  {
+    throw std::runtime_error((boost::format("%s: error:\n %s") % m_name % get_info_log()).str());
+  }
+}
+
 /* EOF */
@@ -18,6 +18,7 @@
 #define HEADER_SHADER_HPP
 
 #include <memory>
+#include <string>
 #include <tuple>
 #include <vector>
 
@@ -31,13 +32,30 @@ class Shader
 {
 private:
   GLuint m_shader;
+  std::string m_name;
 
 public:
   static ShaderPtr from_file(GLenum type, std::string const& filename,
                              std::vector<std::string> const& defines = {});
 
+  /** Returns the sources to compile for \a filename: the #version
+      line, the \a defines and the file itself with its #includes
+      expanded. The included files get appended to \a includes. */
+  static std::vector<std::string> load_source(std::string const& filename,
+                                              std::vector<std::string> const& defines = {},
+                                              std::vector<std::string>* includes = nullptr);
+
+  /** Compiles \a sources, \a name is only used in error messages */
+  static ShaderPtr from_source(GLenum type, std::vector<std::string> const& sources,
+                               std::string const& name);
+
+  /** Like from_source(), but doesn't wait for the compile to finish,
+      errors are reported by check() */
+  static ShaderPtr submit(GLenum type, std::vector<std::string> const& sources,
+                          std::string const& name);
+
 public:
-  Shader(GLenum type);
+  Shader(GLenum type, std::string const& name = {});
   ~Shader();
 
   void source(std::vector<std::string> const& sources);
@@ -47,6 +65,9 @@ public:
   std::string get_info_log() const;
   bool get_compile_status() const;
 
+  /** Throws when the compile failed, blocks until it is done */
+  void check() const;
+
   GLuint get_id() const { return m_shader; }
 
 private:
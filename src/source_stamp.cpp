@@ -0,0 +1,55 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "source_stamp.hpp"
+
+#include <errno.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "format.hpp"
+#include "mapped_file.hpp"
+
+SourceStamp
+SourceStamp::from_file(const std::string& filename)
+{
+  struct stat st;
+  if (stat(filename.c_str(), &st) < 0)
+  {
+    throw std::runtime_error(format("%s: couldn't stat file: %s", filename, strerror(errno)));
+  }
+
+  return { static_cast<uint64_t>(st.st_size),
+           static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec };
+}
+
+uint64_t
+SourceStamp::hash_file(const std::string& filename)
+{
+  MappedFile file(filename);
+  uint64_t hash = 14695981039346656037ull;
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(file.get_data());
+  const unsigned char* end = p + file.get_size();
+  for(; p != end; ++p)
+  {
+    hash ^= *p;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+/* EOF */
@@ -0,0 +1,40 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_SOURCE_STAMP_HPP
+#define HEADER_SOURCE_STAMP_HPP
+
+#include <stdint.h>
+#include <string>
+
+/** Size and modification time of the source file of a cache, a cache
+    is current when they match, or when the content still hashes to
+    the stored value */
+struct SourceStamp
+{
+  uint64_t size;
+  int64_t mtime;
+
+  /** Throws when the file can't be stat'ed */
+  static SourceStamp from_file(const std::string& filename);
+
+  /** FNV-1a of the file content */
+  static uint64_t hash_file(const std::string& filename);
+};
+
+#endif
+
+/* EOF */
@@ -22,6 +22,8 @@
 #include "assert_gl.hpp"
 #include "material_factory.hpp"
 #include "opengl_state.hpp"
+#include "pixel_convert.hpp"
+#include "program_cache.hpp"
 
 std::shared_ptr<TextSurface>
 TextSurface::create(const std::string& text, TextProperties const& text_props)
@@ -37,8 +39,8 @@ TextSurface::create(const std::string& text, TextProperties const& text_props)
 
   MaterialPtr material = std::make_shared<Material>();
 
-  material->set_program(Program::create(Shader::from_file(GL_VERTEX_SHADER,   "src/glsl/basic_texture.vert"),
-                                        Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/basic_texture.frag")));
+  material->set_program(ProgramCache::get().create("src/glsl/basic_texture.vert",
+                                                   "src/glsl/basic_texture.frag"));
 
   material->enable(GL_BLEND);
   material->blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -57,7 +59,9 @@ TextSurface::TextSurface(MaterialPtr material, int width, int height,
   m_width(width),
   m_height(height),
   m_text_extents(text_extents),
-  m_font_extents(font_extents)
+  m_font_extents(font_extents),
+  m_mesh(),
+  m_mesh_position()
 {
 }
 
@@ -70,60 +74,39 @@ TextSurface::draw(RenderContext const& ctx, float x, float y, float z)
 {
   OpenGLState state;
 
-  m_material->apply(ctx);
-
-  x += static_cast<float>(m_text_extents.x_bearing);
-  y += static_cast<float>(m_text_extents.y_bearing);
-
-  GLint program;
-  glGetIntegerv(GL_CURRENT_PROGRAM, &program);
-
-  std::vector<glm::vec2> texcoords{
-    glm::vec2{ 0.0f, 1.0f },
-    glm::vec2{ 1.0f, 1.0f },
-    glm::vec2{ 1.0f, 0.0f },
-    glm::vec2{ 0.0f, 0.0f }
-  };
-
-  std::vector<glm::vec3> positions{
-    glm::vec3{ x, y + static_cast<float>(m_height), z },
-    glm::vec3{ x + static_cast<float>(m_width), y + static_cast<float>(m_height), z },
-    glm::vec3{ x + static_cast<float>(m_width), y, z },
-    glm::vec3{ x, y, z }
-  };
-
-  GLint texcoords_loc = glGetAttribLocation(program, "texcoord");
-  GLint positions_loc = glGetAttribLocation(program, "position");
-
-  assert(texcoords_loc != -1);
-  assert(positions_loc != -1);
-
-  GLuint positions_vbo;
-  GLuint texcoords_vbo;
-
-  glGenBuffers(1, &positions_vbo);
-  glGenBuffers(1, &texcoords_vbo);
-
-  glBindBuffer(GL_ARRAY_BUFFER, positions_vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(positions.front()) * positions.size(), positions.data(), GL_STATIC_DRAW);
-  glVertexAttribPointer(positions_loc, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-  glBindBuffer(GL_ARRAY_BUFFER, texcoords_vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(texcoords.front()) * texcoords.size(), texcoords.data(), GL_STATIC_DRAW);
-  glVertexAttribPointer(texcoords_loc, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-  glEnableVertexAttribArray(texcoords_loc);
-  glEnableVertexAttribArray(positions_loc);
-
-  glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+  if (!m_material->apply(ctx))
+  {
+    return;
+  }
 
-  glDisableVertexAttribArray(texcoords_loc);
-  glDisableVertexAttribArray(positions_loc);
+  if (!m_mesh || m_mesh_position != glm::vec3(x, y, z))
+  {
+    m_mesh_position = glm::vec3(x, y, z);
+
+    x += static_cast<float>(m_text_extents.x_bearing);
+    y += static_cast<float>(m_text_extents.y_bearing);
+
+    std::vector<glm::vec2> texcoords{
+      glm::vec2{ 0.0f, 1.0f },
+      glm::vec2{ 1.0f, 1.0f },
+      glm::vec2{ 1.0f, 0.0f },
+      glm::vec2{ 0.0f, 0.0f }
+    };
+
+    std::vector<glm::vec3> positions{
+      glm::vec3{ x, y + static_cast<float>(m_height), z },
+      glm::vec3{ x + static_cast<float>(m_width), y + static_cast<float>(m_height), z },
+      glm::vec3{ x + static_cast<float>(m_width), y, z },
+      glm::vec3{ x, y, z }
+    };
+
+    // a Mesh brings its own vertex array object, the default one is
+    // not usable in a core profile
+    m_mesh = std::make_unique<Mesh>(GL_TRIANGLE_FAN);
+    m_mesh->attach_interleaved({ { "position", positions }, { "texcoord", texcoords } });
+  }
 
-  glDeleteBuffers(1, &texcoords_vbo);
-  glDeleteBuffers(1, &positions_vbo);
+  m_mesh->draw();
 }
 
 TexturePtr
@@ -142,30 +125,11 @@ TextSurface::create_opengl_texture(Cairo::RefPtr<Cairo::ImageSurface> surface)
   glBindTexture(GL_TEXTURE_2D, texture->get_id());
   assert_gl("Texture failure");
 
-  // flip RGBA to BGRA
+  // Cairo's premultiplied BGRA to straight RGBA
   for(int y = 0; y < surface->get_height(); ++y)
   {
-    uint8_t* pixels = surface->get_data() + surface->get_stride() * y;
-
-    for(int x = 0; x < surface->get_width()*4; x += 4)
-    {
-      uint8_t r = pixels[x+0];
-      uint8_t g = pixels[x+1];
-      uint8_t b = pixels[x+2];
-      uint8_t a = pixels[x+3];
-
-      // removing pre-multiplayed alpha
-      if (a != 0)
-      {
-        pixels[x+0] = static_cast<uint8_t>(b * 255 / a);
-        pixels[x+1] = static_cast<uint8_t>(g * 255 / a);
-        pixels[x+2] = static_cast<uint8_t>(r * 255 / a);
-      }
-
-      // debug foobar
-      //if (pixels[x+3] == 0)
-      //  pixels[x+3] = 32;
-    }
+    PixelConvert::unpremultiply_bgra(surface->get_data() + surface->get_stride() * y,
+                                     surface->get_width());
   }
 
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
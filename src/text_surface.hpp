@@ -32,6 +32,7 @@
 #include "texture.hpp"
 #include "material.hpp"
 
+class Mesh;
 class RenderContext;
 class TextSurface;
 
@@ -96,6 +97,11 @@ private:
   Cairo::TextExtents m_text_extents;
   Cairo::FontExtents m_font_extents;
 
+  /** The quad of the last draw() and where it was drawn, rebuilt
+      only when the text moves */
+  std::unique_ptr<Mesh> m_mesh;
+  glm::vec3 m_mesh_position;
+
 public:
   TextSurface(const TextSurface&) = delete;
   TextSurface& operator=(const TextSurface&) = delete;
@@ -1,47 +1,56 @@
 #include "texture.hpp"
 
-#include <SDL.h>
-#include <SDL_image.h>
-#include <assert.h>
+#include <algorithm>
 #include <math.h>
 #include <stdexcept>
-#include <string.h>
 #include <vector>
 
 #include "log.hpp"
 #include "assert_gl.hpp"
+#include "mipmap.hpp"
 #include "opengl_state.hpp"
+#include "texture_cache_file.hpp"
+#include "thread_pool.hpp"
 
 namespace {
 
-void flip_rgb(SDL_Surface* surface)
+TextureFormat get_image_format(const Image& image)
 {
-  for(int y = 0; y < surface->h; ++y)
-    for(int x = 0; x < surface->w; ++x)
-    {
-      uint8_t* p = static_cast<uint8_t*>(surface->pixels) + y * surface->pitch + x * surface->format->BytesPerPixel;
-      std::swap(p[0], p[2]);
-    }
+  return (image.bytes_per_pixel == 4) ? TextureFormat::RGBA8 : TextureFormat::RGB8;
 }
 
-void vflip_surface(SDL_Surface* surface)
+/** Format of the pixels handed to glTexSubImage2D() */
+GLenum get_pixel_format(TextureFormat format)
 {
-  size_t len = surface->w * surface->format->BytesPerPixel;
-  std::vector<uint8_t> tmp_vec(len);
-  for(int y = 0; y < surface->h/2; ++y)
+  return (format == TextureFormat::RGBA8) ? GL_RGBA : GL_RGB;
+}
+
+GLenum get_internal_format(TextureFormat format)
+{
+  switch(format)
   {
-    uint8_t* src = static_cast<uint8_t*>(surface->pixels) + y * surface->pitch;
-    uint8_t* dst = static_cast<uint8_t*>(surface->pixels) + (surface->h - y - 1) * surface->pitch;
-    uint8_t* tmp = tmp_vec.data();
-    memcpy(tmp, src, len);
-    memcpy(src, dst, len);
-    memcpy(dst, tmp, len);
+#ifndef HAVE_OPENGLES2
+    case TextureFormat::BC1:
+      return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+    case TextureFormat::BC3:
+      return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+    case TextureFormat::RGTC1:
+      return GL_COMPRESSED_RED_RGTC1;
+
+    default:
+      return GL_RGB8;
+#else
+    default:
+      // OpenGL ES 2 wants the internal format to match the pixels
+      return get_pixel_format(format);
+#endif
   }
 }
 
 } // namespace
 
-
 TexturePtr
 Texture::create_empty(GLenum target, GLenum format, int width, int height)
 {
@@ -110,43 +119,25 @@ Texture::create_random_noise(int width, int height)
 {
   OpenGLState state;
 
-  GLuint texture;
-
-  glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
-
-#ifndef HAVE_OPENGLES2
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
-#endif
-
-  std::vector<uint8_t> data(width*height*3);
+  Image image(width, height, 3);
+  std::vector<uint8_t>& data = image.pixels;
 
   for(size_t i = 0; i < sizeof(data); i+=3)
   {
     data[i+0] = data[i+1] = data[i+2] = rand() % 255;
   }
 
-#ifndef HAVE_OPENGLES2
-  gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGB, width, height, GL_RGB, GL_UNSIGNED_BYTE, data.data());
-  assert_gl("texture0()");
-#endif
-
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  assert_gl("texture-0()");
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  assert_gl("texture-1()");
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  assert_gl("texture-2()");
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  assert_gl("texture1()");
+  TexturePtr texture = create_storage(GL_TEXTURE_2D, TextureFormat::RGB8, width, height,
+                                      Mipmap::get_num_levels(width, height), GL_CLAMP_TO_EDGE);
+  texture->upload_levels(0, Mipmap::generate(std::move(image)));
 
 #ifndef HAVE_OPENGLES2
+  glBindTexture(GL_TEXTURE_2D, texture->get_id());
   glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 8.0f);
   assert_gl("texture2()");
 #endif
 
-  return std::make_shared<Texture>(GL_TEXTURE_2D, texture);
+  return texture;
 }
 
 TexturePtr
@@ -154,18 +145,10 @@ Texture::create_lightspot(int width, int height)
 {
   OpenGLState state;
 
-  GLuint texture;
-
-  glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
-
   const int pitch = width * 3;
-#ifndef HAVE_OPENGLES2
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
-#endif
 
-  std::vector<uint8_t> data(width*height*3);
+  Image image(width, height, 3);
+  std::vector<uint8_t>& data = image.pixels;
   for(int y = 0; y < height; ++y)
     for(int x = 0; x < width; ++x)
     {
@@ -179,217 +162,249 @@ Texture::create_lightspot(int width, int height)
       data[y * pitch + 3*x+2] = static_cast<uint8_t>(std::max(0.0f, std::min(f * 255.0f, 255.0f)));
     }
 
-#ifndef HAVE_OPENGLES2
-  gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGB, width, height, GL_RGB, GL_UNSIGNED_BYTE, data.data());
-  assert_gl("texture0()");
-#endif
-
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  TexturePtr texture = create_storage(GL_TEXTURE_2D, TextureFormat::RGB8, width, height,
+                                      Mipmap::get_num_levels(width, height), GL_CLAMP_TO_EDGE);
+  texture->upload_levels(0, Mipmap::generate(std::move(image)));
 
 #ifndef HAVE_OPENGLES2
+  glBindTexture(GL_TEXTURE_2D, texture->get_id());
   glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 8.0f);
 #endif
 
-  return std::make_shared<Texture>(GL_TEXTURE_2D, texture);
+  return texture;
 }
 
-namespace {
-SDL_Surface* surface_from_file(const std::string& filename)
+TexturePtr
+Texture::cubemap_from_file(const std::string& filename)
 {
-  SDL_Surface* surface = IMG_Load(filename.c_str());
-  if (!surface)
+  OpenGLState state;
+
+  // decode and filter the six faces in parallel, unless cached
+  TextureCacheFile::Options options = get_cache_options(GL_TEXTURE_CUBE_MAP, true);
+  std::vector<std::future<std::unique_ptr<TextureCacheFile> > > faces;
+  for(auto const& face_file : get_cubemap_files(filename))
   {
-    throw std::runtime_error("couldn't load " + filename);
+    faces.push_back(ThreadPool::get().schedule([face_file, options]{
+          return TextureCacheFile::load(face_file, options);
+        }));
   }
-  else
+
+  TexturePtr texture;
+  TextureFormat texture_format = TextureFormat::RGB8;
+  for(size_t face = 0; face < faces.size(); ++face)
   {
-    return surface;
+    std::unique_ptr<TextureCacheFile> cache = faces[face].get();
+    std::vector<TextureLevel> const& levels = cache->get_levels();
+    if (!texture)
+    {
+      // cube map faces are assumed to have the same size
+      texture = create_storage(GL_TEXTURE_CUBE_MAP, cache->get_format(), levels[0].width, levels[0].height,
+                               static_cast<int>(levels.size()), GL_CLAMP_TO_EDGE);
+      texture_format = cache->get_format();
+    }
+    else if (cache->get_format() != texture_format)
+    {
+      throw std::runtime_error(filename + ": cube map faces differ in format");
+    }
+    texture->upload_levels(static_cast<int>(face), cache->get_format(), levels);
   }
+
+  assert_gl("cube texture");
+
+  return texture;
 }
-} // namespace
 
 TexturePtr
-Texture::cubemap_from_file(const std::string& filename)
+Texture::from_file(const std::string& filename, bool build_mipmaps, bool exception_on_fail)
 {
   OpenGLState state;
 
-  SDL_Surface* up = surface_from_file(filename + "up.png");
-  SDL_Surface* dn = surface_from_file(filename + "dn.png");
-  SDL_Surface* ft = surface_from_file(filename + "ft.png");
-  SDL_Surface* bk = surface_from_file(filename + "bk.png");
-  SDL_Surface* lf = surface_from_file(filename + "lf.png");
-  SDL_Surface* rt = surface_from_file(filename + "rt.png");
-
-  assert(up);
-  assert(dn);
-  assert(ft);
-  assert(bk);
-  assert(lf);
-  assert(rt);
-
-  flip_rgb(up);
-  flip_rgb(dn);
-  flip_rgb(ft);
-  flip_rgb(bk);
-  flip_rgb(lf);
-  flip_rgb(rt);
+  std::unique_ptr<TextureCacheFile> cache;
+  try
+  {
+    cache = TextureCacheFile::load(filename, get_cache_options(GL_TEXTURE_2D, build_mipmaps));
+  }
+  catch(const std::exception& err)
+  {
+    if (exception_on_fail)
+    {
+      throw;
+    }
+    else
+    {
+      // create replacement texture
+      log_error("Texture: %s, using replacement texture", err.what());
+      Image image(32, 32, 4);
+      TexturePtr texture = create_storage(GL_TEXTURE_2D, TextureFormat::RGBA8, image.width, image.height, 1, GL_REPEAT);
+      texture->upload_levels(0, { image });
+      return texture;
+    }
+  }
 
-#ifndef HAVE_OPENGLES2
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, up->pitch / up->format->BytesPerPixel);
-#endif
+  std::vector<TextureLevel> const& levels = cache->get_levels();
+  TexturePtr texture = create_storage(GL_TEXTURE_2D, cache->get_format(), levels[0].width, levels[0].height,
+                                      static_cast<int>(levels.size()), GL_REPEAT);
+  texture->upload_levels(0, cache->get_format(), levels);
+  return texture;
+}
 
-  //glActiveTexture(GL_TEXTURE0);
-  //glEnable(GL_TEXTURE_CUBE_MAP);
+TexturePtr
+Texture::from_rgb_data(int width, int height, int pitch, void* data)
+{
+  OpenGLState state;
 
+  GLenum target = GL_TEXTURE_2D;
   GLuint texture;
-  GLenum target = GL_TEXTURE_CUBE_MAP;
   glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
-
-  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-#ifndef HAVE_OPENGLES2
-  glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-#endif
-
-#ifndef HAVE_OPENGLES2
-  gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_RGB, up->w, up->h, up->format->BytesPerPixel == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, up->pixels);
-  gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, GL_RGB, dn->w, dn->h, dn->format->BytesPerPixel == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, dn->pixels);
-
-  gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, GL_RGB, lf->w, lf->h, lf->format->BytesPerPixel == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, lf->pixels);
-  gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_RGB, rt->w, rt->h, rt->format->BytesPerPixel == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, rt->pixels);
-
-  gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, GL_RGB, ft->w, ft->h, ft->format->BytesPerPixel == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, ft->pixels);
-  gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, GL_RGB, bk->w, bk->h, bk->format->BytesPerPixel == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, bk->pixels);
-#endif
+  glBindTexture(target, texture);
 
 #ifndef HAVE_OPENGLES2
-  glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
-  glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 10);
-  glGenerateMipmap(target);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
 #endif
 
-  SDL_FreeSurface(up);
-  SDL_FreeSurface(dn);
-  SDL_FreeSurface(ft);
-  SDL_FreeSurface(bk);
-  SDL_FreeSurface(lf);
-  SDL_FreeSurface(rt);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-  assert_gl("cube texture");
+  glTexImage2D(target, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
 
   return std::make_shared<Texture>(target, texture);
 }
 
 TexturePtr
-Texture::from_file(const std::string& filename, bool build_mipmaps, bool exception_on_fail)
+Texture::create_storage(GLenum target, TextureFormat format, int width, int height, int levels, GLenum wrap)
 {
   OpenGLState state;
 
-  SDL_Surface* surface = IMG_Load(filename.c_str());
-  if (!surface)
+  int num_faces = (target == GL_TEXTURE_CUBE_MAP) ? 6 : 1;
+
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(target, texture);
+
+#ifndef HAVE_OPENGLES2
+  if (GLEW_ARB_texture_storage)
   {
-    if (exception_on_fail)
+    glTexStorage2D(target, levels, get_internal_format(format), width, height);
+  }
+  else
+#endif
+  {
+    if (is_compressed(format))
     {
-      throw std::runtime_error("Texture: couldn't open " + filename);
+      glDeleteTextures(1, &texture);
+      throw std::runtime_error("Texture: compressed textures need ARB_texture_storage");
     }
-    else
-    {
-      // create replacement texture
-      log_error("Texture: couldn't open %s, using replacement texture", filename);
-
-      Uint32 rmask = 0x000000ff;
-      Uint32 gmask = 0x0000ff00;
-      Uint32 bmask = 0x00ff0000;
-      Uint32 amask = 0xff000000;
 
-      surface = SDL_CreateRGBSurface(0, 32, 32, 32, rmask, gmask, bmask, amask);
-      if (!surface)
+    for(int level = 0; level < levels; ++level)
+      for(int face = 0; face < num_faces; ++face)
       {
-        log_error("Texture: SDL_CreateRGBSurface() failed: %s", SDL_GetError());
-        throw std::runtime_error("Texture: replacement texture creation failed");
+        glTexImage2D(get_face_target(target, face), level, get_internal_format(format),
+                     std::max(1, width >> level), std::max(1, height >> level), 0,
+                     get_pixel_format(format), GL_UNSIGNED_BYTE, nullptr);
       }
-    }
   }
 
-  { // create texture
-    vflip_surface(surface);
-
-    GLenum target = GL_TEXTURE_2D;
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(target, texture);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, (levels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
 
 #ifndef HAVE_OPENGLES2
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, surface->pitch / surface->format->BytesPerPixel);
-#endif
-
-    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, build_mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
 
-    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  if (format == TextureFormat::RGTC1)
+  {
+    // gray, red only in storage
+    glTexParameteri(target, GL_TEXTURE_SWIZZLE_G, GL_RED);
+    glTexParameteri(target, GL_TEXTURE_SWIZZLE_B, GL_RED);
+  }
 
-#ifndef HAVE_OPENGLES2
+  if (target == GL_TEXTURE_CUBE_MAP)
+  {
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, wrap);
+  }
+  else
+  {
     float max_anisotrophy = 0.0f;
     glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max_anisotrophy);
-    glTexParameteri(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, max_anisotrophy);
-
-    if (build_mipmaps)
-    {
-      gluBuild2DMipmaps(target, GL_RGB, surface->w, surface->h,
-                        surface->format->BytesPerPixel == 4 ? GL_RGBA : GL_RGB,
-                        GL_UNSIGNED_BYTE, surface->pixels);
-    }
-    else
-#endif
-    {
-      glTexImage2D(target, 0, GL_RGB, surface->w, surface->h, 0,
-#ifndef HAVE_OPENGLES2
-                   surface->format->BytesPerPixel == 4 ? GL_RGBA : GL_RGB,
-#else
-                   GL_RGB,
+    glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, max_anisotrophy);
+  }
 #endif
-                   GL_UNSIGNED_BYTE, surface->pixels);
-    }
 
-    SDL_FreeSurface(surface);
+  assert_gl("Texture::create_storage");
 
-    return std::make_shared<Texture>(target, texture);
+  // RGB is stored as RGBA
+  size_t memory_size = 0;
+  for(int level = 0; level < levels; ++level)
+  {
+    int level_width = std::max(1, width >> level);
+    int level_height = std::max(1, height >> level);
+    memory_size += is_compressed(format) ?
+      get_level_size(format, level_width, level_height) :
+      4 * static_cast<size_t>(level_width) * level_height;
   }
-}
 
+  return std::make_shared<Texture>(target, texture, memory_size * num_faces);
+}
 
-TexturePtr
-Texture::from_rgb_data(int width, int height, int pitch, void* data)
+TextureCacheFile::Options
+Texture::get_cache_options(GLenum target, bool build_mipmaps)
 {
-  OpenGLState state;
+  bool cubemap = (target == GL_TEXTURE_CUBE_MAP);
 
-  GLenum target = GL_TEXTURE_2D;
-  GLuint texture;
-  glGenTextures(1, &texture);
-  glBindTexture(target, texture);
+  // 2D textures are stored bottom row first, cube maps come in BGR
+  TextureCacheFile::Options options = { !cubemap, cubemap, build_mipmaps, false, false };
 
 #ifndef HAVE_OPENGLES2
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+  // compressed textures are only allocated through glTexStorage2D(),
+  // gray ones need a swizzle to come out gray instead of red. The six
+  // faces of a cube map have to share one format, so they never use
+  // RGTC1.
+  options.s3tc = GLEW_ARB_texture_storage && GLEW_EXT_texture_compression_s3tc;
+  options.rgtc = (options.s3tc && !cubemap &&
+                  GLEW_ARB_texture_compression_rgtc && GLEW_ARB_texture_swizzle);
 #endif
 
-  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  return options;
+}
 
-  glTexImage2D(target, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+GLenum
+Texture::get_face_target(GLenum target, int face)
+{
+  if (target != GL_TEXTURE_CUBE_MAP)
+  {
+    return target;
+  }
+  else
+  {
+    // same order as get_cubemap_files()
+    static const GLenum faces[] = {
+      GL_TEXTURE_CUBE_MAP_POSITIVE_Y, // up
+      GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, // dn
+      GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, // ft
+      GL_TEXTURE_CUBE_MAP_POSITIVE_Z, // bk
+      GL_TEXTURE_CUBE_MAP_NEGATIVE_X, // lf
+      GL_TEXTURE_CUBE_MAP_POSITIVE_X  // rt
+    };
+    return faces[face];
+  }
+}
 
-  return std::make_shared<Texture>(target, texture);
+std::vector<std::string>
+Texture::get_cubemap_files(const std::string& prefix)
+{
+  return {
+    prefix + "up.png",
+    prefix + "dn.png",
+    prefix + "ft.png",
+    prefix + "bk.png",
+    prefix + "lf.png",
+    prefix + "rt.png"
+  };
 }
 
 TexturePtr
@@ -400,9 +415,10 @@ Texture::create_handle(GLenum target)
   return std::make_shared<Texture>(target, texture);
 }
 
-Texture::Texture(GLenum target, GLuint id) :
+Texture::Texture(GLenum target, GLuint id, size_t memory_size) :
   m_target(target),
-  m_id(id)
+  m_id(id),
+  m_memory_size(memory_size)
 {
 }
 
@@ -411,6 +427,14 @@ Texture::~Texture()
   glDeleteTextures(1, &m_id);
 }
 
+void
+Texture::swap(Texture& other)
+{
+  std::swap(m_target, other.m_target);
+  std::swap(m_id, other.m_id);
+  std::swap(m_memory_size, other.m_memory_size);
+}
+
 void
 Texture::upload(int width, int height, int pitch, void* data)
 {
@@ -426,4 +450,50 @@ Texture::upload(int width, int height, int pitch, void* data)
   assert_gl("Texture::upload");
 }
 
+void
+Texture::upload_level(int face, int level, TextureFormat format, const TextureLevel& data)
+{
+  OpenGLState state;
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+#ifndef HAVE_OPENGLES2
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+
+  glBindTexture(m_target, m_id);
+#ifndef HAVE_OPENGLES2
+  if (is_compressed(format))
+  {
+    glCompressedTexSubImage2D(get_face_target(m_target, face), level, 0, 0, data.width, data.height,
+                              get_internal_format(format), static_cast<GLsizei>(data.size), data.data);
+  }
+  else
+#endif
+  {
+    glTexSubImage2D(get_face_target(m_target, face), level, 0, 0, data.width, data.height,
+                    get_pixel_format(format), GL_UNSIGNED_BYTE, data.data);
+  }
+  assert_gl("Texture::upload_level");
+}
+
+void
+Texture::upload_levels(int face, TextureFormat format, std::vector<TextureLevel> const& levels)
+{
+  for(size_t level = 0; level < levels.size(); ++level)
+  {
+    upload_level(face, static_cast<int>(level), format, levels[level]);
+  }
+}
+
+void
+Texture::upload_levels(int face, std::vector<Image> const& levels)
+{
+  for(size_t level = 0; level < levels.size(); ++level)
+  {
+    upload_level(face, static_cast<int>(level), get_image_format(levels[level]),
+                 { levels[level].width, levels[level].height,
+                   levels[level].pixels.data(), levels[level].pixels.size() });
+  }
+}
+
 /* EOF */
@@ -3,8 +3,12 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "image.hpp"
 #include "opengl.hpp"
+#include "texture_cache_file.hpp"
+#include "texture_format.hpp"
 
 class Texture;
 
@@ -15,6 +19,7 @@ class Texture
 private:
   GLenum m_target;
   GLuint m_id;
+  size_t m_memory_size;
 
 public:
   static TexturePtr cubemap_from_file(const std::string& filename);
@@ -26,15 +31,48 @@ public:
   static TexturePtr create_shadowmap(int width, int height);
   static TexturePtr create_handle(GLenum target);
 
+  /** Allocate \a levels mipmap levels of \a format, for all faces of a
+      cube map, immutable where ARB_texture_storage is available, which
+      compressed formats require. The content is filled in with
+      upload_level(). */
+  static TexturePtr create_storage(GLenum target, TextureFormat format, int width, int height,
+                                   int levels, GLenum wrap);
+
+  /** How image files for \a target are transcoded, compressed where
+      the OpenGL implementation supports it */
+  static TextureCacheFile::Options get_cache_options(GLenum target, bool build_mipmaps);
+
+  /** Upload target of \a face, the faces of a cube map are in the
+      order of get_cubemap_files() */
+  static GLenum get_face_target(GLenum target, int face);
+
+  /** The six face images of a cube map, \a prefix + up.png, dn.png, ... */
+  static std::vector<std::string> get_cubemap_files(const std::string& prefix);
+
 public:
-  Texture(GLenum target, GLuint id);
+  Texture(GLenum target, GLuint id, size_t memory_size = 0);
   ~Texture();
 
   GLuint get_id() const { return m_id; }
   GLenum get_target() const { return m_target; }
 
+  /** Estimated size of the texture in video memory, 0 if unknown */
+  size_t get_memory_size() const { return m_memory_size; }
+
   void upload(int width, int height, int pitch, void* data);
 
+  /** Fill \a level of \a face of a texture from create_storage(),
+      \a format has to match the one it was created with */
+  void upload_level(int face, int level, TextureFormat format, const TextureLevel& data);
+
+  /** Upload a chain from a TextureCacheFile or Mipmap::generate() */
+  void upload_levels(int face, TextureFormat format, std::vector<TextureLevel> const& levels);
+  void upload_levels(int face, std::vector<Image> const& levels);
+
+  /** Exchange the OpenGL objects of the two textures, this swaps a
+      reloaded texture into place without touching its users */
+  void swap(Texture& other);
+
 private:
   Texture(const Texture&);
   Texture& operator=(const Texture&);
@@ -0,0 +1,180 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "texture_cache.hpp"
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "file_watcher.hpp"
+#include "format.hpp"
+#include "log.hpp"
+#include "texture_uploader.hpp"
+
+TextureCache::TextureCache() :
+  m_textures(),
+  m_hits(0),
+  m_misses(0),
+  m_bytes_saved(0),
+  m_reloads(0),
+  m_watched()
+{
+}
+
+TexturePtr
+TextureCache::from_file(const std::string& filename, bool build_mipmaps)
+{
+  // missing files still get a key, they stay with the placeholder
+  std::string path = FileWatcher::canonical_path(filename);
+  std::string key = format("2d:%d:%s", build_mipmaps ? 1 : 0, path);
+  return lookup(key, Entry{ {}, filename, path, false, build_mipmaps, 0 },
+                [&]{ return TextureUploader::get().load(filename, build_mipmaps); });
+}
+
+TexturePtr
+TextureCache::cubemap_from_file(const std::string& filename)
+{
+  // filename is a prefix for the six faces, not a file itself
+  std::string path = FileWatcher::canonical_path(filename);
+  std::string key = format("cube:%s", path);
+  return lookup(key, Entry{ {}, filename, path, true, true, 0 },
+                [&]{ return TextureUploader::get().load_cubemap(filename); });
+}
+
+template<typename Create>
+TexturePtr
+TextureCache::lookup(const std::string& key, Entry entry, const Create& create)
+{
+  auto it = m_textures.find(key);
+  if (it != m_textures.end())
+  {
+    if (TexturePtr texture = it->second.texture.lock())
+    {
+      m_hits += 1;
+      if (texture->get_memory_size() == 0)
+      {
+        it->second.pending_hits += 1;
+      }
+      else
+      {
+        m_bytes_saved += texture->get_memory_size() * (1 + it->second.pending_hits);
+        it->second.pending_hits = 0;
+      }
+      return texture;
+    }
+  }
+
+  m_misses += 1;
+  purge();
+
+  TexturePtr texture = create();
+  entry.texture = texture;
+
+  if (entry.cubemap)
+  {
+    for(const char* face : { "up.png", "dn.png", "ft.png", "bk.png", "lf.png", "rt.png" })
+    {
+      watch(entry.filename + face);
+    }
+  }
+  else
+  {
+    watch(entry.filename);
+  }
+
+  m_textures[key] = std::move(entry);
+  return texture;
+}
+
+void
+TextureCache::watch(const std::string& filename)
+{
+  std::string path = FileWatcher::canonical_path(filename);
+  if (m_watched.insert(path).second)
+  {
+    FileWatcher::get().watch(path, [this](const std::string& changed){ reload(changed); });
+  }
+}
+
+void
+TextureCache::reload(const std::string& filename)
+{
+  for(auto& it : m_textures)
+  {
+    Entry& entry = it.second;
+    if (entry.cubemap ?
+        !boost::algorithm::starts_with(filename, entry.path) :
+        filename != entry.path)
+    {
+      continue;
+    }
+
+    if (TexturePtr texture = entry.texture.lock())
+    {
+      // the old image stays until the new one is uploaded, or for
+      // good if it fails to load
+      if (entry.cubemap)
+      {
+        TextureUploader::get().reload_cubemap(texture, entry.filename);
+      }
+      else
+      {
+        TextureUploader::get().reload(texture, entry.filename, entry.build_mipmaps);
+      }
+      m_reloads += 1;
+    }
+  }
+}
+
+void
+TextureCache::purge()
+{
+  for(auto it = m_textures.begin(); it != m_textures.end();)
+  {
+    if (it->second.texture.expired())
+    {
+      it = m_textures.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+size_t
+TextureCache::get_bytes_saved() const
+{
+  // the hits on textures that have finished loading since
+  size_t bytes = m_bytes_saved;
+  for(auto const& it : m_textures)
+  {
+    if (TexturePtr texture = it.second.texture.lock())
+    {
+      bytes += texture->get_memory_size() * it.second.pending_hits;
+    }
+  }
+  return bytes;
+}
+
+void
+TextureCache::log_stats() const
+{
+  log_info("TextureCache: %d hits, %d misses, %d reloads, %d entries, %.1fMiB saved",
+           m_hits, m_misses, m_reloads, m_textures.size(),
+           static_cast<float>(get_bytes_saved()) / (1024.0f * 1024.0f));
+}
+
+/* EOF */
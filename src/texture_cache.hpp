@@ -0,0 +1,105 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_TEXTURE_CACHE_HPP
+#define HEADER_TEXTURE_CACHE_HPP
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "texture.hpp"
+
+/** Hands out shared Textures for image files, so that materials
+    referencing the same file share a single copy on the GPU. The
+    images are loaded by the TextureUploader, a Texture is handed out
+    right away and filled in later. The cache only holds weak
+    references, a Texture is freed once the last Material using it is
+    gone. Image files are watched, an edited image is reloaded into
+    the existing Texture. Like all OpenGL code this must only be used
+    from the render thread. */
+class TextureCache
+{
+public:
+  static TextureCache& get()
+  {
+    static TextureCache instance;
+    return instance;
+  }
+
+private:
+  struct Entry
+  {
+    std::weak_ptr<Texture> texture;
+
+    /** What to pass to Texture::from_file() or cubemap_from_file() on
+        reload, the cube map path is the prefix of its six faces */
+    std::string filename;
+    std::string path;
+    bool cubemap;
+    bool build_mipmaps;
+
+    /** Hits while the texture was still the placeholder, whose size
+        isn't known before the upload finishes */
+    int pending_hits;
+  };
+
+  /** Keyed by canonical path, target and sampling parameters */
+  std::unordered_map<std::string, Entry> m_textures;
+
+  int m_hits;
+  int m_misses;
+  size_t m_bytes_saved;
+  int m_reloads;
+
+  /** Files registered with the FileWatcher */
+  std::unordered_set<std::string> m_watched;
+
+public:
+  TextureCache();
+
+  TexturePtr from_file(const std::string& filename, bool build_mipmaps = true);
+  TexturePtr cubemap_from_file(const std::string& filename);
+
+  int get_hits() const { return m_hits; }
+  int get_misses() const { return m_misses; }
+
+  /** Video memory that would have been used without the cache */
+  size_t get_bytes_saved() const;
+
+  void log_stats() const;
+
+private:
+  template<typename Create>
+  TexturePtr lookup(const std::string& key, Entry entry, const Create& create);
+
+  void watch(const std::string& filename);
+
+  /** Reload every Texture created from \a filename */
+  void reload(const std::string& filename);
+
+  /** Drop the entries of textures that are no longer used */
+  void purge();
+
+private:
+  TextureCache(const TextureCache&) = delete;
+  TextureCache& operator=(const TextureCache&) = delete;
+};
+
+#endif
+
+/* EOF */
@@ -0,0 +1,320 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "texture_cache_file.hpp"
+
+#include <errno.h>
+#include <fstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "block_compressor.hpp"
+#include "format.hpp"
+#include "image.hpp"
+#include "log.hpp"
+#include "mapped_file.hpp"
+#include "mipmap.hpp"
+#include "source_stamp.hpp"
+
+namespace {
+
+const char g_magic[4] = { 'T', 'E', 'X', 'C' };
+
+struct FileHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t source_size;
+  int64_t source_mtime;
+  uint64_t source_hash;
+  uint32_t options;
+  uint32_t format;
+  uint32_t level_count;
+  uint32_t reserved;
+};
+
+struct LevelRecord
+{
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+  uint64_t size;
+};
+
+uint32_t get_option_bits(const TextureCacheFile::Options& options)
+{
+  return ((options.vflip ? 1u : 0u) |
+          (options.swap_red_blue ? 2u : 0u) |
+          (options.build_mipmaps ? 4u : 0u) |
+          (options.s3tc ? 8u : 0u) |
+          (options.s3tc && options.rgtc ? 16u : 0u));
+}
+
+size_t align16(size_t v)
+{
+  return (v + 15) & ~static_cast<size_t>(15);
+}
+
+} // namespace
+
+std::string
+TextureCacheFile::get_cache_filename(const std::string& filename, const Options& options)
+{
+  return format("%s.%02x.texc", filename, get_option_bits(options));
+}
+
+std::unique_ptr<TextureCacheFile>
+TextureCacheFile::open(const std::string& filename, const Options& options)
+{
+  std::string cache_filename = get_cache_filename(filename, options);
+
+  struct stat st;
+  if (stat(cache_filename.c_str(), &st) < 0)
+  {
+    return {};
+  }
+
+  try
+  {
+    auto file = std::make_unique<MappedFile>(cache_filename);
+
+    FileHeader header;
+    if (file->get_size() < sizeof(header))
+    {
+      throw std::runtime_error("file too short");
+    }
+    memcpy(&header, file->get_data(), sizeof(header));
+
+    if (memcmp(header.magic, g_magic, sizeof(g_magic)) != 0)
+    {
+      throw std::runtime_error("not a texture cache");
+    }
+    else if (header.version != s_version)
+    {
+      log_info("%s: version %d is outdated", cache_filename, header.version);
+      return {};
+    }
+    else if (header.options != get_option_bits(options))
+    {
+      return {};
+    }
+
+    SourceStamp stamp = SourceStamp::from_file(filename);
+    if (stamp.size != header.source_size)
+    {
+      return {};
+    }
+    else if (stamp.mtime != header.source_mtime &&
+             SourceStamp::hash_file(filename) != header.source_hash)
+    {
+      return {};
+    }
+    else
+    {
+      return std::make_unique<TextureCacheFile>(std::move(file));
+    }
+  }
+  catch(const std::exception& err)
+  {
+    log_warn("%s: ignoring broken texture cache: %s", cache_filename, err.what());
+    return {};
+  }
+}
+
+std::unique_ptr<TextureCacheFile>
+TextureCacheFile::create(const std::string& filename, const Options& options)
+{
+  SourceStamp stamp = SourceStamp::from_file(filename);
+
+  Image image = Image::from_file(filename, options.vflip, options.swap_red_blue);
+
+  TextureFormat texture_format;
+  if (options.s3tc)
+  {
+    texture_format = BlockCompressor::choose_format(image, options.rgtc);
+  }
+  else
+  {
+    texture_format = (image.bytes_per_pixel == 4) ? TextureFormat::RGBA8 : TextureFormat::RGB8;
+  }
+
+  std::vector<Image> levels;
+  if (options.build_mipmaps)
+  {
+    levels = Mipmap::generate(std::move(image));
+  }
+  else
+  {
+    levels.push_back(std::move(image));
+  }
+
+  FileHeader header;
+  memcpy(header.magic, g_magic, sizeof(g_magic));
+  header.version = s_version;
+  header.source_size = stamp.size;
+  header.source_mtime = stamp.mtime;
+  header.source_hash = SourceStamp::hash_file(filename);
+  header.options = get_option_bits(options);
+  header.format = static_cast<uint32_t>(texture_format);
+  header.level_count = static_cast<uint32_t>(levels.size());
+  header.reserved = 0;
+
+  std::vector<char> data(align16(sizeof(FileHeader) + sizeof(LevelRecord) * levels.size()));
+  memcpy(data.data(), &header, sizeof(header));
+
+  for(size_t i = 0; i < levels.size(); ++i)
+  {
+    std::vector<uint8_t> compressed;
+    const std::vector<uint8_t>* pixels = &levels[i].pixels;
+    if (is_compressed(texture_format))
+    {
+      compressed = BlockCompressor::compress(levels[i], texture_format);
+      pixels = &compressed;
+    }
+
+    LevelRecord record = { static_cast<uint32_t>(levels[i].width),
+                           static_cast<uint32_t>(levels[i].height),
+                           data.size(), pixels->size() };
+    memcpy(data.data() + sizeof(FileHeader) + sizeof(LevelRecord) * i, &record, sizeof(record));
+
+    data.insert(data.end(), pixels->begin(), pixels->end());
+    data.resize(align16(data.size()));
+  }
+
+  // write to a temporary file first, so that a concurrent or aborted
+  // run never sees a half written cache, the name is unique to this
+  // thread as several may be creating the same cache at once
+  std::string cache_filename = get_cache_filename(filename, options);
+  std::string tmp_filename = format("%s.%d.%s.tmp", cache_filename, getpid(), std::this_thread::get_id());
+  try
+  {
+    {
+      std::ofstream out(tmp_filename, std::ios::binary);
+      if (!out)
+      {
+        throw std::runtime_error(format("%s: couldn't open for writing", tmp_filename));
+      }
+
+      out.write(data.data(), data.size());
+      if (!out)
+      {
+        throw std::runtime_error(format("%s: write error", tmp_filename));
+      }
+    }
+
+    if (rename(tmp_filename.c_str(), cache_filename.c_str()) < 0)
+    {
+      int err = errno;
+      remove(tmp_filename.c_str());
+      throw std::runtime_error(format("%s: couldn't rename: %s", cache_filename, strerror(err)));
+    }
+  }
+  catch(const std::exception& err)
+  {
+    // a read-only data directory just means transcoding on every run
+    log_warn("couldn't save texture cache: %s", err.what());
+  }
+
+  return std::make_unique<TextureCacheFile>(std::move(data));
+}
+
+std::unique_ptr<TextureCacheFile>
+TextureCacheFile::load(const std::string& filename, const Options& options)
+{
+  std::unique_ptr<TextureCacheFile> cache = open(filename, options);
+  if (cache)
+  {
+    return cache;
+  }
+  else
+  {
+    return create(filename, options);
+  }
+}
+
+TextureCacheFile::TextureCacheFile(std::unique_ptr<MappedFile> file) :
+  m_file(std::move(file)),
+  m_data(),
+  m_format(),
+  m_levels()
+{
+  parse(m_file->get_data(), m_file->get_size());
+}
+
+TextureCacheFile::TextureCacheFile(std::vector<char> data) :
+  m_file(),
+  m_data(std::move(data)),
+  m_format(),
+  m_levels()
+{
+  parse(m_data.data(), m_data.size());
+}
+
+TextureCacheFile::~TextureCacheFile()
+{
+}
+
+void
+TextureCacheFile::parse(const char* data, size_t size)
+{
+  FileHeader header;
+  memcpy(&header, data, sizeof(header));
+
+  if (header.format > static_cast<uint32_t>(TextureFormat::RGTC1))
+  {
+    throw std::runtime_error("unknown texture format");
+  }
+  m_format = static_cast<TextureFormat>(header.format);
+
+  if (header.level_count == 0 ||
+      header.level_count > (size - sizeof(header)) / sizeof(LevelRecord))
+  {
+    throw std::runtime_error("level table out of range");
+  }
+
+  for(uint32_t i = 0; i < header.level_count; ++i)
+  {
+    LevelRecord record;
+    memcpy(&record, data + sizeof(header) + sizeof(LevelRecord) * i, sizeof(record));
+
+    if (record.offset > size ||
+        record.size > size - record.offset ||
+        record.size != get_level_size(m_format, record.width, record.height))
+    {
+      throw std::runtime_error("level out of range");
+    }
+
+    m_levels.push_back({ static_cast<int>(record.width), static_cast<int>(record.height),
+                         data + record.offset, static_cast<size_t>(record.size) });
+  }
+}
+
+size_t
+TextureCacheFile::get_size() const
+{
+  size_t size = 0;
+  for(auto const& level : m_levels)
+  {
+    size += level.size;
+  }
+  return size;
+}
+
+/* EOF */
@@ -0,0 +1,104 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_TEXTURE_CACHE_FILE_HPP
+#define HEADER_TEXTURE_CACHE_FILE_HPP
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "texture_format.hpp"
+
+class MappedFile;
+
+/** Binary sidecar (.texc) of an image file, holding the flipped, mip
+    mapped and possibly block compressed texture, so that later loads
+    are an mmap() and an upload. Written on the first load or ahead of
+    time with 'viewer --transcode-textures'. */
+class TextureCacheFile
+{
+public:
+  /** Bump whenever the file layout or the encoding changes */
+  static const uint32_t s_version = 1;
+
+  /** How the image is turned into texture data, a cache written with
+      different options is not used */
+  struct Options
+  {
+    bool vflip;
+    bool swap_red_blue;
+    bool build_mipmaps;
+
+    /** Store BC1 or BC3 instead of raw pixels */
+    bool s3tc;
+
+    /** Store gray images as RGTC1, only with s3tc */
+    bool rgtc;
+  };
+
+  /** Each combination of \a options gets a file of its own, so that
+      the same image used in different ways doesn't keep overwriting
+      its cache */
+  static std::string get_cache_filename(const std::string& filename, const Options& options);
+
+  /** Returns the cache for the image \a filename or nullptr when it
+      doesn't exist, is damaged, out of date or doesn't match \a
+      options */
+  static std::unique_ptr<TextureCacheFile> open(const std::string& filename, const Options& options);
+
+  /** Decode, filter and compress the image \a filename and write its
+      cache, a failed write is only logged. Thread-safe, throws when
+      the image can't be loaded. */
+  static std::unique_ptr<TextureCacheFile> create(const std::string& filename, const Options& options);
+
+  /** open() with a fallback to create() */
+  static std::unique_ptr<TextureCacheFile> load(const std::string& filename, const Options& options);
+
+private:
+  /** Either the mapped cache or a freshly created one in memory */
+  std::unique_ptr<MappedFile> m_file;
+  std::vector<char> m_data;
+
+  TextureFormat m_format;
+  std::vector<TextureLevel> m_levels;
+
+public:
+  TextureCacheFile(std::unique_ptr<MappedFile> file);
+  TextureCacheFile(std::vector<char> data);
+  ~TextureCacheFile();
+
+  TextureFormat get_format() const { return m_format; }
+
+  /** Level 0 is the full size image, the pointers stay valid as long
+      as the TextureCacheFile is alive */
+  std::vector<TextureLevel> const& get_levels() const { return m_levels; }
+
+  /** Bytes of all levels together */
+  size_t get_size() const;
+
+private:
+  void parse(const char* data, size_t size);
+
+private:
+  TextureCacheFile(const TextureCacheFile&) = delete;
+  TextureCacheFile& operator=(const TextureCacheFile&) = delete;
+};
+
+#endif
+
+/* EOF */
@@ -0,0 +1,79 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_TEXTURE_FORMAT_HPP
+#define HEADER_TEXTURE_FORMAT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Pixel layout of texture data in main memory and in the texture
+    cache files, independent of OpenGL */
+enum class TextureFormat : uint32_t
+{
+  RGB8,
+  RGBA8,
+
+  /** 4x4 blocks of 8 bytes, opaque color */
+  BC1,
+
+  /** 4x4 blocks of 16 bytes, color with alpha */
+  BC3,
+
+  /** 4x4 blocks of 8 bytes, single channel */
+  RGTC1
+};
+
+/** One mipmap level, \a data may be an offset into a pixel buffer
+    object instead of a pointer */
+struct TextureLevel
+{
+  int width;
+  int height;
+  const void* data;
+  size_t size;
+};
+
+inline bool is_compressed(TextureFormat format)
+{
+  return format != TextureFormat::RGB8 && format != TextureFormat::RGBA8;
+}
+
+/** Size in bytes of a \a width x \a height image in \a format */
+inline size_t get_level_size(TextureFormat format, int width, int height)
+{
+  size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+  switch(format)
+  {
+    case TextureFormat::RGB8:
+      return static_cast<size_t>(width) * height * 3;
+
+    case TextureFormat::RGBA8:
+      return static_cast<size_t>(width) * height * 4;
+
+    case TextureFormat::BC3:
+      return blocks * 16;
+
+    case TextureFormat::BC1:
+    case TextureFormat::RGTC1:
+    default:
+      return blocks * 8;
+  }
+}
+
+#endif
+
+/* EOF */
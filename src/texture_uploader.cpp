@@ -0,0 +1,381 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "texture_uploader.hpp"
+
+#include <stdexcept>
+#include <string.h>
+
+#include "assert_gl.hpp"
+#include "log.hpp"
+#include "opengl_state.hpp"
+
+namespace {
+
+float seconds_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+TextureUploader* TextureUploader::s_current = nullptr;
+
+TextureUploader&
+TextureUploader::get()
+{
+  if (!s_current)
+  {
+    throw std::runtime_error("TextureUploader: no OpenGL context");
+  }
+  return *s_current;
+}
+
+void
+TextureUploader::set_current(TextureUploader* uploader)
+{
+  s_current = uploader;
+}
+
+TextureUploader::TextureUploader(ThreadPool& pool, size_t num_slots) :
+  m_pool(pool),
+  m_jobs(),
+#ifndef HAVE_OPENGLES2
+  m_slots(num_slots, Slot{0, 0, nullptr}),
+  m_next_slot(0),
+#endif
+  m_budget(8 * 1024 * 1024),
+  m_textures(0),
+  m_bytes(0),
+  m_upload_time(0.0f),
+  m_start()
+{
+}
+
+TextureUploader::~TextureUploader()
+{
+#ifndef HAVE_OPENGLES2
+  for(auto& slot : m_slots)
+  {
+    if (slot.fence)
+    {
+      glDeleteSync(slot.fence);
+    }
+    if (slot.buffer)
+    {
+      glDeleteBuffers(1, &slot.buffer);
+    }
+  }
+#endif
+}
+
+TexturePtr
+TextureUploader::load(const std::string& filename, bool build_mipmaps)
+{
+  TexturePtr texture = create_placeholder(GL_TEXTURE_2D);
+  reload(texture, filename, build_mipmaps);
+  return texture;
+}
+
+TexturePtr
+TextureUploader::load_cubemap(const std::string& prefix)
+{
+  TexturePtr texture = create_placeholder(GL_TEXTURE_CUBE_MAP);
+  reload_cubemap(texture, prefix);
+  return texture;
+}
+
+void
+TextureUploader::reload(TexturePtr texture, const std::string& filename, bool build_mipmaps)
+{
+  queue(texture, GL_TEXTURE_2D, build_mipmaps, filename, { filename });
+}
+
+void
+TextureUploader::reload_cubemap(TexturePtr texture, const std::string& prefix)
+{
+  queue(texture, GL_TEXTURE_CUBE_MAP, true, prefix, Texture::get_cubemap_files(prefix));
+}
+
+void
+TextureUploader::queue(TexturePtr handle, GLenum target, bool build_mipmaps,
+                       const std::string& filename, std::vector<std::string> const& face_files)
+{
+  if (m_jobs.empty())
+  {
+    m_start = std::chrono::steady_clock::now();
+    m_textures = 0;
+    m_bytes = 0;
+    m_upload_time = 0.0f;
+  }
+
+  Job job{ handle, target, build_mipmaps, filename, {}, 0, {}, TextureFormat::RGB8, 0, 0, 0 };
+
+  // the six faces of a cube map load or transcode in parallel
+  TextureCacheFile::Options options = Texture::get_cache_options(target, build_mipmaps);
+  for(auto const& face_file : face_files)
+  {
+    job.faces.push_back(m_pool.schedule([face_file, options]{
+          return std::shared_ptr<TextureCacheFile>(TextureCacheFile::load(face_file, options));
+        }).share());
+  }
+
+  m_jobs.push_back(std::move(job));
+}
+
+void
+TextureUploader::update()
+{
+  if (m_jobs.empty())
+  {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  size_t uploaded = 0;
+  bool slots_full = false;
+  for(auto it = m_jobs.begin(); it != m_jobs.end() && !slots_full && (uploaded == 0 || uploaded < m_budget);)
+  {
+    Job& job = *it;
+    bool failed = false;
+
+    while(job.next_face < job.faces.size() && (uploaded == 0 || uploaded < m_budget))
+    {
+      std::shared_future<std::shared_ptr<TextureCacheFile> >& face = job.faces[job.next_face];
+      if (face.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      {
+        break;
+      }
+
+      std::shared_ptr<TextureCacheFile> cache;
+      try
+      {
+        cache = face.get();
+      }
+      catch(const std::exception& err)
+      {
+        log_error("TextureUploader: %s", err.what());
+        failed = true;
+        break;
+      }
+
+      if (job.texture && cache->get_format() != job.format)
+      {
+        log_error("TextureUploader: %s: cube map faces differ in format", job.filename);
+        failed = true;
+        break;
+      }
+
+      std::vector<TextureLevel> const& levels = cache->get_levels();
+      if (levels.empty())
+      {
+        log_error("TextureUploader: %s: image has no levels", job.filename);
+        failed = true;
+        break;
+      }
+
+      if (job.texture &&
+          (levels[0].width != job.width || levels[0].height != job.height ||
+           static_cast<int>(levels.size()) != job.levels))
+      {
+        log_error("TextureUploader: %s: cube map face %d is %dx%d with %d levels, expected %dx%d with %d levels",
+                  job.filename, job.next_face, levels[0].width, levels[0].height, levels.size(),
+                  job.width, job.height, job.levels);
+        failed = true;
+        break;
+      }
+
+      UploadResult result;
+      try
+      {
+        result = upload_face(job, *cache);
+      }
+      catch(const std::exception& err)
+      {
+        // a broken asset shouldn't take down the frame
+        log_error("TextureUploader: %s: %s", job.filename, err.what());
+#ifndef HAVE_OPENGLES2
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+#endif
+        result = UploadResult::Failed;
+      }
+
+      if (result == UploadResult::Busy)
+      {
+        slots_full = true;
+        break;
+      }
+      else if (result == UploadResult::Failed)
+      {
+        failed = true;
+        break;
+      }
+
+      uploaded += cache->get_size();
+      m_bytes += cache->get_size();
+
+      // drop the mapping
+      face = std::shared_future<std::shared_ptr<TextureCacheFile> >();
+      job.next_face += 1;
+    }
+
+    if (failed)
+    {
+      // the handle keeps what it had, the placeholder or the old image
+      it = m_jobs.erase(it);
+    }
+    else if (job.next_face == job.faces.size())
+    {
+      finish(job);
+      it = m_jobs.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  m_upload_time += seconds_since(start);
+
+  if (m_jobs.empty())
+  {
+    log_stats();
+  }
+}
+
+TextureUploader::UploadResult
+TextureUploader::upload_face(Job& job, const TextureCacheFile& face)
+{
+  std::vector<TextureLevel> levels = face.get_levels();
+
+#ifndef HAVE_OPENGLES2
+  Slot& slot = m_slots[m_next_slot];
+  if (slot.fence)
+  {
+    if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+      return UploadResult::Busy;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+  }
+
+  if (!slot.buffer)
+  {
+    glGenBuffers(1, &slot.buffer);
+  }
+
+  size_t size = face.get_size();
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+  if (size > slot.capacity)
+  {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    slot.capacity = size;
+  }
+
+  uint8_t* dst = static_cast<uint8_t*>(
+    glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+  if (!dst)
+  {
+    // the handle keeps what it had, same as with a failed decode
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    log_error("TextureUploader: %s: glMapBufferRange() failed", job.filename);
+    return UploadResult::Failed;
+  }
+
+  // all levels back to back, with a buffer bound the level pointers
+  // are offsets into it
+  size_t offset = 0;
+  for(auto& level : levels)
+  {
+    memcpy(dst + offset, level.data, level.size);
+    level.data = reinterpret_cast<const void*>(offset);
+    offset += level.size;
+  }
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+#endif
+
+  if (!job.texture)
+  {
+    // update() checks the other cube map faces against this one
+    job.texture = Texture::create_storage(job.target, face.get_format(), levels[0].width, levels[0].height,
+                                          static_cast<int>(levels.size()),
+                                          job.target == GL_TEXTURE_CUBE_MAP ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    job.format = face.get_format();
+    job.width = levels[0].width;
+    job.height = levels[0].height;
+    job.levels = static_cast<int>(levels.size());
+  }
+
+  job.texture->upload_levels(static_cast<int>(job.next_face), face.get_format(), levels);
+
+#ifndef HAVE_OPENGLES2
+  // the slot can be reused once the GPU has copied the pixels out
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  m_next_slot = (m_next_slot + 1) % m_slots.size();
+#endif
+
+  assert_gl("TextureUploader::upload_face");
+
+  return UploadResult::Done;
+}
+
+void
+TextureUploader::finish(Job& job)
+{
+  // the placeholder or the old image goes away with job.texture
+  job.handle->swap(*job.texture);
+  m_textures += 1;
+}
+
+TexturePtr
+TextureUploader::create_placeholder(GLenum target)
+{
+  OpenGLState state;
+
+  const uint8_t gray[3] = { 128, 128, 128 };
+
+  GLuint id;
+  glGenTextures(1, &id);
+  glBindTexture(target, id);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+#ifndef HAVE_OPENGLES2
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+  for(int face = 0; face < (target == GL_TEXTURE_CUBE_MAP ? 6 : 1); ++face)
+  {
+    glTexImage2D(Texture::get_face_target(target, face), 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, gray);
+  }
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(target, 0);
+
+  return std::make_shared<Texture>(target, id);
+}
+
+void
+TextureUploader::log_stats() const
+{
+  log_info("TextureUploader: %d textures, %.1fMiB resident after %.1fms, %.1fms of it on the render thread",
+           m_textures, static_cast<float>(m_bytes) / (1024.0f * 1024.0f),
+           seconds_since(m_start) * 1000.0f, m_upload_time * 1000.0f);
+}
+
+/* EOF */
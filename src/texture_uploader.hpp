@@ -0,0 +1,155 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_TEXTURE_UPLOADER_HPP
+#define HEADER_TEXTURE_UPLOADER_HPP
+
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "texture.hpp"
+#include "texture_cache_file.hpp"
+#include "thread_pool.hpp"
+
+/** Loads image files without blocking the render thread: reading the
+    TextureCacheFile, or transcoding the image on a cache miss, runs
+    on the ThreadPool, the texture data are streamed to the GPU through
+    a ring of pixel buffer objects from update(). load() returns a
+    Texture right away, it shows a single gray pixel until the real
+    data is resident. Render thread only, apart from the decoding. */
+class TextureUploader
+{
+public:
+  /** The uploader of the current GLContext, which owns it and destroys
+      it before the context itself */
+  static TextureUploader& get();
+  static void set_current(TextureUploader* uploader);
+
+private:
+  static TextureUploader* s_current;
+
+private:
+  struct Job
+  {
+    /** Receives the finished texture via Texture::swap() */
+    TexturePtr handle;
+
+    GLenum target;
+    bool build_mipmaps;
+    std::string filename;
+
+    /** One image for 2D textures, six for cube maps */
+    std::vector<std::shared_future<std::shared_ptr<TextureCacheFile> > > faces;
+    size_t next_face;
+
+    /** The texture being filled, created with the first face, the
+        other faces have to match its format and size */
+    TexturePtr texture;
+    TextureFormat format;
+    int width;
+    int height;
+    int levels;
+  };
+
+  enum class UploadResult
+  {
+    Done,
+
+    /** No pixel buffer is free yet, try again in the next update() */
+    Busy,
+
+    /** The face couldn't be uploaded, the job has to be dropped */
+    Failed
+  };
+
+#ifndef HAVE_OPENGLES2
+  struct Slot
+  {
+    GLuint buffer;
+    size_t capacity;
+    GLsync fence;
+  };
+#endif
+
+private:
+  ThreadPool& m_pool;
+  std::deque<Job> m_jobs;
+
+#ifndef HAVE_OPENGLES2
+  /** Ring of pixel buffer objects, a slot is reused once the GPU is
+      done copying out of it. The buffers are created on first use, so
+      that the uploader can be constructed before glewInit(). OpenGL
+      ES 2 has none and uploads straight from the decoded image. */
+  std::vector<Slot> m_slots;
+  size_t m_next_slot;
+#endif
+
+  /** Bytes to upload per update() */
+  size_t m_budget;
+
+  // statistics for log_stats(), since the queue was last empty
+  int m_textures;
+  size_t m_bytes;
+  float m_upload_time;
+  std::chrono::steady_clock::time_point m_start;
+
+public:
+  TextureUploader(ThreadPool& pool = ThreadPool::get(), size_t num_slots = 4);
+  ~TextureUploader();
+
+  /** Start loading \a filename, the returned Texture fills in later */
+  TexturePtr load(const std::string& filename, bool build_mipmaps = true);
+
+  /** Start loading the six faces of a cube map, \a prefix is completed
+      with up.png, dn.png, ... as in Texture::cubemap_from_file() */
+  TexturePtr load_cubemap(const std::string& prefix);
+
+  /** Load \a filename into the existing \a texture, which keeps its
+      old content until the new one is complete or on failure */
+  void reload(TexturePtr texture, const std::string& filename, bool build_mipmaps = true);
+  void reload_cubemap(TexturePtr texture, const std::string& prefix);
+
+  /** Upload decoded images until the budget is used up, at least one
+      face with all its levels per call so that loading always progresses */
+  void update();
+
+  bool is_busy() const { return !m_jobs.empty(); }
+
+  void set_budget(size_t bytes) { m_budget = bytes; }
+
+  void log_stats() const;
+
+private:
+  void queue(TexturePtr handle, GLenum target, bool build_mipmaps,
+             const std::string& filename, std::vector<std::string> const& face_files);
+
+  UploadResult upload_face(Job& job, const TextureCacheFile& face);
+  void finish(Job& job);
+
+  static TexturePtr create_placeholder(GLenum target);
+
+private:
+  TextureUploader(const TextureUploader&) = delete;
+  TextureUploader& operator=(const TextureUploader&) = delete;
+};
+
+#endif
+
+/* EOF */
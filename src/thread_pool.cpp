@@ -0,0 +1,77 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int num_threads) :
+  m_threads(),
+  m_jobs(),
+  m_mutex(),
+  m_cond(),
+  m_quit(false)
+{
+  if (num_threads == 0)
+  {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for(unsigned int i = 0; i < num_threads; ++i)
+  {
+    m_threads.emplace_back([this]{ run(); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_quit = true;
+  }
+  m_cond.notify_all();
+
+  for(auto& thread : m_threads)
+  {
+    thread.join();
+  }
+}
+
+void
+ThreadPool::run()
+{
+  while(true)
+  {
+    std::function<void ()> job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this]{ return m_quit || !m_jobs.empty(); });
+
+      if (m_jobs.empty())
+      {
+        // only reached when m_quit is set, pending jobs get drained first
+        return;
+      }
+
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+
+    job();
+  }
+}
+
+/* EOF */
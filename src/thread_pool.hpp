@@ -0,0 +1,82 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_THREAD_POOL_HPP
+#define HEADER_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/** Fixed set of worker threads processing jobs in FIFO order. Jobs
+    must not touch OpenGL, results are handed back via std::future to
+    be consumed on the main thread. */
+class ThreadPool
+{
+public:
+  static ThreadPool& get()
+  {
+    static ThreadPool instance;
+    return instance;
+  }
+
+private:
+  std::vector<std::thread> m_threads;
+  std::deque<std::function<void ()> > m_jobs;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  bool m_quit;
+
+public:
+  /** Create a pool with \a num_threads workers, 0 picks one per core */
+  ThreadPool(unsigned int num_threads = 0);
+  ~ThreadPool();
+
+  template<typename F>
+  std::future<typename std::result_of<F()>::type> schedule(F&& func)
+  {
+    typedef typename std::result_of<F()>::type Result;
+
+    // std::function needs a copyable target, packaged_task isn't
+    auto task = std::make_shared<std::packaged_task<Result ()> >(std::forward<F>(func));
+    std::future<Result> future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobs.emplace_back([task]{ (*task)(); });
+    }
+    m_cond.notify_one();
+    return future;
+  }
+
+  size_t get_num_threads() const { return m_threads.size(); }
+
+private:
+  void run();
+
+private:
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+};
+
+#endif
+
+/* EOF */
@@ -26,7 +26,7 @@ Uniform<UniformSymbol>::apply(ProgramPtr prog, RenderContext const& ctx)
   switch(m_value)
   {
     case UniformSymbol::NormalMatrix:
-      prog->set_uniform(m_name, glm::mat3(ctx.get_view_matrix() * ctx.get_model_matrix()));
+      prog->set_uniform(m_name, glm::mat3(ctx.get_view_matrix() * ctx.get_node_matrix()));
       break;
 
     case UniformSymbol::ViewMatrix:
@@ -66,6 +66,11 @@ void
 UniformGroup::apply(ProgramPtr prog, RenderContext const& ctx)
 {
   assert_gl("apply:enter");
+  if (m_parent)
+  {
+    m_parent->apply(prog, ctx);
+  }
+
   for(auto& uniform_it : m_uniforms)
   {
     uniform_it.second->apply(prog, ctx);
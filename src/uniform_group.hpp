@@ -106,13 +106,19 @@ public:
   void apply(ProgramPtr prog, RenderContext const& ctx);
 };
 
+typedef std::shared_ptr<UniformGroup> UniformGroupPtr;
+
 class UniformGroup
 {
 private:
+  /** Applied before this group's own uniforms, which thus override
+      the parent's */
+  UniformGroupPtr m_parent;
   std::unordered_map<std::string, std::unique_ptr<UniformBase> > m_uniforms;
 
 public:
-  UniformGroup() :
+  UniformGroup(UniformGroupPtr parent = {}) :
+    m_parent(parent),
     m_uniforms()
   {}
 
@@ -123,6 +129,8 @@ public:
     m_uniforms[name] = std::make_unique<Uniform<T> >(name, value);
   }
 
+  void set_parent(UniformGroupPtr parent) { m_parent = parent; }
+
   void apply(ProgramPtr prog, RenderContext const& ctx);
 
 private:
@@ -130,8 +138,6 @@ private:
   UniformGroup& operator=(const UniformGroup&);
 };
 
-typedef std::shared_ptr<UniformGroup> UniformGroupPtr;
-
 #endif
 
 /* EOF */
@@ -0,0 +1,76 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "vertex_format.hpp"
+
+#include <stdexcept>
+#include <string.h>
+
+VertexData
+VertexData::interleave(std::vector<VertexSource> const& sources)
+{
+  if (sources.empty())
+  {
+    throw std::runtime_error("no arrays to interleave");
+  }
+
+  VertexData result{ VertexFormat(), {}, sources.front().count, glm::mat4(1.0f) };
+  for(auto const& source : sources)
+  {
+    if (source.count != result.count)
+    {
+      throw std::runtime_error("element count does not match");
+    }
+    result.format.add(source.name, source.type, source.size);
+  }
+
+  const int stride = result.format.get_stride();
+  result.data.resize(static_cast<size_t>(stride) * result.count);
+  auto const& attributes = result.format.get_attributes();
+  for(size_t i = 0; i < sources.size(); ++i)
+  {
+    const size_t size = sources[i].size * 4;
+    const uint8_t* src = static_cast<const uint8_t*>(sources[i].data);
+    uint8_t* dst = result.data.data() + attributes[i].offset;
+    for(int v = 0; v < result.count; ++v)
+    {
+      memcpy(dst, src, size);
+      src += size;
+      dst += stride;
+    }
+  }
+
+  return result;
+}
+
+VertexData
+VertexData::gather(std::vector<int> const& vertices) const
+{
+  const size_t stride = format.get_stride();
+
+  VertexData result{ format, {}, static_cast<int>(vertices.size()), transform };
+  result.data.resize(stride * vertices.size());
+  uint8_t* dst = result.data.data();
+  for(int v : vertices)
+  {
+    memcpy(dst, data.data() + stride * v, stride);
+    dst += stride;
+  }
+
+  return result;
+}
+
+/* EOF */
@@ -0,0 +1,177 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_VERTEX_FORMAT_HPP
+#define HEADER_VERTEX_FORMAT_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "opengl.hpp"
+
+/** Attribute locations are fixed per name and bound by Program::link(),
+    so a Mesh's vertex array object fits every program without having
+    to query locations on each draw */
+class VertexAttribute
+{
+public:
+  enum Location
+  {
+    Position,
+    Normal,
+    Texcoord,
+    BoneWeight,
+    BoneIndex,
+    PointSize,
+    Alpha,
+    Count
+  };
+
+  static const char* get_name(int location)
+  {
+    static const char* names[Count] = {
+      "position", "normal", "texcoord", "bone_weight", "bone_index", "point_size", "alpha"
+    };
+    return names[location];
+  }
+
+  /** Returns -1 for names that have no fixed location */
+  static int get_location(const std::string& name)
+  {
+    for(int i = 0; i < Count; ++i)
+    {
+      if (name == get_name(i))
+      {
+        return i;
+      }
+    }
+    return -1;
+  }
+};
+
+/** Layout of the vertices in an interleaved vertex buffer, the
+    attributes follow each other in the order they are added */
+class VertexFormat
+{
+public:
+  enum class Type { Float, Integer };
+
+  struct Attribute
+  {
+    std::string name;
+    Type type;
+    int size;
+    int offset;
+
+    /** GL_FLOAT, GL_INT or one of the packed formats */
+    GLenum component;
+    bool normalized;
+  };
+
+private:
+  std::vector<Attribute> m_attributes;
+  int m_stride;
+
+public:
+  VertexFormat() :
+    m_attributes(),
+    m_stride(0)
+  {}
+
+  /** Add an attribute of \a size 32-bit components */
+  void add(const std::string& name, Type type, int size)
+  {
+    add_packed(name, type == Type::Integer ? GL_INT : GL_FLOAT, size, false, size * 4);
+  }
+
+  /** Add an attribute stored as \a component taking \a bytes per
+      vertex, it gets padded to keep the attributes 4-byte aligned */
+  void add_packed(const std::string& name, GLenum component, int size, bool normalized, int bytes)
+  {
+    Type type = (component == GL_INT) ? Type::Integer : Type::Float;
+    m_attributes.push_back({ name, type, size, m_stride, component, normalized });
+    m_stride += (bytes + 3) & ~3;
+  }
+
+  std::vector<Attribute> const& get_attributes() const { return m_attributes; }
+
+  /** Bytes from one vertex to the next */
+  int get_stride() const { return m_stride; }
+};
+
+/** One attribute array that is to be interleaved, \a data is tightly
+    packed and holds \a count elements of \a size components */
+struct VertexSource
+{
+  std::string name;
+  VertexFormat::Type type;
+  int size;
+  const void* data;
+  int count;
+
+  VertexSource(const std::string& name_, const float* data_, int size_, int count_) :
+    name(name_), type(VertexFormat::Type::Float), size(size_), data(data_), count(count_)
+  {}
+
+  VertexSource(const std::string& name_, const int* data_, int size_, int count_) :
+    name(name_), type(VertexFormat::Type::Integer), size(size_), data(data_), count(count_)
+  {}
+
+  VertexSource(const std::string& name_, const std::vector<float>& vec) :
+    VertexSource(name_, vec.data(), 1, static_cast<int>(vec.size()))
+  {}
+
+  VertexSource(const std::string& name_, const std::vector<glm::vec2>& vec) :
+    VertexSource(name_, reinterpret_cast<const float*>(vec.data()), 2, static_cast<int>(vec.size()))
+  {}
+
+  VertexSource(const std::string& name_, const std::vector<glm::vec3>& vec) :
+    VertexSource(name_, reinterpret_cast<const float*>(vec.data()), 3, static_cast<int>(vec.size()))
+  {}
+
+  VertexSource(const std::string& name_, const std::vector<glm::vec4>& vec) :
+    VertexSource(name_, reinterpret_cast<const float*>(vec.data()), 4, static_cast<int>(vec.size()))
+  {}
+
+  VertexSource(const std::string& name_, const std::vector<glm::ivec4>& vec) :
+    VertexSource(name_, reinterpret_cast<const int*>(vec.data()), 4, static_cast<int>(vec.size()))
+  {}
+};
+
+/** Interleaved vertices, ready for Mesh::attach_vertex_data() */
+struct VertexData
+{
+  VertexFormat format;
+  std::vector<uint8_t> data;
+  int count;
+
+  /** Maps the stored positions into model space, the identity unless
+      they are quantized */
+  glm::mat4 transform;
+
+  /** Interleave the \a sources without changing their formats */
+  static VertexData interleave(std::vector<VertexSource> const& sources);
+
+  /** The vertices at the given indices, in that order */
+  VertexData gather(std::vector<int> const& vertices) const;
+};
+
+#endif
+
+/* EOF */
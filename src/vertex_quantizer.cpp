@@ -0,0 +1,269 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "vertex_quantizer.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+#include <string.h>
+#define GLM_FORCE_RADIANS
+#include <glm/ext.hpp>
+
+// OpenGL ES 2 lacks these, Mesh::attach_quantized() doesn't use them there
+#ifndef GL_HALF_FLOAT
+#  define GL_HALF_FLOAT 0x140B
+#endif
+#ifndef GL_INT_2_10_10_10_REV
+#  define GL_INT_2_10_10_10_REV 0x8D9F
+#endif
+
+namespace {
+
+/** How one source gets written into the vertex */
+struct Packer
+{
+  enum Kind { Copy, Position, Normal, TexcoordUNorm, TexcoordHalf, Weight } kind;
+  const VertexSource* source;
+  int offset;
+  int components;
+};
+
+uint16_t to_unorm16(float value)
+{
+  return static_cast<uint16_t>(lroundf(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+} // namespace
+
+VertexData
+VertexQuantizer::quantize(std::vector<VertexSource> const& sources)
+{
+  if (sources.empty())
+  {
+    throw std::runtime_error("no arrays to quantize");
+  }
+
+  VertexData result{ VertexFormat(), {}, sources.front().count, glm::mat4(1.0f) };
+
+  glm::vec3 bbox_min(0.0f);
+  glm::vec3 bbox_scale(1.0f);
+
+  std::vector<Packer> packers;
+  for(auto const& source : sources)
+  {
+    if (source.count != result.count)
+    {
+      throw std::runtime_error("element count does not match");
+    }
+
+    const int offset = result.format.get_stride();
+    const float* data = static_cast<const float*>(source.data);
+    const bool is_float = source.type == VertexFormat::Type::Float;
+
+    if (is_float && source.name == "position" && source.size == 3 && source.count > 0)
+    {
+      glm::vec3 bbox_max = bbox_min = glm::vec3(data[0], data[1], data[2]);
+      for(int i = 0; i < source.count; ++i)
+      {
+        glm::vec3 p(data[3*i + 0], data[3*i + 1], data[3*i + 2]);
+        bbox_min = glm::min(bbox_min, p);
+        bbox_max = glm::max(bbox_max, p);
+      }
+
+      bbox_scale = bbox_max - bbox_min;
+      for(int c = 0; c < 3; ++c)
+      {
+        // flat along one axis, any scale reproduces it
+        if (bbox_scale[c] == 0.0f)
+        {
+          bbox_scale[c] = 1.0f;
+        }
+      }
+
+      result.transform = glm::scale(glm::translate(glm::mat4(1.0f), bbox_min), bbox_scale);
+      result.format.add_packed(source.name, GL_UNSIGNED_SHORT, 3, true, 6);
+      packers.push_back({ Packer::Position, &source, offset, 3 });
+    }
+    else if (is_float && source.name == "normal" && source.size == 3)
+    {
+      result.format.add_packed(source.name, GL_INT_2_10_10_10_REV, 4, true, 4);
+      packers.push_back({ Packer::Normal, &source, offset, 3 });
+    }
+    else if (is_float && source.name == "texcoord" && (source.size == 2 || source.size == 3))
+    {
+      // the third component is mostly unused and defaults to zero
+      bool unit = true;
+      bool flat = true;
+      for(int i = 0; i < source.count * source.size; ++i)
+      {
+        unit = unit && data[i] >= 0.0f && data[i] <= 1.0f;
+        if (i % source.size == 2)
+        {
+          flat = flat && data[i] == 0.0f;
+        }
+      }
+
+      int components = flat ? 2 : source.size;
+      if (unit)
+      {
+        result.format.add_packed(source.name, GL_UNSIGNED_SHORT, components, true, 2 * components);
+        packers.push_back({ Packer::TexcoordUNorm, &source, offset, components });
+      }
+      else
+      {
+        result.format.add_packed(source.name, GL_HALF_FLOAT, components, false, 2 * components);
+        packers.push_back({ Packer::TexcoordHalf, &source, offset, components });
+      }
+    }
+    else if (is_float && source.name == "bone_weight" && source.size == 4)
+    {
+      result.format.add_packed(source.name, GL_UNSIGNED_BYTE, 4, true, 4);
+      packers.push_back({ Packer::Weight, &source, offset, 4 });
+    }
+    else
+    {
+      result.format.add(source.name, source.type, source.size);
+      packers.push_back({ Packer::Copy, &source, offset, source.size });
+    }
+  }
+
+  const int stride = result.format.get_stride();
+  result.data.resize(static_cast<size_t>(stride) * result.count);
+
+  for(auto const& packer : packers)
+  {
+    const VertexSource& source = *packer.source;
+    const float* src = static_cast<const float*>(source.data);
+    uint8_t* dst = result.data.data() + packer.offset;
+
+    for(int i = 0; i < result.count; ++i, src += source.size, dst += stride)
+    {
+      switch(packer.kind)
+      {
+        case Packer::Copy:
+          memcpy(dst, src, source.size * 4);
+          break;
+
+        case Packer::Position:
+          {
+            uint16_t v[3];
+            for(int c = 0; c < 3; ++c)
+            {
+              v[c] = to_unorm16((src[c] - bbox_min[c]) / bbox_scale[c]);
+            }
+            memcpy(dst, v, sizeof(v));
+          }
+          break;
+
+        case Packer::Normal:
+          {
+            uint32_t v = pack_normal(glm::vec3(src[0], src[1], src[2]));
+            memcpy(dst, &v, sizeof(v));
+          }
+          break;
+
+        case Packer::TexcoordUNorm:
+        case Packer::TexcoordHalf:
+          {
+            uint16_t v[3];
+            for(int c = 0; c < packer.components; ++c)
+            {
+              v[c] = (packer.kind == Packer::TexcoordUNorm) ? to_unorm16(src[c]) : to_half(src[c]);
+            }
+            memcpy(dst, v, 2 * packer.components);
+          }
+          break;
+
+        case Packer::Weight:
+          for(int c = 0; c < 4; ++c)
+          {
+            dst[c] = static_cast<uint8_t>(lroundf(glm::clamp(src[c], 0.0f, 1.0f) * 255.0f));
+          }
+          break;
+      }
+    }
+  }
+
+  return result;
+}
+
+uint16_t
+VertexQuantizer::to_half(float value)
+{
+  uint32_t f;
+  memcpy(&f, &value, sizeof(f));
+
+  const uint32_t sign = (f >> 16) & 0x8000;
+  const int exponent = static_cast<int>((f >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = f & 0x7fffff;
+
+  if (((f >> 23) & 0xff) == 0xff)
+  {
+    // inf and nan
+    return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+  }
+  else if (exponent >= 31)
+  {
+    return static_cast<uint16_t>(sign | 0x7c00);
+  }
+  else if (exponent <= 0)
+  {
+    if (exponent < -10)
+    {
+      return static_cast<uint16_t>(sign);
+    }
+    else
+    {
+      // denormal
+      mantissa |= 0x800000;
+      const int shift = 14 - exponent;
+      uint32_t half = mantissa >> shift;
+      const uint32_t rest = mantissa & ((1u << shift) - 1);
+      const uint32_t halfway = 1u << (shift - 1);
+      if (rest > halfway || (rest == halfway && (half & 1)))
+      {
+        half += 1;
+      }
+      return static_cast<uint16_t>(sign | half);
+    }
+  }
+  else
+  {
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1fff;
+    // a carry out of the mantissa correctly bumps the exponent
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+    {
+      half += 1;
+    }
+    return static_cast<uint16_t>(sign | half);
+  }
+}
+
+uint32_t
+VertexQuantizer::pack_normal(const glm::vec3& normal)
+{
+  uint32_t packed = 0;
+  for(int c = 0; c < 3; ++c)
+  {
+    int32_t v = static_cast<int32_t>(lroundf(glm::clamp(normal[c], -1.0f, 1.0f) * 511.0f));
+    packed |= (static_cast<uint32_t>(v) & 0x3ff) << (10 * c);
+  }
+  return packed;
+}
+
+/* EOF */
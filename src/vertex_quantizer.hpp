@@ -0,0 +1,45 @@
+//  Simple 3D Model Viewer
+//  Copyright (C) 2016 Ingo Ruhnke <grumbel@gmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADER_VERTEX_QUANTIZER_HPP
+#define HEADER_VERTEX_QUANTIZER_HPP
+
+#include <stdint.h>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "vertex_format.hpp"
+
+/** Packs float vertex attributes into smaller formats by their name:
+    positions become 16-bit relative to the bounding box, normals
+    10:10:10:2, texcoords 16-bit normalized or half floats and bone
+    weights 8-bit, everything else is copied as is */
+class VertexQuantizer
+{
+public:
+  static VertexData quantize(std::vector<VertexSource> const& sources);
+
+  /** IEEE half float, rounds to nearest even */
+  static uint16_t to_half(float value);
+
+  /** GL_INT_2_10_10_10_REV with a zero w */
+  static uint32_t pack_normal(const glm::vec3& normal);
+};
+
+#endif
+
+/* EOF */
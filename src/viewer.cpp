@@ -30,22 +30,31 @@
 #include <thread>
 #include <glm/gtx/io.hpp>
 
+#include "asset_loader.hpp"
 #include "assert_gl.hpp"
 #include "compositor.hpp"
+#include "file_watcher.hpp"
 #include "log.hpp"
 #include "material_factory.hpp"
+#include "material_parser.hpp"
 #include "menu.hpp"
 #include "mesh.hpp"
 #include "model.hpp"
 #include "opengl_state.hpp"
 #include "program.hpp"
+#include "program_cache.hpp"
 #include "render_context.hpp"
 #include "scene.hpp"
 #include "scene_manager.hpp"
 #include "shader.hpp"
 #include "system.hpp"
 #include "text_surface.hpp"
+#include "texture_cache.hpp"
+#include "texture_cache_file.hpp"
+#include "texture_uploader.hpp"
+#include "thread_pool.hpp"
 #include "renderbuffer.hpp"
+#include "render_stats.hpp"
 
 namespace {
 
@@ -61,6 +70,84 @@ void print_scene_graph(SceneNode* node, int depth = 0)
   }
 }
 
+/** Every program the viewer knows it will need, submitted together
+    at startup so that they compile while the rest gets set up */
+std::vector<ProgramCache::Variant> get_program_variants()
+{
+  std::vector<ProgramCache::Variant> variants = {
+    // Compositor
+    { "src/glsl/composite.vert", {}, "src/glsl/composite.frag", {"INTERLACED_COMPOSITION"} },
+    { "src/glsl/composite.vert", {}, "src/glsl/composite.frag", {"CROSSEYE_COMPOSITION"} },
+    { "src/glsl/composite.vert", {}, "src/glsl/composite.frag", {"ANAGLYPH_COMPOSITION"} },
+    { "src/glsl/composite.vert", {}, "src/glsl/composite.frag", {"DEPTH_COMPOSITION"} },
+    { "src/glsl/composite.vert", {}, "src/glsl/newsprint.frag", {} },
+    { "src/glsl/composite.vert", {}, "src/glsl/composite.frag", {} },
+
+    // MaterialFactory
+    { "src/glsl/basic_white.vert", {}, "src/glsl/basic_white.frag", {} },
+    { "src/glsl/phong.vert", {}, "src/glsl/phong.frag", {} },
+    { "src/glsl/cubemap.vert", {}, "src/glsl/cubemap.frag", {} },
+    { "src/glsl/textured.vert", {}, "src/glsl/textured.frag", {} },
+
+    // TextSurface
+    { "src/glsl/basic_texture.vert", {}, "src/glsl/basic_texture.frag", {} },
+
+#ifndef HAVE_OPENGLES2
+    // shadowmap pass
+    { "src/glsl/shadowmap.vert", {}, "src/glsl/shadowmap.frag", {} },
+#endif
+  };
+
+  std::vector<ProgramCache::Variant> material_variants = MaterialParser::get_default_program_variants();
+  variants.insert(variants.end(), material_variants.begin(), material_variants.end());
+
+  return variants;
+}
+
+/** Write the TextureCacheFile of each image, or of the six faces for
+    arguments ending in '/', which are cube map prefixes */
+int transcode_textures(std::vector<std::string> const& filenames)
+{
+  std::vector<std::future<std::string> > jobs;
+  for(auto const& filename : filenames)
+  {
+    bool cubemap = !filename.empty() && filename.back() == '/';
+    GLenum target = cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+
+    // there is no OpenGL context to ask, assume a desktop
+    // implementation with S3TC and RGTC
+    TextureCacheFile::Options options = Texture::get_cache_options(target, true);
+    options.s3tc = true;
+    options.rgtc = !cubemap;
+
+    std::vector<std::string> files = cubemap ? Texture::get_cubemap_files(filename) : std::vector<std::string>{ filename };
+    for(auto const& file : files)
+    {
+      jobs.push_back(ThreadPool::get().schedule([file, options]{
+            std::unique_ptr<TextureCacheFile> cache = TextureCacheFile::create(file, options);
+            return format("%s: %d levels, format %d, %d bytes",
+                          TextureCacheFile::get_cache_filename(file, options), cache->get_levels().size(),
+                          static_cast<int>(cache->get_format()), cache->get_size());
+          }));
+    }
+  }
+
+  int result = 0;
+  for(auto& job : jobs)
+  {
+    try
+    {
+      std::cout << job.get() << std::endl;
+    }
+    catch(const std::exception& err)
+    {
+      log_error("%s", err.what());
+      result = 1;
+    }
+  }
+  return result;
+}
+
 } // namespace
 
 std::unique_ptr<Framebuffer> g_shadowmap;
@@ -265,21 +352,17 @@ Viewer::init_scene(std::vector<std::string> const& model_filenames)
     material->enable(GL_CULL_FACE);
     material->enable(GL_DEPTH_TEST);
     material->set_uniform("MVP", UniformSymbol::ModelViewProjectionMatrix);
-    material->set_program(Program::create(Shader::from_file(GL_VERTEX_SHADER, "src/glsl/shadowmap.vert"),
-                                          Shader::from_file(GL_FRAGMENT_SHADER, "src/glsl/shadowmap.frag")));
+    material->set_program(ProgramCache::get().create("src/glsl/shadowmap.vert",
+                                                     "src/glsl/shadowmap.frag"));
     m_scene_manager->set_override_material(material);
   }
 #endif
 
-  // build a scene
+  // build a scene, the models stream in while the main loop is already running
+  m_asset_loader = std::make_unique<AssetLoader>();
   for(auto const& model_filename : model_filenames)
   {
-    auto node = Scene::from_file(model_filename);
-
-    std::cout << "SceneGraph(" << model_filename << "):\n";
-    print_scene_graph(node.get());
-
-    m_scene_manager->get_world()->attach_child(std::move(node));
+    m_scene_manager->get_world()->attach_child(Scene::from_file_async(model_filename, *m_asset_loader));
   }
 
 #ifndef HAVE_OPENGLES2
@@ -769,9 +852,32 @@ Viewer::main_loop(Window& window, GameController& gamecontroller)
     int delta = next - ticks;
     ticks = next;
 
+    // once for all passes, the shadow and both eyes see the same world
+    m_scene_manager->update();
     m_compositor->render(*this);
     window.swap();
 
+    // reloads only queue up work, the uploads are spread over the
+    // following frames like any other load
+    FileWatcher::get().update();
+    ProgramCache::get().update();
+    MaterialFactory::get().update();
+    TextureUploader::get().update();
+
+    if (m_asset_loader->is_busy())
+    {
+      m_asset_loader->update(m_cfg.m_upload_budget);
+
+      if (!m_asset_loader->is_busy())
+      {
+        std::cout << "SceneGraph:\n";
+        print_scene_graph(m_scene_manager->get_world());
+        MaterialFactory::get().log_stats();
+        ProgramCache::get().log_stats();
+        TextureCache::get().log_stats();
+      }
+    }
+
     SDL_Delay(1);
 
     process_events(window, gamecontroller);
@@ -800,7 +906,32 @@ Viewer::main_loop(Window& window, GameController& gamecontroller)
       std::cout << "frames: " << num_frames << " time: " << t
                 << " frame_delay: " << static_cast<float>(t) / static_cast<float>(num_frames)
                 << " fps: " << static_cast<float>(num_frames) / static_cast<float>(t) * 1000.0f
+                << " triangles/frame: " << RenderStats::get().triangles / num_frames
+                << " draws/frame: " << RenderStats::get().draw_calls / num_frames
                 << std::endl;
+      for(int pass = 0; pass < RenderStats::PassCount; ++pass)
+      {
+        RenderStats const& stats = RenderStats::get();
+        if (stats.drawn_nodes[pass] + stats.culled_nodes[pass] > 0)
+        {
+          std::cout << "  " << RenderStats::get_pass_name(pass) << " pass nodes/frame:"
+                    << " drawn: " << stats.drawn_nodes[pass] / num_frames
+                    << " culled: " << stats.culled_nodes[pass] / num_frames
+                    << std::endl;
+        }
+      }
+      if (RenderStats::get().occlusion_tested > 0)
+      {
+        RenderStats const& stats = RenderStats::get();
+        std::cout << "  occlusion nodes/frame:"
+                  << " tested: " << stats.occlusion_tested / num_frames
+                  << " culled: " << stats.occlusion_culled / num_frames
+                  << " (" << 100 * stats.occlusion_culled / stats.occlusion_tested << "%)"
+                  << " cpu us/frame: " << stats.occlusion_cpu_us / num_frames
+                  << " wait us/frame: " << stats.occlusion_wait_us / num_frames
+                  << std::endl;
+      }
+      RenderStats::get().reset();
 
       num_frames = 0;
       start_ticks = SDL_GetTicks();
@@ -878,6 +1009,26 @@ Viewer::parse_args(int argc, char** argv, Options& opts)
           ++i;
         }
       }
+      else if (strcmp("--transcode-textures", argv[i]) == 0)
+      {
+        opts.transcode_textures = true;
+      }
+      else if (strcmp("--quantize-meshes", argv[i]) == 0)
+      {
+        opts.quantize_meshes = true;
+      }
+      else if (strcmp("--lod-threshold", argv[i]) == 0)
+      {
+        if (i + 1 >= argc || sscanf(argv[i+1], "%f", &opts.lod_threshold) != 1)
+        {
+          throw std::runtime_error("expected --lod-threshold PIXELS");
+        }
+        ++i;
+      }
+      else if (strcmp("--no-occlusion-culling", argv[i]) == 0)
+      {
+        opts.occlusion_culling = false;
+      }
       else if (strcmp("--help", argv[i]) == 0 ||
                strcmp("-h", argv[i]) == 0)
       {
@@ -887,7 +1038,15 @@ Viewer::parse_args(int argc, char** argv, Options& opts)
                   << "  --wiimote          Enable Wiimote support\n"
                   << "  --video FILE       Play video\n"
                   << "  --video3d FILE     Play 3D video\n"
-                  << "  --video3d-fov H:V  Horizontal and vertical FOV\n";
+                  << "  --video3d-fov H:V  Horizontal and vertical FOV\n"
+                  << "  --transcode-textures\n"
+                  << "                     Write the texture caches of the image files\n"
+                  << "                     given as arguments and exit\n"
+                  << "  --quantize-meshes  Store vertices in 16-bit and smaller formats\n"
+                  << "  --lod-threshold PIXELS\n"
+                  << "                     Largest error of a LOD level, 0 disables LOD\n"
+                  << "  --no-occlusion-culling\n"
+                  << "                     Draw objects hidden behind others as well\n";
         exit(0);
       }
       else
@@ -908,6 +1067,11 @@ Viewer::main(int argc, char** argv)
   Options opts;
   parse_args(argc, argv, opts);
 
+  if (opts.transcode_textures)
+  {
+    return transcode_textures(opts.models);
+  }
+
   System system = System::create();
   Window window = system.create_gl_window("OpenGL Viewer", m_screen_w, m_screen_h, false, 0);
   //Joystick joystick = system.create_joystick();
@@ -930,9 +1094,15 @@ Viewer::main(int argc, char** argv)
     m_wiimote_manager = std::make_unique<WiimoteManager>();
   }
 
+  ProgramCache::get().prewarm(get_program_variants());
+
   m_compositor = std::make_unique<Compositor>(m_screen_w, m_screen_h);
   m_scene_manager = std::make_unique<SceneManager>();
 
+  Scene::set_quantize_meshes(opts.quantize_meshes);
+  Model::set_lod_threshold(opts.lod_threshold);
+  SceneManager::set_occlusion_culling(opts.occlusion_culling);
+
   if (!opts.video.filename.empty())
   {
     Gst::init(argc, argv);
@@ -18,6 +18,7 @@
 #include "wiimote_manager.hpp"
 #include "window.hpp"
 
+class AssetLoader;
 class GameController;
 class Compositor;
 
@@ -33,6 +34,10 @@ struct VideoOptions
 struct Options
 {
   bool wiimote = false;
+  bool transcode_textures = false;
+  bool quantize_meshes = false;
+  float lod_threshold = 1.0f;
+  bool occlusion_culling = true;
   VideoOptions video;
   std::vector<std::string> models = {};
 };
@@ -77,6 +82,9 @@ public:
   float m_distance_scale = 0.000f;
   float m_yaw_offset   = 0.0f;
 
+  /** Seconds per frame spent on uploading newly loaded assets */
+  float m_upload_budget = 0.004f;
+
   float m_eye_distance = 0.065f;
   float m_convergence = 1.0f;
 };
@@ -112,6 +120,7 @@ public:
   unsigned int m_hat_autorepeat = 0;
 
   std::unique_ptr<Compositor> m_compositor;
+  std::unique_ptr<AssetLoader> m_asset_loader;
   std::vector<std::unique_ptr<Entity> > m_entities;
 
 private:
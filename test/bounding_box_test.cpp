@@ -0,0 +1,69 @@
+#include "bounding_box.hpp"
+#include "frustum.hpp"
+
+#include <iostream>
+#include <glm/ext.hpp>
+
+std::ostream& operator<<(std::ostream& os, BoundingBox const& box)
+{
+  return os << "(" << box.min.x << ", " << box.min.y << ", " << box.min.z << ") - ("
+            << box.max.x << ", " << box.max.y << ", " << box.max.z << ")";
+}
+
+namespace {
+
+bool expect(const char* name, bool result)
+{
+  if (!result)
+  {
+    std::cout << name << ": failed" << std::endl;
+  }
+  return result;
+}
+
+bool near(glm::vec3 const& lhs, glm::vec3 const& rhs)
+{
+  return glm::all(glm::lessThanEqual(glm::abs(lhs - rhs), glm::vec3(1e-5f)));
+}
+
+} // namespace
+
+int main()
+{
+  bool ok = true;
+
+  BoundingBox box;
+  std::cout << "empty: " << box.is_empty() << std::endl;
+  ok &= expect("empty", box.is_empty());
+  box.add(glm::vec3(-1.0f, -1.0f, -1.0f));
+  box.add(glm::vec3(1.0f, 2.0f, 1.0f));
+  std::cout << "box: " << box << std::endl;
+  ok &= expect("box", !box.is_empty() &&
+               box.min == glm::vec3(-1.0f, -1.0f, -1.0f) && box.max == glm::vec3(1.0f, 2.0f, 1.0f));
+
+  // rotated by 45 degrees around y and moved, the box grows to hold
+  // the rotated corners
+  glm::mat4 matrix = glm::translate(glm::vec3(10.0f, 0.0f, 0.0f)) *
+                     glm::rotate(glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  BoundingBox transformed = box.transform(matrix);
+  std::cout << "transformed: " << transformed << std::endl;
+  const float r = glm::sqrt(2.0f);
+  ok &= expect("transformed",
+               near(transformed.min, glm::vec3(10.0f - r, -1.0f, -r)) &&
+               near(transformed.max, glm::vec3(10.0f + r, 2.0f, r)));
+  std::cout << "infinite: " << BoundingBox::infinite().transform(matrix).is_infinite() << std::endl;
+  ok &= expect("infinite", BoundingBox::infinite().transform(matrix).is_infinite());
+
+  // the camera at the origin looks down -z
+  Frustum frustum(glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f));
+  BoundingBox front(glm::vec3(-1.0f, -1.0f, -11.0f), glm::vec3(1.0f, 1.0f, -9.0f));
+  BoundingBox behind(glm::vec3(-1.0f, -1.0f, 9.0f), glm::vec3(1.0f, 1.0f, 11.0f));
+  std::cout << "in front: " << frustum.intersects_box(front.min, front.max) << std::endl;
+  std::cout << "behind: " << frustum.intersects_box(behind.min, behind.max) << std::endl;
+  ok &= expect("in front", frustum.intersects_box(front.min, front.max));
+  ok &= expect("behind", !frustum.intersects_box(behind.min, behind.max));
+
+  return ok ? 0 : 1;
+}
+
+/* EOF */
@@ -0,0 +1,105 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <glm/ext.hpp>
+#include <random>
+
+// the queries have to find the same boxes as testing each box on its
+// own, before and after moving some of them
+
+namespace {
+
+template<typename Test>
+std::vector<int> query_all(std::vector<BoundingBox> const& boxes, const Test& test)
+{
+  std::vector<int> result;
+  for(size_t i = 0; i < boxes.size(); ++i)
+  {
+    if (test(boxes[i]))
+    {
+      result.push_back(static_cast<int>(i));
+    }
+  }
+  return result;
+}
+
+bool check(const char* name, std::vector<int> result, std::vector<int> const& expected)
+{
+  std::sort(result.begin(), result.end());
+  std::cout << name << ": " << result.size() << " boxes, "
+            << (result == expected ? "same" : "different") << std::endl;
+  return result == expected;
+}
+
+} // namespace
+
+int main()
+{
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> position(0.0f, 100.0f);
+
+  Bvh bvh;
+  std::vector<BoundingBox> boxes;
+  for(int i = 0; i < 10000; ++i)
+  {
+    glm::vec3 center(position(rng), position(rng), position(rng));
+    boxes.emplace_back(center - glm::vec3(0.5f), center + glm::vec3(0.5f));
+    bvh.insert(boxes.back());
+  }
+  bvh.commit();
+  std::cout << "nodes: " << bvh.get_nodes().size() << std::endl;
+
+  Frustum frustum(glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 50.0f) *
+                  glm::lookAt(glm::vec3(50.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+  const BoundingBox query_box(glm::vec3(40.0f), glm::vec3(60.0f));
+
+  const glm::vec3 center(50.0f);
+  const float radius = 5.0f;
+
+  const glm::vec3 origin(0.0f);
+  const glm::vec3 direction = glm::normalize(glm::vec3(1.0f));
+  const float max_distance = 1000.0f;
+
+  bool ok = true;
+  for(int round = 0; round < 2; ++round)
+  {
+    std::vector<int> result;
+    bvh.query_frustum(frustum, result);
+    ok &= check("frustum", result, query_all(boxes, [&](BoundingBox const& box) {
+          return frustum.intersects_box(box.min, box.max);
+        }));
+
+    result.clear();
+    bvh.query_box(query_box, result);
+    ok &= check("box", result, query_all(boxes, [&](BoundingBox const& box) {
+          return glm::all(glm::lessThanEqual(box.min, query_box.max)) &&
+            glm::all(glm::greaterThanEqual(box.max, query_box.min));
+        }));
+
+    result.clear();
+    bvh.query_sphere(center, radius, result);
+    ok &= check("sphere", result, query_all(boxes, [&](BoundingBox const& box) {
+          glm::vec3 d = glm::max(glm::max(box.min - center, center - box.max), glm::vec3(0.0f));
+          return d.x * d.x + d.y * d.y + d.z * d.z <= radius * radius;
+        }));
+
+    result.clear();
+    bvh.query_ray(origin, direction, max_distance, result);
+    ok &= check("ray", result, query_all(boxes, [&](BoundingBox const& box) {
+          float distance;
+          return box.intersects_ray(origin, direction, distance) && distance <= max_distance;
+        }));
+
+    for(size_t i = 0; i < boxes.size(); i += 3)
+    {
+      boxes[i] = BoundingBox(boxes[i].min + glm::vec3(5.0f), boxes[i].max + glm::vec3(5.0f));
+      bvh.update(static_cast<int>(i), boxes[i]);
+    }
+  }
+
+  return ok ? 0 : 1;
+}
+
+/* EOF */
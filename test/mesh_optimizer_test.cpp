@@ -0,0 +1,178 @@
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <glm/ext.hpp>
+#include <random>
+
+namespace {
+
+/** The triangles of \a indices rotated to start at their smallest
+    index, which keeps the winding, and sorted */
+std::vector<std::vector<int> > get_triangles(std::vector<int> const& indices)
+{
+  std::vector<std::vector<int> > result;
+  for(size_t i = 0; i + 2 < indices.size(); i += 3)
+  {
+    std::vector<int> triangle(indices.begin() + i, indices.begin() + i + 3);
+    std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+    result.push_back(triangle);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+int count_visible(std::vector<MeshCluster> const& clusters, glm::vec3 const& eye)
+{
+  glm::mat4 projection = glm::perspective(1.5f, 1.0f, 0.1f, 100.0f);
+  glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.5f), glm::vec3(0.0f, 0.0f, 1.0f));
+  ClusterCuller culler(projection, view, glm::mat4(1.0f), ClusterCuller::FaceCulling::Back);
+  return static_cast<int>(std::count_if(clusters.begin(), clusters.end(),
+                                        [&culler](MeshCluster const& cluster) { return culler.is_visible(cluster); }));
+}
+
+} // namespace
+
+int main()
+{
+  bool ok = true;
+
+  // two triangles with one vertex per corner, the shared edge welds
+  std::vector<glm::vec3> position = {
+    glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0),
+    glm::vec3(1, 0, 0), glm::vec3(1, 1, 0), glm::vec3(0, 1, 0)
+  };
+  std::vector<int> remap;
+  const int welded = MeshOptimizer::weld({ { "position", position } }, remap);
+  std::cout << "welded: " << welded << " of " << position.size() << std::endl;
+  if (welded != 4 || remap[3] != remap[1] || remap[5] != remap[2])
+  {
+    std::cout << "welded: expected 4, with 3 onto 1 and 5 onto 2" << std::endl;
+    ok = false;
+  }
+
+  // a grid with its triangles shuffled
+  const int n = 64;
+  std::vector<int> indices;
+  for(int y = 0; y < n; ++y)
+  {
+    for(int x = 0; x < n; ++x)
+    {
+      int v = y * (n + 1) + x;
+      indices.insert(indices.end(), { v, v + 1, v + n + 1, v + 1, v + n + 2, v + n + 1 });
+    }
+  }
+
+  std::vector<int> order(indices.size() / 3);
+  for(size_t i = 0; i < order.size(); ++i)
+  {
+    order[i] = static_cast<int>(i);
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(1));
+  std::vector<int> shuffled;
+  for(int t : order)
+  {
+    shuffled.insert(shuffled.end(), indices.begin() + 3 * t, indices.begin() + 3 * t + 3);
+  }
+
+  const float acmr_shuffled = MeshOptimizer::get_acmr(shuffled);
+  std::vector<int> optimized = shuffled;
+  MeshOptimizer::optimize_vertex_cache(optimized, (n + 1) * (n + 1));
+  const float acmr_optimized = MeshOptimizer::get_acmr(optimized);
+  std::cout << "ACMR shuffled: " << acmr_shuffled << std::endl;
+  std::cout << "ACMR optimized: " << acmr_optimized << std::endl;
+  if (acmr_optimized >= acmr_shuffled)
+  {
+    std::cout << "ACMR optimized: expected less than shuffled" << std::endl;
+    ok = false;
+  }
+  if (get_triangles(optimized) != get_triangles(shuffled))
+  {
+    std::cout << "optimize_vertex_cache: triangles changed" << std::endl;
+    ok = false;
+  }
+
+  std::vector<int> fetch_remap;
+  const int used = MeshOptimizer::optimize_vertex_fetch(optimized, (n + 1) * (n + 1), fetch_remap);
+  std::cout << "used vertices: " << used << std::endl;
+  if (used != (n + 1) * (n + 1))
+  {
+    std::cout << "used vertices: expected " << (n + 1) * (n + 1) << std::endl;
+    ok = false;
+  }
+
+  // the grid bent into a half pipe with the normals pointing out,
+  // seen from below the clusters face away
+  std::vector<glm::vec3> grid;
+  for(int y = 0; y <= n; ++y)
+  {
+    for(int x = 0; x <= n; ++x)
+    {
+      float a = static_cast<float>(x) / n * 3.14159f;
+      grid.emplace_back(cosf(a), sinf(a), static_cast<float>(y) / n);
+    }
+  }
+
+  std::vector<int> clustered = indices;
+  std::vector<MeshCluster> clusters = MeshOptimizer::build_clusters(clustered, grid);
+  std::cout << "clusters: " << clusters.size() << std::endl;
+  int covered = 0;
+  for(auto const& cluster : clusters)
+  {
+    std::cout << "  " << cluster.first << " " << cluster.count / 3 << " triangles, cone cutoff "
+              << cluster.cone_cutoff << std::endl;
+    if (cluster.first != covered ||
+        cluster.count / 3 < MeshOptimizer::s_cluster_min_triangles ||
+        cluster.count / 3 > MeshOptimizer::s_cluster_max_triangles)
+    {
+      std::cout << "  expected " << MeshOptimizer::s_cluster_min_triangles << " to "
+                << MeshOptimizer::s_cluster_max_triangles << " triangles starting at " << covered << std::endl;
+      ok = false;
+    }
+    covered = cluster.first + cluster.count;
+  }
+  if (covered != static_cast<int>(clustered.size()) || get_triangles(clustered) != get_triangles(indices))
+  {
+    std::cout << "clusters: expected to cover all " << indices.size() / 3 << " triangles once" << std::endl;
+    ok = false;
+  }
+
+  // seen from the open side the clusters face away, from the other
+  // side they face the camera, so it isn't the frustum hiding them
+  const int visible_inside = count_visible(clusters, glm::vec3(0.0f, -5.0f, 0.5f));
+  const int visible_outside = count_visible(clusters, glm::vec3(0.0f, 5.0f, 0.5f));
+  std::cout << "visible: " << visible_inside << " from the open side, "
+            << visible_outside << " from the other side" << std::endl;
+  if (visible_inside >= static_cast<int>(clusters.size()) || visible_outside <= visible_inside)
+  {
+    std::cout << "visible: expected the back facing clusters to be culled" << std::endl;
+    ok = false;
+  }
+
+  // the half pipe has 8192 triangles, each level should halve them
+  std::vector<int> lod_indices;
+  std::vector<MeshLod> lods = MeshSimplifier::build_lods(indices, grid, lod_indices);
+  size_t target = indices.size() / 3;
+  for(auto const& lod : lods)
+  {
+    target /= 2;
+    const size_t triangles = static_cast<size_t>(lod.count) / 3;
+    std::cout << "lod: " << triangles << " triangles, error " << lod.error << std::endl;
+    if (triangles > target || triangles <= target / 2)
+    {
+      std::cout << "lod: expected close to " << target << " triangles" << std::endl;
+      ok = false;
+    }
+  }
+  if (lods.size() != static_cast<size_t>(MeshSimplifier::s_max_levels))
+  {
+    std::cout << "lod: expected " << MeshSimplifier::s_max_levels << " levels" << std::endl;
+    ok = false;
+  }
+
+  return ok ? 0 : 1;
+}
+
+/* EOF */
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <stdlib.h>
+
+#include "mipmap.hpp"
+
+namespace {
+
+Image make_checker(int width, int height, int bytes_per_pixel)
+{
+  Image image(width, height, bytes_per_pixel);
+  for(int y = 0; y < height; ++y)
+    for(int x = 0; x < width; ++x)
+      for(int c = 0; c < bytes_per_pixel; ++c)
+      {
+        image.pixels[(y * width + x) * bytes_per_pixel + c] = ((x + y) % 2) ? 255 : 0;
+      }
+  return image;
+}
+
+/** Each level has to halve the size of the previous one, rounding
+    down, and all levels below the first have to come out gray, up to
+    \a tolerance */
+bool check_chain(const char* name, const Image& image, MipmapFilter filter, int tolerance)
+{
+  std::vector<Image> levels = Mipmap::generate(image, filter);
+
+  bool ok = true;
+  std::cout << name << ":";
+  for(size_t i = 0; i < levels.size(); ++i)
+  {
+    Image const& level = levels[i];
+    std::cout << " " << level.width << "x" << level.height
+              << "(" << static_cast<int>(level.pixels[0]) << ")";
+
+    if (i == 0)
+    {
+      ok = ok && level.pixels == image.pixels;
+    }
+    else
+    {
+      ok = ok &&
+        level.width == std::max(1, levels[i - 1].width / 2) &&
+        level.height == std::max(1, levels[i - 1].height / 2) &&
+        level.bytes_per_pixel == image.bytes_per_pixel &&
+        level.pixels.size() == level.get_pitch() * level.height;
+      for(uint8_t pixel : level.pixels)
+      {
+        ok = ok && abs(pixel - 128) <= tolerance;
+      }
+    }
+  }
+
+  ok = ok && static_cast<int>(levels.size()) == Mipmap::get_num_levels(image.width, image.height);
+
+  std::cout << (ok ? "" : " failed") << std::endl;
+  return ok;
+}
+
+} // namespace
+
+int main()
+{
+  bool ok = true;
+
+  // a checker board averages out to gray, exactly so with the box
+  // filter on even sizes, the odd sizes and the wider Kaiser window
+  // see more of one color at the borders
+  ok &= check_chain("box 8x8 rgb", make_checker(8, 8, 3), MipmapFilter::Box, 0);
+  ok &= check_chain("box 5x3 rgba", make_checker(5, 3, 4), MipmapFilter::Box, 32);
+  ok &= check_chain("kaiser 64x16 rgb", make_checker(64, 16, 3), MipmapFilter::Kaiser, 32);
+  ok &= check_chain("kaiser 1x7 rgba", make_checker(1, 7, 4), MipmapFilter::Kaiser, 32);
+
+  std::cout << "levels 1x1: " << Mipmap::get_num_levels(1, 1) << std::endl;
+  std::cout << "levels 640x480: " << Mipmap::get_num_levels(640, 480) << std::endl;
+  ok &= Mipmap::get_num_levels(1, 1) == 1;
+  ok &= Mipmap::get_num_levels(640, 480) == 10;
+
+  return ok ? 0 : 1;
+}
+
+/* EOF */
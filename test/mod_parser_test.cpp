@@ -0,0 +1,86 @@
+#include <fstream>
+#include <iostream>
+
+#include "mod_parser.hpp"
+
+namespace {
+
+bool operator==(ModObject const& lhs, ModObject const& rhs)
+{
+  return
+    lhs.name == rhs.name &&
+    lhs.parent == rhs.parent &&
+    lhs.material == rhs.material &&
+    lhs.location == rhs.location &&
+    lhs.rotation == rhs.rotation &&
+    lhs.scale == rhs.scale &&
+    lhs.normal == rhs.normal &&
+    lhs.position == rhs.position &&
+    lhs.texcoord == rhs.texcoord &&
+    lhs.index == rhs.index &&
+    lhs.bone_weight == rhs.bone_weight &&
+    lhs.bone_index == rhs.bone_index;
+}
+
+/** The baseline parser, kept as ModParser::from_istream(), never
+    cleared the bone data between objects, so each object got that of
+    the objects before it prepended. ModParser::from_file() gives each
+    object only its own, strip the rest for the comparison. */
+void strip_carried_bones(std::vector<ModObject>& objects)
+{
+  size_t weights = 0;
+  size_t indices = 0;
+  for(auto& obj : objects)
+  {
+    size_t next_weights = obj.bone_weight.size();
+    size_t next_indices = obj.bone_index.size();
+    obj.bone_weight.erase(obj.bone_weight.begin(), obj.bone_weight.begin() + weights);
+    obj.bone_index.erase(obj.bone_index.begin(), obj.bone_index.begin() + indices);
+    weights = next_weights;
+    indices = next_indices;
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    std::cout << "Usage: " << argv[0] << " FILENAME..." << std::endl;
+    return 1;
+  }
+  else
+  {
+    int result = 0;
+    for(int i = 1; i < argc; ++i)
+    {
+      std::ifstream in(argv[i]);
+      auto expected = ModParser::from_istream(in, argv[i]);
+      strip_carried_bones(expected);
+      auto objects = ModParser::from_file(argv[i]);
+
+      if (objects.size() != expected.size())
+      {
+        std::cout << argv[i] << ": object count mismatch: "
+                  << objects.size() << " != " << expected.size() << std::endl;
+        result = 1;
+      }
+      else
+      {
+        for(size_t j = 0; j < objects.size(); ++j)
+        {
+          if (!(objects[j] == expected[j]))
+          {
+            std::cout << argv[i] << ": object '" << expected[j].name << "' mismatch" << std::endl;
+            result = 1;
+          }
+        }
+        std::cout << argv[i] << ": " << objects.size() << " objects" << std::endl;
+      }
+    }
+    return result;
+  }
+}
+
+/* EOF */
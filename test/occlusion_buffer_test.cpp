@@ -0,0 +1,104 @@
+#include "occlusion_buffer.hpp"
+
+#include <iostream>
+#include <glm/ext.hpp>
+
+// a wall in front of the camera hides a box behind it, but not one in
+// front of it or one peeking out at the side, with and without the
+// wall being split into several rows of tiles
+
+namespace {
+
+const char* get_name(OcclusionBuffer::Visibility visibility)
+{
+  switch(visibility)
+  {
+    case OcclusionBuffer::Visibility::Outside: return "outside";
+    case OcclusionBuffer::Visibility::Hidden: return "hidden";
+    case OcclusionBuffer::Visibility::Visible: return "visible";
+    default: return "unknown";
+  }
+}
+
+OcclusionBuffer::Visibility test(const OcclusionBuffer& buffer, const glm::mat4& matrix, const BoundingBox& box,
+                                 int bands)
+{
+  OcclusionBuffer::Query query = buffer.project(matrix, box);
+  OcclusionBuffer::Visibility result = OcclusionBuffer::Visibility::Outside;
+  int rows = buffer.get_tile_rows();
+  for(int band = 0; band < bands; ++band)
+  {
+    OcclusionBuffer::Visibility visibility = buffer.test(query, rows * band / bands, rows * (band + 1) / bands);
+    if (visibility == OcclusionBuffer::Visibility::Visible ||
+        result == OcclusionBuffer::Visibility::Outside)
+    {
+      result = visibility;
+    }
+    if (result == OcclusionBuffer::Visibility::Visible)
+    {
+      break;
+    }
+  }
+  return result;
+}
+
+bool expect(const char* name, OcclusionBuffer::Visibility result, OcclusionBuffer::Visibility expected)
+{
+  std::cout << " " << name << " " << get_name(result);
+  if (result != expected)
+  {
+    std::cout << " (expected " << get_name(expected) << ")";
+  }
+  return result == expected;
+}
+
+} // namespace
+
+int main()
+{
+  glm::mat4 matrix = glm::perspective(glm::radians(60.0f), 320.0f / 192.0f, 0.1f, 100.0f) *
+    glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+  OccluderMesh wall;
+  wall.positions = {
+    glm::vec3(-4.0f, -4.0f, 0.0f), glm::vec3(4.0f, -4.0f, 0.0f),
+    glm::vec3(4.0f, 4.0f, 0.0f), glm::vec3(-4.0f, 4.0f, 0.0f)
+  };
+  wall.indices = { 0, 1, 2, 0, 2, 3 };
+
+  const BoundingBox behind_wall(glm::vec3(-1.0f, -1.0f, -3.0f), glm::vec3(1.0f, 1.0f, -1.0f));
+  const BoundingBox in_front(glm::vec3(-1.0f, -1.0f, 1.0f), glm::vec3(1.0f, 1.0f, 3.0f));
+  const BoundingBox at_the_side(glm::vec3(3.0f, -1.0f, -3.0f), glm::vec3(6.0f, 1.0f, -1.0f));
+  const BoundingBox around_camera(glm::vec3(-1.0f, -1.0f, 9.0f), glm::vec3(1.0f, 1.0f, 11.0f));
+
+  bool ok = true;
+  for(int bands = 1; bands <= 3; ++bands)
+  {
+    OcclusionBuffer buffer(320, 192);
+    int rows = buffer.get_tile_rows();
+    for(int band = 0; band < bands; ++band)
+    {
+      buffer.draw(matrix, wall, ClusterCuller::FaceCulling::Back, rows * band / bands, rows * (band + 1) / bands);
+    }
+
+    std::cout << bands << " bands:";
+    ok &= expect("behind", test(buffer, matrix, behind_wall, bands), OcclusionBuffer::Visibility::Hidden);
+    ok &= expect("in front", test(buffer, matrix, in_front, bands), OcclusionBuffer::Visibility::Visible);
+    ok &= expect("at the side", test(buffer, matrix, at_the_side, bands), OcclusionBuffer::Visibility::Visible);
+    ok &= expect("around the camera", test(buffer, matrix, around_camera, bands), OcclusionBuffer::Visibility::Visible);
+    std::cout << std::endl;
+  }
+
+  // seen from behind the wall is culled and hides nothing
+  OcclusionBuffer buffer(320, 192);
+  glm::mat4 behind = glm::perspective(glm::radians(60.0f), 320.0f / 192.0f, 0.1f, 100.0f) *
+    glm::lookAt(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  buffer.draw(behind, wall, ClusterCuller::FaceCulling::Back, 0, buffer.get_tile_rows());
+  std::cout << "back facing:";
+  ok &= expect("behind", test(buffer, behind, in_front, 1), OcclusionBuffer::Visibility::Visible);
+  std::cout << std::endl;
+
+  return ok ? 0 : 1;
+}
+
+/* EOF */
@@ -0,0 +1,62 @@
+#include "vertex_quantizer.hpp"
+
+#include <iostream>
+#include <string.h>
+#include <utility>
+
+int main()
+{
+  bool ok = true;
+
+  // 65520 is halfway to 65536 and rounds to even, which is inf, 6e-8
+  // rounds to the smallest denormal
+  const std::pair<float, uint16_t> halfs[] = {
+    { 0.0f, 0x0000 }, { 1.0f, 0x3c00 }, { -2.5f, 0xc100 }, { 0.1f, 0x2e66 },
+    { 65504.0f, 0x7bff }, { 65520.0f, 0x7c00 }, { 6e-8f, 0x0001 }
+  };
+  for(auto const& half : halfs)
+  {
+    uint16_t result = VertexQuantizer::to_half(half.first);
+    std::cout << "half(" << half.first << ") = 0x" << std::hex << result << std::dec;
+    if (result != half.second)
+    {
+      std::cout << ", expected 0x" << std::hex << half.second << std::dec;
+      ok = false;
+    }
+    std::cout << std::endl;
+  }
+
+  std::vector<glm::vec3> position = { glm::vec3(-1.0f, 2.0f, 0.0f), glm::vec3(3.0f, 4.0f, 0.0f) };
+  std::vector<glm::vec3> normal = { glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+  std::vector<glm::vec3> texcoord = { glm::vec3(0.0f, 0.5f, 0.0f), glm::vec3(2.0f, 1.0f, 0.0f) };
+
+  VertexData result = VertexQuantizer::quantize({ { "position", position },
+                                                  { "normal", normal },
+                                                  { "texcoord", texcoord } });
+
+  std::cout << "stride: " << result.format.get_stride() << std::endl;
+  for(auto const& attr : result.format.get_attributes())
+  {
+    std::cout << attr.name << ": offset " << attr.offset << ", " << attr.size << " components" << std::endl;
+  }
+
+  for(int i = 0; i < result.count; ++i)
+  {
+    uint16_t q[3];
+    memcpy(q, result.data.data() + i * result.format.get_stride(), sizeof(q));
+    glm::vec4 p = result.transform * glm::vec4(q[0] / 65535.0f, q[1] / 65535.0f, q[2] / 65535.0f, 1.0f);
+    std::cout << "position " << i << ": " << p.x << " " << p.y << " " << p.z << std::endl;
+
+    // 16 bits over the 4 units of the bounding box
+    if (glm::any(glm::greaterThan(glm::abs(glm::vec3(p) - position[i]), glm::vec3(1e-4f))))
+    {
+      std::cout << "position " << i << ": expected " << position[i].x << " " << position[i].y << " "
+                << position[i].z << std::endl;
+      ok = false;
+    }
+  }
+
+  return ok ? 0 : 1;
+}
+
+/* EOF */